@@ -0,0 +1,154 @@
+/* vim:set et sts=4: */
+#include <stdio.h>
+#include "matchrule.h"
+
+#define N_CONNECTIONS   100
+#define N_MESSAGES      10000
+
+static BusConnection *connections[N_CONNECTIONS];
+
+static GList *
+create_rules (BusMatchRuleIndex *index,
+              gint               n)
+{
+    GList *rules = NULL;
+    gint i;
+
+    for (i = 0; i < n; i++) {
+        BusMatchRule *rule;
+        gchar *text;
+
+        /* one broad rule per 100 rules, the others are path specific */
+        if (i % 100 == 0) {
+            text = g_strdup ("type='signal',"
+                             "interface='org.freedesktop.IBus.InputContext'");
+        }
+        else {
+            text = g_strdup_printf ("type='signal',"
+                                    "interface='org.freedesktop.IBus.InputContext',"
+                                    "member='CommitText',"
+                                    "path='/org/freedesktop/IBus/InputContext_%d'",
+                                    i);
+        }
+        rule = bus_match_rule_new (text);
+        g_free (text);
+
+        bus_match_rule_add_recipient (rule, connections[i % N_CONNECTIONS]);
+        bus_match_rule_index_add (index, rule);
+        rules = g_list_prepend (rules, rule);
+    }
+
+    return rules;
+}
+
+static gdouble
+bench_linear (GList       *rules,
+              IBusMessage *message)
+{
+    GTimer *timer;
+    gint i;
+    gdouble elapsed;
+
+    timer = g_timer_new ();
+
+    for (i = 0; i < N_MESSAGES; i++) {
+        GList *recipients = NULL;
+        GList *link;
+
+        for (link = rules; link != NULL; link = link->next) {
+            recipients = g_list_concat (recipients,
+                            bus_match_rule_get_recipients (BUS_MATCH_RULE (link->data),
+                                                           message));
+        }
+
+        for (link = recipients; link != NULL; link = link->next) {
+            g_object_unref (link->data);
+        }
+        g_list_free (recipients);
+    }
+
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    return elapsed;
+}
+
+static gdouble
+bench_index (BusMatchRuleIndex *index,
+             IBusMessage       *message)
+{
+    GTimer *timer;
+    GPtrArray *recipients;
+    gint i;
+    guint j;
+    gdouble elapsed;
+
+    recipients = g_ptr_array_new ();
+    timer = g_timer_new ();
+
+    for (i = 0; i < N_MESSAGES; i++) {
+        bus_match_rule_index_get_recipients (index, message, recipients);
+        for (j = 0; j < recipients->len; j++) {
+            g_object_unref (g_ptr_array_index (recipients, j));
+        }
+        g_ptr_array_set_size (recipients, 0);
+    }
+
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+    g_ptr_array_free (recipients, TRUE);
+
+    return elapsed;
+}
+
+int
+main (gint argc, gchar **argv)
+{
+    static const gint counts[] = { 10, 100, 1000, 10000, 0 };
+    IBusMessage *message;
+    gint i;
+
+    g_type_init ();
+
+    for (i = 0; i < N_CONNECTIONS; i++) {
+        connections[i] = bus_connection_new ();
+    }
+
+    message = ibus_message_new_signal ("/org/freedesktop/IBus/InputContext_5",
+                                       "org.freedesktop.IBus.InputContext",
+                                       "CommitText");
+
+    g_print ("%8s %16s %16s\n", "rules", "linear (us/msg)", "index (us/msg)");
+
+    for (i = 0; counts[i] != 0; i++) {
+        BusMatchRuleIndex *index;
+        GList *rules, *link;
+        gdouble linear, indexed;
+
+        index = bus_match_rule_index_new ();
+        rules = create_rules (index, counts[i]);
+
+        linear = bench_linear (rules, message);
+        indexed = bench_index (index, message);
+
+        g_print ("%8d %16.3f %16.3f\n",
+                 counts[i],
+                 linear * 1000000 / N_MESSAGES,
+                 indexed * 1000000 / N_MESSAGES);
+
+        for (link = rules; link != NULL; link = link->next) {
+            bus_match_rule_index_remove (index, BUS_MATCH_RULE (link->data));
+            g_object_unref (link->data);
+        }
+        g_list_free (rules);
+        bus_match_rule_index_free (index);
+    }
+
+    ibus_message_unref (message);
+
+    for (i = 0; i < N_CONNECTIONS; i++) {
+        g_object_unref (connections[i]);
+    }
+
+    return 0;
+}
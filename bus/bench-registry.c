@@ -0,0 +1,233 @@
+/* vim:set et sts=4: */
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "registrycache.h"
+
+#define N_ENGINES_PER_COMPONENT 3
+#define N_ROUNDS                50
+
+static GList *
+create_components (const gchar *dirname,
+                   gint         n)
+{
+    GList *components = NULL;
+    gint i, j;
+
+    for (i = 0; i < n; i++) {
+        IBusComponent *component;
+        gchar *name;
+        gchar *exec;
+
+        name = g_strdup_printf ("org.freedesktop.IBus.Bench%d", i);
+        exec = g_strdup_printf ("/usr/libexec/ibus-engine-bench%d --ibus", i);
+        component = ibus_component_new (name,
+                                        "Benchmark component",
+                                        "1.0",
+                                        "GPL",
+                                        "Nobody <nobody@example.com>",
+                                        "http://code.google.com/p/ibus",
+                                        exec,
+                                        "ibus-bench");
+        g_free (name);
+        g_free (exec);
+
+        for (j = 0; j < N_ENGINES_PER_COMPONENT; j++) {
+            IBusEngineDesc *desc;
+            gchar *engine_name;
+
+            engine_name = g_strdup_printf ("bench-%d-%d", i, j);
+            desc = ibus_engine_desc_new (engine_name,
+                                         "Benchmark engine",
+                                         "An engine which is never started",
+                                         j == 0 ? "zh_CN" : "ja",
+                                         "GPL",
+                                         "Nobody <nobody@example.com>",
+                                         "/usr/share/ibus-bench/icon.svg",
+                                         "us");
+            g_free (engine_name);
+            ibus_component_add_engine (component, desc);
+        }
+
+        ibus_component_add_observed_path (component, dirname, TRUE);
+        components = g_list_append (components, component);
+    }
+
+    return components;
+}
+
+static void
+save_xml (const gchar *filename,
+          GList       *paths,
+          GList       *components)
+{
+    GString *output;
+    GList *p;
+
+    output = g_string_new ("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n");
+    g_string_append (output, "<ibus-registry>\n");
+    g_string_append (output, "    <observed-paths>\n");
+    for (p = paths; p != NULL; p = p->next) {
+        ibus_observed_path_output ((IBusObservedPath *) p->data, output, 2);
+    }
+    g_string_append (output, "    </observed-paths>\n");
+    g_string_append (output, "    <components>\n");
+    for (p = components; p != NULL; p = p->next) {
+        ibus_component_output ((IBusComponent *) p->data, output, 2);
+    }
+    g_string_append (output, "    </components>\n");
+    g_string_append (output, "</ibus-registry>\n");
+
+    g_file_set_contents (filename, output->str, output->len, NULL);
+    g_string_free (output, TRUE);
+}
+
+/* what bus_registry_init does with registry.xml */
+static gdouble
+bench_xml (const gchar *filename)
+{
+    GTimer *timer;
+    gint i;
+    gdouble elapsed;
+
+    timer = g_timer_new ();
+
+    for (i = 0; i < N_ROUNDS; i++) {
+        XMLNode *node;
+        GList *components = NULL;
+        GList *p, *pp;
+
+        node = ibus_xml_parse_file (filename);
+        g_assert (node);
+
+        for (p = node->sub_nodes; p != NULL; p = p->next) {
+            XMLNode *sub_node = (XMLNode *) p->data;
+            if (g_strcmp0 (sub_node->name, "components") != 0)
+                continue;
+            for (pp = sub_node->sub_nodes; pp != NULL; pp = pp->next) {
+                components = g_list_append (components,
+                                ibus_component_new_from_xml_node (pp->data));
+            }
+        }
+        ibus_xml_free (node);
+
+        for (p = components; p != NULL; p = p->next) {
+            ibus_component_check_modification ((IBusComponent *) p->data);
+        }
+
+        g_list_foreach (components, (GFunc) g_object_unref, NULL);
+        g_list_free (components);
+    }
+
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    return elapsed;
+}
+
+/* startup with the binary cache: map, check paths and load the
+ * component of one engine. If load_all is TRUE every component is
+ * created, like ListEngines does. */
+static gdouble
+bench_binary (const gchar *filename,
+              gboolean     load_all)
+{
+    GTimer *timer;
+    gint i;
+    gdouble elapsed;
+
+    timer = g_timer_new ();
+
+    for (i = 0; i < N_ROUNDS; i++) {
+        BusRegistryCache *cache;
+        IBusComponent *component;
+        gint index;
+        guint j;
+
+        cache = bus_registry_cache_new_from_file (filename);
+        g_assert (cache);
+
+        bus_registry_cache_check_modification (cache);
+
+        if (load_all) {
+            for (j = 0; j < bus_registry_cache_get_n_components (cache); j++) {
+                component = bus_registry_cache_new_component (cache, j);
+                g_object_unref (component);
+            }
+        }
+        else {
+            index = bus_registry_cache_lookup_engine (cache, "bench-0-0");
+            g_assert (index >= 0);
+            component = bus_registry_cache_new_component (cache,
+                            bus_registry_cache_get_engine_component (cache, index));
+            g_object_unref (component);
+        }
+
+        bus_registry_cache_free (cache);
+    }
+
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    return elapsed;
+}
+
+int
+main (gint argc, gchar **argv)
+{
+    static const gint counts[] = { 10, 100, 500, 0 };
+    gchar *dirname;
+    gchar *xml_filename;
+    gchar *cache_filename;
+    GList *paths;
+    gint i;
+
+    g_type_init ();
+
+    dirname = g_strdup ("/tmp/ibus-bench-registry-XXXXXX");
+    if (mkdtemp (dirname) == NULL) {
+        g_warning ("Can not create temporary directory");
+        return 1;
+    }
+    xml_filename = g_build_filename (dirname, "registry.xml", NULL);
+    cache_filename = g_build_filename (dirname, "registry.cache", NULL);
+
+    paths = g_list_append (NULL, ibus_observed_path_new (dirname, TRUE));
+
+    g_print ("%10s %14s %18s %18s\n",
+             "components", "xml (ms)", "binary lazy (ms)", "binary all (ms)");
+
+    for (i = 0; counts[i] != 0; i++) {
+        GList *components;
+        gdouble xml, lazy, all;
+
+        components = create_components (dirname, counts[i]);
+        save_xml (xml_filename, paths, components);
+        bus_registry_cache_save (cache_filename, paths, components);
+
+        xml = bench_xml (xml_filename);
+        lazy = bench_binary (cache_filename, FALSE);
+        all = bench_binary (cache_filename, TRUE);
+
+        g_print ("%10d %14.3f %18.3f %18.3f\n",
+                 counts[i],
+                 xml * 1000 / N_ROUNDS,
+                 lazy * 1000 / N_ROUNDS,
+                 all * 1000 / N_ROUNDS);
+
+        g_list_foreach (components, (GFunc) g_object_unref, NULL);
+        g_list_free (components);
+    }
+
+    g_unlink (xml_filename);
+    g_unlink (cache_filename);
+    g_rmdir (dirname);
+
+    g_list_foreach (paths, (GFunc) g_object_unref, NULL);
+    g_list_free (paths);
+    g_free (xml_filename);
+    g_free (cache_filename);
+    g_free (dirname);
+
+    return 0;
+}
@@ -24,12 +24,18 @@
 #define BUS_CONNECTION_GET_PRIVATE(o)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((o), BUS_TYPE_CONNECTION, BusConnectionPrivate))
 
+/* a peer which stays over a queue limit this long is disconnected */
+#define BUS_CONNECTION_OVER_LIMIT_TIMEOUT   (5000)
+
 /* BusConnectionPriv */
 struct _BusConnectionPrivate {
     gchar *unique_name;
     /* list for well known names */
     GList  *names;
     GList  *rules;
+
+    guint peak_bytes;
+    guint over_limit_id;
 };
 typedef struct _BusConnectionPrivate BusConnectionPrivate;
 
@@ -41,6 +47,9 @@ static void     bus_connection_init         (BusConnection          *connection)
 static void     bus_connection_destroy      (BusConnection          *connection);
 static gboolean bus_connection_ibus_message (BusConnection          *connection,
                                              IBusMessage            *message);
+static void     bus_connection_ibus_message_sent
+                                            (BusConnection          *connection,
+                                             IBusMessage            *message);
 #if 0
 static gboolean bus_connection_dbus_signal  (BusConnection          *connection,
                                              DBusMessage            *message);
@@ -48,6 +57,9 @@ static gboolean bus_connection_dbus_signal  (BusConnection          *connection,
 
 static IBusObjectClass  *parent_class = NULL;
 
+static guint max_queue_bytes = 4 * 1024 * 1024;
+static guint n_over_limit_disconnects = 0;
+
 GType
 bus_connection_get_type (void)
 {
@@ -96,6 +108,8 @@ bus_connection_class_init (BusConnectionClass *klass)
 
     ibus_connection_class->ibus_message =
             (IBusIBusMessageFunc) bus_connection_ibus_message;
+    ibus_connection_class->ibus_message_sent =
+            (void (*) (IBusConnection *, IBusMessage *)) bus_connection_ibus_message_sent;
 
 }
 
@@ -108,6 +122,8 @@ bus_connection_init (BusConnection *connection)
 
     priv->unique_name = NULL;
     priv->names = NULL;
+    priv->peak_bytes = 0;
+    priv->over_limit_id = 0;
 }
 
 static void
@@ -120,6 +136,11 @@ bus_connection_destroy (BusConnection *connection)
 
     priv = BUS_CONNECTION_GET_PRIVATE (connection);
 
+    if (priv->over_limit_id != 0) {
+        g_source_remove (priv->over_limit_id);
+        priv->over_limit_id = 0;
+    }
+
     if (priv->unique_name) {
         g_free (priv->unique_name);
         priv->unique_name = NULL;
@@ -150,6 +171,55 @@ bus_connection_ibus_message (BusConnection  *connection,
     return retval;
 }
 
+static gboolean
+bus_connection_is_over_limit (BusConnection *connection)
+{
+    return bus_connection_get_queued_bytes (connection) > max_queue_bytes;
+}
+
+static gboolean
+_connection_over_limit_cb (BusConnection *connection)
+{
+    BusConnectionPrivate *priv;
+    priv = BUS_CONNECTION_GET_PRIVATE (connection);
+
+    priv->over_limit_id = 0;
+
+    /* it caught up in the meantime */
+    if (!bus_connection_is_over_limit (connection))
+        return FALSE;
+
+    g_warning ("Disconnect %s, it did not read its messages for %d seconds",
+               priv->unique_name,
+               BUS_CONNECTION_OVER_LIMIT_TIMEOUT / 1000);
+    n_over_limit_disconnects ++;
+    ibus_connection_close ((IBusConnection *) connection);
+
+    return FALSE;
+}
+
+static void
+bus_connection_ibus_message_sent (BusConnection  *connection,
+                                  IBusMessage    *message)
+{
+    BusConnectionPrivate *priv;
+    guint bytes;
+
+    priv = BUS_CONNECTION_GET_PRIVATE (connection);
+
+    bytes = bus_connection_get_queued_bytes (connection);
+    if (bytes > priv->peak_bytes)
+        priv->peak_bytes = bytes;
+
+    if (priv->over_limit_id == 0 && bus_connection_is_over_limit (connection)) {
+        g_warning ("%s is not reading, %u bytes queued",
+                   priv->unique_name, bytes);
+        priv->over_limit_id = g_timeout_add (BUS_CONNECTION_OVER_LIMIT_TIMEOUT,
+                                             (GSourceFunc) _connection_over_limit_cb,
+                                             connection);
+    }
+}
+
 #if 0
 static gboolean
 bus_connection_dbus_signal  (BusConnection  *connection,
@@ -259,3 +329,48 @@ bus_connection_remove_match (BusConnection  *connection,
     return FALSE;
 }
 
+
+void
+bus_connection_set_queue_limit (guint max_bytes)
+{
+    g_assert (max_bytes > 0);
+
+    max_queue_bytes = max_bytes;
+}
+
+guint
+bus_connection_get_queued_bytes (BusConnection *connection)
+{
+    DBusConnection *dbus_connection;
+
+    dbus_connection = ibus_connection_get_connection ((IBusConnection *) connection);
+    if (dbus_connection == NULL)
+        return 0;
+
+    return dbus_connection_get_outgoing_size (dbus_connection);
+}
+
+guint
+bus_connection_get_peak_queued_bytes (BusConnection *connection)
+{
+    BusConnectionPrivate *priv;
+
+    priv = BUS_CONNECTION_GET_PRIVATE (connection);
+    return priv->peak_bytes;
+}
+
+/* TRUE while a peer lags behind, updates of state which is sent again
+ * later anyway should wait */
+gboolean
+bus_connection_is_congested (BusConnection *connection)
+{
+    g_assert (BUS_IS_CONNECTION (connection));
+
+    return bus_connection_get_queued_bytes (connection) > max_queue_bytes / 16;
+}
+
+guint
+bus_connection_get_over_limit_disconnects (void)
+{
+    return n_over_limit_disconnects;
+}
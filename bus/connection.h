@@ -66,6 +66,13 @@ const gchar     *bus_connection_add_name            (BusConnection  *connection,
                                                      const gchar    *name);
 gboolean         bus_connection_remove_name         (BusConnection  *connection,
                                                      const gchar    *name);
+void             bus_connection_set_queue_limit     (guint           max_bytes);
+guint            bus_connection_get_queued_bytes    (BusConnection  *connection);
+guint            bus_connection_get_peak_queued_bytes
+                                                    (BusConnection  *connection);
+gboolean         bus_connection_is_congested        (BusConnection  *connection);
+guint            bus_connection_get_over_limit_disconnects
+                                                    (void);
 G_END_DECLS
 #endif
 
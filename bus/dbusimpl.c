@@ -24,6 +24,7 @@
 #include "dbusimpl.h"
 #include "connection.h"
 #include "matchrule.h"
+#include "stats.h"
 
 enum {
     NAME_ACQUIRED,
@@ -55,6 +56,7 @@ static void     _connection_destroy_cb          (BusConnection      *connection,
                                                  BusDBusImpl        *dbus);
 static void     _rule_destroy_cb                (BusMatchRule       *rule,
                                                  BusDBusImpl        *dbus);
+static void     _dbus_impl_report_queues        (GString            *report);
 
 static IBusServiceClass  *parent_class = NULL;
 
@@ -136,10 +138,44 @@ bus_dbus_impl_init (BusDBusImpl *dbus)
     dbus->objects = g_hash_table_new (g_str_hash, g_str_equal);
     dbus->connections = NULL;
     dbus->rules = NULL;
+    dbus->rule_index = bus_match_rule_index_new ();
+    dbus->recipients = g_ptr_array_new ();
     dbus->id = 1;
 
     g_object_ref (dbus);
     g_hash_table_insert (dbus->objects, DBUS_PATH_DBUS, dbus);
+
+    bus_stats_add_report_func (_dbus_impl_report_queues);
+}
+
+/* outgoing queues of the connections for the statistics */
+static void
+_dbus_impl_report_queues (GString *report)
+{
+    BusDBusImpl *dbus;
+    GList *p;
+
+    dbus = BUS_DEFAULT_DBUS;
+
+    g_string_append_printf (report,
+                            "%-8s %-24s %10s %10s\n",
+                            "queue", "", "bytes", "peak");
+
+    for (p = dbus->connections; p != NULL; p = p->next) {
+        BusConnection *connection = BUS_CONNECTION (p->data);
+        const gchar *name = bus_connection_get_unique_name (connection);
+
+        g_string_append_printf (report,
+                                "%-8s %-24s %10u %10u\n",
+                                "queue",
+                                name != NULL ? name : "",
+                                bus_connection_get_queued_bytes (connection),
+                                bus_connection_get_peak_queued_bytes (connection));
+    }
+
+    g_string_append_printf (report,
+                            "disconnected over queue limits: %u\n",
+                            bus_connection_get_over_limit_disconnects ());
 }
 
 static void
@@ -155,7 +191,17 @@ bus_dbus_impl_destroy (BusDBusImpl *dbus)
     }
     g_list_free (dbus->rules);
     dbus->rules = NULL;
-    
+
+    if (dbus->rule_index) {
+        bus_match_rule_index_free (dbus->rule_index);
+        dbus->rule_index = NULL;
+    }
+
+    if (dbus->recipients) {
+        g_ptr_array_free (dbus->recipients, TRUE);
+        dbus->recipients = NULL;
+    }
+
     for (p = dbus->connections; p != NULL; p = p->next) {
         BusConnection *connection = BUS_CONNECTION (p->data);
         g_signal_handlers_disconnect_by_func (connection, _connection_destroy_cb, dbus);
@@ -500,6 +546,7 @@ _rule_destroy_cb (BusMatchRule *rule,
     g_assert (BUS_IS_MATCH_RULE (rule));
     g_assert (BUS_IS_DBUS_IMPL (dbus));
 
+    bus_match_rule_index_remove (dbus->rule_index, rule);
     dbus->rules = g_list_remove (dbus->rules, rule);
     g_object_unref (rule);
 }
@@ -514,7 +561,7 @@ _dbus_add_match (BusDBusImpl    *dbus,
     gboolean retval;
     gchar *rule_text;
     BusMatchRule *rule;
-    GList *link;
+    BusMatchRule *old_rule;
 
     retval = ibus_message_get_args (message,
                                     &error,
@@ -539,18 +586,16 @@ _dbus_add_match (BusDBusImpl    *dbus,
         return reply_message;
     }
 
-    for (link = dbus->rules; link != NULL; link = link->next) {
-        if (bus_match_rule_is_equal (rule, BUS_MATCH_RULE (link->data))) {
-            bus_match_rule_add_recipient (BUS_MATCH_RULE (link->data), connection);
-            g_object_unref (rule);
-            rule = NULL;
-            break;
-        }
-    }
+    old_rule = bus_match_rule_index_lookup (dbus->rule_index, rule);
 
-    if (rule) {
+    if (old_rule) {
+        bus_match_rule_add_recipient (old_rule, connection);
+        g_object_unref (rule);
+    }
+    else {
         bus_match_rule_add_recipient (rule, connection);
-        dbus->rules = g_list_append (dbus->rules, rule);
+        dbus->rules = g_list_prepend (dbus->rules, rule);
+        bus_match_rule_index_add (dbus->rule_index, rule);
         g_signal_connect (rule, "destroy", G_CALLBACK (_rule_destroy_cb), dbus);
     }
 
@@ -567,7 +612,7 @@ _dbus_remove_match (BusDBusImpl     *dbus,
     IBusError *error;
     gchar *rule_text;
     BusMatchRule *rule;
-    GList *link;
+    BusMatchRule *old_rule;
 
     if (!ibus_message_get_args (message,
                                 &error,
@@ -590,11 +635,10 @@ _dbus_remove_match (BusDBusImpl     *dbus,
         return reply_message;
     }
 
-    for (link = dbus->rules; link != NULL; link = link->next) {
-        if (bus_match_rule_is_equal (rule, BUS_MATCH_RULE (link->data))) {
-            bus_match_rule_remove_recipient (BUS_MATCH_RULE (link->data), connection);
-            break;
-        }
+    old_rule = bus_match_rule_index_lookup (dbus->rule_index, rule);
+
+    if (old_rule) {
+        bus_match_rule_remove_recipient (old_rule, connection);
     }
 
     g_object_unref (rule);
@@ -808,7 +852,9 @@ _connection_ibus_message_cb (BusConnection  *connection,
     if (G_UNLIKELY (IBUS_OBJECT_DESTROYED (dbus))) {
         return;
     }
-    
+
+    bus_stats_message_received (message);
+
     if (ibus_message_is_signal (message,
                                 DBUS_INTERFACE_LOCAL,
                                 "Disconnected")) {
@@ -907,6 +953,7 @@ _connection_ibus_message_sent_cb (BusConnection  *connection,
                                   IBusMessage    *message,
                                   BusDBusImpl    *dbus)
 {
+    bus_stats_message_sent (message);
     bus_dbus_impl_dispatch_message_by_rule (dbus, message, connection);
 }
 
@@ -1052,8 +1099,8 @@ bus_dbus_impl_dispatch_message_by_rule (BusDBusImpl     *dbus,
     g_assert (message != NULL);
     g_assert (BUS_IS_CONNECTION (skip_connection) || skip_connection == NULL);
 
-    GList *recipients = NULL;
-    GList *link = NULL;
+    GPtrArray *recipients;
+    guint i;
 
     static gint32 data_slot = -1;
 
@@ -1061,6 +1108,11 @@ bus_dbus_impl_dispatch_message_by_rule (BusDBusImpl     *dbus,
         return;
     }
 
+    /* most messages are not watched by any rule */
+    if (!bus_match_rule_index_may_match (dbus->rule_index, message)) {
+        return;
+    }
+
     if (data_slot == -1) {
         dbus_message_allocate_data_slot (&data_slot);
     }
@@ -1077,20 +1129,34 @@ bus_dbus_impl_dispatch_message_by_rule (BusDBusImpl     *dbus,
     }
 #endif
 
-    for (link = dbus->rules; link != NULL; link = link->next) {
-        GList *list = bus_match_rule_get_recipients (BUS_MATCH_RULE (link->data),
-                                                     message);
-        recipients = g_list_concat (recipients, list);
+    /* Sending a message may dispatch another one, so the shared array is
+     * only used by the outermost call. */
+    if (dbus->recipients->len == 0) {
+        recipients = dbus->recipients;
+    }
+    else {
+        recipients = g_ptr_array_new ();
     }
 
-    for (link = recipients; link != NULL; link = link->next) {
-        BusConnection *connection = BUS_CONNECTION (link->data);
+    bus_match_rule_index_get_recipients (dbus->rule_index, message, recipients);
+
+    for (i = 0; i < recipients->len; i++) {
+        BusConnection *connection = BUS_CONNECTION (g_ptr_array_index (recipients, i));
         if (connection != skip_connection) {
             ibus_connection_send (IBUS_CONNECTION (connection), message);
         }
-        g_object_unref (connection);
     }
-    g_list_free (recipients);
+
+    for (i = 0; i < recipients->len; i++) {
+        g_object_unref (g_ptr_array_index (recipients, i));
+    }
+
+    if (recipients == dbus->recipients) {
+        g_ptr_array_set_size (recipients, 0);
+    }
+    else {
+        g_ptr_array_free (recipients, TRUE);
+    }
 }
 
 
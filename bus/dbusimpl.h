@@ -22,6 +22,7 @@
 
 #include <ibus.h>
 #include "connection.h"
+#include "matchrule.h"
 
 /*
  * Type macros.
@@ -57,6 +58,8 @@ struct _BusDBusImpl {
     GHashTable *objects;
     GList *connections;
     GList *rules;
+    BusMatchRuleIndex *rule_index;
+    GPtrArray *recipients;
     gint id;
 };
 
@@ -25,6 +25,10 @@
 #define BUS_ENGINE_PROXY_GET_PRIVATE(o)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((o), BUS_TYPE_ENGINE_PROXY, BusEngineProxyPrivate))
 
+/* milliseconds an engine may take to handle a key, the key is passed
+ * through to the application if it takes longer */
+#define BUS_ENGINE_PROXY_KEY_EVENT_TIMEOUT  (500)
+
 enum {
     COMMIT_TEXT,
     FORWARD_KEY_EVENT,
@@ -53,10 +57,37 @@ struct _BusEngineProxyPrivate {
     IBusEngineDesc *desc;
 
     IBusPropList *prop_list;
+
+    /* the lookup table built from the updates of the engine */
+    IBusLookupTable *lookup_table;
+    guint lookup_table_generation;
+    /* a RequestLookupTable is pending, do not ask again for every delta */
+    gboolean lookup_table_requested;
+
+    /* the input context the engine works for, a shared engine changes
+     * its owner when another context gets the focus */
+    gpointer owner;
+
+    /* key event budget in milliseconds, 0 waits forever, -1 for the
+     * default */
+    gint key_event_timeout;
+    /* the engine missed the budget of its last key event */
+    gboolean degraded;
+    guint n_key_event_timeouts;
+    /* the engine answered ProcessKeyEvents with UnknownMethod, e.g. an
+     * engine on the Python bindings or an older libibus */
+    gboolean no_key_events;
+
+    /* the cursor location the engine knows */
+    gint x;
+    gint y;
+    gint w;
+    gint h;
 };
 typedef struct _BusEngineProxyPrivate BusEngineProxyPrivate;
 
 static guint    engine_signals[LAST_SIGNAL] = { 0 };
+static gint     default_key_event_timeout = BUS_ENGINE_PROXY_KEY_EVENT_TIMEOUT;
 // static guint            engine_signals[LAST_SIGNAL] = { 0 };
 
 /* functions prototype */
@@ -117,6 +148,12 @@ bus_engine_proxy_new (const gchar    *path,
     priv->desc = desc;
     g_object_ref (desc);
 
+    /* engines without the method just ignore it and keep sending
+     * full tables */
+    ibus_proxy_call ((IBusProxy *) engine,
+                     "EnableLookupTableDelta",
+                     G_TYPE_INVALID);
+
     return engine;
 }
 
@@ -329,6 +366,17 @@ bus_engine_proxy_init (BusEngineProxy *engine)
     priv->enabled = FALSE;
     priv->prop_list = NULL;
     priv->desc = NULL;
+    priv->lookup_table = NULL;
+    priv->lookup_table_generation = 0;
+    priv->lookup_table_requested = FALSE;
+    priv->owner = NULL;
+    priv->key_event_timeout = -1;
+    priv->degraded = FALSE;
+    priv->n_key_event_timeouts = 0;
+
+    /* no real location has a negative size */
+    priv->x = priv->y = 0;
+    priv->w = priv->h = -1;
 }
 
 static void
@@ -342,6 +390,11 @@ bus_engine_proxy_real_destroy (BusEngineProxy *engine)
         priv->prop_list = NULL;
     }
 
+    if (priv->lookup_table) {
+        g_object_unref (priv->lookup_table);
+        priv->lookup_table = NULL;
+    }
+
     if (ibus_proxy_get_connection ((IBusProxy *) engine)) {
         ibus_proxy_call ((IBusProxy *) engine,
                          "Destroy",
@@ -476,8 +529,54 @@ bus_engine_proxy_ibus_signal (IBusProxy     *proxy,
         if (!retval)
             goto failed;
 
+        if (priv->lookup_table)
+            g_object_unref (priv->lookup_table);
+        priv->lookup_table = table;
+        priv->lookup_table_generation ++;
+        priv->lookup_table_requested = FALSE;
+
+        g_signal_emit (engine, engine_signals[UPDATE_LOOKUP_TABLE], 0, table, visible);
+    }
+    else if (ibus_message_is_signal (message, IBUS_INTERFACE_ENGINE, "UpdateLookupTableDelta")) {
+        IBusMessageIter iter;
+        IBusLookupTableDelta *delta = NULL;
+        IBusLookupTable *table = NULL;
+        gboolean visible;
+
+        if (ibus_message_iter_init (message, &iter))
+            delta = ibus_lookup_table_delta_deserialize (&iter);
+
+        if (delta == NULL || !ibus_message_iter_get (&iter, G_TYPE_BOOLEAN, &visible)) {
+            if (delta)
+                ibus_lookup_table_delta_free (delta);
+            error = ibus_error_new_from_printf (DBUS_ERROR_INVALID_ARGS,
+                                                "Can not parse arguments of UpdateLookupTableDelta");
+            goto failed;
+        }
+
+        /* the link is ordered, so a mismatch means a full table was lost;
+         * drop deltas and ask the engine for the next full table */
+        if (priv->lookup_table != NULL &&
+            delta->generation == priv->lookup_table_generation) {
+            table = ibus_lookup_table_apply_delta (priv->lookup_table, delta);
+        }
+        ibus_lookup_table_delta_free (delta);
+
+        if (table == NULL) {
+            if (!priv->lookup_table_requested) {
+                g_warning ("Drop lookup table delta of engine %s", ibus_proxy_get_path (proxy));
+                ibus_proxy_call (proxy,
+                                 "RequestLookupTable",
+                                 G_TYPE_INVALID);
+                priv->lookup_table_requested = TRUE;
+            }
+            goto handled;
+        }
+
+        g_object_unref (priv->lookup_table);
+        priv->lookup_table = table;
+
         g_signal_emit (engine, engine_signals[UPDATE_LOOKUP_TABLE], 0, table, visible);
-        g_object_unref (table);
     }
     else if (ibus_message_is_signal (message, IBUS_INTERFACE_ENGINE, "RegisterProperties")) {
         gboolean retval;
@@ -526,7 +625,58 @@ failed:
     return FALSE;
 }
 
+/* the timeout of a key event call, libdbus takes G_MAXINT for none and
+ * -1 for its own default of 25 seconds */
+static gint
+bus_engine_proxy_get_key_event_timeout (BusEngineProxy *engine)
+{
+    BusEngineProxyPrivate *priv;
+    gint timeout;
+
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    timeout = priv->key_event_timeout >= 0 ? priv->key_event_timeout : default_key_event_timeout;
+    return timeout > 0 ? timeout : G_MAXINT;
+}
+
+/*
+ * Records whether a key event reply came in time. libdbus completes a
+ * pending call which hit its timeout with a NoReply error and drops the
+ * real reply when it arrives later, so the keys are passed through once
+ * and never handled twice.
+ */
+static void
+bus_engine_proxy_key_event_done (BusEngineProxy *engine,
+                                 IBusError      *error)
+{
+    BusEngineProxyPrivate *priv;
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    if (error != NULL && g_strcmp0 (error->name, DBUS_ERROR_NO_REPLY) == 0) {
+        priv->n_key_event_timeouts ++;
+        if (!priv->degraded) {
+            priv->degraded = TRUE;
+            g_warning ("Engine %s did not handle a key in %d milliseconds, "
+                       "the key was passed to the application",
+                       priv->desc ? priv->desc->name : "",
+                       bus_engine_proxy_get_key_event_timeout (engine));
+        }
+        return;
+    }
+
+    if (error != NULL) {
+        g_warning ("%s: %s", error->name, error->message);
+        return;
+    }
+
+    if (priv->degraded) {
+        priv->degraded = FALSE;
+        g_debug ("Engine %s responds again", priv->desc ? priv->desc->name : "");
+    }
+}
+
 typedef struct {
+    BusEngineProxy *engine;
     GFunc    func;
     gpointer user_data;
 }CallData;
@@ -542,29 +692,30 @@ bus_engine_proxy_process_key_event_reply_cb (IBusPendingCall *pending,
     reply_message = dbus_pending_call_steal_reply (pending);
 
     if (reply_message == NULL) {
-        call_data->func(FALSE, call_data->user_data);
-        return;
+        retval = FALSE;
     }
     else if ((error = ibus_error_new_from_message (reply_message)) != NULL) {
-        g_warning ("%s: %s", error->name, error->message);
-        ibus_message_unref (reply_message);
+        bus_engine_proxy_key_event_done (call_data->engine, error);
         ibus_error_free (error);
-        call_data->func(FALSE, call_data->user_data);
-        return;
+        retval = FALSE;
     }
-
-    if (!ibus_message_get_args (reply_message,
-                                &error,
-                                G_TYPE_BOOLEAN, &retval,
-                                G_TYPE_INVALID)) {
+    else if (!ibus_message_get_args (reply_message,
+                                     &error,
+                                     G_TYPE_BOOLEAN, &retval,
+                                     G_TYPE_INVALID)) {
         g_warning ("%s: %s", error->name, error->message);
-        ibus_message_unref (reply_message);
         ibus_error_free (error);
-        call_data->func (GINT_TO_POINTER (FALSE), call_data->user_data);
-        return;
+        retval = FALSE;
     }
+    else {
+        bus_engine_proxy_key_event_done (call_data->engine, NULL);
+    }
+
+    if (reply_message)
+        ibus_message_unref (reply_message);
 
     call_data->func (GINT_TO_POINTER (retval), call_data->user_data);
+    g_object_unref (call_data->engine);
     g_slice_free (CallData, call_data);
 }
 
@@ -586,7 +737,7 @@ bus_engine_proxy_process_key_event (BusEngineProxy *engine,
     retval = ibus_proxy_call_with_reply ((IBusProxy *) engine,
                                          "ProcessKeyEvent",
                                          &pending,
-                                         -1,
+                                         bus_engine_proxy_get_key_event_timeout (engine),
                                          &error,
                                          G_TYPE_UINT, &keyval,
                                          G_TYPE_UINT, &state,
@@ -599,6 +750,7 @@ bus_engine_proxy_process_key_event (BusEngineProxy *engine,
     }
 
     call_data = g_slice_new0 (CallData);
+    call_data->engine = (BusEngineProxy *) g_object_ref (engine);
     call_data->func = return_cb;
     call_data->user_data = user_data;
 
@@ -610,11 +762,171 @@ bus_engine_proxy_process_key_event (BusEngineProxy *engine,
 
     if (!retval) {
         g_warning ("%s : ProcessKeyEvent", DBUS_ERROR_NO_MEMORY);
+        g_object_unref (call_data->engine);
+        g_slice_free (CallData, call_data);
         return_cb (GINT_TO_POINTER (FALSE), user_data);
         return;
     }
 }
 
+typedef struct {
+    BusEngineProxy *engine;
+    BusEngineProxyKeyEventsFunc func;
+    gpointer user_data;
+    guint n_keys;
+} KeyEventsCallData;
+
+static void
+bus_engine_proxy_process_key_events_reply_cb (IBusPendingCall   *pending,
+                                              KeyEventsCallData *call_data)
+{
+    IBusMessage *reply_message;
+    IBusMessageIter iter;
+    IBusError *error;
+    GArray *handled = NULL;
+    guint processed = 0;
+
+    reply_message = pending ? dbus_pending_call_steal_reply (pending) : NULL;
+
+    if (reply_message == NULL) {
+        /* no reply or not sent */
+    }
+    else if ((error = ibus_error_new_from_message (reply_message)) != NULL) {
+        if (g_strcmp0 (error->name, DBUS_ERROR_UNKNOWN_METHOD) == 0) {
+            BusEngineProxyPrivate *priv;
+            priv = BUS_ENGINE_PROXY_GET_PRIVATE (call_data->engine);
+
+            /* nothing was processed, the caller sends the keys again and
+             * they go one at a time from now on */
+            priv->no_key_events = TRUE;
+            ibus_error_free (error);
+            ibus_message_unref (reply_message);
+            call_data->func (0, NULL, call_data->user_data);
+            g_object_unref (call_data->engine);
+            g_slice_free (KeyEventsCallData, call_data);
+            return;
+        }
+        bus_engine_proxy_key_event_done (call_data->engine, error);
+        ibus_error_free (error);
+    }
+    else if (!ibus_message_iter_init (reply_message, &iter) ||
+             !ibus_message_iter_get (&iter, G_TYPE_UINT, &processed) ||
+             (handled = ibus_message_iter_get_uint_array (&iter)) == NULL ||
+             processed > call_data->n_keys ||
+             handled->len < (processed + 31) / 32) {
+        g_warning ("%s: Can not match signature (uau) of ProcessKeyEvents reply",
+                   DBUS_ERROR_INVALID_ARGS);
+        if (handled) {
+            g_array_free (handled, TRUE);
+            handled = NULL;
+        }
+    }
+
+    if (reply_message)
+        ibus_message_unref (reply_message);
+
+    if (handled != NULL) {
+        bus_engine_proxy_key_event_done (call_data->engine, NULL);
+        call_data->func (processed, (guint32 *) handled->data, call_data->user_data);
+        g_array_free (handled, TRUE);
+    }
+    else {
+        /* the engine did not see the keys or failed, give them all back */
+        guint32 *none = g_new0 (guint32, (call_data->n_keys + 31) / 32);
+        call_data->func (call_data->n_keys, none, call_data->user_data);
+        g_free (none);
+    }
+
+    g_object_unref (call_data->engine);
+    g_slice_free (KeyEventsCallData, call_data);
+}
+
+static void
+bus_engine_proxy_process_key_event_as_batch_cb (gpointer           retval,
+                                                KeyEventsCallData *call_data)
+{
+    guint32 handled = GPOINTER_TO_INT (retval) ? 1 : 0;
+
+    call_data->func (1, &handled, call_data->user_data);
+    g_object_unref (call_data->engine);
+    g_slice_free (KeyEventsCallData, call_data);
+}
+
+void
+bus_engine_proxy_process_key_events (BusEngineProxy             *engine,
+                                     const guint32              *keys,
+                                     guint                       n_keys,
+                                     BusEngineProxyKeyEventsFunc return_cb,
+                                     gpointer                    user_data)
+{
+    g_assert (BUS_IS_ENGINE_PROXY (engine));
+    g_assert (keys != NULL);
+    g_assert (n_keys > 0);
+    g_assert (return_cb);
+
+    IBusMessage *message;
+    IBusMessageIter iter;
+    IBusPendingCall *pending = NULL;
+    KeyEventsCallData *call_data;
+    gboolean retval;
+
+    BusEngineProxyPrivate *priv;
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    if (priv->no_key_events) {
+        /* process the first key only, the caller sends the rest again */
+        call_data = g_slice_new0 (KeyEventsCallData);
+        call_data->engine = (BusEngineProxy *) g_object_ref (engine);
+        call_data->func = return_cb;
+        call_data->user_data = user_data;
+        call_data->n_keys = 1;
+
+        bus_engine_proxy_process_key_event (engine,
+                                            keys[0],
+                                            keys[1],
+                                            (GFunc) bus_engine_proxy_process_key_event_as_batch_cb,
+                                            call_data);
+        return;
+    }
+
+    message = ibus_message_new_method_call (ibus_proxy_get_name ((IBusProxy *) engine),
+                                            ibus_proxy_get_path ((IBusProxy *) engine),
+                                            ibus_proxy_get_interface ((IBusProxy *) engine),
+                                            "ProcessKeyEvents");
+    ibus_message_iter_init_append (message, &iter);
+    ibus_message_iter_append_uint_array (&iter, keys, n_keys * 2);
+
+    retval = ibus_proxy_send_with_reply ((IBusProxy *) engine,
+                                         message,
+                                         &pending,
+                                         bus_engine_proxy_get_key_event_timeout (engine));
+    ibus_message_unref (message);
+
+    call_data = g_slice_new0 (KeyEventsCallData);
+    call_data->engine = (BusEngineProxy *) g_object_ref (engine);
+    call_data->func = return_cb;
+    call_data->user_data = user_data;
+    call_data->n_keys = n_keys;
+
+    if (!retval || pending == NULL) {
+        g_warning ("%s: Can not send ProcessKeyEvents", DBUS_ERROR_DISCONNECTED);
+        bus_engine_proxy_process_key_events_reply_cb (NULL, call_data);
+        return;
+    }
+
+    retval = ibus_pending_call_set_notify (pending,
+                                           (IBusPendingCallNotifyFunction) bus_engine_proxy_process_key_events_reply_cb,
+                                           call_data,
+                                           NULL);
+    ibus_pending_call_unref (pending);
+
+    if (!retval) {
+        g_warning ("%s : ProcessKeyEvents", DBUS_ERROR_NO_MEMORY);
+        bus_engine_proxy_process_key_events_reply_cb (NULL, call_data);
+        return;
+    }
+}
+
 void
 bus_engine_proxy_set_cursor_location (BusEngineProxy *engine,
                                       gint            x,
@@ -624,6 +936,17 @@ bus_engine_proxy_set_cursor_location (BusEngineProxy *engine,
 {
     g_assert (BUS_IS_ENGINE_PROXY (engine));
 
+    BusEngineProxyPrivate *priv;
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    if (priv->x == x && priv->y == y && priv->w == w && priv->h == h)
+        return;
+
+    priv->x = x;
+    priv->y = y;
+    priv->w = w;
+    priv->h = h;
+
     ibus_proxy_call ((IBusProxy *) engine,
                      "SetCursorLocation",
                      G_TYPE_INT, &x,
@@ -718,3 +1041,93 @@ bus_engine_proxy_get_desc (BusEngineProxy *engine)
 
     return priv->desc;
 }
+
+gboolean
+bus_engine_proxy_is_shared (BusEngineProxy *engine)
+{
+    g_assert (BUS_IS_ENGINE_PROXY (engine));
+
+    BusEngineProxyPrivate *priv;
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    return priv->desc != NULL && priv->desc->shared;
+}
+
+gpointer
+bus_engine_proxy_get_owner (BusEngineProxy *engine)
+{
+    g_assert (BUS_IS_ENGINE_PROXY (engine));
+
+    BusEngineProxyPrivate *priv;
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    return priv->owner;
+}
+
+/*
+ * The signals of the engine are only meant for its owner. Handing the
+ * engine from one owner to another resets it, so the state of the first
+ * context does not show up in the second one.
+ */
+void
+bus_engine_proxy_set_owner (BusEngineProxy *engine,
+                            gpointer        owner)
+{
+    g_assert (BUS_IS_ENGINE_PROXY (engine));
+
+    BusEngineProxyPrivate *priv;
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    if (priv->owner == owner)
+        return;
+
+    if (priv->owner != NULL && owner != NULL) {
+        bus_engine_proxy_focus_out (engine);
+        bus_engine_proxy_reset (engine);
+    }
+
+    priv->owner = owner;
+}
+
+/* timeout is in milliseconds, 0 waits forever */
+void
+bus_engine_proxy_set_default_key_event_timeout (gint timeout)
+{
+    default_key_event_timeout = MAX (timeout, 0);
+}
+
+/* overrides the default key event budget, 0 waits forever and -1 goes back
+ * to the default */
+void
+bus_engine_proxy_set_key_event_timeout (BusEngineProxy *engine,
+                                        gint            timeout)
+{
+    g_assert (BUS_IS_ENGINE_PROXY (engine));
+
+    BusEngineProxyPrivate *priv;
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    priv->key_event_timeout = MAX (timeout, -1);
+}
+
+gboolean
+bus_engine_proxy_is_degraded (BusEngineProxy *engine)
+{
+    g_assert (BUS_IS_ENGINE_PROXY (engine));
+
+    BusEngineProxyPrivate *priv;
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    return priv->degraded;
+}
+
+guint
+bus_engine_proxy_get_key_event_timeouts (BusEngineProxy *engine)
+{
+    g_assert (BUS_IS_ENGINE_PROXY (engine));
+
+    BusEngineProxyPrivate *priv;
+    priv = BUS_ENGINE_PROXY_GET_PRIVATE (engine);
+
+    return priv->n_key_event_timeouts;
+}
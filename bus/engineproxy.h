@@ -46,6 +46,12 @@ G_BEGIN_DECLS
 typedef struct _BusEngineProxy BusEngineProxy;
 typedef struct _BusEngineProxyClass BusEngineProxyClass;
 
+/* the engine took the first processed keys, bit i of handled is set if
+ * it handled key i; processed may be less than the keys sent, down to 0 */
+typedef void (* BusEngineProxyKeyEventsFunc)    (guint           processed,
+                                                 const guint32  *handled,
+                                                 gpointer        user_data);
+
 struct _BusEngineProxy {
     IBusProxy parent;
     /* instance members */
@@ -66,6 +72,13 @@ void             bus_engine_proxy_process_key_event (BusEngineProxy *engine,
                                                      guint           state,
                                                      GFunc           return_cn,
                                                      gpointer        user_data);
+void             bus_engine_proxy_process_key_events
+                                                    (BusEngineProxy *engine,
+                                                     const guint32  *keys,
+                                                     guint           n_keys,
+                                                     BusEngineProxyKeyEventsFunc
+                                                                     return_cb,
+                                                     gpointer        user_data);
 void             bus_engine_proxy_set_cursor_location
                                                     (BusEngineProxy *engine,
                                                      gint            x,
@@ -90,6 +103,18 @@ void             bus_engine_proxy_property_show     (BusEngineProxy *engine,
                                                      const gchar    *prop_name);
 void             bus_engine_proxy_property_hide     (BusEngineProxy *engine,
                                                      const gchar    *prop_name);
+gboolean         bus_engine_proxy_is_shared         (BusEngineProxy *engine);
+gpointer         bus_engine_proxy_get_owner         (BusEngineProxy *engine);
+void             bus_engine_proxy_set_owner         (BusEngineProxy *engine,
+                                                     gpointer        owner);
+void             bus_engine_proxy_set_default_key_event_timeout
+                                                    (gint            timeout);
+void             bus_engine_proxy_set_key_event_timeout
+                                                    (BusEngineProxy *engine,
+                                                     gint            timeout);
+gboolean         bus_engine_proxy_is_degraded       (BusEngineProxy *engine);
+guint            bus_engine_proxy_get_key_event_timeouts
+                                                    (BusEngineProxy *engine);
 G_END_DECLS
 #endif
 
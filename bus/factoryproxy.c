@@ -23,10 +23,27 @@
 #include "dbusimpl.h"
 #include "factoryproxy.h"
 
+/* milliseconds a factory may take to create an idle engine */
+#define BUS_FACTORY_PROXY_FILL_TIMEOUT  (5000)
+/* idle engines kept for each engine description */
+#define BUS_FACTORY_PROXY_POOL_SIZE     (2)
+
 /* functions prototype */
 static void      bus_factory_proxy_class_init   (BusFactoryProxyClass   *klass);
 static void      bus_factory_proxy_init         (BusFactoryProxy        *factory);
 static void      bus_factory_proxy_destroy      (BusFactoryProxy        *factory);
+static void      bus_factory_proxy_fill_pool    (BusFactoryProxy        *factory,
+                                                 IBusEngineDesc         *desc);
+static void      _idle_engine_destroy_cb        (BusEngineProxy         *engine,
+                                                 BusFactoryProxy        *factory);
+static void      _shared_engine_destroy_cb      (BusEngineProxy         *engine,
+                                                 BusFactoryProxy        *factory);
+static void      bus_factory_proxy_call_create_engine
+                                                (BusFactoryProxy        *factory,
+                                                 IBusEngineDesc         *desc,
+                                                 gint                    timeout,
+                                                 GFunc                   return_cb,
+                                                 gpointer                user_data);
 
 
 static IBusProxyClass  *parent_class = NULL;
@@ -110,6 +127,41 @@ static void
 bus_factory_proxy_init (BusFactoryProxy *factory)
 {
     factory->component = NULL;
+    factory->idle_engines = g_hash_table_new (g_direct_hash, g_direct_equal);
+    factory->filling = NULL;
+    factory->shared_engines = g_hash_table_new_full (g_direct_hash,
+                                                     g_direct_equal,
+                                                     NULL,
+                                                     (GDestroyNotify) g_object_unref);
+}
+
+static void
+_destroy_engines (IBusEngineDesc *desc,
+                  GList          *engines,
+                  gpointer        user_data)
+{
+    GList *p;
+
+    for (p = engines; p != NULL; p = p->next) {
+        g_signal_handlers_disconnect_by_func (p->data,
+                                              G_CALLBACK (_idle_engine_destroy_cb),
+                                              user_data);
+        ibus_object_destroy ((IBusObject *) p->data);
+        g_object_unref (p->data);
+    }
+    g_list_free (engines);
+}
+
+static void
+_destroy_shared_engine (IBusEngineDesc *desc,
+                        BusEngineProxy *engine,
+                        gpointer        user_data)
+{
+    g_signal_handlers_disconnect_by_func (engine,
+                                          G_CALLBACK (_shared_engine_destroy_cb),
+                                          user_data);
+    /* the input contexts using it drop it in their destroy handlers */
+    ibus_object_destroy ((IBusObject *) engine);
 }
 
 static void
@@ -117,6 +169,17 @@ bus_factory_proxy_destroy (BusFactoryProxy *factory)
 {
     GList *p;
 
+    g_hash_table_foreach (factory->idle_engines, (GHFunc) _destroy_engines, factory);
+    g_hash_table_destroy (factory->idle_engines);
+    factory->idle_engines = NULL;
+
+    g_list_free (factory->filling);
+    factory->filling = NULL;
+
+    g_hash_table_foreach (factory->shared_engines, (GHFunc) _destroy_shared_engine, factory);
+    g_hash_table_destroy (factory->shared_engines);
+    factory->shared_engines = NULL;
+
     for (p = factory->engine_list; p != NULL ; p = p->next) {
         IBusEngineDesc *desc = (IBusEngineDesc *)p->data;
         g_object_steal_data ((GObject *)desc, "factory");
@@ -140,6 +203,37 @@ bus_factory_proxy_get_component (BusFactoryProxy *factory)
     return factory->component;
 }
 
+/* Hands the factory over to component, which replaced the component of
+ * the factory while its process kept running. The old engine
+ * descriptions stay with the factory, engines created from them may
+ * still be in use. */
+void
+bus_factory_proxy_set_component (BusFactoryProxy *factory,
+                                 IBusComponent   *component)
+{
+    g_assert (BUS_IS_FACTORY_PROXY (factory));
+    g_assert (IBUS_IS_COMPONENT (component));
+
+    GList *engines, *p;
+
+    g_object_steal_data ((GObject *)factory->component, "factory");
+    g_object_unref (factory->component);
+
+    g_object_ref (component);
+    factory->component = component;
+    g_object_set_data ((GObject *)factory->component, "factory", factory);
+
+    engines = ibus_component_get_engines (factory->component);
+
+    for (p = engines; p != NULL; p = p->next) {
+        IBusEngineDesc *desc = (IBusEngineDesc *)p->data;
+        g_object_ref (desc);
+        g_object_set_data ((GObject *)desc, "factory", factory);
+    }
+
+    factory->engine_list = g_list_concat (factory->engine_list, engines);
+}
+
 BusFactoryProxy *
 bus_factory_proxy_get_from_component (IBusComponent *component)
 {
@@ -165,6 +259,38 @@ bus_factory_proxy_get_from_engine (IBusEngineDesc *desc)
     return factory;
 }
 
+static BusEngineProxy *
+bus_factory_proxy_new_engine_from_reply (BusFactoryProxy *factory,
+                                         IBusEngineDesc  *desc,
+                                         IBusMessage     *reply_message)
+{
+    IBusError *error;
+    IBusConnection *connection;
+    gchar *object_path;
+
+    if ((error = ibus_error_new_from_message (reply_message)) != NULL) {
+        g_warning ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
+        return NULL;
+    }
+
+    if (!ibus_message_get_args (reply_message,
+                                &error,
+                                IBUS_TYPE_OBJECT_PATH, &object_path,
+                                G_TYPE_INVALID)) {
+        g_warning ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
+        return NULL;
+    }
+
+    connection = ibus_proxy_get_connection ((IBusProxy *) factory);
+    if (connection == NULL) {
+        return NULL;
+    }
+
+    return bus_engine_proxy_new (object_path, desc, (BusConnection *) connection);
+}
+
 BusEngineProxy *
 bus_factory_proxy_create_engine (BusFactoryProxy *factory,
                                  IBusEngineDesc  *desc)
@@ -175,9 +301,8 @@ bus_factory_proxy_create_engine (BusFactoryProxy *factory,
     IBusMessage *reply_message;
     IBusError *error;
     BusEngineProxy *engine;
-    gchar *object_path;
 
-    if (g_list_find (factory->component->engines, desc) == NULL) {
+    if (g_list_find (factory->engine_list, desc) == NULL) {
         return NULL;
     }
 
@@ -193,28 +318,368 @@ bus_factory_proxy_create_engine (BusFactoryProxy *factory,
         return NULL;
     }
 
-    if ((error = ibus_error_new_from_message (reply_message)) != NULL) {
-        g_warning ("%s: %s", error->name, error->message);
-        ibus_error_free (error);
+    engine = bus_factory_proxy_new_engine_from_reply (factory, desc, reply_message);
+    ibus_message_unref (reply_message);
+
+    return engine;
+}
+
+typedef struct {
+    BusFactoryProxy *factory;
+    IBusEngineDesc  *desc;
+    GFunc            func;
+    gpointer         user_data;
+} CreateEngineData;
+
+static void
+bus_factory_proxy_create_engine_reply_cb (IBusPendingCall  *pending,
+                                          CreateEngineData *data)
+{
+    IBusMessage *reply_message;
+    BusEngineProxy *engine = NULL;
+
+    /* A call that hit its timeout completes with a NoReply error. */
+    reply_message = ibus_pending_call_steal_reply (pending);
+
+    if (reply_message != NULL) {
+        if (!IBUS_OBJECT_DESTROYED (data->factory)) {
+            engine = bus_factory_proxy_new_engine_from_reply (data->factory,
+                                                              data->desc,
+                                                              reply_message);
+        }
         ibus_message_unref (reply_message);
-        return NULL;
     }
 
-    if (!ibus_message_get_args (reply_message,
-                                &error,
-                                IBUS_TYPE_OBJECT_PATH, &object_path,
-                                G_TYPE_INVALID)) {
+    data->func (engine, data->user_data);
+
+    if (engine != NULL) {
+        g_object_unref (engine);
+    }
+
+    g_object_unref (data->factory);
+    g_object_unref (data->desc);
+    g_slice_free (CreateEngineData, data);
+}
+
+static void
+bus_factory_proxy_call_create_engine (BusFactoryProxy *factory,
+                                      IBusEngineDesc  *desc,
+                                      gint             timeout,
+                                      GFunc            return_cb,
+                                      gpointer         user_data)
+{
+    g_assert (BUS_IS_FACTORY_PROXY (factory));
+    g_assert (IBUS_IS_ENGINE_DESC (desc));
+    g_assert (return_cb);
+
+    IBusPendingCall *pending = NULL;
+    IBusError *error;
+    CreateEngineData *data;
+    gboolean retval;
+
+    if (g_list_find (factory->engine_list, desc) == NULL) {
+        return_cb (NULL, user_data);
+        return;
+    }
+
+    retval = ibus_proxy_call_with_reply ((IBusProxy *) factory,
+                                         "CreateEngine",
+                                         &pending,
+                                         timeout,
+                                         &error,
+                                         G_TYPE_STRING, &(desc->name),
+                                         G_TYPE_INVALID);
+    if (!retval) {
         g_warning ("%s: %s", error->name, error->message);
         ibus_error_free (error);
-        ibus_message_unref (reply_message);
+        return_cb (NULL, user_data);
+        return;
+    }
 
-        return NULL;
+    if (pending == NULL) {
+        /* the connection was closed while sending */
+        return_cb (NULL, user_data);
+        return;
     }
 
-    IBusConnection *connection = ibus_proxy_get_connection ((IBusProxy *) factory);
-    engine = bus_engine_proxy_new (object_path, desc, (BusConnection *) connection);
-    ibus_message_unref (reply_message);
+    data = g_slice_new0 (CreateEngineData);
+    data->factory = (BusFactoryProxy *) g_object_ref (factory);
+    data->desc = (IBusEngineDesc *) g_object_ref (desc);
+    data->func = return_cb;
+    data->user_data = user_data;
+
+    retval = ibus_pending_call_set_notify (pending,
+                                           (IBusPendingCallNotifyFunction) bus_factory_proxy_create_engine_reply_cb,
+                                           data,
+                                           NULL);
+    ibus_pending_call_unref (pending);
+
+    if (!retval) {
+        g_warning ("%s : CreateEngine", DBUS_ERROR_NO_MEMORY);
+        g_object_unref (data->factory);
+        g_object_unref (data->desc);
+        g_slice_free (CreateEngineData, data);
+        return_cb (NULL, user_data);
+        return;
+    }
+}
+
+static void
+_idle_engine_destroy_cb (BusEngineProxy  *engine,
+                         BusFactoryProxy *factory)
+{
+    IBusEngineDesc *desc;
+    GList *engines;
+
+    desc = bus_engine_proxy_get_desc (engine);
+    engines = (GList *) g_hash_table_lookup (factory->idle_engines, desc);
+    engines = g_list_remove (engines, engine);
+
+    if (engines != NULL)
+        g_hash_table_insert (factory->idle_engines, desc, engines);
+    else
+        g_hash_table_remove (factory->idle_engines, desc);
+
+    g_object_unref (engine);
+}
+
+static gboolean
+bus_factory_proxy_add_idle_engine (BusFactoryProxy *factory,
+                                   BusEngineProxy  *engine)
+{
+    IBusEngineDesc *desc;
+    GList *engines;
+
+    desc = bus_engine_proxy_get_desc (engine);
+    engines = (GList *) g_hash_table_lookup (factory->idle_engines, desc);
+
+    if (g_list_length (engines) >= BUS_FACTORY_PROXY_POOL_SIZE)
+        return FALSE;
+
+    g_object_ref (engine);
+    engines = g_list_append (engines, engine);
+    g_hash_table_insert (factory->idle_engines, desc, engines);
+
+    g_signal_connect (engine,
+                      "destroy",
+                      G_CALLBACK (_idle_engine_destroy_cb),
+                      factory);
+    return TRUE;
+}
 
+static BusEngineProxy *
+bus_factory_proxy_take_idle_engine (BusFactoryProxy *factory,
+                                    IBusEngineDesc  *desc)
+{
+    BusEngineProxy *engine;
+    GList *engines;
+
+    engines = (GList *) g_hash_table_lookup (factory->idle_engines, desc);
+    if (engines == NULL)
+        return NULL;
+
+    engine = (BusEngineProxy *) engines->data;
+    engines = g_list_delete_link (engines, engines);
+
+    if (engines != NULL)
+        g_hash_table_insert (factory->idle_engines, desc, engines);
+    else
+        g_hash_table_remove (factory->idle_engines, desc);
+
+    g_signal_handlers_disconnect_by_func (engine,
+                                          G_CALLBACK (_idle_engine_destroy_cb),
+                                          factory);
     return engine;
 }
 
+typedef struct {
+    BusFactoryProxy *factory;
+    IBusEngineDesc  *desc;
+    GFunc            func;
+    gpointer         user_data;
+} PoolRequest;
+
+static void
+_fill_pool_cb (BusEngineProxy *engine,
+               PoolRequest    *data)
+{
+    BusFactoryProxy *factory = data->factory;
+
+    if (!IBUS_OBJECT_DESTROYED (factory)) {
+        factory->filling = g_list_remove (factory->filling, data->desc);
+
+        if (engine != NULL && !bus_factory_proxy_add_idle_engine (factory, engine)) {
+            ibus_object_destroy ((IBusObject *) engine);
+        }
+    }
+    else if (engine != NULL) {
+        ibus_object_destroy ((IBusObject *) engine);
+    }
+
+    g_object_unref (data->factory);
+    g_object_unref (data->desc);
+    g_slice_free (PoolRequest, data);
+}
+
+/* keeps one idle engine of desc ready for the next input context */
+static void
+bus_factory_proxy_fill_pool (BusFactoryProxy *factory,
+                             IBusEngineDesc  *desc)
+{
+    PoolRequest *data;
+
+    if (desc->shared ||
+        g_hash_table_lookup (factory->idle_engines, desc) != NULL ||
+        g_list_find (factory->filling, desc) != NULL) {
+        return;
+    }
+
+    factory->filling = g_list_prepend (factory->filling, desc);
+
+    data = g_slice_new0 (PoolRequest);
+    data->factory = (BusFactoryProxy *) g_object_ref (factory);
+    data->desc = (IBusEngineDesc *) g_object_ref (desc);
+
+    bus_factory_proxy_call_create_engine (factory,
+                                          desc,
+                                          BUS_FACTORY_PROXY_FILL_TIMEOUT,
+                                          (GFunc) _fill_pool_cb,
+                                          data);
+}
+
+static void
+_shared_engine_destroy_cb (BusEngineProxy  *engine,
+                           BusFactoryProxy *factory)
+{
+    g_hash_table_remove (factory->shared_engines,
+                         bus_engine_proxy_get_desc (engine));
+}
+
+static void
+_create_shared_engine_cb (BusEngineProxy *engine,
+                          PoolRequest    *data)
+{
+    BusFactoryProxy *factory = data->factory;
+
+    if (engine != NULL && !IBUS_OBJECT_DESTROYED (factory)) {
+        BusEngineProxy *shared;
+
+        shared = (BusEngineProxy *) g_hash_table_lookup (factory->shared_engines, data->desc);
+
+        if (shared == NULL) {
+            g_hash_table_insert (factory->shared_engines,
+                                 data->desc,
+                                 g_object_ref (engine));
+            g_signal_connect (engine,
+                              "destroy",
+                              G_CALLBACK (_shared_engine_destroy_cb),
+                              factory);
+        }
+        else if (shared != engine) {
+            /* another context asked for it at the same time */
+            ibus_object_destroy ((IBusObject *) engine);
+            engine = shared;
+        }
+    }
+
+    data->func (engine, data->user_data);
+
+    g_object_unref (data->factory);
+    g_object_unref (data->desc);
+    g_slice_free (PoolRequest, data);
+}
+
+/*
+ * Ask the factory for an engine without blocking the main loop.
+ * return_cb is called with the BusEngineProxy, or NULL if the engine
+ * can not be created within timeout milliseconds.  The engine is owned by
+ * the caller of this function only for the duration of return_cb, so it
+ * has to be referenced there.
+ *
+ * An idle engine from the pool is handed out at once if there is one, and
+ * the pool is refilled in the background.  All requests for a shared
+ * engine get the same instance.
+ */
+void
+bus_factory_proxy_create_engine_async (BusFactoryProxy *factory,
+                                       IBusEngineDesc  *desc,
+                                       gint             timeout,
+                                       GFunc            return_cb,
+                                       gpointer         user_data)
+{
+    g_assert (BUS_IS_FACTORY_PROXY (factory));
+    g_assert (IBUS_IS_ENGINE_DESC (desc));
+    g_assert (return_cb);
+
+    BusEngineProxy *engine;
+
+    if (desc->shared) {
+        PoolRequest *data;
+
+        engine = (BusEngineProxy *) g_hash_table_lookup (factory->shared_engines, desc);
+        if (engine != NULL) {
+            return_cb (engine, user_data);
+            return;
+        }
+
+        data = g_slice_new0 (PoolRequest);
+        data->factory = (BusFactoryProxy *) g_object_ref (factory);
+        data->desc = (IBusEngineDesc *) g_object_ref (desc);
+        data->func = return_cb;
+        data->user_data = user_data;
+
+        bus_factory_proxy_call_create_engine (factory,
+                                              desc,
+                                              timeout,
+                                              (GFunc) _create_shared_engine_cb,
+                                              data);
+        return;
+    }
+
+    engine = bus_factory_proxy_take_idle_engine (factory, desc);
+
+    if (engine != NULL) {
+        return_cb (engine, user_data);
+        g_object_unref (engine);
+    }
+    else {
+        bus_factory_proxy_call_create_engine (factory, desc, timeout, return_cb, user_data);
+    }
+
+    if (!IBUS_OBJECT_DESTROYED (factory)) {
+        bus_factory_proxy_fill_pool (factory, desc);
+    }
+}
+
+/*
+ * Takes back an engine an input context does not use anymore. The engine
+ * is reset and kept for the next context, a shared engine just stays with
+ * the factory. Returns FALSE if the engine can not be reused, the caller
+ * has to destroy it then.
+ */
+gboolean
+bus_factory_proxy_release_engine (BusFactoryProxy *factory,
+                                  BusEngineProxy  *engine)
+{
+    g_assert (BUS_IS_FACTORY_PROXY (factory));
+    g_assert (BUS_IS_ENGINE_PROXY (engine));
+
+    if (IBUS_OBJECT_DESTROYED (factory) ||
+        IBUS_OBJECT_DESTROYED (engine) ||
+        g_list_find (factory->engine_list, bus_engine_proxy_get_desc (engine)) == NULL) {
+        return FALSE;
+    }
+
+    if (ibus_proxy_get_connection ((IBusProxy *) engine) !=
+        ibus_proxy_get_connection ((IBusProxy *) factory)) {
+        return FALSE;
+    }
+
+    if (bus_engine_proxy_is_shared (engine)) {
+        return g_hash_table_lookup (factory->shared_engines,
+                                    bus_engine_proxy_get_desc (engine)) == engine;
+    }
+
+    bus_engine_proxy_reset (engine);
+    return bus_factory_proxy_add_idle_engine (factory, engine);
+}
@@ -53,6 +53,13 @@ struct _BusFactoryProxy {
 
     IBusComponent *component;
     GList *engine_list;
+
+    /* reset engines waiting to be handed out, IBusEngineDesc -> GList */
+    GHashTable *idle_engines;
+    /* engines being created for idle_engines */
+    GList *filling;
+    /* the only instance of each shared engine, IBusEngineDesc -> engine */
+    GHashTable *shared_engines;
 };
 
 struct _BusFactoryProxyClass {
@@ -64,8 +71,19 @@ GType            bus_factory_proxy_get_type     (void);
 BusFactoryProxy *bus_factory_proxy_new          (IBusComponent      *component,
                                                  BusConnection      *connection);
 IBusComponent   *bus_factory_proxy_get_component(BusFactoryProxy    *factory);
+void             bus_factory_proxy_set_component(BusFactoryProxy    *factory,
+                                                 IBusComponent      *component);
 BusEngineProxy  *bus_factory_proxy_create_engine(BusFactoryProxy    *factory,
                                                  IBusEngineDesc     *desc);
+void             bus_factory_proxy_create_engine_async
+                                                (BusFactoryProxy    *factory,
+                                                 IBusEngineDesc     *desc,
+                                                 gint                timeout,
+                                                 GFunc               return_cb,
+                                                 gpointer            user_data);
+gboolean         bus_factory_proxy_release_engine
+                                                (BusFactoryProxy    *factory,
+                                                 BusEngineProxy     *engine);
 BusFactoryProxy *bus_factory_proxy_get_from_component
                                                 (IBusComponent      *component);
 BusFactoryProxy *bus_factory_proxy_get_from_engine
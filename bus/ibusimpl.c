@@ -33,7 +33,10 @@
 #include "factoryproxy.h"
 #include "panelproxy.h"
 #include "inputcontext.h"
+#include "stats.h"
 
+/* milliseconds a factory may take to create an engine */
+#define BUS_ENGINE_CREATE_TIMEOUT   (5000)
 
 enum {
     LAST_SIGNAL,
@@ -59,8 +62,14 @@ static void     bus_ibus_impl_set_trigger       (BusIBusImpl        *ibus,
 static void     bus_ibus_impl_set_preload_engines
                                                 (BusIBusImpl        *ibus,
                                                  GValue             *value);
+static void     bus_ibus_impl_set_max_launches  (BusIBusImpl        *ibus,
+                                                 GValue             *value);
+static void     bus_ibus_impl_set_key_event_timeout
+                                                (BusIBusImpl        *ibus,
+                                                 GValue             *value);
 static void     _factory_destroy_cb             (BusFactoryProxy      *factory,
                                                  BusIBusImpl          *ibus);
+static void     _ibus_impl_report_engines       (GString            *report);
 
 static IBusServiceClass  *parent_class = NULL;
 
@@ -228,13 +237,48 @@ bus_ibus_impl_set_preload_engines (BusIBusImpl *ibus,
     g_list_foreach (engine_list, (GFunc) g_object_ref, NULL);
     ibus->engine_list = engine_list;
 
-    if (ibus->engine_list) {
-        IBusComponent *component;
+    bus_registry_preload_engines (ibus->registry, ibus->engine_list);
+}
 
-        component = ibus_component_get_from_engine ((IBusEngineDesc *) ibus->engine_list->data);
-        if (component && !ibus_component_is_running (component)) {
-            ibus_component_start (component);
-        }
+static void
+bus_ibus_impl_set_max_launches (BusIBusImpl *ibus,
+                                GValue      *value)
+{
+    if (value != NULL && G_VALUE_TYPE (value) == G_TYPE_INT) {
+        bus_registry_set_max_launches (ibus->registry,
+                                       MAX (g_value_get_int (value), 0));
+    }
+}
+
+static void
+bus_ibus_impl_set_key_event_timeout (BusIBusImpl *ibus,
+                                     GValue      *value)
+{
+    if (value != NULL && G_VALUE_TYPE (value) == G_TYPE_INT) {
+        bus_engine_proxy_set_default_key_event_timeout (g_value_get_int (value));
+    }
+}
+
+/* an engine may get its own key event budget in general/key_event_timeouts,
+ * 0 waits forever as in general/key_event_timeout */
+static void
+bus_ibus_impl_load_engine_key_event_timeout (BusIBusImpl    *ibus,
+                                             BusEngineProxy *engine)
+{
+    IBusEngineDesc *desc;
+    GValue value = { 0 };
+
+    if (ibus->config == NULL)
+        return;
+
+    desc = bus_engine_proxy_get_desc (engine);
+    if (ibus_config_get_value (ibus->config,
+                               "general/key_event_timeouts",
+                               desc->name,
+                               &value)) {
+        if (G_VALUE_TYPE (&value) == G_TYPE_INT)
+            bus_engine_proxy_set_key_event_timeout (engine, g_value_get_int (&value));
+        g_value_unset (&value);
     }
 }
 
@@ -301,6 +345,22 @@ bus_ibus_impl_set_default_preload_engines (BusIBusImpl *ibus)
     g_list_free (engines);
 }
 
+static void
+bus_ibus_impl_preload_config (BusIBusImpl *ibus)
+{
+    g_assert (BUS_IS_IBUS_IMPL (ibus));
+
+    GHashTable *values;
+
+    /* "general" and its subsections (hotkeys) hold everything the daemon
+     * reads, fetch them in one call and serve the reads from the cache */
+    ibus_config_set_cache_enabled (ibus->config, TRUE);
+
+    values = ibus_config_get_section (ibus->config, "general");
+    if (values != NULL)
+        g_hash_table_destroy (values);
+}
+
 static void
 bus_ibus_impl_reload_config (BusIBusImpl *ibus)
 {
@@ -317,6 +377,8 @@ bus_ibus_impl_reload_config (BusIBusImpl *ibus)
         { "general/hotkey", "trigger", bus_ibus_impl_set_trigger },
         { "general/hotkey", "next_engine", bus_ibus_impl_set_next_engine },
         { "general/hotkey", "prev_engine", bus_ibus_impl_set_prev_engine },
+        { "general", "max_concurrent_launches", bus_ibus_impl_set_max_launches },
+        { "general", "key_event_timeout", bus_ibus_impl_set_key_event_timeout },
         { "general", "preload_engines", bus_ibus_impl_set_preload_engines },
         { NULL, NULL, NULL },
     };
@@ -359,6 +421,8 @@ _config_value_changed_cb (IBusConfig  *config,
         { "general/hotkey", "trigger",     bus_ibus_impl_set_trigger },
         { "general/hotkey", "next_engine", bus_ibus_impl_set_next_engine },
         { "general/hotkey", "prev_engine", bus_ibus_impl_set_prev_engine },
+        { "general", "max_concurrent_launches", bus_ibus_impl_set_max_launches },
+        { "general", "key_event_timeout",  bus_ibus_impl_set_key_event_timeout },
         { "general", "preload_engines",    bus_ibus_impl_set_preload_engines },
         { NULL, NULL, NULL },
     };
@@ -452,6 +516,7 @@ _dbus_name_owner_changed_cb (BusDBusImpl *dbus,
                               G_CALLBACK (_config_destroy_cb),
                               ibus);
 
+            bus_ibus_impl_preload_config (ibus);
             bus_ibus_impl_set_default_preload_engines (ibus);
             bus_ibus_impl_reload_config (ibus);
         }
@@ -490,6 +555,44 @@ bus_ibus_impl_init (BusIBusImpl *ibus)
                       "name-owner-changed",
                       G_CALLBACK (_dbus_name_owner_changed_cb),
                       ibus);
+
+    bus_stats_add_report_func (_ibus_impl_report_engines);
+}
+
+/* key events the engines in use did not handle in time for the statistics */
+static void
+_ibus_impl_report_engines (GString *report)
+{
+    BusIBusImpl *ibus;
+    GList *engines = NULL;
+    GList *p;
+
+    ibus = BUS_DEFAULT_IBUS;
+
+    g_string_append_printf (report,
+                            "%-8s %-24s %10s %10s\n",
+                            "timeouts", "", "keys", "degraded");
+
+    for (p = ibus->contexts; p != NULL; p = p->next) {
+        BusEngineProxy *engine;
+        IBusEngineDesc *desc;
+
+        engine = bus_input_context_get_engine (BUS_INPUT_CONTEXT (p->data));
+        /* a shared engine works for several contexts */
+        if (engine == NULL || g_list_find (engines, engine) != NULL)
+            continue;
+        engines = g_list_prepend (engines, engine);
+
+        desc = bus_engine_proxy_get_desc (engine);
+        g_string_append_printf (report,
+                                "%-8s %-24s %10u %10s\n",
+                                "timeouts",
+                                desc->name,
+                                bus_engine_proxy_get_key_event_timeouts (engine),
+                                bus_engine_proxy_is_degraded (engine) ? "yes" : "no");
+    }
+
+    g_list_free (engines);
 }
 
 static void
@@ -610,50 +713,80 @@ _ibus_get_address (BusIBusImpl     *ibus,
     return reply;
 }
 
-static BusEngineProxy *
-bus_ibus_impl_create_engine (IBusEngineDesc *engine_desc)
-{
-    IBusComponent *comp;
-    BusFactoryProxy *factory;
-    BusEngineProxy *engine;
+typedef struct {
+    BusInputContext *context;
+    IBusEngineDesc  *desc;
+    guint            request;
+} EngineRequest;
 
-    factory = bus_factory_proxy_get_from_engine (engine_desc);
+static void
+_create_engine_cb (BusEngineProxy *engine,
+                   EngineRequest  *data)
+{
+    g_assert (engine == NULL || BUS_IS_ENGINE_PROXY (engine));
 
-    if (factory == NULL) {
-        /* try to execute the engine */
-        comp = ibus_component_get_from_engine (engine_desc);
-        g_assert (comp);
+    if (engine != NULL)
+        bus_ibus_impl_load_engine_key_event_timeout (BUS_DEFAULT_IBUS, engine);
 
-        if (!ibus_component_is_running (comp)) {
-            ibus_component_start (comp);
+    if (!bus_input_context_end_engine_request (data->context,
+                                               data->request,
+                                               engine)) {
+        /* the context was destroyed or requested another engine */
+        if (engine != NULL) {
+            BusFactoryProxy *factory;
 
-            gint time = 0;
-            while (time < G_USEC_PER_SEC * 3) {
-                if (g_main_context_pending (NULL)) {
-                    g_main_context_iteration (NULL, FALSE);
-                }
-                else {
-                    g_usleep (50 * 1000);
-                    time += 50 * 1000;
-                }
-                factory = bus_factory_proxy_get_from_engine (engine_desc);
-                if (factory != NULL) {
-                    break;
-                }
+            factory = bus_factory_proxy_get_from_engine (data->desc);
+            if (factory == NULL || !bus_factory_proxy_release_engine (factory, engine)) {
+                ibus_object_destroy ((IBusObject *) engine);
             }
         }
-        factory = bus_factory_proxy_get_from_engine (engine_desc);
     }
 
+    g_object_unref (data->context);
+    g_object_unref (data->desc);
+    g_slice_free (EngineRequest, data);
+}
+
+static void
+_component_started_cb (BusFactoryProxy *factory,
+                       EngineRequest   *data)
+{
+    g_assert (factory == NULL || BUS_IS_FACTORY_PROXY (factory));
+
     if (factory == NULL) {
-        return NULL;
+        _create_engine_cb (NULL, data);
+        return;
     }
 
-    g_object_ref (factory);
-    engine = bus_factory_proxy_create_engine (factory, engine_desc);
-    g_object_unref (factory);
+    bus_factory_proxy_create_engine_async (factory,
+                                           data->desc,
+                                           BUS_ENGINE_CREATE_TIMEOUT,
+                                           (GFunc) _create_engine_cb,
+                                           data);
+}
 
-    return engine;
+static void
+bus_ibus_impl_create_engine (BusIBusImpl     *ibus,
+                             IBusEngineDesc  *engine_desc,
+                             BusInputContext *context)
+{
+    IBusComponent *comp;
+    EngineRequest *data;
+
+    data = g_slice_new (EngineRequest);
+    data->context = (BusInputContext *) g_object_ref (context);
+    data->desc = (IBusEngineDesc *) g_object_ref (engine_desc);
+    data->request = bus_input_context_begin_engine_request (context);
+
+    comp = ibus_component_get_from_engine (engine_desc);
+    g_assert (comp);
+
+    /* the factory is ready or the component is started without blocking
+     * the daemon, the request continues when it owns its name */
+    bus_registry_start_component_async (ibus->registry,
+                                        comp,
+                                        (GFunc) _component_started_cb,
+                                        data);
 }
 
 static void
@@ -662,7 +795,6 @@ _context_request_engine_cb (BusInputContext *context,
                             BusIBusImpl     *ibus)
 {
     IBusEngineDesc *engine_desc = NULL;
-    BusEngineProxy *engine;
 
     if (engine_name == NULL || engine_name[0] == '\0') {
         /* request default engine */
@@ -707,14 +839,7 @@ _context_request_engine_cb (BusInputContext *context,
         return;
     }
 
-    engine = bus_ibus_impl_create_engine (engine_desc);
-
-    if (engine == NULL) {
-        return;
-    }
-
-    bus_input_context_set_engine (context, engine);
-    g_object_unref (engine);
+    bus_ibus_impl_create_engine (ibus, engine_desc, context);
 }
 
 static void
@@ -758,9 +883,7 @@ _context_request_next_engine_cb (BusInputContext *context,
     }
 
     if (next_desc != NULL) {
-        engine = bus_ibus_impl_create_engine (next_desc);
-        bus_input_context_set_engine (context, engine);
-        g_object_unref (engine);
+        bus_ibus_impl_create_engine (ibus, next_desc, context);
     }
 }
 
@@ -1088,6 +1211,25 @@ _ibus_exit (BusIBusImpl     *ibus,
     return NULL;
 }
 
+static IBusMessage *
+_ibus_get_stats (BusIBusImpl     *ibus,
+                 IBusMessage     *message,
+                 BusConnection   *connection)
+{
+    IBusMessage *reply;
+    gchar *stats;
+
+    stats = bus_stats_to_string ();
+
+    reply = ibus_message_new_method_return (message);
+    ibus_message_append_args (reply,
+                              G_TYPE_STRING, &stats,
+                              G_TYPE_INVALID);
+    g_free (stats);
+
+    return reply;
+}
+
 static gboolean
 bus_ibus_impl_ibus_message (BusIBusImpl     *ibus,
                             BusConnection   *connection,
@@ -1115,6 +1257,7 @@ bus_ibus_impl_ibus_message (BusIBusImpl     *ibus,
         { IBUS_INTERFACE_IBUS, "ListEngines",           _ibus_list_engines },
         { IBUS_INTERFACE_IBUS, "ListActiveEngines",     _ibus_list_active_engines },
         { IBUS_INTERFACE_IBUS, "Exit",                  _ibus_exit },
+        { IBUS_INTERFACE_IBUS, "GetStats",              _ibus_get_stats },
         { NULL, NULL, NULL }
     };
 
@@ -20,14 +20,35 @@
 
 #include <ibusinternal.h>
 #include <ibusmarshalers.h>
+#include <ibuskeyring.h>
 #include "ibusimpl.h"
 #include "inputcontext.h"
 #include "engineproxy.h"
 #include "factoryproxy.h"
+#include "stats.h"
 
 #define BUS_INPUT_CONTEXT_GET_PRIVATE(o)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((o), BUS_TYPE_INPUT_CONTEXT, BusInputContextPrivate))
 
+/* a shared engine works for the context which used it last, the others
+ * ignore its signals and do not pass their state to it */
+#define ENGINE_IS_OURS(context, engine) \
+    (bus_engine_proxy_get_owner (engine) == (context))
+
+/* how often held back updates are retried while a peer is congested */
+#define BUS_INPUT_CONTEXT_CONGESTED_RETRY   (50)
+
+/* marks an item of the panel state as changed */
+#define STATE_CHANGED(priv, item) \
+    ((priv)->serials.item = ++state_serial)
+
+/* updates waiting to be passed to the client or the panel */
+enum {
+    PENDING_PREEDIT_TEXT    = 1 << 0,
+    PENDING_AUXILIARY_TEXT  = 1 << 1,
+    PENDING_LOOKUP_TABLE    = 1 << 2,
+};
+
 enum {
     PROCESS_KEY_EVENT,
     SET_CURSOR_LOCATION,
@@ -95,6 +116,29 @@ struct _BusInputContextPrivate {
 
     /* properties */
     IBusPropList *props;
+
+    /* changes of the above, the panel skips what it shows already */
+    BusInputContextSerials serials;
+
+    /* updates of the above not passed on yet */
+    guint pending_updates;
+    guint flush_id;
+
+    /* engine creation in progress */
+    guint engine_request;
+    gboolean enable_on_engine;
+    IBusMessage *set_engine_message;
+
+    /* last key seen by the hotkey filter, release-triggered hotkeys
+     * fire only right after the press of the same key */
+    guint prev_keyval;
+    guint prev_modifiers;
+
+    /* shared memory path for key events, opened by the client */
+    IBusKeyRing *key_ring;
+    /* serial of the last signal sent since the ring was opened, the
+     * client holds a ring reply back until it has seen it */
+    guint32 message_serial;
 };
 
 typedef struct _BusInputContextPrivate BusInputContextPrivate;
@@ -116,8 +160,19 @@ static gboolean bus_input_context_send_signal   (BusInputContext        *context
                                                  const gchar            *signal_name,
                                                  GType                   first_arg_type,
                                                  ...);
+static IBusSerializeFlags
+                bus_input_context_get_serialize_flags
+                                                (BusInputContext        *context);
+static IBusMessage
+               *bus_input_context_new_signal    (BusInputContext        *context,
+                                                 const gchar            *signal_name);
+static gboolean bus_input_context_send_message  (BusInputContext        *context,
+                                                 IBusMessage            *message);
 
 static void     bus_input_context_unset_engine  (BusInputContext        *context);
+static void     bus_input_context_close_key_ring(BusInputContext        *context);
+static void     bus_input_context_flush_updates (BusInputContext        *context);
+static gboolean bus_input_context_claim_engine  (BusInputContext        *context);
 static void     bus_input_context_update_preedit_text
                                                 (BusInputContext        *context,
                                                  IBusText               *text,
@@ -162,6 +217,9 @@ static void     _engine_destroy_cb              (BusEngineProxy         *factory
 
 static IBusServiceClass  *parent_class = NULL;
 static guint id = 0;
+static guint engine_request_id = 0;
+static guint state_serial = 0;
+static guint n_elided_updates = 0;
 static IBusText *text_empty = NULL;
 static IBusLookupTable *lookup_table_empty = NULL;
 static IBusPropList    *props_empty = NULL;
@@ -551,6 +609,24 @@ bus_input_context_init (BusInputContext *context)
 
     g_object_ref (props_empty);
     priv->props = props_empty;
+
+    STATE_CHANGED (priv, props);
+    STATE_CHANGED (priv, preedit);
+    STATE_CHANGED (priv, auxiliary);
+    STATE_CHANGED (priv, lookup_table);
+
+    priv->pending_updates = 0;
+    priv->flush_id = 0;
+
+    priv->engine_request = 0;
+    priv->enable_on_engine = FALSE;
+    priv->set_engine_message = NULL;
+
+    priv->key_ring = NULL;
+    priv->message_serial = 0;
+
+    priv->prev_keyval = IBUS_VoidSymbol;
+    priv->prev_modifiers = 0;
 }
 
 static void
@@ -559,6 +635,8 @@ bus_input_context_destroy (BusInputContext *context)
     BusInputContextPrivate *priv;
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
+    bus_input_context_close_key_ring (context);
+
     if (priv->has_focus) {
         bus_input_context_focus_out (context);
         priv->has_focus = FALSE;
@@ -568,6 +646,21 @@ bus_input_context_destroy (BusInputContext *context)
         bus_input_context_unset_engine (context);
     }
 
+    if (priv->connection) {
+        bus_input_context_flush_updates (context);
+    }
+    else if (priv->flush_id != 0) {
+        g_source_remove (priv->flush_id);
+        priv->flush_id = 0;
+    }
+    priv->pending_updates = 0;
+
+    priv->engine_request = 0;
+    if (priv->set_engine_message) {
+        ibus_message_unref (priv->set_engine_message);
+        priv->set_engine_message = NULL;
+    }
+
     if (priv->preedit_text) {
         g_object_unref (priv->preedit_text);
         priv->preedit_text = NULL;
@@ -644,8 +737,22 @@ _ibus_introspect (BusInputContext   *context,
 typedef struct {
     BusInputContext *context;
     IBusMessage     *message;
+    IBusEngineDesc  *desc;
+    BusKeyTiming     timing;
 } CallData;
 
+/* ends the timing of a key, desc is the engine which had it */
+static void
+bus_input_context_key_timing_done (BusInputContext *context,
+                                   BusKeyTiming    *timing,
+                                   IBusEngineDesc  *desc)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    bus_stats_key_done (timing, priv->client, desc != NULL ? desc->name : NULL);
+}
+
 static void
 _ic_process_key_event_reply_cb (gpointer data,
                                 gpointer user_data)
@@ -653,6 +760,7 @@ _ic_process_key_event_reply_cb (gpointer data,
     gboolean retval;
     CallData *call_data;
     IBusMessage *reply;
+    IBusMessageIter iter;
 
     retval = (gboolean) GPOINTER_TO_INT (data);
     call_data = (CallData *) user_data;
@@ -660,14 +768,22 @@ _ic_process_key_event_reply_cb (gpointer data,
     BusInputContextPrivate *priv;
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (call_data->context);
 
+    call_data->timing.engine_replied = bus_stats_now ();
+
+    /* the client gets the updates caused by the key before the reply */
+    bus_input_context_flush_updates (call_data->context);
 
     reply = ibus_message_new_method_return (call_data->message);
-    ibus_message_append_args (reply,
-                              G_TYPE_BOOLEAN, &retval,
-                              G_TYPE_INVALID);
+    ibus_message_iter_init_append (reply, &iter);
+    ibus_message_iter_append_boolean (&iter, retval);
     ibus_connection_send ((IBusConnection *)priv->connection, reply);
 
+    bus_input_context_key_timing_done (call_data->context,
+                                       &call_data->timing,
+                                       call_data->desc);
+
     g_object_unref (call_data->context);
+    g_object_unref (call_data->desc);
     ibus_message_unref (call_data->message);
     ibus_message_unref (reply);
     g_slice_free (CallData, call_data);
@@ -686,10 +802,13 @@ _ic_process_key_event (BusInputContext *context,
     guint keyval, modifiers;
     gboolean retval;
     IBusError *error;
+    BusKeyTiming timing;
 
     BusInputContextPrivate *priv;
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
+    bus_stats_key_timing_start (&timing, TRUE);
+
     retval = ibus_message_get_args (message,
                 &error,
                 G_TYPE_UINT, &keyval,
@@ -705,6 +824,7 @@ _ic_process_key_event (BusInputContext *context,
     }
 
     retval = bus_input_context_filter_keyboard_shortcuts (context, keyval, modifiers);
+    timing.filtered = bus_stats_now ();
 
     if (retval) {
         reply = ibus_message_new_method_return (message);
@@ -713,6 +833,8 @@ _ic_process_key_event (BusInputContext *context,
                                   G_TYPE_INVALID);
     }
     else if (priv->enabled && priv->engine) {
+        /* While a new engine is being created the current one, if any,
+         * keeps handling keys; without one they are passed through. */
         CallData *call_data;
 
         call_data = g_slice_new (CallData);
@@ -722,7 +844,11 @@ _ic_process_key_event (BusInputContext *context,
 
         call_data->context = context;
         call_data->message = message;
+        call_data->desc = g_object_ref (bus_engine_proxy_get_desc (priv->engine));
+        call_data->timing = timing;
 
+        bus_input_context_claim_engine (context);
+        call_data->timing.engine_sent = bus_stats_now ();
         bus_engine_proxy_process_key_event (priv->engine,
                                             keyval,
                                             modifiers,
@@ -735,9 +861,383 @@ _ic_process_key_event (BusInputContext *context,
                                   G_TYPE_BOOLEAN, &retval,
                                   G_TYPE_INVALID);
     }
+
+    if (reply != NULL) {
+        /* the reply is sent right after the handler returns */
+        bus_input_context_key_timing_done (context, &timing, NULL);
+    }
+    return reply;
+}
+
+typedef struct {
+    BusInputContext *context;
+    IBusMessage     *message;
+    GArray          *keys;
+    guint            n_keys;
+    guint            index;
+    /* keys before this one went through the hotkey filter */
+    guint            n_filtered;
+    guint32         *handled;
+    gboolean         passthrough;
+} KeyBatch;
+
+#define KEY_BATCH_KEYVAL(batch, i) (g_array_index ((batch)->keys, guint32, (i) * 2))
+#define KEY_BATCH_STATE(batch, i)  (g_array_index ((batch)->keys, guint32, (i) * 2 + 1))
+
+static void     _ic_process_key_batch           (KeyBatch           *batch);
+
+/* runs key i through the hotkey filter, once: an engine may stop in the
+ * middle of a run, and the keys it did not take are sent again */
+static gboolean
+_ic_key_batch_filter (KeyBatch *batch,
+                      guint     i)
+{
+    if (i < batch->n_filtered)
+        return FALSE;
+
+    batch->n_filtered = i + 1;
+    return bus_input_context_filter_keyboard_shortcuts (batch->context,
+                                                        KEY_BATCH_KEYVAL (batch, i),
+                                                        KEY_BATCH_STATE (batch, i));
+}
+
+static void
+_ic_process_key_batch_done (KeyBatch *batch)
+{
+    IBusMessage *reply;
+    IBusMessageIter iter;
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (batch->context);
+
+    if (priv->connection) {
+        bus_input_context_flush_updates (batch->context);
+
+        reply = ibus_message_new_method_return (batch->message);
+        ibus_message_iter_init_append (reply, &iter);
+        ibus_message_iter_append (&iter, G_TYPE_UINT, &batch->index);
+        ibus_message_iter_append_uint_array (&iter,
+                                             batch->handled,
+                                             (batch->n_keys + 31) / 32);
+        ibus_connection_send ((IBusConnection *) priv->connection, reply);
+        ibus_message_unref (reply);
+    }
+
+    g_object_unref (batch->context);
+    ibus_message_unref (batch->message);
+    g_array_free (batch->keys, TRUE);
+    g_free (batch->handled);
+    g_slice_free (KeyBatch, batch);
+}
+
+static void
+_ic_process_key_batch_reply_cb (guint          processed,
+                                const guint32 *handled,
+                                KeyBatch      *batch)
+{
+    guint i;
+
+    for (i = 0; i < processed; i++) {
+        guint j = batch->index + i;
+        /* the first key of the run was filtered before it was sent */
+        _ic_key_batch_filter (batch, j);
+        if (handled[i / 32] & (1u << (i % 32)))
+            batch->handled[j / 32] |= 1u << (j % 32);
+        else
+            batch->passthrough = TRUE;
+    }
+    batch->index += processed;
+
+    _ic_process_key_batch (batch);
+}
+
+static void
+_ic_process_key_batch (KeyBatch *batch)
+{
+    BusInputContext *context = batch->context;
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    while (batch->index < batch->n_keys && !IBUS_OBJECT_DESTROYED (context)) {
+        guint keyval = KEY_BATCH_KEYVAL (batch, batch->index);
+        guint modifiers = KEY_BATCH_STATE (batch, batch->index);
+        guint end;
+
+        if (batch->passthrough) {
+            /* The client handles the unhandled keys after the reply, so
+             * stop before any key which could produce output ahead of them. */
+            if (priv->enabled && priv->engine)
+                break;
+            if (ibus_hotkey_profile_lookup_hotkey (BUS_DEFAULT_HOTKEY_PROFILE,
+                                                   keyval, modifiers) != 0)
+                break;
+            _ic_key_batch_filter (batch, batch->index);
+            batch->index ++;
+            continue;
+        }
+
+        if (_ic_key_batch_filter (batch, batch->index)) {
+            batch->handled[batch->index / 32] |= 1u << (batch->index % 32);
+            batch->index ++;
+            continue;
+        }
+
+        if (!priv->enabled || priv->engine == NULL) {
+            batch->passthrough = TRUE;
+            batch->index ++;
+            continue;
+        }
+
+        /* send the following keys up to the next possible hotkey to the
+         * engine in one call; they go through the hotkey filter once the
+         * engine reports them processed */
+        for (end = batch->index + 1; end < batch->n_keys; end++) {
+            keyval = KEY_BATCH_KEYVAL (batch, end);
+            modifiers = KEY_BATCH_STATE (batch, end);
+            if (ibus_hotkey_profile_lookup_hotkey (BUS_DEFAULT_HOTKEY_PROFILE,
+                                                   keyval, modifiers) != 0)
+                break;
+        }
+
+        bus_input_context_claim_engine (context);
+        bus_engine_proxy_process_key_events (priv->engine,
+                                             &KEY_BATCH_KEYVAL (batch, batch->index),
+                                             end - batch->index,
+                                             (BusEngineProxyKeyEventsFunc) _ic_process_key_batch_reply_cb,
+                                             batch);
+        return;
+    }
+
+    _ic_process_key_batch_done (batch);
+}
+
+static IBusMessage *
+_ic_process_key_events (BusInputContext *context,
+                        IBusMessage     *message,
+                        BusConnection   *connection)
+{
+    g_assert (BUS_IS_INPUT_CONTEXT (context));
+    g_assert (message != NULL);
+    g_assert (BUS_IS_CONNECTION (connection));
+
+    IBusMessageIter iter;
+    GArray *keys = NULL;
+    KeyBatch *batch;
+
+    if (ibus_message_iter_init (message, &iter))
+        keys = ibus_message_iter_get_uint_array (&iter);
+
+    if (keys == NULL || keys->len % 2 != 0) {
+        if (keys)
+            g_array_free (keys, TRUE);
+        return ibus_message_new_error_printf (message,
+                                              DBUS_ERROR_INVALID_ARGS,
+                                              "%s.%s: Can not match signature (au) of method",
+                                              IBUS_INTERFACE_INPUT_CONTEXT,
+                                              "ProcessKeyEvents");
+    }
+
+    batch = g_slice_new0 (KeyBatch);
+    batch->context = g_object_ref (context);
+    batch->message = ibus_message_ref (message);
+    batch->keys = keys;
+    batch->n_keys = keys->len / 2;
+    batch->handled = g_new0 (guint32, (batch->n_keys + 31) / 32);
+
+    _ic_process_key_batch (batch);
+
+    return NULL;
+}
+
+typedef struct {
+    BusInputContext *context;
+    guint32          serial;
+    IBusEngineDesc  *desc;
+    BusKeyTiming     timing;
+} KeyRingCallData;
+
+static void
+bus_input_context_key_ring_reply (BusInputContext *context,
+                                  guint32          serial,
+                                  gboolean         handled)
+{
+    IBusKeyRingEvent event = { 0 };
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    /* closed while the engine had the key */
+    if (priv->key_ring == NULL ||
+        priv->connection == NULL ||
+        !ibus_connection_is_connected ((IBusConnection *) priv->connection))
+        return;
+
+    bus_input_context_flush_updates (context);
+
+    /* the signals caused by the key must reach the application first, the
+     * client holds the reply until it has dispatched the last of them */
+    event.serial = serial;
+    event.handled = handled;
+    event.message_serial = priv->message_serial;
+
+    if (!ibus_key_ring_push (priv->key_ring, &event)) {
+        /* the client stopped reading, its call times out */
+        g_warning ("Key ring of %s is full", priv->client);
+    }
+}
+
+static void
+_ic_key_ring_reply_cb (gpointer         data,
+                       KeyRingCallData *call_data)
+{
+    call_data->timing.engine_replied = bus_stats_now ();
+
+    bus_input_context_key_ring_reply (call_data->context,
+                                      call_data->serial,
+                                      (gboolean) GPOINTER_TO_INT (data));
+
+    bus_input_context_key_timing_done (call_data->context,
+                                       &call_data->timing,
+                                       call_data->desc);
+
+    g_object_unref (call_data->context);
+    g_object_unref (call_data->desc);
+    g_slice_free (KeyRingCallData, call_data);
+}
+
+static void
+_ic_key_ring_process_cb (IBusKeyRing            *ring,
+                         const IBusKeyRingEvent *event,
+                         BusInputContext        *context)
+{
+    gboolean retval;
+    BusKeyTiming timing;
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    bus_stats_key_timing_start (&timing, FALSE);
+
+    /* same as _ic_process_key_event, with the reply on the ring */
+    retval = bus_input_context_filter_keyboard_shortcuts (context,
+                                                          event->keyval,
+                                                          event->state);
+    timing.filtered = bus_stats_now ();
+
+    if (!retval && priv->enabled && priv->engine) {
+        KeyRingCallData *call_data;
+
+        call_data = g_slice_new (KeyRingCallData);
+        call_data->context = g_object_ref (context);
+        call_data->serial = event->serial;
+        call_data->desc = g_object_ref (bus_engine_proxy_get_desc (priv->engine));
+        call_data->timing = timing;
+
+        bus_input_context_claim_engine (context);
+        call_data->timing.engine_sent = bus_stats_now ();
+        bus_engine_proxy_process_key_event (priv->engine,
+                                            event->keyval,
+                                            event->state,
+                                            (GFunc) _ic_key_ring_reply_cb,
+                                            call_data);
+        return;
+    }
+
+    bus_input_context_key_ring_reply (context, event->serial, retval);
+    bus_input_context_key_timing_done (context, &timing, NULL);
+}
+
+/* keys queued on the ring before a D-Bus call are handled before it */
+static void
+bus_input_context_dispatch_key_ring (BusInputContext *context)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (priv->key_ring == NULL)
+        return;
+
+    ibus_key_ring_dispatch (priv->key_ring,
+                            (IBusKeyRingFunc) _ic_key_ring_process_cb,
+                            context);
+}
+
+static void
+bus_input_context_close_key_ring (BusInputContext *context)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (priv->key_ring == NULL)
+        return;
+
+    /* the client unlinks the files once it has them open; this covers
+     * a client which never did */
+    ibus_key_ring_unlink (priv->key_ring);
+    ibus_key_ring_free (priv->key_ring);
+    priv->key_ring = NULL;
+}
+
+static IBusMessage *
+_ic_open_key_ring (BusInputContext  *context,
+                   IBusMessage      *message,
+                   BusConnection    *connection)
+{
+    g_assert (BUS_IS_INPUT_CONTEXT (context));
+    g_assert (message != NULL);
+    g_assert (BUS_IS_CONNECTION (connection));
+
+    IBusMessage *reply;
+    const gchar *path;
+    gchar *dir;
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (priv->key_ring == NULL) {
+        /* next to the socket, which only the user can reach */
+        dir = g_path_get_dirname (ibus_get_socket_path ());
+        priv->key_ring = ibus_key_ring_new (dir);
+        g_free (dir);
+
+        if (priv->key_ring == NULL) {
+            reply = ibus_message_new_error (message,
+                                            DBUS_ERROR_FAILED,
+                                            "Can not create key ring");
+            return reply;
+        }
+
+        ibus_key_ring_set_watch (priv->key_ring,
+                                 (IBusKeyRingFunc) _ic_key_ring_process_cb,
+                                 context);
+
+        /* signals sent earlier may predate the proxy of the client,
+         * which would then wait for them in vain */
+        priv->message_serial = 0;
+    }
+
+    path = ibus_key_ring_get_path (priv->key_ring);
+    reply = ibus_message_new_method_return (message);
+    ibus_message_append_args (reply,
+                              G_TYPE_STRING, &path,
+                              G_TYPE_INVALID);
     return reply;
 }
 
+static IBusMessage *
+_ic_close_key_ring (BusInputContext  *context,
+                    IBusMessage      *message,
+                    BusConnection    *connection)
+{
+    g_assert (BUS_IS_INPUT_CONTEXT (context));
+    g_assert (message != NULL);
+    g_assert (BUS_IS_CONNECTION (connection));
+
+    bus_input_context_close_key_ring (context);
+
+    return ibus_message_new_method_return (message);
+}
+
 static IBusMessage *
 _ic_set_cursor_location (BusInputContext  *context,
                          IBusMessage      *message,
@@ -770,12 +1270,18 @@ _ic_set_cursor_location (BusInputContext  *context,
         return reply;
     }
 
+    /* toolkits set the location on every redraw, pass on changes only */
+    if (priv->x == x && priv->y == y && priv->w == w && priv->h == h) {
+        reply = ibus_message_new_method_return (message);
+        return reply;
+    }
+
     priv->x = x;
     priv->y = y;
     priv->h = h;
     priv->w = w;
 
-    if (priv->engine) {
+    if (priv->engine && ENGINE_IS_OURS (context, priv->engine)) {
         bus_engine_proxy_set_cursor_location (priv->engine, x, y, w, h);
     }
 
@@ -844,7 +1350,7 @@ _ic_reset (BusInputContext  *context,
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
 
-    if (priv->engine) {
+    if (priv->engine && ENGINE_IS_OURS (context, priv->engine)) {
         bus_engine_proxy_reset (priv->engine);
     }
 
@@ -886,7 +1392,7 @@ _ic_set_capabilities (BusInputContext  *context,
     if (priv->capabilities != caps) {
         priv->capabilities = caps;
 
-        if (priv->engine) {
+        if (priv->engine && ENGINE_IS_OURS (context, priv->engine)) {
             bus_engine_proxy_set_capabilities (priv->engine, caps);
         }
     }
@@ -964,6 +1470,7 @@ _ic_set_engine (BusInputContext  *context,
     IBusMessage *reply;
     IBusError *error;
     gchar *engine_name;
+    guint request;
 
     BusInputContextPrivate *priv;
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
@@ -980,8 +1487,16 @@ _ic_set_engine (BusInputContext  *context,
         return reply;
     }
 
+    request = priv->engine_request;
     g_signal_emit (context, context_signals[REQUEST_ENGINE], 0, engine_name);
 
+    if (priv->engine_request != 0 && priv->engine_request != request) {
+        /* reply when the engine is ready */
+        priv->enable_on_engine = TRUE;
+        priv->set_engine_message = ibus_message_ref (message);
+        return NULL;
+    }
+
     if (priv->engine == NULL) {
         reply = ibus_message_new_error_printf (message,
                                                "org.freedesktop.IBus.NoEngine",
@@ -1071,6 +1586,7 @@ bus_input_context_ibus_message (BusInputContext *context,
                                "Introspect", _ibus_introspect },
         /* IBus interface */
         { IBUS_INTERFACE_INPUT_CONTEXT, "ProcessKeyEvent",   _ic_process_key_event },
+        { IBUS_INTERFACE_INPUT_CONTEXT, "ProcessKeyEvents",  _ic_process_key_events },
         { IBUS_INTERFACE_INPUT_CONTEXT, "SetCursorLocation", _ic_set_cursor_location },
         { IBUS_INTERFACE_INPUT_CONTEXT, "FocusIn",           _ic_focus_in },
         { IBUS_INTERFACE_INPUT_CONTEXT, "FocusOut",          _ic_focus_out },
@@ -1081,6 +1597,8 @@ bus_input_context_ibus_message (BusInputContext *context,
         { IBUS_INTERFACE_INPUT_CONTEXT, "IsEnabled",         _ic_is_enabled },
         { IBUS_INTERFACE_INPUT_CONTEXT, "SetEngine",         _ic_set_engine },
         { IBUS_INTERFACE_INPUT_CONTEXT, "GetEngine",         _ic_get_engine },
+        { IBUS_INTERFACE_INPUT_CONTEXT, "OpenKeyRing",       _ic_open_key_ring },
+        { IBUS_INTERFACE_INPUT_CONTEXT, "CloseKeyRing",      _ic_close_key_ring },
         { IBUS_INTERFACE_INPUT_CONTEXT, "Destroy",           _ic_destroy },
 
         { NULL, NULL, NULL }
@@ -1089,6 +1607,8 @@ bus_input_context_ibus_message (BusInputContext *context,
     ibus_message_set_sender (message, bus_connection_get_unique_name (connection));
     ibus_message_set_destination (message, DBUS_SERVICE_DBUS);
 
+    bus_input_context_dispatch_key_ring (context);
+
     for (i = 0; handlers[i].interface != NULL; i++) {
         if (ibus_message_is_method_call (message,
                                          handlers[i].interface,
@@ -1142,20 +1662,36 @@ bus_input_context_focus_in (BusInputContext *context)
 
     priv->has_focus = TRUE;
 
+    /* keys pressed in another window must not complete a hotkey here */
+    priv->prev_keyval = IBUS_VoidSymbol;
+    priv->prev_modifiers = 0;
+
     if (priv->engine && priv->enabled) {
+        bus_input_context_claim_engine (context);
         bus_engine_proxy_focus_in (priv->engine);
     }
 
     if (priv->capabilities & IBUS_CAP_FOCUS) {
         g_signal_emit (context, context_signals[FOCUS_IN], 0);
 
+        /* the client does not send an unchanged location again */
+        g_signal_emit (context,
+                       context_signals[SET_CURSOR_LOCATION],
+                       0,
+                       priv->x,
+                       priv->y,
+                       priv->w,
+                       priv->h);
+
         if ((priv->capabilities & IBUS_CAP_PROPERTY) == 0) {
             g_signal_emit (context,
                            context_signals[REGISTER_PROPERTIES],
                            0,
                            priv->props);
         }
-        if (priv->preedit_visible && (priv->capabilities & IBUS_CAP_PREEDIT_TEXT) == 0) {
+        /* hidden items are passed too, the panel may still show them
+         * from the snapshot it restores */
+        if ((priv->capabilities & IBUS_CAP_PREEDIT_TEXT) == 0) {
             g_signal_emit (context,
                            context_signals[UPDATE_PREEDIT_TEXT],
                            0,
@@ -1163,14 +1699,14 @@ bus_input_context_focus_in (BusInputContext *context)
                            priv->preedit_cursor_pos,
                            priv->preedit_visible);
         }
-        if (priv->auxiliary_visible && (priv->capabilities & IBUS_CAP_AUXILIARY_TEXT) == 0) {
+        if ((priv->capabilities & IBUS_CAP_AUXILIARY_TEXT) == 0) {
             g_signal_emit (context,
                            context_signals[UPDATE_AUXILIARY_TEXT],
                            0,
                            priv->auxiliary_text,
                            priv->auxiliary_visible);
         }
-        if (priv->auxiliary_visible && (priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == 0) {
+        if ((priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == 0) {
             g_signal_emit (context,
                            context_signals[UPDATE_LOOKUP_TABLE],
                            0,
@@ -1191,9 +1727,12 @@ bus_input_context_focus_out (BusInputContext *context)
     if (!priv->has_focus)
         return;
 
+    /* the panel keeps what it shows when the context loses the focus */
+    bus_input_context_flush_updates (context);
+
     priv->has_focus = FALSE;
 
-    if (priv->engine && priv->enabled) {
+    if (priv->engine && priv->enabled && ENGINE_IS_OURS (context, priv->engine)) {
         bus_engine_proxy_focus_out (priv->engine);
     }
 
@@ -1204,7 +1743,7 @@ bus_input_context_focus_out (BusInputContext *context)
         if (priv->auxiliary_visible && (priv->capabilities & IBUS_CAP_AUXILIARY_TEXT) == 0) {
             g_signal_emit (context, context_signals[HIDE_AUXILIARY_TEXT], 0);
         }
-        if (priv->auxiliary_visible && (priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == 0) {
+        if (priv->lookup_table_visible && (priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == 0) {
             g_signal_emit (context, context_signals[HIDE_LOOKUP_TABLE], 0);
         }
         g_signal_emit (context, context_signals[FOCUS_OUT], 0);
@@ -1220,6 +1759,7 @@ bus_input_context_page_up (BusInputContext *context)
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
     if (priv->engine) {
+        bus_input_context_claim_engine (context);
         bus_engine_proxy_page_up (priv->engine);
     }
 }
@@ -1233,6 +1773,7 @@ bus_input_context_page_down (BusInputContext *context)
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
     if (priv->engine) {
+        bus_input_context_claim_engine (context);
         bus_engine_proxy_page_down (priv->engine);
     }
 }
@@ -1246,6 +1787,7 @@ bus_input_context_cursor_up (BusInputContext *context)
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
     if (priv->engine) {
+        bus_input_context_claim_engine (context);
         bus_engine_proxy_cursor_up (priv->engine);
     }
 }
@@ -1259,6 +1801,7 @@ bus_input_context_cursor_down (BusInputContext *context)
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
     if (priv->engine) {
+        bus_input_context_claim_engine (context);
         bus_engine_proxy_cursor_down (priv->engine);
     }
 }
@@ -1274,10 +1817,164 @@ bus_input_context_property_activate (BusInputContext *context,
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
     if (priv->engine) {
+        bus_input_context_claim_engine (context);
         bus_engine_proxy_property_activate (priv->engine, prop_name, prop_state);
     }
 }
 
+void
+bus_input_context_get_serials (BusInputContext        *context,
+                               BusInputContextSerials *serials)
+{
+    g_assert (BUS_IS_INPUT_CONTEXT (context));
+    g_assert (serials != NULL);
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    *serials = priv->serials;
+}
+
+static void     bus_input_context_send_preedit_text
+                                                (BusInputContext        *context);
+static void     bus_input_context_send_auxiliary_text
+                                                (BusInputContext        *context);
+static void     bus_input_context_send_lookup_table
+                                                (BusInputContext        *context);
+
+/* TRUE if the client or the panel showing the updates lags behind */
+static gboolean
+bus_input_context_peer_is_congested (BusInputContext *context)
+{
+    BusPanelProxy *panel;
+    IBusConnection *connection;
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (priv->connection != NULL &&
+        bus_connection_is_congested (priv->connection)) {
+        return TRUE;
+    }
+
+    /* the items the client does not show itself go to the panel */
+    panel = BUS_DEFAULT_IBUS->panel;
+    if (panel != NULL &&
+        (priv->capabilities & (IBUS_CAP_PREEDIT_TEXT |
+                               IBUS_CAP_AUXILIARY_TEXT |
+                               IBUS_CAP_LOOKUP_TABLE)) !=
+            (IBUS_CAP_PREEDIT_TEXT | IBUS_CAP_AUXILIARY_TEXT | IBUS_CAP_LOOKUP_TABLE)) {
+        connection = ibus_proxy_get_connection ((IBusProxy *) panel);
+        if (connection != NULL &&
+            bus_connection_is_congested ((BusConnection *) connection)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+_ic_flush_updates_cb (BusInputContext *context)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    priv->flush_id = 0;
+
+    /* While a peer is slow to read, the updates wait here and collapse
+     * with the following ones instead of piling up in its queue. Key
+     * replies still flush them, to keep the order. */
+    if (bus_input_context_peer_is_congested (context)) {
+        priv->flush_id = g_timeout_add (BUS_INPUT_CONTEXT_CONGESTED_RETRY,
+                                        (GSourceFunc) _ic_flush_updates_cb,
+                                        context);
+        return FALSE;
+    }
+
+    bus_input_context_flush_updates (context);
+
+    return FALSE;
+}
+
+/*
+ * Engines usually update the preedit, the auxiliary text and the lookup
+ * table one after another for a single key. The updates are passed on
+ * once the main loop is idle, so an item changed several times is sent
+ * only with its last state.
+ */
+static void
+bus_input_context_queue_update (BusInputContext *context,
+                                guint            update)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (priv->pending_updates & update) {
+        n_elided_updates ++;
+    }
+
+    priv->pending_updates |= update;
+
+    if (priv->flush_id == 0) {
+        priv->flush_id = g_idle_add ((GSourceFunc) _ic_flush_updates_cb, context);
+    }
+}
+
+/* returns TRUE if a pending update of the item makes a signal needless */
+static gboolean
+bus_input_context_elide_update (BusInputContext *context,
+                                guint            update)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if ((priv->pending_updates & update) == 0) {
+        return FALSE;
+    }
+
+    n_elided_updates ++;
+    return TRUE;
+}
+
+/* passes the pending updates on, this is done before anything else is
+ * sent to the client to keep the order of the engine */
+static void
+bus_input_context_flush_updates (BusInputContext *context)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    guint pending = priv->pending_updates;
+
+    if (priv->flush_id != 0) {
+        g_source_remove (priv->flush_id);
+        priv->flush_id = 0;
+    }
+
+    if (pending == 0) {
+        return;
+    }
+
+    priv->pending_updates = 0;
+
+    if (pending & PENDING_PREEDIT_TEXT) {
+        bus_input_context_send_preedit_text (context);
+    }
+    if (pending & PENDING_AUXILIARY_TEXT) {
+        bus_input_context_send_auxiliary_text (context);
+    }
+    if (pending & PENDING_LOOKUP_TABLE) {
+        bus_input_context_send_lookup_table (context);
+    }
+}
+
+guint
+bus_input_context_get_elided_updates (void)
+{
+    return n_elided_updates;
+}
+
 static void
 bus_input_context_update_preedit_text (BusInputContext *context,
                                        IBusText        *text,
@@ -1296,14 +1993,29 @@ bus_input_context_update_preedit_text (BusInputContext *context,
     priv->preedit_text = (IBusText *) g_object_ref (text ? text : text_empty);
     priv->preedit_cursor_pos = cursor_pos;
     priv->preedit_visible = visible;
+    STATE_CHANGED (priv, preedit);
+
+    bus_input_context_queue_update (context, PENDING_PREEDIT_TEXT);
+}
+
+static void
+bus_input_context_send_preedit_text (BusInputContext *context)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
     if (priv->capabilities & IBUS_CAP_PREEDIT_TEXT) {
-        bus_input_context_send_signal (context,
-                                       "UpdatePreeditText",
-                                       IBUS_TYPE_TEXT, &(priv->preedit_text),
-                                       G_TYPE_UINT, &(priv->preedit_cursor_pos),
-                                       G_TYPE_BOOLEAN, &(priv->preedit_visible),
-                                       G_TYPE_INVALID);
+        IBusMessage *message;
+        IBusMessageIter iter;
+
+        message = bus_input_context_new_signal (context, "UpdatePreeditText");
+        ibus_message_iter_init_append (message, &iter);
+        ibus_serializable_serialize_with_flags ((IBusSerializable *) priv->preedit_text,
+                                                &iter,
+                                                bus_input_context_get_serialize_flags (context));
+        ibus_message_iter_append_uint (&iter, priv->preedit_cursor_pos);
+        ibus_message_iter_append_boolean (&iter, priv->preedit_visible);
+        bus_input_context_send_message (context, message);
     }
     else {
         g_signal_emit (context,
@@ -1328,6 +2040,11 @@ bus_input_context_show_preedit_text (BusInputContext *context)
     }
 
     priv->preedit_visible = TRUE;
+    STATE_CHANGED (priv, preedit);
+
+    if (bus_input_context_elide_update (context, PENDING_PREEDIT_TEXT)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_PREEDIT_TEXT) == IBUS_CAP_PREEDIT_TEXT) {
         bus_input_context_send_signal (context,
@@ -1354,6 +2071,11 @@ bus_input_context_hide_preedit_text (BusInputContext *context)
     }
 
     priv->preedit_visible = FALSE;
+    STATE_CHANGED (priv, preedit);
+
+    if (bus_input_context_elide_update (context, PENDING_PREEDIT_TEXT)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_PREEDIT_TEXT) == IBUS_CAP_PREEDIT_TEXT) {
         bus_input_context_send_signal (context,
@@ -1383,6 +2105,16 @@ bus_input_context_update_auxiliary_text (BusInputContext *context,
 
     priv->auxiliary_text = (IBusText *) g_object_ref (text ? text : text_empty);
     priv->auxiliary_visible = visible;
+    STATE_CHANGED (priv, auxiliary);
+
+    bus_input_context_queue_update (context, PENDING_AUXILIARY_TEXT);
+}
+
+static void
+bus_input_context_send_auxiliary_text (BusInputContext *context)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
     if (priv->capabilities & IBUS_CAP_AUXILIARY_TEXT) {
         bus_input_context_send_signal (context,
@@ -1413,6 +2145,11 @@ bus_input_context_show_auxiliary_text (BusInputContext *context)
     }
 
     priv->auxiliary_visible = TRUE;
+    STATE_CHANGED (priv, auxiliary);
+
+    if (bus_input_context_elide_update (context, PENDING_AUXILIARY_TEXT)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_AUXILIARY_TEXT) == IBUS_CAP_AUXILIARY_TEXT) {
         bus_input_context_send_signal (context,
@@ -1439,6 +2176,11 @@ bus_input_context_hide_auxiliary_text (BusInputContext *context)
     }
 
     priv->auxiliary_visible = FALSE;
+    STATE_CHANGED (priv, auxiliary);
+
+    if (bus_input_context_elide_update (context, PENDING_AUXILIARY_TEXT)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_AUXILIARY_TEXT) == IBUS_CAP_AUXILIARY_TEXT) {
         bus_input_context_send_signal (context,
@@ -1468,6 +2210,16 @@ bus_input_context_update_lookup_table (BusInputContext *context,
 
     priv->lookup_table = (IBusLookupTable *) g_object_ref (table ? table : lookup_table_empty);
     priv->lookup_table_visible = visible;
+    STATE_CHANGED (priv, lookup_table);
+
+    bus_input_context_queue_update (context, PENDING_LOOKUP_TABLE);
+}
+
+static void
+bus_input_context_send_lookup_table (BusInputContext *context)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
     if (priv->capabilities & IBUS_CAP_LOOKUP_TABLE) {
         bus_input_context_send_signal (context,
@@ -1498,6 +2250,11 @@ bus_input_context_show_lookup_table (BusInputContext *context)
     }
 
     priv->lookup_table_visible = TRUE;
+    STATE_CHANGED (priv, lookup_table);
+
+    if (bus_input_context_elide_update (context, PENDING_LOOKUP_TABLE)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == IBUS_CAP_LOOKUP_TABLE) {
         bus_input_context_send_signal (context,
@@ -1524,6 +2281,11 @@ bus_input_context_hide_lookup_table (BusInputContext *context)
     }
 
     priv->lookup_table_visible = FALSE;
+    STATE_CHANGED (priv, lookup_table);
+
+    if (bus_input_context_elide_update (context, PENDING_LOOKUP_TABLE)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == IBUS_CAP_LOOKUP_TABLE) {
         bus_input_context_send_signal (context,
@@ -1548,6 +2310,11 @@ bus_input_context_page_up_lookup_table (BusInputContext *context)
     if (!ibus_lookup_table_page_up (priv->lookup_table)) {
         return;
     }
+    STATE_CHANGED (priv, lookup_table);
+
+    if (bus_input_context_elide_update (context, PENDING_LOOKUP_TABLE)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == IBUS_CAP_LOOKUP_TABLE) {
         bus_input_context_send_signal (context,
@@ -1572,6 +2339,11 @@ bus_input_context_page_down_lookup_table (BusInputContext *context)
     if (!ibus_lookup_table_page_down (priv->lookup_table)) {
         return;
     }
+    STATE_CHANGED (priv, lookup_table);
+
+    if (bus_input_context_elide_update (context, PENDING_LOOKUP_TABLE)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == IBUS_CAP_LOOKUP_TABLE) {
         bus_input_context_send_signal (context,
@@ -1596,6 +2368,11 @@ bus_input_context_cursor_up_lookup_table (BusInputContext *context)
     if (!ibus_lookup_table_cursor_up (priv->lookup_table)) {
         return;
     }
+    STATE_CHANGED (priv, lookup_table);
+
+    if (bus_input_context_elide_update (context, PENDING_LOOKUP_TABLE)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == IBUS_CAP_LOOKUP_TABLE) {
         bus_input_context_send_signal (context,
@@ -1620,6 +2397,11 @@ bus_input_context_cursor_down_lookup_table (BusInputContext *context)
     if (!ibus_lookup_table_cursor_down (priv->lookup_table)) {
         return;
     }
+    STATE_CHANGED (priv, lookup_table);
+
+    if (bus_input_context_elide_update (context, PENDING_LOOKUP_TABLE)) {
+        return;
+    }
 
     if ((priv->capabilities & IBUS_CAP_LOOKUP_TABLE) == IBUS_CAP_LOOKUP_TABLE) {
         bus_input_context_send_signal (context,
@@ -1648,6 +2430,7 @@ bus_input_context_register_properties (BusInputContext *context,
     }
 
     priv->props = (IBusPropList *) g_object_ref (props ? props : props_empty);
+    STATE_CHANGED (priv, props);
 
     if (priv->capabilities & IBUS_CAP_PROPERTY) {
         bus_input_context_send_signal (context,
@@ -1680,6 +2463,7 @@ bus_input_context_update_property (BusInputContext *context,
     if (!ibus_prop_list_update_property (priv->props, prop)) {
         return;
     }
+    STATE_CHANGED (priv, props);
 
     if (priv->capabilities & IBUS_CAP_PROPERTY) {
         bus_input_context_send_signal (context,
@@ -1725,10 +2509,18 @@ _engine_commit_text_cb (BusEngineProxy  *engine,
 
     g_assert (priv->engine == engine);
 
-    bus_input_context_send_signal (context,
-                                   "CommitText",
-                                   IBUS_TYPE_TEXT, &text,
-                                   G_TYPE_INVALID);
+    IBusMessage *message;
+    IBusMessageIter iter;
+
+    if (!ENGINE_IS_OURS (context, engine))
+        return;
+
+    message = bus_input_context_new_signal (context, "CommitText");
+    ibus_message_iter_init_append (message, &iter);
+    ibus_serializable_serialize_with_flags ((IBusSerializable *) text,
+                                            &iter,
+                                            bus_input_context_get_serialize_flags (context));
+    bus_input_context_send_message (context, message);
 
 }
 
@@ -1746,11 +2538,17 @@ _engine_forward_key_event_cb (BusEngineProxy    *engine,
 
     g_assert (priv->engine == engine);
 
-    bus_input_context_send_signal (context,
-                                   "ForwardKeyEvent",
-                                   G_TYPE_UINT,  &keyval,
-                                   G_TYPE_UINT,  &state,
-                                   G_TYPE_INVALID);
+    IBusMessage *message;
+    IBusMessageIter iter;
+
+    if (!ENGINE_IS_OURS (context, engine))
+        return;
+
+    message = bus_input_context_new_signal (context, "ForwardKeyEvent");
+    ibus_message_iter_init_append (message, &iter);
+    ibus_message_iter_append_uint (&iter, keyval);
+    ibus_message_iter_append_uint (&iter, state);
+    bus_input_context_send_message (context, message);
 
 }
 
@@ -1770,6 +2568,9 @@ _engine_update_preedit_text_cb (BusEngineProxy  *engine,
 
     g_assert (priv->engine == engine);
 
+    if (!ENGINE_IS_OURS (context, engine))
+        return;
+
     bus_input_context_update_preedit_text (context, text, cursor_pos, visible);
 }
 
@@ -1788,6 +2589,9 @@ _engine_update_auxiliary_text_cb (BusEngineProxy   *engine,
 
     g_assert (priv->engine == engine);
 
+    if (!ENGINE_IS_OURS (context, engine))
+        return;
+
     bus_input_context_update_auxiliary_text (context, text, visible);
 }
 
@@ -1806,6 +2610,9 @@ _engine_update_lookup_table_cb (BusEngineProxy   *engine,
 
     g_assert (priv->engine == engine);
 
+    if (!ENGINE_IS_OURS (context, engine))
+        return;
+
     bus_input_context_update_lookup_table (context, table, visible);
 }
 
@@ -1823,6 +2630,9 @@ _engine_register_properties_cb (BusEngineProxy  *engine,
 
     g_assert (priv->engine == engine);
 
+    if (!ENGINE_IS_OURS (context, engine))
+        return;
+
     bus_input_context_register_properties (context, props);
 }
 
@@ -1840,6 +2650,9 @@ _engine_update_property_cb (BusEngineProxy  *engine,
 
     g_assert (priv->engine == engine);
 
+    if (!ENGINE_IS_OURS (context, engine))
+        return;
+
     bus_input_context_update_property (context, prop);
 }
 
@@ -1856,6 +2669,9 @@ _engine_update_property_cb (BusEngineProxy  *engine,
                                                                 \
         g_assert (priv->engine == engine);                      \
                                                                 \
+        if (!ENGINE_IS_OURS (context, engine))                  \
+            return;                                             \
+                                                                \
         bus_input_context_##name (context);                     \
 }
 
@@ -1884,7 +2700,9 @@ bus_input_context_enable (BusInputContext *context)
 
     priv->enabled = TRUE;
 
-    bus_engine_proxy_enable (priv->engine);
+    if (!bus_input_context_claim_engine (context)) {
+        bus_engine_proxy_enable (priv->engine);
+    }
     bus_input_context_send_signal (context,
                                    "Enabled",
                                    G_TYPE_INVALID);
@@ -1904,7 +2722,7 @@ bus_input_context_disable (BusInputContext *context)
     BusInputContextPrivate *priv;
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
-    if (priv->engine) {
+    if (priv->engine && ENGINE_IS_OURS (context, priv->engine)) {
         if (priv->has_focus) {
             bus_engine_proxy_focus_out (priv->engine);
         }
@@ -1971,12 +2789,27 @@ bus_input_context_unset_engine (BusInputContext *context)
     bus_input_context_update_lookup_table (context, lookup_table_empty, FALSE);
 
     if (priv->engine) {
+        BusFactoryProxy *factory;
         gint i;
         for (i = 0; signals[i].name != NULL; i++) {
             g_signal_handlers_disconnect_by_func (priv->engine, signals[i].callback, context);
         }
-        /* we destroy the engine */
-        ibus_object_destroy ((IBusObject *) priv->engine);
+
+        if (ENGINE_IS_OURS (context, priv->engine)) {
+            if (priv->enabled && !IBUS_OBJECT_DESTROYED (priv->engine)) {
+                if (priv->has_focus) {
+                    bus_engine_proxy_focus_out (priv->engine);
+                }
+                bus_engine_proxy_disable (priv->engine);
+            }
+            bus_engine_proxy_set_owner (priv->engine, NULL);
+        }
+
+        /* the engine goes back to its factory if it can be reused */
+        factory = bus_factory_proxy_get_from_engine (bus_engine_proxy_get_desc (priv->engine));
+        if (factory == NULL || !bus_factory_proxy_release_engine (factory, priv->engine)) {
+            ibus_object_destroy ((IBusObject *) priv->engine);
+        }
         g_object_unref (priv->engine);
         priv->engine = NULL;
     }
@@ -2010,12 +2843,9 @@ bus_input_context_set_engine (BusInputContext *context,
                               signals[i].callback,
                               context);
         }
-        bus_engine_proxy_set_cursor_location (priv->engine, priv->x, priv->y, priv->w, priv->h);
-        if (priv->enabled) {
-            bus_engine_proxy_enable (priv->engine);
-            if (priv->has_focus) {
-                bus_engine_proxy_focus_in (priv->engine);
-            }
+        bus_input_context_claim_engine (context);
+        if (priv->enabled && priv->has_focus) {
+            bus_engine_proxy_focus_in (priv->engine);
         }
     }
     g_signal_emit (context,
@@ -2023,6 +2853,34 @@ bus_input_context_set_engine (BusInputContext *context,
                    0);
 }
 
+/*
+ * Makes context the owner of its engine. If the engine worked for another
+ * context or for nobody before, it gets the state of this context.
+ * Returns TRUE in that case.
+ */
+static gboolean
+bus_input_context_claim_engine (BusInputContext *context)
+{
+    g_assert (BUS_IS_INPUT_CONTEXT (context));
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    g_assert (priv->engine != NULL);
+
+    if (ENGINE_IS_OURS (context, priv->engine))
+        return FALSE;
+
+    bus_engine_proxy_set_owner (priv->engine, context);
+    bus_engine_proxy_set_capabilities (priv->engine, priv->capabilities);
+    bus_engine_proxy_set_cursor_location (priv->engine, priv->x, priv->y, priv->w, priv->h);
+    if (priv->enabled) {
+        bus_engine_proxy_enable (priv->engine);
+    }
+
+    return TRUE;
+}
+
 BusEngineProxy *
 bus_input_context_get_engine (BusInputContext *context)
 {
@@ -2034,6 +2892,107 @@ bus_input_context_get_engine (BusInputContext *context)
     return priv->engine;
 }
 
+static void
+bus_input_context_reply_set_engine (BusInputContext *context,
+                                    gboolean         succeeded)
+{
+    IBusMessage *reply;
+    BusInputContextPrivate *priv;
+
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (priv->set_engine_message == NULL)
+        return;
+
+    if (succeeded) {
+        reply = ibus_message_new_method_return (priv->set_engine_message);
+    }
+    else {
+        reply = ibus_message_new_error (priv->set_engine_message,
+                                        "org.freedesktop.IBus.NoEngine",
+                                        "can not create engine");
+    }
+
+    ibus_message_set_sender (reply, DBUS_SERVICE_DBUS);
+    ibus_message_set_destination (reply,
+                                  bus_connection_get_unique_name (priv->connection));
+    ibus_message_set_no_reply (reply, TRUE);
+    ibus_connection_send ((IBusConnection *) priv->connection, reply);
+    ibus_message_unref (reply);
+
+    ibus_message_unref (priv->set_engine_message);
+    priv->set_engine_message = NULL;
+}
+
+/*
+ * Mark the context as waiting for an engine.  The returned id has to be
+ * passed to bus_input_context_end_engine_request () when the engine is
+ * created.  A newer request supersedes the pending one.
+ */
+guint
+bus_input_context_begin_engine_request (BusInputContext *context)
+{
+    g_assert (BUS_IS_INPUT_CONTEXT (context));
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    bus_input_context_reply_set_engine (context, FALSE);
+
+    if (++engine_request_id == 0)
+        ++engine_request_id;
+
+    priv->engine_request = engine_request_id;
+    priv->enable_on_engine = FALSE;
+
+    return priv->engine_request;
+}
+
+/*
+ * Finish the engine request.  engine is NULL if the engine could not be
+ * created.  Returns FALSE if the request was superseded or the context
+ * was destroyed, and the engine has not been used.
+ */
+gboolean
+bus_input_context_end_engine_request (BusInputContext *context,
+                                      guint            request,
+                                      BusEngineProxy  *engine)
+{
+    g_assert (BUS_IS_INPUT_CONTEXT (context));
+    g_assert (engine == NULL || BUS_IS_ENGINE_PROXY (engine));
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (IBUS_OBJECT_DESTROYED (context) || priv->engine_request != request)
+        return FALSE;
+
+    priv->engine_request = 0;
+
+    if (engine != NULL) {
+        bus_input_context_set_engine (context, engine);
+        if (priv->enable_on_engine) {
+            bus_input_context_enable (context);
+        }
+    }
+
+    priv->enable_on_engine = FALSE;
+    bus_input_context_reply_set_engine (context, engine != NULL);
+
+    return engine != NULL;
+}
+
+gboolean
+bus_input_context_has_engine_request (BusInputContext *context)
+{
+    g_assert (BUS_IS_INPUT_CONTEXT (context));
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    return priv->engine_request != 0;
+}
+
 static gboolean
 bus_input_context_filter_keyboard_shortcuts (BusInputContext    *context,
                                              guint               keyval,
@@ -2048,9 +3007,6 @@ bus_input_context_filter_keyboard_shortcuts (BusInputContext    *context,
     static GQuark next_factory;
     static GQuark prev_factory;
 
-    static guint prev_keyval = 0;
-    static guint prev_modifiers = 0;
-
     GQuark event;
 
     if (trigger == 0) {
@@ -2062,19 +3018,24 @@ bus_input_context_filter_keyboard_shortcuts (BusInputContext    *context,
     event = ibus_hotkey_profile_filter_key_event (BUS_DEFAULT_HOTKEY_PROFILE,
                                                   keyval,
                                                   modifiers,
-                                                  prev_keyval,
-                                                  prev_modifiers,
+                                                  priv->prev_keyval,
+                                                  priv->prev_modifiers,
                                                   0);
-    prev_keyval = keyval;
-    prev_modifiers = modifiers;
+    priv->prev_keyval = keyval;
+    priv->prev_modifiers = modifiers;
 
     if (event == trigger) {
-        if (priv->engine == NULL) {
+        if (priv->engine == NULL && priv->engine_request == 0) {
             g_signal_emit (context, context_signals[REQUEST_ENGINE], 0, NULL);
         }
 
         if (priv->engine == NULL) {
-            return FALSE;
+            if (priv->engine_request == 0) {
+                return FALSE;
+            }
+            /* toggle the state the engine will get once it is ready */
+            priv->enable_on_engine = !priv->enable_on_engine;
+            return TRUE;
         }
 
         if (priv->enabled) {
@@ -2088,14 +3049,20 @@ bus_input_context_filter_keyboard_shortcuts (BusInputContext    *context,
     }
     else if (event == next_factory) {
         g_signal_emit (context, context_signals[REQUEST_NEXT_ENGINE], 0);
-        if (priv->engine && !priv->enabled) {
+        if (priv->engine_request != 0) {
+            priv->enable_on_engine = TRUE;
+        }
+        else if (priv->engine && !priv->enabled) {
             bus_input_context_enable (context);
         }
         return TRUE;
     }
     else if (event == prev_factory) {
         g_signal_emit (context, context_signals[REQUEST_PREV_ENGINE], 0);
-        if (priv->engine && !priv->enabled) {
+        if (priv->engine_request != 0) {
+            priv->enable_on_engine = TRUE;
+        }
+        else if (priv->engine && !priv->enabled) {
             bus_input_context_enable (context);
         }
         return TRUE;
@@ -2116,24 +3083,80 @@ bus_input_context_send_signal (BusInputContext *context,
 
     va_list args;
     gboolean retval;
+    GType type;
+    IBusSerializeFlags flags;
     IBusMessage *message;
+    IBusMessageIter iter;
     BusInputContextPrivate *priv;
 
     priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
 
     g_assert (priv->connection != NULL);
 
+    message = bus_input_context_new_signal (context, signal_name);
+
+    /* as ibus_message_append_args, with the texts the client reads */
+    flags = bus_input_context_get_serialize_flags (context);
+    ibus_message_iter_init_append (message, &iter);
+    va_start (args, first_arg_type);
+    for (type = first_arg_type; type != G_TYPE_INVALID; type = va_arg (args, GType)) {
+        gpointer value = va_arg (args, gpointer);
+
+        if (g_type_is_a (type, IBUS_TYPE_SERIALIZABLE))
+            ibus_serializable_serialize_with_flags (*(IBusSerializable **) value, &iter, flags);
+        else
+            ibus_message_iter_append (&iter, type, value);
+    }
+    va_end (args);
+
+    retval = bus_input_context_send_message (context, message);
+
+    return retval;
+}
+
+/* Texts go to the client in the compact encoding only if it set
+ * IBUS_CAP_COMPACT_TEXT, older clients read the full IBusAttrList only. */
+static IBusSerializeFlags
+bus_input_context_get_serialize_flags (BusInputContext *context)
+{
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    return (priv->capabilities & IBUS_CAP_COMPACT_TEXT) ? IBUS_SERIALIZE_COMPACT_TEXT : 0;
+}
+
+/* returns a new signal of the context without arguments */
+static IBusMessage *
+bus_input_context_new_signal (BusInputContext *context,
+                              const gchar     *signal_name)
+{
+    IBusMessage *message;
+
     message = ibus_message_new_signal (ibus_service_get_path ((IBusService *)context),
                                        IBUS_INTERFACE_INPUT_CONTEXT,
                                        signal_name);
-
     ibus_message_set_sender (message, IBUS_SERVICE_IBUS);
 
-    va_start (args, first_arg_type);
-    ibus_message_append_args_valist (message, first_arg_type, args);
-    va_end (args);
+    return message;
+}
+
+/* sends the message and drops it, after the pending updates */
+static gboolean
+bus_input_context_send_message (BusInputContext *context,
+                                IBusMessage     *message)
+{
+    gboolean retval;
+
+    BusInputContextPrivate *priv;
+    priv = BUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    g_assert (priv->connection != NULL);
+
+    bus_input_context_flush_updates (context);
 
     retval = ibus_connection_send ((IBusConnection *)priv->connection, message);
+    if (retval && priv->key_ring != NULL)
+        priv->message_serial = dbus_message_get_serial (message);
     ibus_message_unref (message);
 
     return retval;
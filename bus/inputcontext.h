@@ -46,6 +46,7 @@ G_BEGIN_DECLS
 
 typedef struct _BusInputContext BusInputContext;
 typedef struct _BusInputContextClass BusInputContextClass;
+typedef struct _BusInputContextSerials BusInputContextSerials;
 
 struct _BusInputContext {
     IBusService parent;
@@ -58,6 +59,15 @@ struct _BusInputContextClass {
     /* class members */
 };
 
+/* change counters of the state shown by the panel, a serial changes
+ * whenever the item changes and is never 0 */
+struct _BusInputContextSerials {
+    guint props;
+    guint preedit;
+    guint auxiliary;
+    guint lookup_table;
+};
+
 GType                bus_input_context_get_type         (void);
 BusInputContext     *bus_input_context_new              (BusConnection      *connection,
                                                          const gchar        *client);
@@ -74,9 +84,22 @@ void                 bus_input_context_cursor_down      (BusInputContext    *con
 void                 bus_input_context_set_engine       (BusInputContext    *context,
                                                          BusEngineProxy     *factory);
 BusEngineProxy      *bus_input_context_get_engine       (BusInputContext    *context);
+guint                bus_input_context_begin_engine_request
+                                                        (BusInputContext    *context);
+gboolean             bus_input_context_end_engine_request
+                                                        (BusInputContext    *context,
+                                                         guint               request,
+                                                         BusEngineProxy     *engine);
+gboolean             bus_input_context_has_engine_request
+                                                        (BusInputContext    *context);
 void                 bus_input_context_property_activate(BusInputContext    *context,
                                                          const gchar        *prop_name,
                                                          gint                prop_state);
+void                 bus_input_context_get_serials      (BusInputContext    *context,
+                                                         BusInputContextSerials
+                                                                            *serials);
+guint                bus_input_context_get_elided_updates
+                                                        (void);
 
 G_END_DECLS
 #endif
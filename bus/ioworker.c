@@ -0,0 +1,115 @@
+/* vim:set et sts=4: */
+/* bus - The Input Bus
+ * Copyright (C) 2008-2009 Huang Peng <shawn.p.huang@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <ibusinternal.h>
+#include "ioworker.h"
+
+typedef struct _BusIOWorker BusIOWorker;
+
+struct _BusIOWorker {
+    GThread *thread;
+    GMainContext *context;
+    GMainLoop *loop;
+    /* held while the worker handles a socket, see dbus_connection_setup_with_io */
+    GStaticRecMutex lock;
+    /* only used by the main thread */
+    guint n_connections;
+};
+
+static BusIOWorker *workers = NULL;
+static guint n_workers = 0;
+
+static gpointer
+_worker_run (BusIOWorker *worker)
+{
+    g_main_loop_run (worker->loop);
+    return NULL;
+}
+
+gboolean
+bus_io_workers_start (guint n)
+{
+    guint i;
+
+    g_assert (workers == NULL);
+    g_assert (g_thread_supported ());
+
+    workers = g_new0 (BusIOWorker, n);
+
+    for (i = 0; i < n; i++) {
+        BusIOWorker *worker = &workers[i];
+        GError *error = NULL;
+
+        worker->context = g_main_context_new ();
+        worker->loop = g_main_loop_new (worker->context, FALSE);
+        g_static_rec_mutex_init (&worker->lock);
+        worker->thread = g_thread_create ((GThreadFunc) _worker_run, worker, FALSE, &error);
+
+        if (worker->thread == NULL) {
+            g_warning ("Can not create I/O thread: %s", error->message);
+            g_error_free (error);
+            g_main_loop_unref (worker->loop);
+            g_main_context_unref (worker->context);
+            g_static_rec_mutex_free (&worker->lock);
+            break;
+        }
+    }
+
+    /* go on with the threads created so far */
+    n_workers = i;
+    return n_workers > 0;
+}
+
+static void
+_connection_destroy_cb (BusConnection *connection,
+                        BusIOWorker   *worker)
+{
+    worker->n_connections --;
+}
+
+void
+bus_io_workers_add (BusConnection *connection)
+{
+    BusIOWorker *worker;
+    guint i;
+
+    g_assert (BUS_IS_CONNECTION (connection));
+
+    if (n_workers == 0)
+        return;
+
+    /* the worker with the fewest connections */
+    worker = &workers[0];
+    for (i = 1; i < n_workers; i++) {
+        if (workers[i].n_connections < worker->n_connections)
+            worker = &workers[i];
+    }
+
+    worker->n_connections ++;
+    g_signal_connect (connection,
+                      "destroy",
+                      G_CALLBACK (_connection_destroy_cb),
+                      worker);
+
+    /* IBusConnection sets it up for the main context again when it is destroyed */
+    dbus_connection_setup_with_io (ibus_connection_get_connection ((IBusConnection *) connection),
+                                   NULL,
+                                   worker->context,
+                                   &worker->lock);
+}
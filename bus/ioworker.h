@@ -0,0 +1,39 @@
+/* vim:set et sts=4: */
+/* bus - The Input Bus
+ * Copyright (C) 2008-2009 Huang Peng <shawn.p.huang@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __IO_WORKER_H_
+#define __IO_WORKER_H_
+
+#include <ibus.h>
+#include "connection.h"
+
+/*
+ * A pool of threads which read and write the sockets of the client
+ * connections. Messages are still dispatched by the main thread, so
+ * a client which is slow to read or sends a lot only keeps its own
+ * worker busy.
+ */
+
+G_BEGIN_DECLS
+
+gboolean         bus_io_workers_start           (guint               n_workers);
+void             bus_io_workers_add             (BusConnection      *connection);
+
+G_END_DECLS
+#endif
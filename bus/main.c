@@ -25,8 +25,11 @@
 #include <pwd.h>
 #include <stdlib.h>
 #include <locale.h>
+#include <signal.h>
 #include "server.h"
 #include "ibusimpl.h"
+#include "stats.h"
+#include "ioworker.h"
 
 gchar **g_argv = NULL;
 
@@ -40,6 +43,9 @@ static gchar *desktop = "gnome";
 static gchar *address = "";
 gboolean g_rescan = FALSE;
 static gboolean verbose = FALSE;
+static gboolean stats = FALSE;
+static gint io_threads = 0;
+static gint max_queue_bytes = 4 * 1024 * 1024;
 
 static const GOptionEntry entries[] =
 {
@@ -53,6 +59,9 @@ static const GOptionEntry entries[] =
     { "replace", 'r', 0, G_OPTION_ARG_NONE, &replace, "if there is an old ibus-daemon is running, it will be replaced.", NULL },
     { "re-scan", 't', 0, G_OPTION_ARG_NONE, &g_rescan, "force to re-scan components, and re-create registry cache.", NULL },
     { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "verbose.", NULL },
+    { "io-threads", 0, 0, G_OPTION_ARG_INT, &io_threads, "read and write connections on n threads. [default=0]", "n" },
+    { "max-queue-bytes", 0, 0, G_OPTION_ARG_INT, &max_queue_bytes, "disconnect clients which leave more bytes unread. [default=4194304]", "bytes" },
+    { "stats", 0, 0, G_OPTION_ARG_NONE, &stats, "count bytes and allocations, dump statistics on SIGUSR1.", NULL },
     { NULL },
 };
 
@@ -140,6 +149,27 @@ main (gint argc, gchar **argv)
     IBusBus *bus;
 
     GError *error = NULL;
+    gboolean early_stats = FALSE;
+    gboolean early_threads = FALSE;
+    gint i;
+
+    /* the allocation counter and threads have to be set up before glib
+     * and dbus are used, so these options are checked before parsing */
+    for (i = 1; i < argc; i++) {
+        if (strcmp (argv[i], "--stats") == 0)
+            early_stats = TRUE;
+        else if (strncmp (argv[i], "--io-threads", 12) == 0)
+            early_threads = TRUE;
+    }
+
+    if (early_stats) {
+        bus_stats_enable_details ();
+    }
+
+    if (early_threads) {
+        g_thread_init (NULL);
+        dbus_threads_init_default ();
+    }
 
     setlocale (LC_ALL, "");
 
@@ -194,6 +224,16 @@ main (gint argc, gchar **argv)
     g_object_unref (bus);
     bus = NULL;
 
+    if (io_threads > 0) {
+        bus_io_workers_start (io_threads);
+    }
+
+    if (max_queue_bytes <= 0) {
+        g_printerr ("Queue limit must be positive.\n");
+        exit (-1);
+    }
+    bus_connection_set_queue_limit (max_queue_bytes);
+
     /* create ibus server */
     server = bus_server_get_default ();
     bus_server_listen (server);
@@ -232,6 +272,10 @@ main (gint argc, gchar **argv)
             exit (-1);
     }
 
+    if (stats) {
+        bus_stats_dump_on_signal (SIGUSR1);
+    }
+
     bus_server_run (server);
 
     return 0;
@@ -673,3 +673,400 @@ bus_match_rule_get_recipients (BusMatchRule   *rule,
     return recipients;
 }
 
+
+/*
+ * BusMatchRuleIndex buckets rules by the interned values of the fields
+ * that can be read directly from a message header (interface, member,
+ * path and sender).  A field a rule does not set is stored as 0, so each
+ * rule falls in one of 16 "shapes".  Dispatching a message only probes
+ * the buckets of the shapes that are currently in use, and only the
+ * rules found there go through the full bus_match_rule_match ().
+ */
+enum {
+    MATCH_KEY_INTERFACE = 1 << 0,
+    MATCH_KEY_MEMBER    = 1 << 1,
+    MATCH_KEY_PATH      = 1 << 2,
+    MATCH_KEY_SENDER    = 1 << 3,
+    MATCH_KEY_SHAPES    = 1 << 4,
+};
+
+typedef struct _BusMatchKey BusMatchKey;
+struct _BusMatchKey {
+    GQuark interface;
+    GQuark member;
+    GQuark path;
+    GQuark sender;
+};
+
+struct _BusMatchRuleIndex {
+    /* BusMatchKey -> GList of BusMatchRule */
+    GHashTable *buckets;
+    /* number of indexed rules of each shape */
+    guint shapes[MATCH_KEY_SHAPES];
+    guint size;
+    /* reused by get_recipients to drop duplicated recipients */
+    GHashTable *seen;
+
+    /* summary for bus_match_rule_index_may_match: the number of rules
+     * of each message type (INVALID for any type), and of each interface
+     * and member quark, rules without one are counted in any_* */
+    guint types[DBUS_NUM_MESSAGE_TYPES];
+    GHashTable *interfaces;
+    guint any_interface;
+    GHashTable *members;
+    guint any_member;
+};
+
+static guint
+_match_key_hash (const BusMatchKey *key)
+{
+    guint hash;
+
+    hash = key->interface;
+    hash = hash * 31 + key->member;
+    hash = hash * 31 + key->path;
+    hash = hash * 31 + key->sender;
+
+    return hash;
+}
+
+static gboolean
+_match_key_equal (const BusMatchKey *a,
+                  const BusMatchKey *b)
+{
+    return a->interface == b->interface &&
+           a->member == b->member &&
+           a->path == b->path &&
+           a->sender == b->sender;
+}
+
+static void
+_match_key_free (BusMatchKey *key)
+{
+    g_slice_free (BusMatchKey, key);
+}
+
+static gint
+_match_rule_get_key (BusMatchRule *rule,
+                     BusMatchKey  *key)
+{
+    gint shape = 0;
+
+    key->interface = 0;
+    key->member = 0;
+    key->path = 0;
+    key->sender = 0;
+
+    if (rule->flags & MATCH_INTERFACE) {
+        key->interface = g_quark_from_string (rule->interface);
+        shape |= MATCH_KEY_INTERFACE;
+    }
+    if (rule->flags & MATCH_MEMBER) {
+        key->member = g_quark_from_string (rule->member);
+        shape |= MATCH_KEY_MEMBER;
+    }
+    if (rule->flags & MATCH_PATH) {
+        key->path = g_quark_from_string (rule->path);
+        shape |= MATCH_KEY_PATH;
+    }
+    if (rule->flags & MATCH_SENDER) {
+        key->sender = g_quark_from_string (rule->sender);
+        shape |= MATCH_KEY_SENDER;
+    }
+
+    return shape;
+}
+
+BusMatchRuleIndex *
+bus_match_rule_index_new (void)
+{
+    BusMatchRuleIndex *index;
+
+    index = g_slice_new0 (BusMatchRuleIndex);
+    index->buckets = g_hash_table_new_full ((GHashFunc) _match_key_hash,
+                                            (GEqualFunc) _match_key_equal,
+                                            (GDestroyNotify) _match_key_free,
+                                            (GDestroyNotify) g_list_free);
+    index->seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+    index->interfaces = g_hash_table_new (g_direct_hash, g_direct_equal);
+    index->members = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    return index;
+}
+
+static void
+_summary_count (GHashTable *table,
+                GQuark      quark,
+                gint        delta)
+{
+    guint count;
+
+    count = GPOINTER_TO_UINT (g_hash_table_lookup (table, GUINT_TO_POINTER (quark)));
+    count += delta;
+
+    if (count != 0)
+        g_hash_table_insert (table, GUINT_TO_POINTER (quark), GUINT_TO_POINTER (count));
+    else
+        g_hash_table_remove (table, GUINT_TO_POINTER (quark));
+}
+
+static void
+bus_match_rule_index_update_summary (BusMatchRuleIndex *index,
+                                     BusMatchRule      *rule,
+                                     BusMatchKey       *key,
+                                     gint               delta)
+{
+    if (rule->flags & MATCH_TYPE)
+        index->types[rule->message_type] += delta;
+    else
+        index->types[DBUS_MESSAGE_TYPE_INVALID] += delta;
+
+    if (key->interface != 0)
+        _summary_count (index->interfaces, key->interface, delta);
+    else
+        index->any_interface += delta;
+
+    if (key->member != 0)
+        _summary_count (index->members, key->member, delta);
+    else
+        index->any_member += delta;
+}
+
+void
+bus_match_rule_index_free (BusMatchRuleIndex *index)
+{
+    g_assert (index != NULL);
+
+    g_hash_table_destroy (index->buckets);
+    g_hash_table_destroy (index->seen);
+    g_hash_table_destroy (index->interfaces);
+    g_hash_table_destroy (index->members);
+    g_slice_free (BusMatchRuleIndex, index);
+}
+
+void
+bus_match_rule_index_add (BusMatchRuleIndex *index,
+                          BusMatchRule      *rule)
+{
+    g_assert (index != NULL);
+    g_assert (BUS_IS_MATCH_RULE (rule));
+
+    BusMatchKey key;
+    BusMatchKey *bucket_key;
+    GList *bucket;
+    gint shape;
+
+    shape = _match_rule_get_key (rule, &key);
+
+    if (g_hash_table_lookup_extended (index->buckets, &key,
+                                      (gpointer *) &bucket_key,
+                                      (gpointer *) &bucket)) {
+        g_hash_table_steal (index->buckets, bucket_key);
+    }
+    else {
+        bucket_key = g_slice_dup (BusMatchKey, &key);
+        bucket = NULL;
+    }
+
+    bucket = g_list_prepend (bucket, rule);
+    g_hash_table_insert (index->buckets, bucket_key, bucket);
+
+    bus_match_rule_index_update_summary (index, rule, &key, 1);
+
+    index->shapes[shape] ++;
+    index->size ++;
+}
+
+void
+bus_match_rule_index_remove (BusMatchRuleIndex *index,
+                             BusMatchRule      *rule)
+{
+    g_assert (index != NULL);
+    g_assert (BUS_IS_MATCH_RULE (rule));
+
+    BusMatchKey key;
+    BusMatchKey *bucket_key;
+    GList *bucket;
+    GList *link;
+    gint shape;
+
+    shape = _match_rule_get_key (rule, &key);
+
+    if (!g_hash_table_lookup_extended (index->buckets, &key,
+                                       (gpointer *) &bucket_key,
+                                       (gpointer *) &bucket)) {
+        g_warning ("Remove rule from index failed");
+        return;
+    }
+
+    link = g_list_find (bucket, rule);
+    if (link == NULL) {
+        g_warning ("Remove rule from index failed");
+        return;
+    }
+
+    g_hash_table_steal (index->buckets, bucket_key);
+    bucket = g_list_delete_link (bucket, link);
+
+    if (bucket != NULL) {
+        g_hash_table_insert (index->buckets, bucket_key, bucket);
+    }
+    else {
+        _match_key_free (bucket_key);
+    }
+
+    bus_match_rule_index_update_summary (index, rule, &key, -1);
+
+    index->shapes[shape] --;
+    index->size --;
+}
+
+BusMatchRule *
+bus_match_rule_index_lookup (BusMatchRuleIndex *index,
+                             BusMatchRule      *rule)
+{
+    g_assert (index != NULL);
+    g_assert (BUS_IS_MATCH_RULE (rule));
+
+    BusMatchKey key;
+    GList *link;
+
+    _match_rule_get_key (rule, &key);
+
+    link = (GList *) g_hash_table_lookup (index->buckets, &key);
+    for (; link != NULL; link = link->next) {
+        if (bus_match_rule_is_equal (rule, BUS_MATCH_RULE (link->data)))
+            return BUS_MATCH_RULE (link->data);
+    }
+
+    return NULL;
+}
+
+guint
+bus_match_rule_index_get_size (BusMatchRuleIndex *index)
+{
+    g_assert (index != NULL);
+
+    return index->size;
+}
+
+/*
+ * Returns FALSE if no indexed rule can match message, judged by its type,
+ * interface and member only. This is cheap and does not allocate, so the
+ * daemon checks it before dispatching the messages it sends by rule.
+ */
+gboolean
+bus_match_rule_index_may_match (BusMatchRuleIndex *index,
+                                DBusMessage       *message)
+{
+    g_assert (index != NULL);
+    g_assert (message != NULL);
+
+    gint type;
+    GQuark quark;
+
+    if (index->size == 0)
+        return FALSE;
+
+    if (index->types[DBUS_MESSAGE_TYPE_INVALID] == 0) {
+        type = ibus_message_get_type (message);
+        if (type <= DBUS_MESSAGE_TYPE_INVALID ||
+            type >= DBUS_NUM_MESSAGE_TYPES ||
+            index->types[type] == 0) {
+            return FALSE;
+        }
+    }
+
+    if (index->any_interface == 0) {
+        quark = g_quark_try_string (ibus_message_get_interface (message));
+        if (quark == 0 ||
+            g_hash_table_lookup (index->interfaces, GUINT_TO_POINTER (quark)) == NULL) {
+            return FALSE;
+        }
+    }
+
+    if (index->any_member == 0) {
+        quark = g_quark_try_string (ibus_message_get_member (message));
+        if (quark == 0 ||
+            g_hash_table_lookup (index->members, GUINT_TO_POINTER (quark)) == NULL) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+void
+bus_match_rule_index_get_recipients (BusMatchRuleIndex *index,
+                                     DBusMessage       *message,
+                                     GPtrArray         *recipients)
+{
+    g_assert (index != NULL);
+    g_assert (message != NULL);
+    g_assert (recipients != NULL);
+
+    BusMatchKey message_key;
+    gint shape;
+
+    if (index->size == 0)
+        return;
+
+    /* Values never seen in a rule are not interned, so the lookup
+     * returns 0 and every shape using that field is skipped. */
+    message_key.interface = g_quark_try_string (ibus_message_get_interface (message));
+    message_key.member = g_quark_try_string (ibus_message_get_member (message));
+    message_key.path = g_quark_try_string (ibus_message_get_path (message));
+    message_key.sender = g_quark_try_string (ibus_message_get_sender (message));
+
+    for (shape = 0; shape < MATCH_KEY_SHAPES; shape++) {
+        BusMatchKey key = { 0 };
+        GList *link;
+
+        if (index->shapes[shape] == 0)
+            continue;
+
+        if (shape & MATCH_KEY_INTERFACE) {
+            if (message_key.interface == 0)
+                continue;
+            key.interface = message_key.interface;
+        }
+        if (shape & MATCH_KEY_MEMBER) {
+            if (message_key.member == 0)
+                continue;
+            key.member = message_key.member;
+        }
+        if (shape & MATCH_KEY_PATH) {
+            if (message_key.path == 0)
+                continue;
+            key.path = message_key.path;
+        }
+        if (shape & MATCH_KEY_SENDER) {
+            if (message_key.sender == 0)
+                continue;
+            key.sender = message_key.sender;
+        }
+
+        link = (GList *) g_hash_table_lookup (index->buckets, &key);
+        for (; link != NULL; link = link->next) {
+            BusMatchRule *rule = BUS_MATCH_RULE (link->data);
+            GList *p;
+
+            if (!bus_match_rule_match (rule, message))
+                continue;
+
+            for (p = rule->recipients; p != NULL; p = p->next) {
+                BusConnection *connection = ((BusRecipient *) p->data)->connection;
+
+                if (g_hash_table_lookup (index->seen, connection) != NULL)
+                    continue;
+                g_hash_table_insert (index->seen, connection, connection);
+
+                g_object_ref (connection);
+                g_ptr_array_add (recipients, connection);
+            }
+        }
+    }
+
+    if (recipients->len > 0)
+        g_hash_table_remove_all (index->seen);
+}
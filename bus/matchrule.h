@@ -45,6 +45,7 @@ G_BEGIN_DECLS
 
 typedef struct _BusMatchRule BusMatchRule;
 typedef struct _BusMatchRuleClass BusMatchRuleClass;
+typedef struct _BusMatchRuleIndex BusMatchRuleIndex;
 
 typedef enum {
     MATCH_TYPE          = 1 << 0,
@@ -118,6 +119,32 @@ GList           *bus_match_rule_get_recipients
                                             (BusMatchRule   *rule,
                                              DBusMessage    *message);
 
+BusMatchRuleIndex
+                *bus_match_rule_index_new   (void);
+void             bus_match_rule_index_free  (BusMatchRuleIndex
+                                                            *index);
+void             bus_match_rule_index_add   (BusMatchRuleIndex
+                                                            *index,
+                                             BusMatchRule   *rule);
+void             bus_match_rule_index_remove(BusMatchRuleIndex
+                                                            *index,
+                                             BusMatchRule   *rule);
+BusMatchRule    *bus_match_rule_index_lookup(BusMatchRuleIndex
+                                                            *index,
+                                             BusMatchRule   *rule);
+guint            bus_match_rule_index_get_size
+                                            (BusMatchRuleIndex
+                                                            *index);
+gboolean         bus_match_rule_index_may_match
+                                            (BusMatchRuleIndex
+                                                            *index,
+                                             DBusMessage    *message);
+void             bus_match_rule_index_get_recipients
+                                            (BusMatchRuleIndex
+                                                            *index,
+                                             DBusMessage    *message,
+                                             GPtrArray      *recipients);
+
 G_END_DECLS
 #endif
 
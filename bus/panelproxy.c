@@ -18,6 +18,7 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#include <string.h>
 #include <ibusinternal.h>
 #include <ibusmarshalers.h>
 #include "panelproxy.h"
@@ -37,12 +38,52 @@ enum {
 };
 
 
+/* what a panel reports from GetCapabilities, panels without the method
+ * get full updates only */
+#define BUS_PANEL_CAP_LOOKUP_TABLE_DELTA    (1 << 0)
+#define BUS_PANEL_CAP_RESTORE_STATE         (1 << 1)
+#define BUS_PANEL_CAP_COMPACT_TEXT          (1 << 2)
+
+/* contexts the panel keeps a snapshot of, the panel keeps at least as many */
+#define BUS_PANEL_PROXY_SNAPSHOTS   (8)
+
 /* BusPanelProxyPriv */
 struct _BusPanelProxyPrivate {
     BusInputContext *focused_context;
+
+    /* BUS_PANEL_CAP_*, 0 until the panel replied */
+    guint capabilities;
+
+    /* the lookup table as last sent, and the number of full updates */
+    IBusLookupTable *lookup_table;
+    gboolean lookup_table_visible;
+    guint lookup_table_generation;
+    /* counts all updates, a failed delta is sent again if it is the last */
+    guint lookup_table_serial;
+
+    /* the cursor location the panel knows */
+    gint x;
+    gint y;
+    gint w;
+    gint h;
+
+    /* the state of the focused context the panel shows, 0 for none */
+    BusInputContextSerials shown;
+    /* the state the panel remembers of recently focused contexts */
+    GList *snapshots;
 };
 typedef struct _BusPanelProxyPrivate BusPanelProxyPrivate;
 
+typedef struct {
+    gchar *path;
+    BusInputContextSerials serials;
+} BusPanelSnapshot;
+
+typedef struct {
+    BusPanelProxy *panel;
+    guint serial;
+} BusPanelDeltaCall;
+
 static guint    panel_signals[LAST_SIGNAL] = { 0 };
 // static guint            engine_signals[LAST_SIGNAL] = { 0 };
 
@@ -53,6 +94,12 @@ static void     bus_panel_proxy_real_destroy    (BusPanelProxy          *panel);
 
 static gboolean bus_panel_proxy_ibus_signal     (IBusProxy              *proxy,
                                                  IBusMessage            *message);
+static void     bus_panel_proxy_call            (BusPanelProxy          *panel,
+                                                 const gchar            *method,
+                                                 GType                   first_arg_type,
+                                                 ...);
+static void     bus_panel_proxy_send_lookup_table
+                                                (BusPanelProxy          *panel);
 static void     bus_panel_proxy_page_up         (BusPanelProxy          *panel);
 static void     bus_panel_proxy_page_down       (BusPanelProxy          *panel);
 static void     bus_panel_proxy_cursor_up       (BusPanelProxy          *panel);
@@ -97,18 +144,71 @@ bus_panel_proxy_get_type (void)
     return type;
 }
 
+static void
+_get_capabilities_reply_cb (IBusPendingCall *pending,
+                            BusPanelProxy   *panel)
+{
+    BusPanelProxyPrivate *priv;
+    IBusMessage *reply_message;
+    IBusError *error;
+    guint capabilities;
+
+    priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);
+
+    reply_message = ibus_pending_call_steal_reply (pending);
+    if (reply_message == NULL)
+        return;
+
+    /* an older panel does not know the method and keeps getting full
+     * updates */
+    if ((error = ibus_error_new_from_message (reply_message)) != NULL) {
+        ibus_error_free (error);
+    }
+    else if (!ibus_message_get_args (reply_message,
+                                     &error,
+                                     G_TYPE_UINT, &capabilities,
+                                     G_TYPE_INVALID)) {
+        g_warning ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
+    }
+    else if (!IBUS_OBJECT_DESTROYED (panel)) {
+        priv->capabilities = capabilities;
+    }
+
+    ibus_message_unref (reply_message);
+}
+
 BusPanelProxy *
 bus_panel_proxy_new (BusConnection *connection)
 {
     g_assert (BUS_IS_CONNECTION (connection));
 
     GObject *obj;
+    IBusPendingCall *pending = NULL;
+    IBusError *error = NULL;
+
     obj = g_object_new (BUS_TYPE_PANEL_PROXY,
                         "name", NULL,
                         "path", IBUS_PATH_PANEL,
                         "connection", connection,
                         NULL);
 
+    if (ibus_proxy_call_with_reply ((IBusProxy *) obj,
+                                    "GetCapabilities",
+                                    &pending,
+                                    -1,
+                                    &error,
+                                    G_TYPE_INVALID) && pending != NULL) {
+        ibus_pending_call_set_notify (pending,
+                                      (IBusPendingCallNotifyFunction) _get_capabilities_reply_cb,
+                                      g_object_ref (obj),
+                                      (GDestroyNotify) g_object_unref);
+        ibus_pending_call_unref (pending);
+    }
+    else if (error != NULL) {
+        ibus_error_free (error);
+    }
+
     return BUS_PANEL_PROXY (obj);
 }
 
@@ -211,6 +311,23 @@ bus_panel_proxy_init (BusPanelProxy *panel)
     priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);
 
     priv->focused_context = NULL;
+    priv->capabilities = 0;
+    priv->lookup_table = NULL;
+    priv->lookup_table_visible = FALSE;
+    priv->lookup_table_generation = 0;
+    priv->lookup_table_serial = 0;
+    memset (&priv->shown, 0, sizeof (priv->shown));
+    priv->snapshots = NULL;
+
+    priv->x = priv->y = 0;
+    priv->w = priv->h = -1;
+}
+
+static void
+bus_panel_snapshot_free (BusPanelSnapshot *snapshot)
+{
+    g_free (snapshot->path);
+    g_slice_free (BusPanelSnapshot, snapshot);
 }
 
 static void
@@ -230,6 +347,15 @@ bus_panel_proxy_real_destroy (BusPanelProxy *panel)
         priv->focused_context = NULL;
     }
 
+    if (priv->lookup_table) {
+        g_object_unref (priv->lookup_table);
+        priv->lookup_table = NULL;
+    }
+
+    g_list_foreach (priv->snapshots, (GFunc) bus_panel_snapshot_free, NULL);
+    g_list_free (priv->snapshots);
+    priv->snapshots = NULL;
+
     IBUS_OBJECT_CLASS(parent_class)->destroy (IBUS_OBJECT (panel));
 }
 
@@ -305,6 +431,14 @@ bus_panel_proxy_ibus_signal (IBusProxy      *proxy,
             goto failed;
         g_signal_emit (panel, panel_signals[PROPERTY_HIDE], 0, prop_name);
     }
+    else if (ibus_message_is_signal (message, IBUS_INTERFACE_PANEL, "RequestLookupTable")) {
+        BusPanelProxyPrivate *priv;
+        priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);
+
+        /* the panel missed a full table, deltas do not apply any more */
+        if (priv->lookup_table != NULL)
+            bus_panel_proxy_send_lookup_table (panel);
+    }
 
 handled:
     g_signal_stop_emission_by_name (panel, "ibus-signal");
@@ -343,6 +477,32 @@ bus_panel_proxy_focus_in (BusPanelProxy     *panel,
                      IBUS_TYPE_OBJECT_PATH, &path,
                      G_TYPE_INVALID);
 
+    /* the panel brings back what it showed when the context lost the
+     * focus, the context then passes its state and only the items which
+     * changed since are sent; snapshots are recorded only for a panel
+     * which reported RestoreState */
+    GList *p;
+    memset (&priv->shown, 0, sizeof (priv->shown));
+    for (p = priv->snapshots; p != NULL; p = p->next) {
+        BusPanelSnapshot *snapshot = (BusPanelSnapshot *) p->data;
+        if (g_strcmp0 (snapshot->path, path) == 0) {
+            ibus_proxy_call ((IBusProxy *) panel,
+                             "RestoreState",
+                             IBUS_TYPE_OBJECT_PATH, &path,
+                             G_TYPE_INVALID);
+            priv->shown = snapshot->serials;
+            bus_panel_snapshot_free (snapshot);
+            priv->snapshots = g_list_delete_link (priv->snapshots, p);
+            break;
+        }
+    }
+
+    /* lookup table deltas apply to the table of the focused context */
+    if (priv->lookup_table) {
+        g_object_unref (priv->lookup_table);
+        priv->lookup_table = NULL;
+    }
+
     /* install signal handlers */
     gint i;
     for (i = 0; __signals[i].name != NULL; i++) {
@@ -380,6 +540,24 @@ bus_panel_proxy_focus_out (BusPanelProxy    *panel,
                      IBUS_TYPE_OBJECT_PATH, &path,
                      G_TYPE_INVALID);
 
+    /* the panel takes a snapshot on FocusOut, remember what is in it;
+     * without RestoreState everything is sent again on FocusIn */
+    if (priv->capabilities & BUS_PANEL_CAP_RESTORE_STATE) {
+        BusPanelSnapshot *snapshot;
+        GList *last;
+
+        snapshot = g_slice_new (BusPanelSnapshot);
+        snapshot->path = g_strdup (path);
+        snapshot->serials = priv->shown;
+        priv->snapshots = g_list_prepend (priv->snapshots, snapshot);
+
+        if (g_list_length (priv->snapshots) > BUS_PANEL_PROXY_SNAPSHOTS) {
+            last = g_list_last (priv->snapshots);
+            bus_panel_snapshot_free ((BusPanelSnapshot *) last->data);
+            priv->snapshots = g_list_delete_link (priv->snapshots, last);
+        }
+    }
+
     g_object_unref (priv->focused_context);
     priv->focused_context = NULL;
 }
@@ -393,6 +571,17 @@ bus_panel_proxy_set_cursor_location (BusPanelProxy *panel,
 {
     g_assert (BUS_IS_PANEL_PROXY (panel));
 
+    BusPanelProxyPrivate *priv;
+    priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);
+
+    if (priv->x == x && priv->y == y && priv->w == w && priv->h == h)
+        return;
+
+    priv->x = x;
+    priv->y = y;
+    priv->w = w;
+    priv->h = h;
+
     ibus_proxy_call ((IBusProxy *) panel,
                      "SetCursorLocation",
                      G_TYPE_INT, &x,
@@ -402,6 +591,53 @@ bus_panel_proxy_set_cursor_location (BusPanelProxy *panel,
                      G_TYPE_INVALID);
 }
 
+/* Texts go to the panel in the compact encoding only if it reported
+ * BUS_PANEL_CAP_COMPACT_TEXT, older panels read the full IBusAttrList
+ * only. */
+static IBusSerializeFlags
+bus_panel_proxy_get_serialize_flags (BusPanelProxy *panel)
+{
+    BusPanelProxyPrivate *priv;
+    priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);
+
+    return (priv->capabilities & BUS_PANEL_CAP_COMPACT_TEXT) ? IBUS_SERIALIZE_COMPACT_TEXT : 0;
+}
+
+/* as ibus_proxy_call, with the texts the panel reads */
+static void
+bus_panel_proxy_call (BusPanelProxy *panel,
+                      const gchar   *method,
+                      GType          first_arg_type,
+                      ...)
+{
+    va_list args;
+    GType type;
+    IBusSerializeFlags flags;
+    IBusMessage *message;
+    IBusMessageIter iter;
+
+    message = ibus_message_new_method_call (ibus_proxy_get_name ((IBusProxy *) panel),
+                                            ibus_proxy_get_path ((IBusProxy *) panel),
+                                            ibus_proxy_get_interface ((IBusProxy *) panel),
+                                            method);
+
+    flags = bus_panel_proxy_get_serialize_flags (panel);
+    ibus_message_iter_init_append (message, &iter);
+    va_start (args, first_arg_type);
+    for (type = first_arg_type; type != G_TYPE_INVALID; type = va_arg (args, GType)) {
+        gpointer value = va_arg (args, gpointer);
+
+        if (g_type_is_a (type, IBUS_TYPE_SERIALIZABLE))
+            ibus_serializable_serialize_with_flags (*(IBusSerializable **) value, &iter, flags);
+        else
+            ibus_message_iter_append (&iter, type, value);
+    }
+    va_end (args);
+
+    ibus_proxy_send ((IBusProxy *) panel, message);
+    ibus_message_unref (message);
+}
+
 void
 bus_panel_proxy_update_preedit_text (BusPanelProxy  *panel,
                                      IBusText       *text,
@@ -411,12 +647,12 @@ bus_panel_proxy_update_preedit_text (BusPanelProxy  *panel,
     g_assert (BUS_IS_PANEL_PROXY (panel));
     g_assert (text != NULL);
 
-    ibus_proxy_call ((IBusProxy *) panel,
-                     "UpdatePreeditText",
-                     IBUS_TYPE_TEXT, &text,
-                     G_TYPE_UINT, &cursor_pos,
-                     G_TYPE_BOOLEAN, &visible,
-                     G_TYPE_INVALID);
+    bus_panel_proxy_call (panel,
+                          "UpdatePreeditText",
+                          IBUS_TYPE_TEXT, &text,
+                          G_TYPE_UINT, &cursor_pos,
+                          G_TYPE_BOOLEAN, &visible,
+                          G_TYPE_INVALID);
 }
 
 void
@@ -427,11 +663,65 @@ bus_panel_proxy_update_auxiliary_text (BusPanelProxy *panel,
     g_assert (BUS_IS_PANEL_PROXY (panel));
     g_assert (text != NULL);
 
-    ibus_proxy_call ((IBusProxy *) panel,
-                     "UpdateAuxiliaryText",
-                     IBUS_TYPE_TEXT, &text,
-                     G_TYPE_BOOLEAN, &visible,
-                     G_TYPE_INVALID);
+    bus_panel_proxy_call (panel,
+                          "UpdateAuxiliaryText",
+                          IBUS_TYPE_TEXT, &text,
+                          G_TYPE_BOOLEAN, &visible,
+                          G_TYPE_INVALID);
+}
+
+static void
+bus_panel_proxy_send_lookup_table (BusPanelProxy *panel)
+{
+    BusPanelProxyPrivate *priv;
+    priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);
+
+    bus_panel_proxy_call (panel,
+                          "UpdateLookupTable",
+                          IBUS_TYPE_LOOKUP_TABLE, &priv->lookup_table,
+                          G_TYPE_BOOLEAN, &priv->lookup_table_visible,
+                          G_TYPE_INVALID);
+    priv->lookup_table_generation ++;
+}
+
+static void
+_update_lookup_table_delta_reply_cb (IBusPendingCall   *pending,
+                                     BusPanelDeltaCall *call)
+{
+    BusPanelProxyPrivate *priv;
+    IBusMessage *reply_message;
+    IBusError *error;
+
+    priv = BUS_PANEL_PROXY_GET_PRIVATE (call->panel);
+
+    reply_message = ibus_pending_call_steal_reply (pending);
+    if (reply_message == NULL)
+        return;
+
+    error = ibus_error_new_from_message (reply_message);
+    ibus_message_unref (reply_message);
+
+    if (error == NULL)
+        return;
+
+    if (!IBUS_OBJECT_DESTROYED (call->panel)) {
+        if (g_strcmp0 (error->name, DBUS_ERROR_UNKNOWN_METHOD) == 0)
+            priv->capabilities &= ~BUS_PANEL_CAP_LOOKUP_TABLE_DELTA;
+
+        /* the panel does not show the table, send it in full unless a
+         * later update or a focus change replaced it */
+        if (call->serial == priv->lookup_table_serial && priv->lookup_table != NULL)
+            bus_panel_proxy_send_lookup_table (call->panel);
+    }
+
+    ibus_error_free (error);
+}
+
+static void
+bus_panel_delta_call_free (BusPanelDeltaCall *call)
+{
+    g_object_unref (call->panel);
+    g_slice_free (BusPanelDeltaCall, call);
 }
 
 void
@@ -442,11 +732,67 @@ bus_panel_proxy_update_lookup_table (BusPanelProxy   *panel,
     g_assert (BUS_IS_PANEL_PROXY (panel));
     g_assert (table != NULL);
 
-    ibus_proxy_call ((IBusProxy *) panel,
-                     "UpdateLookupTable",
-                     IBUS_TYPE_LOOKUP_TABLE, &table,
-                     G_TYPE_BOOLEAN, &visible,
-                     G_TYPE_INVALID);
+    BusPanelProxyPrivate *priv;
+    IBusLookupTableDelta *delta = NULL;
+
+    priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);
+
+    priv->lookup_table_serial ++;
+
+    if (priv->lookup_table != NULL &&
+        (priv->capabilities & BUS_PANEL_CAP_LOOKUP_TABLE_DELTA)) {
+        delta = ibus_lookup_table_diff (priv->lookup_table, table);
+        /* a delta replacing every candidate is not smaller than the table */
+        if (delta->candidates->len > 0 &&
+            delta->candidates->len == table->candidates->len) {
+            ibus_lookup_table_delta_free (delta);
+            delta = NULL;
+        }
+    }
+
+    if (delta != NULL) {
+        IBusMessage *message;
+        IBusMessageIter iter;
+        IBusPendingCall *pending = NULL;
+
+        delta->generation = priv->lookup_table_generation;
+
+        message = ibus_message_new_method_call (ibus_proxy_get_name ((IBusProxy *) panel),
+                                                ibus_proxy_get_path ((IBusProxy *) panel),
+                                                ibus_proxy_get_interface ((IBusProxy *) panel),
+                                                "UpdateLookupTableDelta");
+        ibus_message_iter_init_append (message, &iter);
+        ibus_lookup_table_delta_serialize (delta, &iter,
+                                           bus_panel_proxy_get_serialize_flags (panel));
+        ibus_message_iter_append (&iter, G_TYPE_BOOLEAN, &visible);
+
+        /* the reply tells if the panel took it */
+        if (ibus_proxy_send_with_reply ((IBusProxy *) panel, message, &pending, -1) &&
+            pending != NULL) {
+            BusPanelDeltaCall *call;
+
+            call = g_slice_new (BusPanelDeltaCall);
+            call->panel = (BusPanelProxy *) g_object_ref (panel);
+            call->serial = priv->lookup_table_serial;
+            ibus_pending_call_set_notify (pending,
+                                          (IBusPendingCallNotifyFunction) _update_lookup_table_delta_reply_cb,
+                                          call,
+                                          (GDestroyNotify) bus_panel_delta_call_free);
+            ibus_pending_call_unref (pending);
+        }
+        ibus_message_unref (message);
+
+        ibus_lookup_table_delta_free (delta);
+    }
+
+    /* the table of the input context is paged in place */
+    if (priv->lookup_table != NULL)
+        g_object_unref (priv->lookup_table);
+    priv->lookup_table = ibus_lookup_table_dup (table);
+    priv->lookup_table_visible = visible;
+
+    if (delta == NULL)
+        bus_panel_proxy_send_lookup_table (panel);
 }
 
 void
@@ -456,10 +802,10 @@ bus_panel_proxy_register_properties (BusPanelProxy  *panel,
     g_assert (BUS_IS_PANEL_PROXY (panel));
     g_assert (prop_list != NULL);
 
-    ibus_proxy_call ((IBusProxy *) panel,
-                     "RegisterProperties",
-                     IBUS_TYPE_PROP_LIST, &prop_list,
-                     G_TYPE_INVALID);
+    bus_panel_proxy_call (panel,
+                          "RegisterProperties",
+                          IBUS_TYPE_PROP_LIST, &prop_list,
+                          G_TYPE_INVALID);
     ibus_connection_flush (ibus_proxy_get_connection((IBusProxy *)panel));
 }
 
@@ -470,10 +816,10 @@ bus_panel_proxy_update_property (BusPanelProxy  *panel,
     g_assert (BUS_IS_PANEL_PROXY (panel));
     g_assert (prop != NULL);
 
-    ibus_proxy_call ((IBusProxy *) panel,
-                     "UpdateProperty",
-                     IBUS_TYPE_PROPERTY, &prop,
-                     G_TYPE_INVALID);
+    bus_panel_proxy_call (panel,
+                          "UpdateProperty",
+                          IBUS_TYPE_PROPERTY, &prop,
+                          G_TYPE_INVALID);
 }
 
 static void
@@ -565,6 +911,55 @@ DEFINE_FUNCTION (StateChanged, state_changed)
 
 #undef DEFINE_FUNCTION
 
+/* returns TRUE if the panel does not show this change of the item yet */
+static gboolean
+bus_panel_proxy_need_update (BusPanelProxy   *panel,
+                             BusInputContext *context,
+                             glong            item,
+                             gboolean         visible)
+{
+    BusPanelProxyPrivate *priv;
+    BusInputContextSerials serials;
+    guint *shown;
+    guint serial;
+
+    priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);
+
+    bus_input_context_get_serials (context, &serials);
+    shown = &G_STRUCT_MEMBER (guint, &priv->shown, item);
+    serial = G_STRUCT_MEMBER (guint, &serials, item);
+
+    if (*shown == serial)
+        return FALSE;
+
+    /* the panel was reset on focus in, there is nothing to hide */
+    if (!visible && *shown == 0) {
+        *shown = serial;
+        return FALSE;
+    }
+
+    *shown = serial;
+    return TRUE;
+}
+
+/* records that the panel followed a change of the item, while the context
+ * loses the focus it hides the items without changing them, so the panel
+ * has to get them again */
+static void
+bus_panel_proxy_state_sent (BusPanelProxy   *panel,
+                            BusInputContext *context,
+                            glong            item)
+{
+    BusPanelProxyPrivate *priv;
+    BusInputContextSerials serials;
+
+    priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);
+
+    bus_input_context_get_serials (context, &serials);
+    G_STRUCT_MEMBER (guint, &priv->shown, item) =
+        bus_input_context_has_focus (context) ? G_STRUCT_MEMBER (guint, &serials, item) : 0;
+}
+
 static void
 _context_set_cursor_location_cb (BusInputContext *context,
                                  gint             x,
@@ -600,6 +995,10 @@ _context_update_preedit_text_cb (BusInputContext *context,
 
     g_return_if_fail (priv->focused_context == context);
 
+    if (!bus_panel_proxy_need_update (panel, context,
+                G_STRUCT_OFFSET (BusInputContextSerials, preedit), visible))
+        return;
+
     bus_panel_proxy_update_preedit_text (panel,
                                          text,
                                          cursor_pos,
@@ -620,6 +1019,10 @@ _context_update_auxiliary_text_cb (BusInputContext *context,
 
     g_return_if_fail (priv->focused_context == context);
 
+    if (!bus_panel_proxy_need_update (panel, context,
+                G_STRUCT_OFFSET (BusInputContextSerials, auxiliary), visible))
+        return;
+
     bus_panel_proxy_update_auxiliary_text (panel,
                                            text,
                                            visible);
@@ -639,6 +1042,10 @@ _context_update_lookup_table_cb (BusInputContext *context,
 
     g_return_if_fail (priv->focused_context == context);
 
+    if (!bus_panel_proxy_need_update (panel, context,
+                G_STRUCT_OFFSET (BusInputContextSerials, lookup_table), visible))
+        return;
+
     bus_panel_proxy_update_lookup_table (panel,
                                          table,
                                          visible);
@@ -657,6 +1064,10 @@ _context_register_properties_cb (BusInputContext *context,
 
     g_return_if_fail (priv->focused_context == context);
 
+    if (!bus_panel_proxy_need_update (panel, context,
+                G_STRUCT_OFFSET (BusInputContextSerials, props), TRUE))
+        return;
+
     bus_panel_proxy_register_properties (panel,
                                          prop_list);
 }
@@ -676,6 +1087,8 @@ _context_update_property_cb (BusInputContext *context,
 
     bus_panel_proxy_update_property (panel,
                                      prop);
+    bus_panel_proxy_state_sent (panel, context,
+                G_STRUCT_OFFSET (BusInputContextSerials, props));
 }
 
 #if 0
@@ -710,12 +1123,6 @@ _context_destroy_cb (BusInputContext *context,
         bus_panel_proxy_##name (panel);                         \
     }
 
-DEFINE_FUNCTION (show_preedit_text)
-DEFINE_FUNCTION (hide_preedit_text)
-DEFINE_FUNCTION (show_auxiliary_text)
-DEFINE_FUNCTION (hide_auxiliary_text)
-DEFINE_FUNCTION (show_lookup_table)
-DEFINE_FUNCTION (hide_lookup_table)
 DEFINE_FUNCTION (page_up_lookup_table)
 DEFINE_FUNCTION (page_down_lookup_table)
 DEFINE_FUNCTION (cursor_up_lookup_table)
@@ -724,6 +1131,32 @@ DEFINE_FUNCTION (state_changed)
 
 #undef DEFINE_FUNCTION
 
+#define DEFINE_FUNCTION(name, item)                             \
+    static void _context_##name##_cb (BusInputContext *context, \
+                                      BusPanelProxy   *panel)   \
+    {                                                           \
+        g_assert (BUS_IS_INPUT_CONTEXT (context));              \
+        g_assert (BUS_IS_PANEL_PROXY (panel));                  \
+                                                                \
+        BusPanelProxyPrivate *priv;                             \
+        priv = BUS_PANEL_PROXY_GET_PRIVATE (panel);             \
+                                                                \
+        g_return_if_fail (priv->focused_context == context);    \
+                                                                \
+        bus_panel_proxy_##name (panel);                         \
+        bus_panel_proxy_state_sent (panel, context,             \
+            G_STRUCT_OFFSET (BusInputContextSerials, item));    \
+    }
+
+DEFINE_FUNCTION (show_preedit_text, preedit)
+DEFINE_FUNCTION (hide_preedit_text, preedit)
+DEFINE_FUNCTION (show_auxiliary_text, auxiliary)
+DEFINE_FUNCTION (hide_auxiliary_text, auxiliary)
+DEFINE_FUNCTION (show_lookup_table, lookup_table)
+DEFINE_FUNCTION (hide_lookup_table, lookup_table)
+
+#undef DEFINE_FUNCTION
+
 static const struct _SignalCallbackTable
 __signals[] = {
     { "set-cursor-location",        G_CALLBACK (_context_set_cursor_location_cb) },
@@ -23,6 +23,31 @@
 #include <string.h>
 #include "registry.h"
 
+/* upper bound of the delay between a component file change and the
+ * registry update, events during the delay are handled in one reload */
+#define BUS_REGISTRY_RELOAD_DELAY   500
+
+/* default milliseconds a started component may take to own its bus name */
+#define BUS_REGISTRY_LAUNCH_TIMEOUT (5000)
+/* components started at the same time, 0 is unlimited */
+#define BUS_REGISTRY_MAX_LAUNCHES   (2)
+
+typedef struct _BusComponentLaunch BusComponentLaunch;
+struct _BusComponentLaunch {
+    BusRegistry *registry;
+    IBusComponent *component;
+    /* holds one of the max_launches slots */
+    gboolean started;
+    guint timeout_id;
+    GList *waiters;
+};
+
+typedef struct _BusLaunchWaiter BusLaunchWaiter;
+struct _BusLaunchWaiter {
+    GFunc callback;
+    gpointer user_data;
+};
+
 enum {
     LAST_SIGNAL,
 };
@@ -38,8 +63,29 @@ static void              bus_registry_load_in_dir       (BusRegistry        *reg
                                                          const gchar        *dirname);
 static gboolean          bus_registry_save_cache        (BusRegistry        *registry);
 static gboolean          bus_registry_load_cache        (BusRegistry        *registry);
+static gboolean          bus_registry_save_binary_cache (BusRegistry        *registry);
+static gboolean          bus_registry_load_binary_cache (BusRegistry        *registry);
+static IBusComponent    *bus_registry_load_cached_component
+                                                        (BusRegistry        *registry,
+                                                         guint               index);
+static void              bus_registry_load_all_cached   (BusRegistry        *registry);
+static void              bus_registry_add_component     (BusRegistry        *registry,
+                                                         IBusComponent      *component);
 static gboolean          bus_registry_check_modification(BusRegistry        *registry);
 static void              bus_registry_remove_all        (BusRegistry        *registry);
+static void              bus_registry_start_monitor     (BusRegistry        *registry);
+static void              bus_registry_reload_file       (BusRegistry        *registry,
+                                                         const gchar        *filename);
+static void              bus_registry_replace_component (BusRegistry        *registry,
+                                                         IBusComponent      *old,
+                                                         IBusComponent      *component);
+static gboolean          bus_registry_component_is_running
+                                                        (BusRegistry        *registry,
+                                                         IBusComponent      *component);
+static void              bus_registry_run_launch_queue  (BusRegistry        *registry);
+static void              bus_registry_finish_launch     (BusRegistry        *registry,
+                                                         BusComponentLaunch *launch,
+                                                         BusFactoryProxy    *factory);
 
 static IBusObjectClass  *parent_class = NULL;
 
@@ -88,15 +134,32 @@ bus_registry_init (BusRegistry *registry)
     registry->observed_paths = NULL;
     registry->components = NULL;
     registry->engine_table = g_hash_table_new (g_str_hash, g_str_equal);
+    registry->cache = NULL;
+    registry->cache_components = NULL;
+    registry->changed_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    registry->reload_id = 0;
+    registry->removed_components = NULL;
+    registry->launches = g_hash_table_new (g_direct_hash, g_direct_equal);
+    registry->launch_queue = NULL;
+    registry->n_launching = 0;
+    registry->max_launches = BUS_REGISTRY_MAX_LAUNCHES;
+    registry->launch_timeout = BUS_REGISTRY_LAUNCH_TIMEOUT;
     
     extern gboolean g_rescan;
 
+    /* registry.xml is only used if the binary cache is missing or was
+     * written by an incompatible version */
     if (g_rescan ||
-        bus_registry_load_cache (registry) == FALSE ||
+        (bus_registry_load_binary_cache (registry) == FALSE &&
+         bus_registry_load_cache (registry) == FALSE) ||
         bus_registry_check_modification (registry)) {
         bus_registry_remove_all (registry);
         bus_registry_load (registry);
         bus_registry_save_cache (registry);
+        bus_registry_save_binary_cache (registry);
+    }
+    else if (registry->cache == NULL) {
+        bus_registry_save_binary_cache (registry);
     }
 
     for (p = registry->components; p != NULL; p = p->next) {
@@ -109,11 +172,72 @@ bus_registry_init (BusRegistry *registry)
             g_object_set_data ((GObject *)desc, "component", comp);
         }
     }
+
+    bus_registry_start_monitor (registry);
+}
+
+static void
+bus_registry_add_component (BusRegistry   *registry,
+                            IBusComponent *component)
+{
+    GList *p;
+
+    registry->components = g_list_append (registry->components, component);
+
+    for (p = component->engines; p != NULL; p = p->next) {
+        IBusEngineDesc *desc = (IBusEngineDesc *)p->data;
+        g_hash_table_insert (registry->engine_table, desc->name, desc);
+    }
+}
+
+static IBusComponent *
+bus_registry_load_cached_component (BusRegistry *registry,
+                                    guint        index)
+{
+    g_assert (registry->cache != NULL);
+
+    if (registry->cache_components[index] == NULL) {
+        IBusComponent *component;
+        component = bus_registry_cache_new_component (registry->cache, index);
+        registry->cache_components[index] = component;
+        bus_registry_add_component (registry, component);
+    }
+
+    return registry->cache_components[index];
+}
+
+static void
+bus_registry_load_all_cached (BusRegistry *registry)
+{
+    guint i, n;
+
+    if (registry->cache == NULL)
+        return;
+
+    n = bus_registry_cache_get_n_components (registry->cache);
+    for (i = 0; i < n; i++) {
+        bus_registry_load_cached_component (registry, i);
+    }
+
+    /* keep the order of the cache file */
+    g_list_free (registry->components);
+    registry->components = NULL;
+    for (i = 0; i < n; i++) {
+        registry->components = g_list_append (registry->components,
+                                              registry->cache_components[i]);
+    }
+
+    /* everything is copied out, the file is not needed anymore */
+    bus_registry_cache_free (registry->cache);
+    registry->cache = NULL;
+    g_free (registry->cache_components);
+    registry->cache_components = NULL;
 }
 
 static void
 bus_registry_remove_all (BusRegistry *registry)
 {
+    g_list_foreach (registry->observed_paths, (GFunc) ibus_observed_path_stop_monitor, NULL);
     g_list_foreach (registry->observed_paths, (GFunc) g_object_unref, NULL);
     g_list_free (registry->observed_paths);
     registry->observed_paths = NULL;
@@ -123,16 +247,47 @@ bus_registry_remove_all (BusRegistry *registry)
     registry->components = NULL;
 
     g_hash_table_remove_all (registry->engine_table);
+
+    if (registry->cache) {
+        bus_registry_cache_free (registry->cache);
+        registry->cache = NULL;
+    }
+    g_free (registry->cache_components);
+    registry->cache_components = NULL;
 }
 
 static void
 bus_registry_destroy (BusRegistry *registry)
 {
+    GList *launches, *p;
+
+    /* fail the pending requests, the components are stopped by the caller */
+    g_list_free (registry->launch_queue);
+    registry->launch_queue = NULL;
+    launches = g_hash_table_get_values (registry->launches);
+    for (p = launches; p != NULL; p = p->next) {
+        bus_registry_finish_launch (registry, (BusComponentLaunch *) p->data, NULL);
+    }
+    g_list_free (launches);
+    g_hash_table_destroy (registry->launches);
+    registry->launches = NULL;
+
     bus_registry_remove_all (registry);
 
     g_hash_table_destroy (registry->engine_table);
     registry->engine_table = NULL;
 
+    if (registry->reload_id != 0) {
+        g_source_remove (registry->reload_id);
+        registry->reload_id = 0;
+    }
+    g_hash_table_destroy (registry->changed_files);
+    registry->changed_files = NULL;
+
+    g_list_foreach (registry->removed_components, (GFunc) g_object_unref, NULL);
+    g_list_free (registry->removed_components);
+    registry->removed_components = NULL;
+
     IBUS_OBJECT_CLASS (parent_class)->destroy (IBUS_OBJECT (registry));
 }
 
@@ -179,6 +334,52 @@ bus_registry_load (BusRegistry *registry)
         }                                       \
     }
 
+static gboolean
+bus_registry_load_binary_cache (BusRegistry *registry)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+
+    gchar *filename;
+    BusRegistryCache *cache;
+
+    filename = g_build_filename (g_get_user_cache_dir (), "ibus", "registry.cache", NULL);
+    cache = bus_registry_cache_new_from_file (filename);
+    g_free (filename);
+
+    if (cache == NULL) {
+        return FALSE;
+    }
+
+    registry->cache = cache;
+    registry->cache_components = g_new0 (IBusComponent *,
+                                         bus_registry_cache_get_n_components (cache));
+    registry->observed_paths = bus_registry_cache_new_observed_paths (cache);
+
+    return TRUE;
+}
+
+static gboolean
+bus_registry_save_binary_cache (BusRegistry *registry)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+
+    gchar *cachedir;
+    gchar *filename;
+    gboolean retval;
+
+    cachedir = g_build_filename (g_get_user_cache_dir (), "ibus", NULL);
+    filename = g_build_filename (cachedir, "registry.cache", NULL);
+    g_mkdir_with_parents (cachedir, 0775);
+
+    retval = bus_registry_cache_save (filename,
+                                      registry->observed_paths,
+                                      registry->components);
+    g_free (filename);
+    g_free (cachedir);
+
+    return retval;
+}
+
 static gboolean
 bus_registry_load_cache (BusRegistry *registry)
 {
@@ -239,6 +440,10 @@ bus_registry_check_modification (BusRegistry *registry)
 {
     GList *p;
 
+    if (registry->cache &&
+        bus_registry_cache_check_modification (registry->cache))
+        return TRUE;
+
     for (p = registry->observed_paths; p != NULL; p = p->next) {
         if (ibus_observed_path_check_modification ((IBusObservedPath *)p->data))
             return TRUE;
@@ -349,6 +554,203 @@ bus_registry_load_in_dir (BusRegistry *registry,
     g_dir_close (dir);
 }
 
+static gint
+_component_is_file (IBusComponent *component,
+                    const gchar   *filename)
+{
+    IBusObservedPath *path;
+
+    /* ibus_component_new_from_file puts the xml file first */
+    if (component->observed_paths == NULL)
+        return -1;
+
+    path = (IBusObservedPath *) component->observed_paths->data;
+    return g_strcmp0 (path->path, filename);
+}
+
+/* A replaced component may have a running process which owns the bus
+ * name, the component replacing it takes over its factory and launch, so
+ * no second process is started which can not own the name */
+static void
+bus_registry_replace_component (BusRegistry   *registry,
+                                IBusComponent *old,
+                                IBusComponent *component)
+{
+    BusFactoryProxy *factory;
+    BusComponentLaunch *launch;
+
+    if (g_strcmp0 (old->name, component->name) != 0)
+        return;
+
+    factory = bus_factory_proxy_get_from_component (old);
+    if (factory != NULL) {
+        bus_factory_proxy_set_component (factory, component);
+    }
+
+    launch = (BusComponentLaunch *) g_hash_table_lookup (registry->launches, old);
+    if (launch != NULL) {
+        g_hash_table_remove (registry->launches, old);
+        g_object_unref (launch->component);
+        launch->component = (IBusComponent *) g_object_ref (component);
+        g_hash_table_insert (registry->launches, component, launch);
+    }
+}
+
+/* the process of a replaced component with the same name counts too */
+static gboolean
+bus_registry_component_is_running (BusRegistry   *registry,
+                                   IBusComponent *component)
+{
+    GList *p;
+
+    if (ibus_component_is_running (component))
+        return TRUE;
+
+    for (p = registry->removed_components; p != NULL; p = p->next) {
+        IBusComponent *old = (IBusComponent *) p->data;
+        if (g_strcmp0 (old->name, component->name) == 0 &&
+            ibus_component_is_running (old))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+bus_registry_reload_file (BusRegistry *registry,
+                          const gchar *filename)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+    g_assert (filename);
+
+    GList *p, *p1;
+    IBusComponent *component = NULL;
+
+    if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
+        component = ibus_component_new_from_file (filename);
+    }
+
+    p = g_list_find_custom (registry->components,
+                            filename,
+                            (GCompareFunc) _component_is_file);
+
+    if (p != NULL) {
+        IBusComponent *old = (IBusComponent *) p->data;
+
+        for (p1 = old->engines; p1 != NULL; p1 = p1->next) {
+            IBusEngineDesc *desc = (IBusEngineDesc *) p1->data;
+            if (g_hash_table_lookup (registry->engine_table, desc->name) == desc)
+                g_hash_table_remove (registry->engine_table, desc->name);
+        }
+
+        /* the engines of the old component may still be referenced and
+         * its process may still be running, so keep it until exit */
+        registry->removed_components = g_list_append (registry->removed_components, old);
+
+        if (component != NULL) {
+            p->data = component;
+            bus_registry_replace_component (registry, old, component);
+        }
+        else {
+            registry->components = g_list_delete_link (registry->components, p);
+        }
+    }
+    else if (component != NULL) {
+        registry->components = g_list_append (registry->components, component);
+    }
+
+    if (component == NULL)
+        return;
+
+    for (p1 = component->engines; p1 != NULL; p1 = p1->next) {
+        IBusEngineDesc *desc = (IBusEngineDesc *) p1->data;
+        g_hash_table_insert (registry->engine_table, desc->name, desc);
+    }
+}
+
+static gboolean
+bus_registry_reload_changed_files (BusRegistry *registry)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+
+    GList *files, *p;
+
+    registry->reload_id = 0;
+
+    /* the caches are rewritten below, so all components are needed */
+    bus_registry_load_all_cached (registry);
+
+    files = g_hash_table_get_keys (registry->changed_files);
+    for (p = files; p != NULL; p = p->next) {
+        bus_registry_reload_file (registry, (const gchar *) p->data);
+    }
+    g_list_free (files);
+    g_hash_table_remove_all (registry->changed_files);
+
+    bus_registry_save_cache (registry);
+    bus_registry_save_binary_cache (registry);
+
+    return FALSE;
+}
+
+static void
+_observed_path_changed_cb (IBusObservedPath *path,
+                           const gchar      *filename,
+                           guint             event,
+                           BusRegistry      *registry)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+
+    if (!g_str_has_suffix (filename, ".xml"))
+        return;
+
+    g_hash_table_replace (registry->changed_files, g_strdup (filename), NULL);
+
+    /* do not restart the timeout, a burst of events must not delay the
+     * update for ever */
+    if (registry->reload_id == 0) {
+        registry->reload_id = g_timeout_add (BUS_REGISTRY_RELOAD_DELAY,
+                                             (GSourceFunc) bus_registry_reload_changed_files,
+                                             registry);
+    }
+}
+
+/* reloads filename right away instead of after BUS_REGISTRY_RELOAD_DELAY,
+ * together with the files the monitor reported so far */
+void
+bus_registry_file_changed (BusRegistry *registry,
+                           const gchar *filename)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+    g_assert (filename);
+
+    g_hash_table_replace (registry->changed_files, g_strdup (filename), NULL);
+
+    if (registry->reload_id != 0) {
+        g_source_remove (registry->reload_id);
+    }
+    bus_registry_reload_changed_files (registry);
+}
+
+static void
+bus_registry_start_monitor (BusRegistry *registry)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+
+    GList *p;
+
+    for (p = registry->observed_paths; p != NULL; p = p->next) {
+        IBusObservedPath *path = (IBusObservedPath *) p->data;
+
+        if (ibus_observed_path_start_monitor (path)) {
+            g_signal_connect (path,
+                              "changed",
+                              G_CALLBACK (_observed_path_changed_cb),
+                              registry);
+        }
+    }
+}
+
 
 BusRegistry *
 bus_registry_new (void)
@@ -376,6 +778,13 @@ bus_registry_lookup_component_by_name (BusRegistry *registry,
     g_assert (name);
 
     GList *p;
+
+    if (registry->cache) {
+        gint index = bus_registry_cache_lookup_component (registry->cache, name);
+        if (index >= 0)
+            return bus_registry_load_cached_component (registry, index);
+    }
+
     p = g_list_find_custom (registry->components,
                             name,
                             (GCompareFunc)_component_is_name);
@@ -392,6 +801,8 @@ bus_registry_get_components (BusRegistry *registry)
 {
     g_assert (BUS_IS_REGISTRY (registry));
 
+    bus_registry_load_all_cached (registry);
+
     return g_list_copy (registry->components);
 }
 
@@ -400,6 +811,8 @@ bus_registry_get_engines (BusRegistry *registry)
 {
     g_assert (BUS_IS_REGISTRY (registry));
 
+    bus_registry_load_all_cached (registry);
+
     return g_hash_table_get_values (registry->engine_table);
 }
 
@@ -416,7 +829,20 @@ bus_registry_get_engines_by_language (BusRegistry *registry,
 
     n = strlen (language);
 
-    p1 = bus_registry_get_engines (registry);
+    /* only load the components which have engines for the language */
+    if (registry->cache) {
+        guint i;
+        for (i = 0; i < bus_registry_cache_get_n_engines (registry->cache); i++) {
+            const gchar *lang;
+            lang = bus_registry_cache_get_engine_language (registry->cache, i);
+            if (lang != NULL && strncmp (lang, language, n) == 0) {
+                bus_registry_load_cached_component (registry,
+                    bus_registry_cache_get_engine_component (registry->cache, i));
+            }
+        }
+    }
+
+    p1 = g_hash_table_get_values (registry->engine_table);
 
     engines = NULL;
 
@@ -438,7 +864,20 @@ bus_registry_find_engine_by_name (BusRegistry *registry,
     g_assert (BUS_IS_REGISTRY (registry));
     g_assert (name);
 
-    return (IBusEngineDesc *) g_hash_table_lookup (registry->engine_table, name);
+    IBusEngineDesc *desc;
+
+    desc = (IBusEngineDesc *) g_hash_table_lookup (registry->engine_table, name);
+
+    if (desc == NULL && registry->cache) {
+        gint index = bus_registry_cache_lookup_engine (registry->cache, name);
+        if (index >= 0) {
+            bus_registry_load_cached_component (registry,
+                bus_registry_cache_get_engine_component (registry->cache, index));
+            desc = (IBusEngineDesc *) g_hash_table_lookup (registry->engine_table, name);
+        }
+    }
+
+    return desc;
 }
 
 void
@@ -447,7 +886,8 @@ bus_registry_stop_all_components (BusRegistry *registry)
     g_assert (BUS_IS_REGISTRY (registry));
 
     g_list_foreach (registry->components, (GFunc) ibus_component_stop, NULL);
-    
+    g_list_foreach (registry->removed_components, (GFunc) ibus_component_stop, NULL);
+
 }
 
 BusFactoryProxy *
@@ -480,8 +920,185 @@ bus_registry_name_owner_changed (BusRegistry *registry,
 
     if (g_strcmp0 (new_name, "") != 0) {
         factory = bus_factory_proxy_new (component, NULL);
+
+        if (factory != NULL) {
+            BusComponentLaunch *launch;
+
+            launch = (BusComponentLaunch *) g_hash_table_lookup (registry->launches, component);
+            if (launch != NULL) {
+                bus_registry_finish_launch (registry, launch, factory);
+            }
+        }
         return factory;
     }
 
     return NULL;
 }
+
+static void
+bus_registry_finish_launch (BusRegistry        *registry,
+                            BusComponentLaunch *launch,
+                            BusFactoryProxy    *factory)
+{
+    GList *p;
+
+    g_hash_table_remove (registry->launches, launch->component);
+    registry->launch_queue = g_list_remove (registry->launch_queue, launch);
+
+    if (launch->started) {
+        registry->n_launching --;
+    }
+
+    if (launch->timeout_id != 0) {
+        g_source_remove (launch->timeout_id);
+        launch->timeout_id = 0;
+    }
+
+    for (p = launch->waiters; p != NULL; p = p->next) {
+        BusLaunchWaiter *waiter = (BusLaunchWaiter *) p->data;
+        waiter->callback (factory, waiter->user_data);
+        g_slice_free (BusLaunchWaiter, waiter);
+    }
+    g_list_free (launch->waiters);
+
+    g_object_unref (launch->component);
+    g_slice_free (BusComponentLaunch, launch);
+
+    /* a slot may be free now */
+    bus_registry_run_launch_queue (registry);
+}
+
+static gboolean
+_launch_timeout_cb (BusComponentLaunch *launch)
+{
+    g_warning ("Component %s did not start in %u milliseconds",
+               launch->component->name, launch->registry->launch_timeout);
+
+    launch->timeout_id = 0;
+    bus_registry_finish_launch (launch->registry, launch, NULL);
+
+    return FALSE;
+}
+
+static void
+bus_registry_run_launch_queue (BusRegistry *registry)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+
+    while (registry->launch_queue != NULL &&
+           (registry->max_launches == 0 ||
+            registry->n_launching < registry->max_launches)) {
+        BusComponentLaunch *launch;
+
+        launch = (BusComponentLaunch *) registry->launch_queue->data;
+        registry->launch_queue = g_list_delete_link (registry->launch_queue,
+                                                     registry->launch_queue);
+
+        /* the process may still run from a launch which timed out or
+         * belong to the component this one replaced */
+        if (!bus_registry_component_is_running (registry, launch->component) &&
+            !ibus_component_start (launch->component)) {
+            bus_registry_finish_launch (registry, launch, NULL);
+            /* finish_launch ran the queue again */
+            return;
+        }
+
+        launch->started = TRUE;
+        registry->n_launching ++;
+        launch->timeout_id = g_timeout_add (registry->launch_timeout,
+                                            (GSourceFunc) _launch_timeout_cb,
+                                            launch);
+    }
+}
+
+/* Starts the component and calls callback with its BusFactoryProxy once the
+ * component owns its bus name, or with NULL if it failed to start in time.
+ * callback is called before returning if the factory already exists. At
+ * most max_launches components are started at the same time, a component
+ * somebody waits for goes ahead of the preloaded ones. */
+void
+bus_registry_start_component_async (BusRegistry   *registry,
+                                    IBusComponent *component,
+                                    GFunc          callback,
+                                    gpointer       user_data)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+    g_assert (IBUS_IS_COMPONENT (component));
+
+    BusFactoryProxy *factory;
+    BusComponentLaunch *launch;
+
+    factory = bus_factory_proxy_get_from_component (component);
+    if (factory != NULL) {
+        if (callback != NULL)
+            callback (factory, user_data);
+        return;
+    }
+
+    launch = (BusComponentLaunch *) g_hash_table_lookup (registry->launches, component);
+
+    if (launch == NULL) {
+        launch = g_slice_new0 (BusComponentLaunch);
+        launch->registry = registry;
+        launch->component = (IBusComponent *) g_object_ref (component);
+        g_hash_table_insert (registry->launches, component, launch);
+        registry->launch_queue = g_list_append (registry->launch_queue, launch);
+    }
+
+    if (callback != NULL) {
+        BusLaunchWaiter *waiter;
+
+        waiter = g_slice_new (BusLaunchWaiter);
+        waiter->callback = callback;
+        waiter->user_data = user_data;
+        launch->waiters = g_list_append (launch->waiters, waiter);
+
+        if (!launch->started) {
+            registry->launch_queue = g_list_remove (registry->launch_queue, launch);
+            registry->launch_queue = g_list_prepend (registry->launch_queue, launch);
+        }
+    }
+
+    bus_registry_run_launch_queue (registry);
+}
+
+/* starts the components of engines in the background, so the first
+ * activation of an engine does not wait for its process */
+void
+bus_registry_preload_engines (BusRegistry *registry,
+                              GList       *engines)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+
+    GList *p;
+
+    for (p = engines; p != NULL; p = p->next) {
+        IBusComponent *component;
+
+        component = ibus_component_get_from_engine ((IBusEngineDesc *) p->data);
+        if (component != NULL) {
+            bus_registry_start_component_async (registry, component, NULL, NULL);
+        }
+    }
+}
+
+void
+bus_registry_set_max_launches (BusRegistry *registry,
+                               guint        max_launches)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+
+    registry->max_launches = max_launches;
+    bus_registry_run_launch_queue (registry);
+}
+
+/* applies to launches started from now on */
+void
+bus_registry_set_launch_timeout (BusRegistry *registry,
+                                 guint        timeout)
+{
+    g_assert (BUS_IS_REGISTRY (registry));
+    g_assert (timeout > 0);
+
+    registry->launch_timeout = timeout;
+}
@@ -22,6 +22,7 @@
 
 #include <ibus.h>
 #include "factoryproxy.h"
+#include "registrycache.h"
 
 /*
  * Type macros.
@@ -55,6 +56,24 @@ struct _BusRegistry {
 
     GHashTable *engine_table;
     GList *active_engines;
+
+    /* components not yet loaded from the binary cache */
+    BusRegistryCache *cache;
+    IBusComponent **cache_components;
+
+    /* component files changed since the last reload */
+    GHashTable *changed_files;
+    guint reload_id;
+    /* replaced components, their engines and processes may still be in use */
+    GList *removed_components;
+
+    /* components being started, see bus_registry_start_component_async */
+    GHashTable *launches;
+    GList *launch_queue;
+    guint n_launching;
+    guint max_launches;
+    /* milliseconds a started component may take to own its bus name */
+    guint launch_timeout;
 };
 
 struct _BusRegistryClass {
@@ -83,6 +102,19 @@ BusFactoryProxy *bus_registry_name_owner_changed(BusRegistry    *registry,
                                                  const gchar    *name,
                                                  const gchar    *old_name,
                                                  const gchar    *new_name);
+void             bus_registry_start_component_async
+                                                (BusRegistry    *registry,
+                                                 IBusComponent  *component,
+                                                 GFunc           callback,
+                                                 gpointer        user_data);
+void             bus_registry_preload_engines   (BusRegistry    *registry,
+                                                 GList          *engines);
+void             bus_registry_set_max_launches  (BusRegistry    *registry,
+                                                 guint           max_launches);
+void             bus_registry_set_launch_timeout(BusRegistry    *registry,
+                                                 guint           timeout);
+void             bus_registry_file_changed      (BusRegistry    *registry,
+                                                 const gchar    *filename);
 
 G_END_DECLS
 #endif
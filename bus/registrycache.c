@@ -0,0 +1,552 @@
+/* vim:set et sts=4: */
+/* bus - The Input Bus
+ * Copyright (C) 2008-2009 Huang Peng <shawn.p.huang@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <string.h>
+#include "registrycache.h"
+
+/*
+ * Layout of the cache file, all numbers in host byte order:
+ *
+ *   CacheHeader
+ *   PathRecord      [n_paths]       registry paths first, then components'
+ *   ComponentRecord [n_components]
+ *   EngineRecord    [n_engines]
+ *   string table                    NUL terminated strings
+ *
+ * Strings are referenced by their offset in the string table. Offset 0
+ * is reserved for NULL.
+ */
+#define REGISTRY_CACHE_MAGIC    (0x43524249)    /* "IBRC" */
+#define REGISTRY_CACHE_VERSION  (2)
+
+typedef struct {
+    guint32 magic;
+    guint32 version;
+    guint32 size;
+    guint32 n_registry_paths;
+    guint32 n_paths;
+    guint32 paths;
+    guint32 n_components;
+    guint32 components;
+    guint32 n_engines;
+    guint32 engines;
+    guint32 strings;
+    guint32 strings_size;
+} CacheHeader;
+
+enum {
+    PATH_IS_DIR     = 1 << 0,
+    PATH_IS_EXIST   = 1 << 1,
+};
+
+enum {
+    ENGINE_IS_SHARED    = 1 << 0,
+};
+
+typedef struct {
+    gint64  mtime;
+    guint32 path;
+    guint32 flags;
+} PathRecord;
+
+typedef struct {
+    guint32 name;
+    guint32 description;
+    guint32 version;
+    guint32 license;
+    guint32 author;
+    guint32 homepage;
+    guint32 exec;
+    guint32 textdomain;
+    guint32 first_engine;
+    guint32 n_engines;
+    guint32 first_path;
+    guint32 n_paths;
+} ComponentRecord;
+
+typedef struct {
+    guint32 name;
+    guint32 longname;
+    guint32 description;
+    guint32 language;
+    guint32 license;
+    guint32 author;
+    guint32 icon;
+    guint32 layout;
+    guint32 rank;
+    guint32 flags;
+    guint32 component;
+} EngineRecord;
+
+struct _BusRegistryCache {
+    GMappedFile *file;
+    const CacheHeader *header;
+    const PathRecord *paths;
+    const ComponentRecord *components;
+    const EngineRecord *engines;
+    const gchar *strings;
+
+    GHashTable *component_table;
+    GHashTable *engine_table;
+};
+
+#define CACHE_STRING(cache, offset) \
+    ((offset) != 0 ? (cache)->strings + (offset) : NULL)
+
+static gboolean
+_check_region (const CacheHeader *header,
+               guint32            offset,
+               guint32            n,
+               gsize              size,
+               gsize              align)
+{
+    if (offset % align != 0)
+        return FALSE;
+    return (guint64) offset + (guint64) n * size <= header->size;
+}
+
+static gboolean
+_check_strings (const BusRegistryCache *cache,
+                const guint32          *offsets,
+                gint                    n)
+{
+    gint i;
+    for (i = 0; i < n; i++) {
+        if (offsets[i] >= cache->header->strings_size)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+bus_registry_cache_validate (BusRegistryCache *cache,
+                             gsize             length)
+{
+    const CacheHeader *header = cache->header;
+    const gchar *data = (const gchar *) header;
+    guint32 i;
+
+    if (length < sizeof (CacheHeader) ||
+        header->magic != REGISTRY_CACHE_MAGIC ||
+        header->version != REGISTRY_CACHE_VERSION ||
+        header->size != length)
+        return FALSE;
+
+    if (!_check_region (header, header->paths, header->n_paths,
+                        sizeof (PathRecord), 8) ||
+        !_check_region (header, header->components, header->n_components,
+                        sizeof (ComponentRecord), 4) ||
+        !_check_region (header, header->engines, header->n_engines,
+                        sizeof (EngineRecord), 4) ||
+        !_check_region (header, header->strings, header->strings_size, 1, 1))
+        return FALSE;
+
+    if (header->n_registry_paths > header->n_paths ||
+        header->strings_size == 0 ||
+        data[header->strings + header->strings_size - 1] != '\0')
+        return FALSE;
+
+    cache->paths = (const PathRecord *) (data + header->paths);
+    cache->components = (const ComponentRecord *) (data + header->components);
+    cache->engines = (const EngineRecord *) (data + header->engines);
+    cache->strings = data + header->strings;
+
+    for (i = 0; i < header->n_paths; i++) {
+        if (!_check_strings (cache, &cache->paths[i].path, 1))
+            return FALSE;
+    }
+
+    for (i = 0; i < header->n_components; i++) {
+        const ComponentRecord *record = &cache->components[i];
+        if (!_check_strings (cache, &record->name, 8) ||
+            record->name == 0 ||
+            (guint64) record->first_engine + record->n_engines > header->n_engines ||
+            (guint64) record->first_path + record->n_paths > header->n_paths)
+            return FALSE;
+    }
+
+    for (i = 0; i < header->n_engines; i++) {
+        const EngineRecord *record = &cache->engines[i];
+        if (!_check_strings (cache, &record->name, 8) ||
+            record->name == 0 ||
+            record->component >= header->n_components)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+BusRegistryCache *
+bus_registry_cache_new_from_file (const gchar *filename)
+{
+    g_assert (filename);
+
+    BusRegistryCache *cache;
+    GMappedFile *file;
+    guint32 i;
+
+    file = g_mapped_file_new (filename, FALSE, NULL);
+    if (file == NULL)
+        return NULL;
+
+    cache = g_slice_new0 (BusRegistryCache);
+    cache->file = file;
+    cache->header = (const CacheHeader *) g_mapped_file_get_contents (file);
+
+    if (cache->header == NULL ||
+        !bus_registry_cache_validate (cache, g_mapped_file_get_length (file))) {
+        g_mapped_file_free (file);
+        g_slice_free (BusRegistryCache, cache);
+        return NULL;
+    }
+
+    /* keys point into the mapped file */
+    cache->component_table = g_hash_table_new (g_str_hash, g_str_equal);
+    for (i = 0; i < cache->header->n_components; i++) {
+        g_hash_table_insert (cache->component_table,
+                             (gpointer) CACHE_STRING (cache, cache->components[i].name),
+                             GUINT_TO_POINTER (i + 1));
+    }
+
+    cache->engine_table = g_hash_table_new (g_str_hash, g_str_equal);
+    for (i = 0; i < cache->header->n_engines; i++) {
+        g_hash_table_insert (cache->engine_table,
+                             (gpointer) CACHE_STRING (cache, cache->engines[i].name),
+                             GUINT_TO_POINTER (i + 1));
+    }
+
+    return cache;
+}
+
+void
+bus_registry_cache_free (BusRegistryCache *cache)
+{
+    g_assert (cache);
+
+    g_hash_table_destroy (cache->component_table);
+    g_hash_table_destroy (cache->engine_table);
+    g_mapped_file_free (cache->file);
+    g_slice_free (BusRegistryCache, cache);
+}
+
+gboolean
+bus_registry_cache_check_modification (BusRegistryCache *cache)
+{
+    g_assert (cache);
+
+    guint32 i;
+
+    for (i = 0; i < cache->header->n_paths; i++) {
+        const PathRecord *record = &cache->paths[i];
+        struct stat buf;
+
+        if (g_stat (CACHE_STRING (cache, record->path), &buf) != 0) {
+            buf.st_mtime = 0;
+        }
+
+        if (record->mtime != buf.st_mtime)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static IBusObservedPath *
+bus_registry_cache_new_observed_path (BusRegistryCache *cache,
+                                      const PathRecord *record)
+{
+    IBusObservedPath *path;
+
+    path = ibus_observed_path_new (CACHE_STRING (cache, record->path), FALSE);
+    path->mtime = record->mtime;
+    path->is_dir = (record->flags & PATH_IS_DIR) != 0;
+    path->is_exist = (record->flags & PATH_IS_EXIST) != 0;
+
+    return path;
+}
+
+GList *
+bus_registry_cache_new_observed_paths (BusRegistryCache *cache)
+{
+    g_assert (cache);
+
+    GList *paths = NULL;
+    guint32 i;
+
+    for (i = 0; i < cache->header->n_registry_paths; i++) {
+        paths = g_list_append (paths,
+                    bus_registry_cache_new_observed_path (cache, &cache->paths[i]));
+    }
+
+    return paths;
+}
+
+guint
+bus_registry_cache_get_n_components (BusRegistryCache *cache)
+{
+    g_assert (cache);
+
+    return cache->header->n_components;
+}
+
+IBusComponent *
+bus_registry_cache_new_component (BusRegistryCache *cache,
+                                  guint             index)
+{
+    g_assert (cache);
+    g_assert (index < cache->header->n_components);
+
+    const ComponentRecord *record = &cache->components[index];
+    IBusComponent *component;
+    guint32 i;
+
+    component = ibus_component_new (CACHE_STRING (cache, record->name),
+                                    CACHE_STRING (cache, record->description),
+                                    CACHE_STRING (cache, record->version),
+                                    CACHE_STRING (cache, record->license),
+                                    CACHE_STRING (cache, record->author),
+                                    CACHE_STRING (cache, record->homepage),
+                                    CACHE_STRING (cache, record->exec),
+                                    CACHE_STRING (cache, record->textdomain));
+
+    for (i = record->first_engine; i < record->first_engine + record->n_engines; i++) {
+        const EngineRecord *engine = &cache->engines[i];
+        IBusEngineDesc *desc;
+
+        desc = (IBusEngineDesc *) g_object_new (IBUS_TYPE_ENGINE_DESC, NULL);
+        desc->name          = g_strdup (CACHE_STRING (cache, engine->name));
+        desc->longname      = g_strdup (CACHE_STRING (cache, engine->longname));
+        desc->description   = g_strdup (CACHE_STRING (cache, engine->description));
+        desc->language      = g_strdup (CACHE_STRING (cache, engine->language));
+        desc->license       = g_strdup (CACHE_STRING (cache, engine->license));
+        desc->author        = g_strdup (CACHE_STRING (cache, engine->author));
+        desc->icon          = g_strdup (CACHE_STRING (cache, engine->icon));
+        desc->layout        = g_strdup (CACHE_STRING (cache, engine->layout));
+        desc->rank          = engine->rank;
+        desc->shared        = (engine->flags & ENGINE_IS_SHARED) != 0;
+
+        ibus_component_add_engine (component, desc);
+    }
+
+    for (i = record->first_path; i < record->first_path + record->n_paths; i++) {
+        component->observed_paths = g_list_append (component->observed_paths,
+                    bus_registry_cache_new_observed_path (cache, &cache->paths[i]));
+    }
+
+    return component;
+}
+
+gint
+bus_registry_cache_lookup_component (BusRegistryCache *cache,
+                                     const gchar      *name)
+{
+    g_assert (cache);
+    g_assert (name);
+
+    return (gint) GPOINTER_TO_UINT (g_hash_table_lookup (cache->component_table, name)) - 1;
+}
+
+gint
+bus_registry_cache_lookup_engine (BusRegistryCache *cache,
+                                  const gchar      *name)
+{
+    g_assert (cache);
+    g_assert (name);
+
+    return (gint) GPOINTER_TO_UINT (g_hash_table_lookup (cache->engine_table, name)) - 1;
+}
+
+guint
+bus_registry_cache_get_n_engines (BusRegistryCache *cache)
+{
+    g_assert (cache);
+
+    return cache->header->n_engines;
+}
+
+const gchar *
+bus_registry_cache_get_engine_language (BusRegistryCache *cache,
+                                        guint             index)
+{
+    g_assert (cache);
+    g_assert (index < cache->header->n_engines);
+
+    return CACHE_STRING (cache, cache->engines[index].language);
+}
+
+guint
+bus_registry_cache_get_engine_component (BusRegistryCache *cache,
+                                         guint             index)
+{
+    g_assert (cache);
+    g_assert (index < cache->header->n_engines);
+
+    return cache->engines[index].component;
+}
+
+typedef struct {
+    GString    *strings;
+    GHashTable *offsets;
+} StringTable;
+
+static guint32
+_string_table_add (StringTable *table,
+                   const gchar *str)
+{
+    gpointer offset;
+
+    if (str == NULL)
+        return 0;
+
+    if (g_hash_table_lookup_extended (table->offsets, str, NULL, &offset))
+        return GPOINTER_TO_UINT (offset);
+
+    offset = GUINT_TO_POINTER (table->strings->len);
+    g_string_append_len (table->strings, str, strlen (str) + 1);
+    g_hash_table_insert (table->offsets, (gpointer) str, offset);
+
+    return GPOINTER_TO_UINT (offset);
+}
+
+static void
+_append_path (GArray           *paths,
+              StringTable      *table,
+              IBusObservedPath *path)
+{
+    PathRecord record = { 0 };
+
+    record.mtime = path->mtime;
+    record.path = _string_table_add (table, path->path);
+    record.flags = (path->is_dir ? PATH_IS_DIR : 0) |
+                   (path->is_exist ? PATH_IS_EXIST : 0);
+    g_array_append_val (paths, record);
+}
+
+gboolean
+bus_registry_cache_save (const gchar *filename,
+                         GList       *observed_paths,
+                         GList       *components)
+{
+    g_assert (filename);
+
+    StringTable table;
+    GArray *paths;
+    GArray *component_records;
+    GArray *engine_records;
+    CacheHeader header = { 0 };
+    GString *output;
+    GError *error = NULL;
+    GList *p, *p1;
+    gboolean retval;
+
+    table.strings = g_string_new ("");
+    g_string_append_len (table.strings, "", 1);
+    table.offsets = g_hash_table_new (g_str_hash, g_str_equal);
+
+    paths = g_array_new (FALSE, FALSE, sizeof (PathRecord));
+    component_records = g_array_new (FALSE, FALSE, sizeof (ComponentRecord));
+    engine_records = g_array_new (FALSE, FALSE, sizeof (EngineRecord));
+
+    for (p = observed_paths; p != NULL; p = p->next) {
+        _append_path (paths, &table, (IBusObservedPath *) p->data);
+    }
+    header.n_registry_paths = paths->len;
+
+    for (p = components; p != NULL; p = p->next) {
+        IBusComponent *component = (IBusComponent *) p->data;
+        ComponentRecord record = { 0 };
+
+        record.name = _string_table_add (&table, component->name);
+        record.description = _string_table_add (&table, component->description);
+        record.version = _string_table_add (&table, component->version);
+        record.license = _string_table_add (&table, component->license);
+        record.author = _string_table_add (&table, component->author);
+        record.homepage = _string_table_add (&table, component->homepage);
+        record.exec = _string_table_add (&table, component->exec);
+        record.textdomain = _string_table_add (&table, component->textdomain);
+
+        record.first_engine = engine_records->len;
+        for (p1 = component->engines; p1 != NULL; p1 = p1->next) {
+            IBusEngineDesc *desc = (IBusEngineDesc *) p1->data;
+            EngineRecord engine = { 0 };
+
+            engine.name = _string_table_add (&table, desc->name);
+            engine.longname = _string_table_add (&table, desc->longname);
+            engine.description = _string_table_add (&table, desc->description);
+            engine.language = _string_table_add (&table, desc->language);
+            engine.license = _string_table_add (&table, desc->license);
+            engine.author = _string_table_add (&table, desc->author);
+            engine.icon = _string_table_add (&table, desc->icon);
+            engine.layout = _string_table_add (&table, desc->layout);
+            engine.rank = desc->rank;
+            engine.flags = desc->shared ? ENGINE_IS_SHARED : 0;
+            engine.component = component_records->len;
+            g_array_append_val (engine_records, engine);
+        }
+        record.n_engines = engine_records->len - record.first_engine;
+
+        record.first_path = paths->len;
+        for (p1 = component->observed_paths; p1 != NULL; p1 = p1->next) {
+            _append_path (paths, &table, (IBusObservedPath *) p1->data);
+        }
+        record.n_paths = paths->len - record.first_path;
+
+        g_array_append_val (component_records, record);
+    }
+
+    header.magic = REGISTRY_CACHE_MAGIC;
+    header.version = REGISTRY_CACHE_VERSION;
+    header.n_paths = paths->len;
+    header.paths = sizeof (CacheHeader);
+    header.n_components = component_records->len;
+    header.components = header.paths + paths->len * sizeof (PathRecord);
+    header.n_engines = engine_records->len;
+    header.engines = header.components + component_records->len * sizeof (ComponentRecord);
+    header.strings = header.engines + engine_records->len * sizeof (EngineRecord);
+    header.strings_size = table.strings->len;
+    header.size = header.strings + header.strings_size;
+
+    output = g_string_sized_new (header.size);
+    g_string_append_len (output, (const gchar *) &header, sizeof (header));
+    g_string_append_len (output, paths->data, paths->len * sizeof (PathRecord));
+    g_string_append_len (output, component_records->data,
+                         component_records->len * sizeof (ComponentRecord));
+    g_string_append_len (output, engine_records->data,
+                         engine_records->len * sizeof (EngineRecord));
+    g_string_append_len (output, table.strings->str, table.strings->len);
+
+    /* g_file_set_contents replaces the file atomically, so a running
+     * daemon which has the old file mapped is not affected */
+    retval = g_file_set_contents (filename, output->str, output->len, &error);
+    if (!retval) {
+        g_warning ("create %s failed: %s", filename, error->message);
+        g_error_free (error);
+    }
+
+    g_string_free (output, TRUE);
+    g_array_free (paths, TRUE);
+    g_array_free (component_records, TRUE);
+    g_array_free (engine_records, TRUE);
+    g_hash_table_destroy (table.offsets);
+    g_string_free (table.strings, TRUE);
+
+    return retval;
+}
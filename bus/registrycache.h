@@ -0,0 +1,67 @@
+/* vim:set et sts=4: */
+/* bus - The Input Bus
+ * Copyright (C) 2008-2009 Huang Peng <shawn.p.huang@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __REGISTRY_CACHE_H_
+#define __REGISTRY_CACHE_H_
+
+#include <ibus.h>
+
+/*
+ * BusRegistryCache is a read only view of the binary registry cache.
+ * The file is mapped into memory; components and engines are only
+ * turned into objects when they are asked for.
+ */
+
+G_BEGIN_DECLS
+
+typedef struct _BusRegistryCache BusRegistryCache;
+
+BusRegistryCache
+                *bus_registry_cache_new_from_file
+                                                (const gchar        *filename);
+void             bus_registry_cache_free        (BusRegistryCache   *cache);
+gboolean         bus_registry_cache_save        (const gchar        *filename,
+                                                 GList              *observed_paths,
+                                                 GList              *components);
+gboolean         bus_registry_cache_check_modification
+                                                (BusRegistryCache   *cache);
+GList           *bus_registry_cache_new_observed_paths
+                                                (BusRegistryCache   *cache);
+guint            bus_registry_cache_get_n_components
+                                                (BusRegistryCache   *cache);
+IBusComponent   *bus_registry_cache_new_component
+                                                (BusRegistryCache   *cache,
+                                                 guint               index);
+gint             bus_registry_cache_lookup_component
+                                                (BusRegistryCache   *cache,
+                                                 const gchar        *name);
+gint             bus_registry_cache_lookup_engine
+                                                (BusRegistryCache   *cache,
+                                                 const gchar        *name);
+guint            bus_registry_cache_get_n_engines
+                                                (BusRegistryCache   *cache);
+const gchar     *bus_registry_cache_get_engine_language
+                                                (BusRegistryCache   *cache,
+                                                 guint               index);
+guint            bus_registry_cache_get_engine_component
+                                                (BusRegistryCache   *cache,
+                                                 guint               index);
+
+G_END_DECLS
+#endif
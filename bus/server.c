@@ -26,6 +26,7 @@
 #include "connection.h"
 #include "dbusimpl.h"
 #include "ibusimpl.h"
+#include "ioworker.h"
 
 /* functions prototype */
 static void      bus_server_class_init  (BusServerClass     *klass);
@@ -145,6 +146,7 @@ bus_server_new_connection (BusServer     *server,
                            BusConnection *connection)
 {
     g_assert (BUS_IS_SERVER (server));
+    bus_io_workers_add (connection);
     bus_dbus_impl_new_connection (server->dbus, connection);
 }
 
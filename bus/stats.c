@@ -0,0 +1,451 @@
+/* vim:set et sts=4: */
+/* bus - The Input Bus
+ * Copyright (C) 2008-2009 Huang Peng <shawn.p.huang@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "stats.h"
+
+enum {
+    STAGE_DISPATCH,
+    STAGE_FILTER,
+    STAGE_ENGINE,
+    STAGE_REPLY,
+    STAGE_TOTAL,
+    N_STAGES,
+};
+
+static const gchar *stage_names[N_STAGES] = {
+    "dispatch",     /* connection to input context */
+    "filter",       /* keyboard shortcuts */
+    "engine",       /* engine round trip */
+    "reply",        /* engine reply to client reply */
+    "total",
+};
+
+static gint64 start_time = 0;
+static gint64 received_time = 0;
+
+/* byte and allocation counters cost more, they need --stats */
+static gboolean details = FALSE;
+
+static guint64 n_messages_received = 0;
+static guint64 n_messages_sent = 0;
+static guint64 n_bytes_received = 0;
+static guint64 n_bytes_sent = 0;
+/* the I/O threads allocate too */
+static volatile gint n_allocations = 0;
+
+static BusHistogram stages[N_STAGES];
+/* name -> BusHistogram */
+static GHashTable *clients = NULL;
+static GHashTable *engines = NULL;
+
+static GSList *report_funcs = NULL;
+
+static gint signal_pipe[2] = { -1, -1 };
+
+gint64
+bus_stats_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (gint64) ts.tv_sec * G_GINT64_CONSTANT (1000000) + ts.tv_nsec / 1000;
+}
+
+static guint
+_histogram_index (guint64 value)
+{
+    guint shift;
+
+    if (value < BUS_HISTOGRAM_SUB_BUCKETS * 2)
+        return (guint) value;
+
+    if (value >= (guint64) BUS_HISTOGRAM_SUB_BUCKETS * 2 << BUS_HISTOGRAM_MAX_SHIFT)
+        return BUS_HISTOGRAM_N_BUCKETS - 1;
+
+    /* value >> shift is in [SUB_BUCKETS, 2 * SUB_BUCKETS) */
+    shift = g_bit_storage ((gulong) value) - g_bit_storage (BUS_HISTOGRAM_SUB_BUCKETS);
+
+    return BUS_HISTOGRAM_SUB_BUCKETS * shift + (guint) (value >> shift);
+}
+
+/* the highest value which falls into bucket index */
+static guint64
+_histogram_value (guint index)
+{
+    guint shift;
+
+    if (index < BUS_HISTOGRAM_SUB_BUCKETS * 2)
+        return index;
+
+    shift = index / BUS_HISTOGRAM_SUB_BUCKETS - 1;
+    return (((guint64) (index % BUS_HISTOGRAM_SUB_BUCKETS + BUS_HISTOGRAM_SUB_BUCKETS) + 1) << shift) - 1;
+}
+
+void
+bus_histogram_record (BusHistogram *histogram,
+                      gint64        value)
+{
+    g_assert (histogram != NULL);
+
+    if (value < 0)
+        value = 0;
+
+    histogram->count ++;
+    histogram->sum += value;
+    if ((guint64) value > histogram->max)
+        histogram->max = value;
+    histogram->buckets[_histogram_index (value)] ++;
+}
+
+guint64
+bus_histogram_get_percentile (const BusHistogram *histogram,
+                              gdouble             percentile)
+{
+    gdouble r;
+    guint64 rank;
+    guint64 seen = 0;
+    guint i;
+
+    g_assert (histogram != NULL);
+
+    if (histogram->count == 0)
+        return 0;
+
+    /* nearest rank */
+    r = percentile * histogram->count / 100;
+    rank = (guint64) r;
+    if (rank < r)
+        rank ++;
+    rank = CLAMP (rank, 1, histogram->count);
+
+    /* the last bucket also holds everything above its range */
+    for (i = 0; i < BUS_HISTOGRAM_N_BUCKETS - 1; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank)
+            return MIN (_histogram_value (i), histogram->max);
+    }
+
+    return histogram->max;
+}
+
+static BusHistogram *
+_lookup_histogram (GHashTable  **table,
+                   const gchar  *name)
+{
+    BusHistogram *histogram;
+
+    if (*table == NULL)
+        *table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    histogram = (BusHistogram *) g_hash_table_lookup (*table, name);
+    if (histogram == NULL) {
+        histogram = g_new0 (BusHistogram, 1);
+        g_hash_table_insert (*table, g_strdup (name), histogram);
+    }
+
+    return histogram;
+}
+
+static gpointer
+_counting_malloc (gsize n_bytes)
+{
+    g_atomic_int_inc (&n_allocations);
+    return malloc (n_bytes);
+}
+
+static gpointer
+_counting_realloc (gpointer mem,
+                   gsize    n_bytes)
+{
+    if (mem == NULL)
+        g_atomic_int_inc (&n_allocations);
+    return realloc (mem, n_bytes);
+}
+
+static gpointer
+_counting_calloc (gsize n_blocks,
+                  gsize n_block_bytes)
+{
+    g_atomic_int_inc (&n_allocations);
+    return calloc (n_blocks, n_block_bytes);
+}
+
+static GMemVTable counting_vtable = {
+    _counting_malloc,
+    _counting_realloc,
+    free,
+    _counting_calloc,
+    _counting_malloc,
+    _counting_realloc,
+};
+
+void
+bus_stats_enable_details (void)
+{
+    /* must run before glib allocates anything */
+    g_mem_set_vtable (&counting_vtable);
+    details = TRUE;
+}
+
+static guint64
+_message_size (IBusMessage *message)
+{
+    gchar *data;
+    gint len;
+
+    if (!dbus_message_marshal (message, &data, &len))
+        return 0;
+
+    dbus_free (data);
+    return len;
+}
+
+void
+bus_stats_message_received (IBusMessage *message)
+{
+    received_time = bus_stats_now ();
+    if (start_time == 0)
+        start_time = received_time;
+
+    n_messages_received ++;
+    if (details)
+        n_bytes_received += _message_size (message);
+}
+
+void
+bus_stats_message_sent (IBusMessage *message)
+{
+    n_messages_sent ++;
+    if (details)
+        n_bytes_sent += _message_size (message);
+}
+
+gint64
+bus_stats_get_received_time (void)
+{
+    return received_time;
+}
+
+void
+bus_stats_key_timing_start (BusKeyTiming *timing,
+                            gboolean      from_message)
+{
+    g_assert (timing != NULL);
+
+    memset (timing, 0, sizeof (BusKeyTiming));
+    timing->dispatched = bus_stats_now ();
+
+    /* keys from the key ring have no message */
+    if (from_message && received_time != 0)
+        timing->received = received_time;
+    else
+        timing->received = timing->dispatched;
+}
+
+void
+bus_stats_key_done (BusKeyTiming *timing,
+                    const gchar  *client,
+                    const gchar  *engine)
+{
+    gint64 now;
+
+    g_assert (timing != NULL);
+
+    now = bus_stats_now ();
+
+    bus_histogram_record (&stages[STAGE_DISPATCH], timing->dispatched - timing->received);
+
+    if (timing->filtered != 0) {
+        bus_histogram_record (&stages[STAGE_FILTER], timing->filtered - timing->dispatched);
+    }
+
+    if (timing->engine_sent != 0 && timing->engine_replied != 0) {
+        gint64 round_trip = timing->engine_replied - timing->engine_sent;
+
+        bus_histogram_record (&stages[STAGE_ENGINE], round_trip);
+        bus_histogram_record (&stages[STAGE_REPLY], now - timing->engine_replied);
+        if (engine != NULL) {
+            bus_histogram_record (_lookup_histogram (&engines, engine), round_trip);
+        }
+    }
+
+    bus_histogram_record (&stages[STAGE_TOTAL], now - timing->received);
+    if (client != NULL) {
+        bus_histogram_record (_lookup_histogram (&clients, client), now - timing->received);
+    }
+}
+
+static void
+_append_histogram (GString            *string,
+                   const gchar        *kind,
+                   const gchar        *name,
+                   const BusHistogram *histogram)
+{
+    g_string_append_printf (string,
+                            "%-8s %-24s %10" G_GUINT64_FORMAT
+                            " %10" G_GUINT64_FORMAT
+                            " %10" G_GUINT64_FORMAT
+                            " %10" G_GUINT64_FORMAT
+                            " %10" G_GUINT64_FORMAT
+                            " %10" G_GUINT64_FORMAT "\n",
+                            kind,
+                            name,
+                            histogram->count,
+                            bus_histogram_get_percentile (histogram, 50),
+                            bus_histogram_get_percentile (histogram, 90),
+                            bus_histogram_get_percentile (histogram, 99),
+                            bus_histogram_get_percentile (histogram, 99.9),
+                            histogram->max);
+}
+
+static void
+_append_table (GString     *string,
+               const gchar *kind,
+               GHashTable  *table)
+{
+    GList *names, *p;
+
+    if (table == NULL)
+        return;
+
+    names = g_list_sort (g_hash_table_get_keys (table), (GCompareFunc) g_strcmp0);
+    for (p = names; p != NULL; p = p->next) {
+        _append_histogram (string,
+                           kind,
+                           (const gchar *) p->data,
+                           (const BusHistogram *) g_hash_table_lookup (table, p->data));
+    }
+    g_list_free (names);
+}
+
+gchar *
+bus_stats_to_string (void)
+{
+    GString *string;
+    GSList *p;
+    gint i;
+
+    string = g_string_new ("");
+
+    g_string_append_printf (string,
+                            "uptime: %" G_GINT64_FORMAT " s\n",
+                            start_time ? (bus_stats_now () - start_time) / 1000000 : 0);
+    g_string_append_printf (string,
+                            "messages: %" G_GUINT64_FORMAT " received, %" G_GUINT64_FORMAT " sent\n",
+                            n_messages_received, n_messages_sent);
+    if (details) {
+        g_string_append_printf (string,
+                                "bytes: %" G_GUINT64_FORMAT " received, %" G_GUINT64_FORMAT " sent\n",
+                                n_bytes_received, n_bytes_sent);
+        g_string_append_printf (string,
+                                "allocations: %u\n",
+                                (guint) g_atomic_int_get (&n_allocations));
+    }
+
+    g_string_append_printf (string,
+                            "%-8s %-24s %10s %10s %10s %10s %10s %10s\n",
+                            "latency", "(us)", "count", "p50", "p90", "p99", "p99.9", "max");
+    for (i = 0; i < N_STAGES; i++) {
+        _append_histogram (string, "stage", stage_names[i], &stages[i]);
+    }
+    _append_table (string, "client", clients);
+    _append_table (string, "engine", engines);
+
+    for (p = report_funcs; p != NULL; p = p->next) {
+        ((BusStatsReportFunc) p->data) (string);
+    }
+
+    return g_string_free (string, FALSE);
+}
+
+void
+bus_stats_add_report_func (BusStatsReportFunc func)
+{
+    g_assert (func != NULL);
+
+    report_funcs = g_slist_append (report_funcs, (gpointer) func);
+}
+
+static void
+_signal_handler (gint signum)
+{
+    gint saved_errno = errno;
+
+    /* only async-signal-safe calls here, the main loop does the rest */
+    if (write (signal_pipe[1], "", 1) < 0) {
+        /* the pipe is full, a dump is pending anyway */
+    }
+
+    errno = saved_errno;
+}
+
+static gboolean
+_signal_pipe_cb (GIOChannel   *channel,
+                 GIOCondition  condition,
+                 gpointer      user_data)
+{
+    gchar buf[16];
+    gchar *report;
+
+    while (read (signal_pipe[0], buf, sizeof (buf)) > 0);
+
+    report = bus_stats_to_string ();
+    g_printerr ("%s", report);
+    g_free (report);
+
+    return TRUE;
+}
+
+void
+bus_stats_dump_on_signal (gint signum)
+{
+    struct sigaction action;
+    GIOChannel *channel;
+    gint i;
+
+    if (signal_pipe[0] < 0) {
+        if (pipe (signal_pipe) < 0) {
+            g_warning ("Can not create pipe: %s", g_strerror (errno));
+            return;
+        }
+
+        for (i = 0; i < 2; i++) {
+            fcntl (signal_pipe[i], F_SETFL, O_NONBLOCK);
+            fcntl (signal_pipe[i], F_SETFD, FD_CLOEXEC);
+        }
+
+        channel = g_io_channel_unix_new (signal_pipe[0]);
+        g_io_add_watch (channel, G_IO_IN, (GIOFunc) _signal_pipe_cb, NULL);
+        g_io_channel_unref (channel);
+    }
+
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = _signal_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset (&action.sa_mask);
+    sigaction (signum, &action, NULL);
+}
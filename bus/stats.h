@@ -0,0 +1,81 @@
+/* vim:set et sts=4: */
+/* bus - The Input Bus
+ * Copyright (C) 2008-2009 Huang Peng <shawn.p.huang@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __STATS_H_
+#define __STATS_H_
+
+#include <ibus.h>
+
+/*
+ * Counters and latency histograms of the daemon. Key events are timed at
+ * each stage between the client connection and the reply; the report is
+ * returned by GetStats and, with --stats, dumped on SIGUSR1.
+ */
+
+/* log-linear buckets: 16 per power of two, about 6% error up to 268 s */
+#define BUS_HISTOGRAM_SUB_BUCKETS   (16)
+#define BUS_HISTOGRAM_MAX_SHIFT     (23)
+#define BUS_HISTOGRAM_N_BUCKETS     (BUS_HISTOGRAM_SUB_BUCKETS * (BUS_HISTOGRAM_MAX_SHIFT + 2))
+
+G_BEGIN_DECLS
+
+typedef struct _BusHistogram BusHistogram;
+typedef struct _BusKeyTiming BusKeyTiming;
+
+/* appends more lines to the report */
+typedef void (* BusStatsReportFunc) (GString *report);
+
+/* values are microseconds */
+struct _BusHistogram {
+    guint64 count;
+    guint64 sum;
+    guint64 max;
+    guint32 buckets[BUS_HISTOGRAM_N_BUCKETS];
+};
+
+/* monotonic timestamps of one key event, 0 for stages it skipped */
+struct _BusKeyTiming {
+    gint64 received;
+    gint64 dispatched;
+    gint64 filtered;
+    gint64 engine_sent;
+    gint64 engine_replied;
+};
+
+gint64           bus_stats_now                  (void);
+void             bus_stats_enable_details       (void);
+void             bus_stats_dump_on_signal       (gint                signum);
+void             bus_stats_message_received     (IBusMessage        *message);
+void             bus_stats_message_sent         (IBusMessage        *message);
+gint64           bus_stats_get_received_time    (void);
+void             bus_stats_key_timing_start     (BusKeyTiming       *timing,
+                                                 gboolean            from_message);
+void             bus_stats_key_done             (BusKeyTiming       *timing,
+                                                 const gchar        *client,
+                                                 const gchar        *engine);
+gchar           *bus_stats_to_string            (void);
+void             bus_stats_add_report_func      (BusStatsReportFunc  func);
+
+void             bus_histogram_record           (BusHistogram       *histogram,
+                                                 gint64              value);
+guint64          bus_histogram_get_percentile   (const BusHistogram *histogram,
+                                                 gdouble             percentile);
+
+G_END_DECLS
+#endif
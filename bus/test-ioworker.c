@@ -0,0 +1,193 @@
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "ioworker.h"
+
+#define N_WORKERS		2
+#define N_CONNECTIONS	200
+#define N_CALLS			20
+#define N_SIGNALS		20
+#define TEST_PATH		"/org/freedesktop/IBus/Test"
+#define TEST_INTERFACE	"org.freedesktop.IBus.Test"
+
+/* Clients connect, send and disconnect, often with replies and signals
+ * still queued for them, while the I/O threads read and write the
+ * sockets and the main thread sends. It crashes or hangs if the glue
+ * of the I/O threads races with the main thread. */
+
+static guint n_connections = 0;
+static guint n_destroyed = 0;
+static gboolean client_done = FALSE;
+static GMainLoop *loop;
+
+static gboolean
+_echo_cb (IBusConnection *connection,
+		  IBusMessage	 *message,
+		  gpointer		  user_data)
+{
+	IBusMessage *reply;
+	gint i;
+
+	if (!ibus_message_is_method_call (message, TEST_INTERFACE, "Echo"))
+		return FALSE;
+
+	/* toggles the write watch while the I/O thread may be writing */
+	for (i = 0; i < N_SIGNALS; i++) {
+		ibus_connection_send_signal (connection,
+									 TEST_PATH,
+									 TEST_INTERFACE,
+									 "Ping",
+									 G_TYPE_INT, &i,
+									 G_TYPE_INVALID);
+	}
+
+	reply = ibus_message_new_method_return (message);
+	ibus_connection_send (connection, reply);
+	ibus_message_unref (reply);
+
+	return TRUE;
+}
+
+static void
+_connection_destroy_cb (BusConnection *connection,
+						gpointer	   user_data)
+{
+	n_destroyed ++;
+	g_object_unref (connection);
+
+	if (client_done && n_destroyed == n_connections)
+		g_main_loop_quit (loop);
+}
+
+static void
+_new_connection_cb (IBusServer	   *server,
+					IBusConnection *connection,
+					gpointer		user_data)
+{
+	n_connections ++;
+	g_object_ref (connection);
+	g_signal_connect (connection, "destroy", (GCallback) _connection_destroy_cb, NULL);
+	ibus_connection_register_object_path (connection, TEST_PATH, _echo_cb, NULL);
+
+	bus_io_workers_add ((BusConnection *) connection);
+}
+
+static void
+_client_exit_cb (GPid	  pid,
+				 gint	  status,
+				 gpointer user_data)
+{
+	g_assert (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+
+	client_done = TRUE;
+	if (n_destroyed == n_connections)
+		g_main_loop_quit (loop);
+}
+
+static gboolean
+_timeout_cb (gpointer user_data)
+{
+	g_error ("Timed out with %u of %u connections destroyed",
+			 n_destroyed, n_connections);
+	return FALSE;
+}
+
+static IBusMessage *
+new_echo (void)
+{
+	return ibus_message_new_method_call (NULL, TEST_PATH, TEST_INTERFACE, "Echo");
+}
+
+static void
+run_client (const gchar *address)
+{
+	IBusConnection *connection;
+	IBusMessage *message;
+	IBusMessage *reply;
+	IBusError *error = NULL;
+	gint i, j;
+
+	g_type_init ();
+
+	for (i = 0; i < N_CONNECTIONS; i++) {
+		connection = NULL;
+		for (j = 0; j < 100 && connection == NULL; j++) {
+			connection = ibus_connection_open_private (address);
+			if (connection == NULL)
+				g_usleep (10000);
+		}
+		if (connection == NULL)
+			_exit (1);
+
+		for (j = 0; j < N_CALLS; j++) {
+			message = new_echo ();
+			ibus_connection_send (connection, message);
+			ibus_message_unref (message);
+		}
+
+		/* a round trip on every other connection, the others go away
+		 * before their calls are answered */
+		if (i % 2 == 0) {
+			message = new_echo ();
+			reply = ibus_connection_send_with_reply_and_block (connection, message, 5000, &error);
+			ibus_message_unref (message);
+			if (reply == NULL)
+				_exit (2);
+			ibus_message_unref (reply);
+		}
+		else {
+			ibus_connection_flush (connection);
+		}
+
+		ibus_connection_close (connection);
+		g_object_unref (connection);
+	}
+
+	_exit (0);
+}
+
+int
+main (gint argc, gchar **argv)
+{
+	gchar dir[] = "/tmp/ibus-test-XXXXXX";
+	gchar *address;
+	IBusServer *server;
+	pid_t pid;
+
+	if (mkdtemp (dir) == NULL) {
+		g_warning ("Can not create %s", dir);
+		return 1;
+	}
+	address = g_strdup_printf ("unix:abstract=%s", dir);
+
+	/* fork before any thread exists */
+	pid = fork ();
+	if (pid == 0) {
+		run_client (address);
+	}
+
+	g_thread_init (NULL);
+	dbus_threads_init_default ();
+	g_type_init ();
+
+	g_assert (bus_io_workers_start (N_WORKERS));
+
+	server = g_object_new (IBUS_TYPE_SERVER,
+						   "connection-type", BUS_TYPE_CONNECTION,
+						   NULL);
+	g_assert (ibus_server_listen (server, address));
+	g_signal_connect (server, "new-connection", (GCallback) _new_connection_cb, NULL);
+
+	loop = g_main_loop_new (NULL, FALSE);
+	g_child_watch_add (pid, _client_exit_cb, NULL);
+	g_timeout_add (60000, _timeout_cb, NULL);
+	g_main_loop_run (loop);
+
+	g_assert (n_connections == N_CONNECTIONS);
+
+	rmdir (dir);
+	g_free (address);
+
+	return 0;
+}
@@ -36,5 +36,47 @@ main(gint argc, gchar **argv)
 	g_object_unref (rule);
 	g_object_unref (rule1);
 
+	/* the index summary rejects messages no rule can match */
+	BusMatchRuleIndex *index;
+	IBusMessage *message;
+
+	index = bus_match_rule_index_new ();
+	rule = bus_match_rule_new ("type='signal',"
+							   "interface='org.freedesktop.DBus',"
+							   "member='NameOwnerChanged'");
+	message = ibus_message_new_signal ("/org/freedesktop/DBus",
+									   "org.freedesktop.DBus",
+									   "NameOwnerChanged");
+	g_assert (!bus_match_rule_index_may_match (index, message));
+
+	bus_match_rule_index_add (index, rule);
+	g_assert (bus_match_rule_index_may_match (index, message));
+	ibus_message_unref (message);
+
+	message = ibus_message_new_signal ("/org/freedesktop/IBus/InputContext_1",
+									   "org.freedesktop.IBus.InputContext",
+									   "CommitText");
+	g_assert (!bus_match_rule_index_may_match (index, message));
+
+	/* a rule without interface and member may match anything of its type */
+	rule1 = bus_match_rule_new ("type='signal'");
+	bus_match_rule_index_add (index, rule1);
+	g_assert (bus_match_rule_index_may_match (index, message));
+	bus_match_rule_index_remove (index, rule1);
+	g_assert (!bus_match_rule_index_may_match (index, message));
+	ibus_message_unref (message);
+
+	message = ibus_message_new_method_call ("org.freedesktop.DBus",
+											"/org/freedesktop/DBus",
+											"org.freedesktop.DBus",
+											"NameOwnerChanged");
+	g_assert (!bus_match_rule_index_may_match (index, message));
+	ibus_message_unref (message);
+
+	bus_match_rule_index_remove (index, rule);
+	bus_match_rule_index_free (index);
+	g_object_unref (rule);
+	g_object_unref (rule1);
+
 	return 0;
 }
@@ -0,0 +1,166 @@
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "registry.h"
+
+#define TEST_COMPONENT	"org.freedesktop.IBus.TestReload"
+#define TEST_ENGINE		"test-reload"
+#define TEST_LAUNCH_TIMEOUT	100
+
+/* A component file changes while the process of the component is being
+ * started. The component replacing it must take over the launch instead
+ * of starting a second process. */
+
+/* defined in main.c of the daemon */
+gchar **g_argv = NULL;
+gboolean g_rescan = TRUE;
+
+static BusRegistry *registry;
+static GMainLoop *loop;
+static guint n_started = 0;
+static gchar *sleep_path;
+
+static void
+write_component (const gchar *filename,
+				 const gchar *longname)
+{
+	gchar *contents;
+
+	/* the process never owns the bus name, so the launch times out */
+	contents = g_strdup_printf (
+		"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+		"<component>\n"
+		"	<name>" TEST_COMPONENT "</name>\n"
+		"	<description>Test component</description>\n"
+		"	<exec>%s 30</exec>\n"
+		"	<version>1.0</version>\n"
+		"	<author>Nobody</author>\n"
+		"	<license>GPL</license>\n"
+		"	<homepage></homepage>\n"
+		"	<engines>\n"
+		"		<engine>\n"
+		"			<name>" TEST_ENGINE "</name>\n"
+		"			<longname>%s</longname>\n"
+		"			<description>Test engine</description>\n"
+		"			<language>zh_CN</language>\n"
+		"			<license>GPL</license>\n"
+		"			<author>Nobody</author>\n"
+		"			<icon></icon>\n"
+		"			<layout>us</layout>\n"
+		"		</engine>\n"
+		"	</engines>\n"
+		"</component>\n",
+		sleep_path, longname);
+	g_assert (g_file_set_contents (filename, contents, -1, NULL));
+	g_free (contents);
+}
+
+static void
+_started_cb (gpointer factory,
+			 gpointer user_data)
+{
+	g_assert (factory == NULL);
+
+	n_started ++;
+	if (n_started == 2)
+		g_main_loop_quit (loop);
+}
+
+static gboolean
+_timeout_cb (gpointer user_data)
+{
+	g_error ("Timed out");
+	return FALSE;
+}
+
+int
+main (gint argc, gchar **argv)
+{
+	IBusEngineDesc *desc;
+	IBusComponent *old;
+	IBusComponent *component;
+	gchar *dirname;
+	gchar *cachedir;
+	gchar *componentdir;
+	gchar *filename;
+
+	g_type_init ();
+
+	sleep_path = g_find_program_in_path ("sleep");
+	g_assert (sleep_path != NULL);
+
+	dirname = g_build_filename (g_get_tmp_dir (), "ibus-test-registry-XXXXXX", NULL);
+	g_assert (mkdtemp (dirname) != NULL);
+	cachedir = g_build_filename (dirname, "cache", NULL);
+	componentdir = g_build_filename (dirname, ".ibus", "component", NULL);
+	g_assert (g_mkdir_with_parents (componentdir, 0755) == 0);
+	filename = g_build_filename (componentdir, "test.xml", NULL);
+
+	g_setenv ("HOME", dirname, TRUE);
+	g_setenv ("XDG_CACHE_HOME", cachedir, TRUE);
+
+	write_component (filename, "Old");
+
+	loop = g_main_loop_new (NULL, FALSE);
+	registry = bus_registry_new ();
+	bus_registry_set_launch_timeout (registry, TEST_LAUNCH_TIMEOUT);
+
+	desc = bus_registry_find_engine_by_name (registry, TEST_ENGINE);
+	g_assert (desc != NULL);
+	g_assert (g_strcmp0 (desc->longname, "Old") == 0);
+	old = ibus_component_get_from_engine (desc);
+	g_assert (old != NULL);
+
+	bus_registry_start_component_async (registry, old, (GFunc) _started_cb, NULL);
+	g_assert (ibus_component_is_running (old));
+
+	/* reload at once instead of waiting for the file monitor */
+	write_component (filename, "New");
+	bus_registry_file_changed (registry, filename);
+
+	desc = bus_registry_find_engine_by_name (registry, TEST_ENGINE);
+	g_assert (g_strcmp0 (desc->longname, "New") == 0);
+	component = ibus_component_get_from_engine (desc);
+	g_assert (component != old);
+	g_assert (bus_registry_lookup_component_by_name (registry, TEST_COMPONENT) == component);
+	g_assert (g_hash_table_lookup (registry->launches, old) == NULL);
+	g_assert (g_hash_table_lookup (registry->launches, component) != NULL);
+
+	/* waits for the running process instead of starting another one */
+	bus_registry_start_component_async (registry, component, (GFunc) _started_cb, NULL);
+	g_assert (!ibus_component_is_running (component));
+	g_assert (ibus_component_is_running (old));
+
+	/* both waiters get NULL when the launch times out */
+	g_timeout_add (TEST_LAUNCH_TIMEOUT * 50, _timeout_cb, NULL);
+	g_main_loop_run (loop);
+	g_assert (n_started == 2);
+
+	bus_registry_stop_all_components (registry);
+	g_object_unref (registry);
+	g_main_loop_unref (loop);
+
+	g_unlink (filename);
+	g_rmdir (componentdir);
+	g_free (filename);
+	filename = g_build_filename (dirname, ".ibus", NULL);
+	g_rmdir (filename);
+	g_free (filename);
+	filename = g_build_filename (cachedir, "ibus", "registry.cache", NULL);
+	g_unlink (filename);
+	g_free (filename);
+	filename = g_build_filename (cachedir, "ibus", "registry.xml", NULL);
+	g_unlink (filename);
+	g_free (filename);
+	filename = g_build_filename (cachedir, "ibus", NULL);
+	g_rmdir (filename);
+	g_free (filename);
+	g_rmdir (cachedir);
+	g_rmdir (dirname);
+	g_free (componentdir);
+	g_free (cachedir);
+	g_free (dirname);
+	g_free (sleep_path);
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+#include <glib/gstdio.h>
+#include <unistd.h>
+#include "registrycache.h"
+
+int
+main(gint argc, gchar **argv)
+{
+	IBusComponent *component;
+	IBusEngineDesc *desc;
+	BusRegistryCache *cache;
+	GList *components = NULL;
+	GList *paths = NULL;
+	gchar *dirname;
+	gchar *filename;
+	gchar *observed;
+	gchar *contents;
+	gsize length;
+	gint index;
+
+	g_type_init ();
+
+	dirname = g_strdup ("/tmp/ibus-test-registry-XXXXXX");
+	g_assert (mkdtemp (dirname) != NULL);
+	filename = g_build_filename (dirname, "registry.cache", NULL);
+	observed = g_build_filename (dirname, "component", NULL);
+	g_assert (g_mkdir (observed, 0755) == 0);
+
+	paths = g_list_append (paths, ibus_observed_path_new (observed, TRUE));
+
+	component = ibus_component_new ("org.freedesktop.IBus.Test",
+									"Test component",
+									"1.0",
+									"GPL",
+									"Nobody",
+									"",
+									"/usr/bin/true",
+									NULL);
+	ibus_component_add_engine (component,
+		ibus_engine_desc_new ("test-zh", "Test", "Test engine", "zh_CN",
+							  "GPL", "Nobody", "", "us"));
+	ibus_component_add_engine (component,
+		ibus_engine_desc_new ("test-ja", "Test", "Test engine", "ja",
+							  "GPL", "Nobody", "", "jp"));
+	((IBusEngineDesc *) g_list_last (component->engines)->data)->rank = 99;
+	((IBusEngineDesc *) g_list_last (component->engines)->data)->shared = TRUE;
+	components = g_list_append (components, component);
+
+	g_assert (bus_registry_cache_save (filename, paths, components));
+
+	cache = bus_registry_cache_new_from_file (filename);
+	g_assert (cache);
+	g_assert (bus_registry_cache_get_n_components (cache) == 1);
+	g_assert (bus_registry_cache_get_n_engines (cache) == 2);
+	g_assert (bus_registry_cache_lookup_component (cache, "org.freedesktop.IBus.Test") == 0);
+	g_assert (bus_registry_cache_lookup_component (cache, "none") == -1);
+
+	index = bus_registry_cache_lookup_engine (cache, "test-ja");
+	g_assert (index == 1);
+	g_assert (g_strcmp0 (bus_registry_cache_get_engine_language (cache, index), "ja") == 0);
+	g_assert (bus_registry_cache_get_engine_component (cache, index) == 0);
+
+	/* the cache was just written, the paths did not change */
+	g_assert (!bus_registry_cache_check_modification (cache));
+
+	component = bus_registry_cache_new_component (cache, 0);
+	g_assert (g_strcmp0 (component->name, "org.freedesktop.IBus.Test") == 0);
+	g_assert (g_strcmp0 (component->homepage, "") == 0);
+	g_assert (component->textdomain == NULL);
+	g_assert (g_list_length (component->engines) == 2);
+	desc = (IBusEngineDesc *) component->engines->next->data;
+	g_assert (g_strcmp0 (desc->name, "test-ja") == 0);
+	g_assert (g_strcmp0 (desc->layout, "jp") == 0);
+	g_assert (desc->rank == 99);
+	g_assert (desc->shared);
+	g_assert (!((IBusEngineDesc *) component->engines->data)->shared);
+	g_assert (ibus_component_get_from_engine (desc) == component);
+	g_object_unref (component);
+
+	bus_registry_cache_free (cache);
+
+	/* a truncated file is rejected */
+	g_assert (g_file_get_contents (filename, &contents, &length, NULL));
+	g_assert (g_file_set_contents (filename, contents, length - 1, NULL));
+	g_assert (bus_registry_cache_new_from_file (filename) == NULL);
+	g_free (contents);
+
+	g_unlink (filename);
+	g_rmdir (observed);
+	g_rmdir (dirname);
+	g_free (filename);
+	g_free (observed);
+	g_free (dirname);
+
+	g_list_foreach (components, (GFunc) g_object_unref, NULL);
+	g_list_free (components);
+	g_list_foreach (paths, (GFunc) g_object_unref, NULL);
+	g_list_free (paths);
+
+	return 0;
+}
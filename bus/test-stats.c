@@ -0,0 +1,55 @@
+#include <string.h>
+#include "stats.h"
+
+int
+main(gint argc, gchar **argv)
+{
+	BusHistogram histogram = { 0 };
+	BusKeyTiming timing;
+	gchar *report;
+	gint64 i;
+
+	g_type_init ();
+
+	g_assert (bus_histogram_get_percentile (&histogram, 50) == 0);
+
+	/* small values are exact */
+	for (i = 1; i <= 20; i++)
+		bus_histogram_record (&histogram, i);
+	g_assert (histogram.count == 20);
+	g_assert (histogram.sum == 210);
+	g_assert (histogram.max == 20);
+	g_assert (bus_histogram_get_percentile (&histogram, 50) == 10);
+	g_assert (bus_histogram_get_percentile (&histogram, 100) == 20);
+	g_assert (bus_histogram_get_percentile (&histogram, 0) == 1);
+
+	/* larger values are rounded up to the end of their bucket, within
+	 * 1/16 and never above the maximum */
+	memset (&histogram, 0, sizeof (histogram));
+	for (i = 0; i < 99; i++)
+		bus_histogram_record (&histogram, 1000);
+	bus_histogram_record (&histogram, 123456);
+	g_assert (bus_histogram_get_percentile (&histogram, 50) >= 1000);
+	g_assert (bus_histogram_get_percentile (&histogram, 50) <= 1000 + 1000 / 16);
+	g_assert (bus_histogram_get_percentile (&histogram, 99) <= 1000 + 1000 / 16);
+	g_assert (bus_histogram_get_percentile (&histogram, 99.9) == 123456);
+
+	/* out of range values go to the last bucket */
+	bus_histogram_record (&histogram, -1);
+	bus_histogram_record (&histogram, G_MAXINT64);
+	g_assert (bus_histogram_get_percentile (&histogram, 0) == 0);
+	g_assert (bus_histogram_get_percentile (&histogram, 100) == G_MAXINT64);
+
+	bus_stats_key_timing_start (&timing, FALSE);
+	g_assert (timing.received == timing.dispatched);
+	g_assert (timing.received <= bus_stats_now ());
+	timing.engine_sent = timing.engine_replied = bus_stats_now ();
+	bus_stats_key_done (&timing, "test-client", "test-engine");
+
+	report = bus_stats_to_string ();
+	g_assert (strstr (report, "test-client") != NULL);
+	g_assert (strstr (report, "test-engine") != NULL);
+	g_free (report);
+
+	return 0;
+}
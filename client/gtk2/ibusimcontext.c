@@ -23,6 +23,8 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/un.h>
+#include <stdlib.h>
+#include <errno.h>
 #include <ibus.h>
 #include "ibusimcontext.h"
 
@@ -46,8 +48,23 @@ struct _IBusIMContext {
     GdkRectangle     cursor_area;
     gboolean         has_focus;
 
+    /* cursor location as last sent, in root window coordinates */
+    GdkRectangle     cursor_sent;
+    guint            cursor_update_id;
+
+    /* origin of the toplevel window of client_window, kept until the
+     * toplevel moves or the widget changes its toplevel */
+    GtkWidget       *client_widget;
+    GtkWidget       *client_toplevel;
+    gint             origin_x;
+    gint             origin_y;
+    gboolean         origin_valid;
+
     gint             caps;
 
+    /* keys waiting for the engine, the head is the one sent */
+    GQueue          *key_events;
+
 };
 
 struct _IBusIMContextClass {
@@ -66,6 +83,12 @@ static const gchar * _snooper_apps [] = {
                     "xchat", "pidgin", NULL };
 #endif
 static gboolean _use_key_snooper = TRUE;
+/* milliseconds to wait for the engine before a key is given back to
+ * the application, -1 means the default dbus timeout and G_MAXINT
+ * waits forever */
+static gint     _key_event_timeout = 3000;
+/* send key events through shared memory instead of D-Bus */
+static gboolean _use_key_ring = FALSE;
 static GtkIMContext *_focus_im_context = NULL;
 
 /* functions prototype */
@@ -97,6 +120,9 @@ static void     ibus_im_context_set_use_preedit
 static void     _create_input_context       (IBusIMContext      *context);
 static void     _set_cursor_location_internal
                                             (GtkIMContext       *context);
+static void     _watch_client_window        (IBusIMContext      *context,
+                                             GdkWindow          *client);
+static void     _send_key_event             (IBusIMContext      *context);
 
 static void     _bus_connected_cb           (IBusBus            *bus,
                                              IBusIMContext      *context);
@@ -180,41 +206,181 @@ ibus_im_context_new (void)
     return obj;
 }
 
+typedef struct {
+    IBusIMContext *ibusimcontext;
+    GtkWidget *widget;
+    GdkEvent *event;
+} KeyEventData;
+
+static void
+_forward_key_event (KeyEventData *data)
+{
+    /* FORWARD_MASK keeps it from being sent to ibus again */
+    ((GdkEventKey *) data->event)->state |= IBUS_FORWARD_MASK;
+
+    /* deliver it now instead of appending it to the event queue, so it
+     * is not reordered with the keys typed after it */
+    if (data->widget == NULL) {
+        gtk_main_do_event (data->event);
+    }
+    else if (GTK_WIDGET_REALIZED (data->widget)) {
+        gtk_widget_event (data->widget, data->event);
+    }
+}
+
+static void
+_process_key_event_done_cb (IBusInputContext *ibuscontext,
+                            gboolean          handled,
+                            KeyEventData     *data)
+{
+    IBusIMContext *ibusimcontext = data->ibusimcontext;
+
+    g_assert (g_queue_peek_head (ibusimcontext->key_events) == data);
+
+    /* engine did not consume the key or did not reply in time, so give
+     * it back to the widget it was meant for. It stays at the head until
+     * then, a key typed in a nested main loop must not be sent yet. */
+    if (!handled) {
+        _forward_key_event (data);
+    }
+
+    g_queue_pop_head (ibusimcontext->key_events);
+
+    if (data->widget) {
+        g_object_unref (data->widget);
+    }
+    gdk_event_free (data->event);
+    g_slice_free (KeyEventData, data);
+
+    _send_key_event (ibusimcontext);
+    g_object_unref (ibusimcontext);
+}
+
+/* sends the head of the queue, the keys behind it wait for its reply so
+ * the commits of the engine and the keys it gives back stay in order */
+static void
+_send_key_event (IBusIMContext *ibusimcontext)
+{
+    KeyEventData *data;
+    GdkEventKey *event;
+    guint state;
+
+    data = (KeyEventData *) g_queue_peek_head (ibusimcontext->key_events);
+    if (data == NULL) {
+        return;
+    }
+
+    event = (GdkEventKey *) data->event;
+    state = event->state;
+    if (event->type == GDK_KEY_RELEASE) {
+        state |= IBUS_RELEASE_MASK;
+    }
+
+    if (ibusimcontext->ibuscontext == NULL) {
+        _process_key_event_done_cb (NULL, FALSE, data);
+        return;
+    }
+
+    /* the callback may run before this returns and send the next key */
+    ibus_input_context_process_key_event_async (ibusimcontext->ibuscontext,
+                                                event->keyval,
+                                                state,
+                                                _key_event_timeout,
+                                                (IBusInputContextKeyEventFunc) _process_key_event_done_cb,
+                                                data);
+}
+
+static gboolean
+_process_key_event (IBusIMContext *ibusimcontext,
+                    GtkWidget     *widget,
+                    GdkEventKey   *event)
+{
+    KeyEventData *data;
+
+    if (event->state & IBUS_FORWARD_MASK)
+        return FALSE;
+
+    if (event->type != GDK_KEY_PRESS && event->type != GDK_KEY_RELEASE)
+        return FALSE;
+
+    data = g_slice_new (KeyEventData);
+    data->ibusimcontext = g_object_ref (ibusimcontext);
+    data->widget = widget ? g_object_ref (widget) : NULL;
+    data->event = gdk_event_copy ((GdkEvent *) event);
+
+    g_queue_push_tail (ibusimcontext->key_events, data);
+    if (g_queue_get_length (ibusimcontext->key_events) == 1) {
+        _send_key_event (ibusimcontext);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+_process_key_event_sync (IBusIMContext *ibusimcontext,
+                         GdkEventKey   *event)
+{
+    if (event->state & IBUS_FORWARD_MASK)
+        return FALSE;
+
+    switch (event->type) {
+    case GDK_KEY_RELEASE:
+        return ibus_input_context_process_key_event (ibusimcontext->ibuscontext,
+                                                     event->keyval,
+                                                     event->state | IBUS_RELEASE_MASK);
+    case GDK_KEY_PRESS:
+        return ibus_input_context_process_key_event (ibusimcontext->ibuscontext,
+                                                     event->keyval,
+                                                     event->state);
+    default:
+        return FALSE;
+    }
+}
+
 static gint
 _key_snooper_cb (GtkWidget   *widget,
                  GdkEventKey *event,
                  gpointer     user_data)
 {
-    gboolean retval = FALSE;
-
     IBusIMContext *ibusimcontext;
     ibusimcontext = (IBusIMContext *) _focus_im_context;
 
     if (!_use_key_snooper)
-        return retval;
+        return FALSE;
 
     if (ibusimcontext == NULL)
-        return retval;
+        return FALSE;
 
     if (ibusimcontext->ibuscontext == NULL || ibusimcontext->has_focus == FALSE)
-        return retval;
+        return FALSE;
 
-    switch (event->type) {
-    case GDK_KEY_RELEASE:
-        retval = ibus_input_context_process_key_event (ibusimcontext->ibuscontext,
-                                                       event->keyval,
-                                                       event->state | IBUS_RELEASE_MASK);
-        break;
-    case GDK_KEY_PRESS:
-        retval = ibus_input_context_process_key_event (ibusimcontext->ibuscontext,
-                                                       event->keyval,
-                                                       event->state);
-        break;
-    default:
-        retval = FALSE;
-    }
+    /* the snooper runs before the event is propagated, a key given back
+     * goes through gtk_main_do_event again */
+    return _process_key_event (ibusimcontext, NULL, event);
+}
 
-    return retval;
+/* 0 waits forever like the daemon setting, a negative value takes the
+ * default dbus timeout, garbage is rejected */
+static gboolean
+_parse_key_event_timeout (const gchar *str,
+                          gint        *timeout)
+{
+    gchar *end;
+    glong value;
+
+    errno = 0;
+    value = strtol (str, &end, 10);
+    if (end == str || *end != '\0' || errno != 0 ||
+        value > G_MAXINT || value < G_MININT)
+        return FALSE;
+
+    if (value == 0)
+        *timeout = G_MAXINT;
+    else if (value < 0)
+        *timeout = -1;
+    else
+        *timeout = value;
+    return TRUE;
 }
 
 static void
@@ -269,6 +435,17 @@ ibus_im_context_class_init     (IBusIMContextClass *klass)
     }
 #endif
 
+    const gchar *timeout = g_getenv ("IBUS_KEY_EVENT_TIMEOUT");
+    if (timeout != NULL &&
+        !_parse_key_event_timeout (timeout, &_key_event_timeout)) {
+        g_warning ("Invalid IBUS_KEY_EVENT_TIMEOUT %s", timeout);
+    }
+
+    const gchar *key_ring = g_getenv ("IBUS_KEY_RING");
+    if (key_ring != NULL) {
+        _use_key_ring = atoi (key_ring) != 0;
+    }
+
     if (_use_key_snooper) {
         gtk_key_snooper_install (_key_snooper_cb, NULL);
     }
@@ -297,10 +474,19 @@ ibus_im_context_init (GObject *obj)
     ibusimcontext->cursor_area.width = 0;
     ibusimcontext->cursor_area.height = 0;
 
+    ibusimcontext->cursor_sent.width = -1;
+    ibusimcontext->cursor_update_id = 0;
+
+    ibusimcontext->client_widget = NULL;
+    ibusimcontext->client_toplevel = NULL;
+    ibusimcontext->origin_valid = FALSE;
+
     ibusimcontext->ibuscontext = NULL;
     ibusimcontext->has_focus = FALSE;
     ibusimcontext->caps = IBUS_CAP_PREEDIT_TEXT | IBUS_CAP_FOCUS;
 
+    ibusimcontext->key_events = g_queue_new ();
+
 
     // Create slave im context
     ibusimcontext->slave = gtk_im_context_simple_new ();
@@ -358,11 +544,19 @@ ibus_im_context_finalize (GObject *obj)
 
     ibus_im_context_set_client_window ((GtkIMContext *)ibusimcontext, NULL);
 
+    if (ibusimcontext->cursor_update_id != 0) {
+        g_source_remove (ibusimcontext->cursor_update_id);
+        ibusimcontext->cursor_update_id = 0;
+    }
+
     if (ibusimcontext->slave) {
         g_object_unref (ibusimcontext->slave);
         ibusimcontext->slave = NULL;
     }
 
+    /* every queued key holds a reference, so none is left */
+    g_queue_free (ibusimcontext->key_events);
+
     // release preedit
     if (ibusimcontext->preedit_string) {
         g_free (ibusimcontext->preedit_string);
@@ -384,23 +578,22 @@ ibus_im_context_filter_keypress (GtkIMContext *context,
     IBusIMContext *ibusimcontext = (IBusIMContext *) context;
 
     if (ibusimcontext->ibuscontext && ibusimcontext->has_focus) {
-        /* If context does not have focus, ibus will process key event in sync mode.
+        gboolean retval;
+
+        /* Synthetic events are processed in sync mode, their sender wants
+         * to know at once whether the key was used.
          * It is a workaround for increase search in treeview.
          */
-        gboolean retval;
-        switch (event->type) {
-        case GDK_KEY_RELEASE:
-            retval = ibus_input_context_process_key_event (ibusimcontext->ibuscontext,
-                                                           event->keyval,
-                                                           event->state | IBUS_RELEASE_MASK);
-            break;
-        case GDK_KEY_PRESS:
-            retval = ibus_input_context_process_key_event (ibusimcontext->ibuscontext,
-                                                           event->keyval,
-                                                           event->state);
-            break;
-        default:
-            retval = FALSE;
+        if (event->send_event) {
+            retval = _process_key_event_sync (ibusimcontext, event);
+        }
+        /* Keys not handled by the engine come back to the client widget
+         * with IBUS_FORWARD_MASK set and go to the slave context.
+         */
+        else {
+            retval = _process_key_event (ibusimcontext,
+                                         ibusimcontext->client_widget,
+                                         event);
         }
 
         if (retval) {
@@ -547,17 +740,87 @@ ibus_im_context_set_client_window (GtkIMContext *context, GdkWindow *client)
     }
 
     ibusimcontext->client_window = client;
+    _watch_client_window (ibusimcontext, client);
 
     if (ibusimcontext->slave)
         gtk_im_context_set_client_window (ibusimcontext->slave, client);
 }
 
+static gboolean
+_client_window_configure_cb (GtkWidget         *toplevel,
+                             GdkEventConfigure *event,
+                             IBusIMContext     *ibusimcontext)
+{
+    ibusimcontext->origin_valid = FALSE;
+    return FALSE;
+}
+
+static void
+_client_window_hierarchy_changed_cb (GtkWidget     *widget,
+                                     GtkWidget     *previous_toplevel,
+                                     IBusIMContext *ibusimcontext)
+{
+    /* the widget was reparented, maybe into another toplevel */
+    _watch_client_window (ibusimcontext, ibusimcontext->client_window);
+}
+
+/* the origin of the toplevel changes only when it moves, so it is looked
+ * up once after that instead of with an X round trip for every cursor
+ * location; the windows below it are placed by gdk, which knows where,
+ * also after scrolling */
+static void
+_watch_client_window (IBusIMContext *ibusimcontext,
+                      GdkWindow     *client)
+{
+    GtkWidget *widget = NULL;
+
+    if (ibusimcontext->client_widget) {
+        g_signal_handlers_disconnect_by_func (ibusimcontext->client_widget,
+                                              G_CALLBACK (_client_window_hierarchy_changed_cb),
+                                              ibusimcontext);
+        ibusimcontext->client_widget = NULL;
+    }
+
+    if (ibusimcontext->client_toplevel) {
+        g_signal_handlers_disconnect_by_func (ibusimcontext->client_toplevel,
+                                              G_CALLBACK (_client_window_configure_cb),
+                                              ibusimcontext);
+        ibusimcontext->client_toplevel = NULL;
+    }
+
+    ibusimcontext->origin_valid = FALSE;
+
+    if (client == NULL) {
+        return;
+    }
+
+    gdk_window_get_user_data (client, (gpointer *) &widget);
+    if (widget == NULL || !GTK_IS_WIDGET (widget)) {
+        return;
+    }
+
+    ibusimcontext->client_widget = widget;
+    g_signal_connect (widget,
+                      "hierarchy-changed",
+                      G_CALLBACK (_client_window_hierarchy_changed_cb),
+                      ibusimcontext);
+
+    /* a plug moves with its socket without a configure event */
+    widget = gtk_widget_get_toplevel (widget);
+    if (GTK_WIDGET_TOPLEVEL (widget) && !GTK_IS_PLUG (widget)) {
+        ibusimcontext->client_toplevel = widget;
+        g_signal_connect (widget,
+                          "configure-event",
+                          G_CALLBACK (_client_window_configure_cb),
+                          ibusimcontext);
+    }
+}
+
 static void
 _set_cursor_location_internal (GtkIMContext *context)
 {
     IBusIMContext *ibusimcontext = IBUS_IM_CONTEXT (context);
     GdkRectangle area;
-    gint x, y;
 
     if(ibusimcontext->client_window == NULL || ibusimcontext->ibuscontext == NULL) {
         return;
@@ -571,9 +834,45 @@ _set_cursor_location_internal (GtkIMContext *context)
         area.x = 0;
     }
 
-    gdk_window_get_origin (ibusimcontext->client_window, &x, &y);
-    area.x += x;
-    area.y += y;
+    /* without a toplevel to watch the origin can not be kept */
+    if (ibusimcontext->client_toplevel == NULL) {
+        gint x, y;
+        gdk_window_get_origin (ibusimcontext->client_window, &x, &y);
+        area.x += x;
+        area.y += y;
+    }
+    else {
+        GdkWindow *window;
+        GdkWindow *toplevel;
+        gint x, y;
+
+        toplevel = gdk_window_get_toplevel (ibusimcontext->client_window);
+        for (window = ibusimcontext->client_window;
+             window != toplevel;
+             window = gdk_window_get_parent (window)) {
+            gdk_window_get_position (window, &x, &y);
+            area.x += x;
+            area.y += y;
+        }
+
+        if (!ibusimcontext->origin_valid) {
+            gdk_window_get_origin (toplevel,
+                                   &ibusimcontext->origin_x,
+                                   &ibusimcontext->origin_y);
+            ibusimcontext->origin_valid = TRUE;
+        }
+        area.x += ibusimcontext->origin_x;
+        area.y += ibusimcontext->origin_y;
+    }
+
+    if (area.x == ibusimcontext->cursor_sent.x &&
+        area.y == ibusimcontext->cursor_sent.y &&
+        area.width == ibusimcontext->cursor_sent.width &&
+        area.height == ibusimcontext->cursor_sent.height) {
+        return;
+    }
+    ibusimcontext->cursor_sent = area;
+
     ibus_input_context_set_cursor_location (ibusimcontext->ibuscontext,
                                             area.x,
                                             area.y,
@@ -581,6 +880,14 @@ _set_cursor_location_internal (GtkIMContext *context)
                                             area.height);
 }
 
+static gboolean
+_set_cursor_location_idle_cb (IBusIMContext *ibusimcontext)
+{
+    ibusimcontext->cursor_update_id = 0;
+    _set_cursor_location_internal ((GtkIMContext *) ibusimcontext);
+    return FALSE;
+}
+
 static void
 ibus_im_context_set_cursor_location (GtkIMContext *context, GdkRectangle *area)
 {
@@ -590,7 +897,13 @@ ibus_im_context_set_cursor_location (GtkIMContext *context, GdkRectangle *area)
     IBusIMContext *ibusimcontext = IBUS_IM_CONTEXT (context);
 
     ibusimcontext->cursor_area = *area;
-    _set_cursor_location_internal (context);
+
+    /* widgets set the location on every redraw, send it once the frame
+     * is drawn */
+    if (ibusimcontext->cursor_update_id == 0) {
+        ibusimcontext->cursor_update_id =
+            g_idle_add ((GSourceFunc) _set_cursor_location_idle_cb, ibusimcontext);
+    }
     gtk_im_context_set_cursor_location (ibusimcontext->slave, area);
 }
 
@@ -813,6 +1126,9 @@ _create_input_context (IBusIMContext *ibusimcontext)
 
     g_return_if_fail (ibusimcontext->ibuscontext != NULL);
 
+    /* the new input context does not know the location yet */
+    ibusimcontext->cursor_sent.width = -1;
+
     g_signal_connect (ibusimcontext->ibuscontext,
                       "commit-text",
                       G_CALLBACK (_ibus_context_commit_text_cb),
@@ -847,6 +1163,11 @@ _create_input_context (IBusIMContext *ibusimcontext)
 
     ibus_input_context_set_capabilities (ibusimcontext->ibuscontext, ibusimcontext->caps);
 
+    /* key events keep going over D-Bus if the ring can not be set up */
+    if (_use_key_ring) {
+        ibus_input_context_open_key_ring (ibusimcontext->ibuscontext);
+    }
+
     if (ibusimcontext->has_focus) {
         ibus_input_context_focus_in (ibusimcontext->ibuscontext);
     }
@@ -26,13 +26,17 @@
 #include <QCoreApplication>
 #include <QDBusMessage>
 #include <QDBusArgument>
+#include <QDBusPendingCall>
+#include <QQueue>
 
 #include <pwd.h>
+#include <limits.h>
 
 #include "ibus-client.h"
 #include "ibus-input-context.h"
 
 #ifdef Q_WS_X11
+# include <QApplication>
 # include <QX11Info>
 # include <X11/Xlib.h>
 # include <X11/keysym.h>
@@ -47,11 +51,39 @@
 #define IBUS_PATH	"/org/freedesktop/IBus"
 #define IBUS_INTERFACE	"org.freedesktop.IBus"
 
+/* bounds how long a key event may wait for ibus */
+#define IBUS_KEY_EVENT_TIMEOUT	3000
+
+/* marks key events sent back to Qt after ibus did not handle them */
+#define IBUS_FORWARD_MASK	(1 << 25)
+
+#ifdef Q_WS_X11
+struct IBusClient::KeyEventQueue {
+	QQueue <XEvent> events;
+	/* the call for events.head (), NULL if nothing is outstanding */
+	QDBusPendingCallWatcher *watcher;
+};
+#endif
 
 IBusClient::IBusClient ()
-	: ibus (NULL), japan_groups (0)
+	: ibus (NULL), key_event_timeout (IBUS_KEY_EVENT_TIMEOUT), japan_groups (0)
 {
 	findYenBarKeys ();
+
+	QString timeout = getenv ("IBUS_KEY_EVENT_TIMEOUT");
+	if (!timeout.isEmpty ()) {
+		bool ok;
+		int value = timeout.toInt (&ok);
+		/* 0 waits forever like the daemon setting, a negative value
+		 * takes the default dbus timeout */
+		if (!ok)
+			qWarning () << "Invalid IBUS_KEY_EVENT_TIMEOUT" << timeout;
+		else if (value == 0)
+			key_event_timeout = INT_MAX;
+		else
+			key_event_timeout = value > 0 ? value : -1;
+	}
+
 	username = getlogin ();
 
 	if (username.isEmpty ())
@@ -102,6 +134,10 @@ IBusClient::IBusClient ()
 
 IBusClient::~IBusClient ()
 {
+#ifdef Q_WS_X11
+	while (!key_event_queues.isEmpty ())
+		dropKeyEvents (key_event_queues.begin ().key ());
+#endif
 	if (ibus)
 		delete ibus;
 }
@@ -236,6 +272,10 @@ IBusClient::releaseInputContext (IBusInputContext *ctx)
 
 	QString ic = ctx->getIC ();
 
+#ifdef Q_WS_X11
+	dropKeyEvents (ctx);
+#endif
+
 	if (ibus && !ic.isEmpty ()) {
 		QDBusMessage message = QDBusMessage::createMethodCall (
 								IBUS_NAME,
@@ -326,18 +366,62 @@ IBusClient::x11FilterEvent (IBusInputContext *ctx, QWidget * /* keywidget */, XE
 	// Q_ASSERT (keywidget);
 	Q_ASSERT (xevent);
 
+	if (xevent->type != KeyPress && xevent->type != KeyRelease) {
+		return false;
+	}
+
+	/* ibus has already seen this one, let Qt have it */
+	if (xevent->xkey.state & IBUS_FORWARD_MASK) {
+		xevent->xkey.state &= ~IBUS_FORWARD_MASK;
+		return false;
+	}
+
+	if (ibus == NULL || !ibus->isConnected () || ctx->getIC().isEmpty ()) {
+		return false;
+	}
+
+	/*
+	 * Queue the event and answer Qt right away. Only the head of the queue
+	 * is sent to ibus, so the engine sees keys in order; events ibus does
+	 * not handle are put back into Qt from slotProcessKeyEventDone.
+	 */
+	KeyEventQueue *queue = key_event_queues.value (ctx);
+	if (queue == NULL) {
+		queue = new KeyEventQueue;
+		queue->watcher = NULL;
+		key_event_queues.insert (ctx, queue);
+	}
+
+	queue->events.enqueue (*xevent);
+
+	if (queue->watcher == NULL) {
+		processNextKeyEvent (ctx);
+	}
+
+	return true;
+}
+
+void
+IBusClient::processNextKeyEvent (IBusInputContext *ctx)
+{
 	quint32 keyval;
 	quint32 state;
 	bool is_press;
 
-	if (ibus == NULL || !ibus->isConnected () || ctx->getIC().isEmpty ()) {
-		return false;
+	KeyEventQueue *queue = key_event_queues.value (ctx);
+
+	if (queue == NULL || queue->watcher != NULL || queue->events.isEmpty ()) {
+		return;
 	}
 
-	if (!translate_x_key_event (xevent, &keyval, &is_press, &state)) {
-		return false;
+	if (ibus == NULL || !ibus->isConnected () || ctx->getIC().isEmpty ()) {
+		flushKeyEvents (ctx);
+		return;
 	}
 
+	XEvent *xevent = &queue->events.head ();
+	translate_x_key_event (xevent, &keyval, &is_press, &state);
+
 #ifdef HAVE_XKB
 	int group = XkbGroupForCoreState (state);
 	if (keyval == XK_backslash && japan_groups & (1 << group)) {
@@ -357,15 +441,50 @@ IBusClient::x11FilterEvent (IBusInputContext *ctx, QWidget * /* keywidget */, XE
 	message << is_press;
 	message << state;
 
-	message = ibus->call (message);
+	queue->watcher = new QDBusPendingCallWatcher (
+							ibus->asyncCall (message, key_event_timeout),
+							this);
+	QObject::connect (
+		queue->watcher,
+		SIGNAL(finished(QDBusPendingCallWatcher *)),
+		this,
+		SLOT(slotProcessKeyEventDone(QDBusPendingCallWatcher *)));
+}
 
-	if (message.type() == QDBusMessage::ErrorMessage) {
-		qWarning() << message.errorMessage ();
-		return false;
+void
+IBusClient::forwardKeyEvent (XEvent *xevent)
+{
+	xevent->xkey.state |= IBUS_FORWARD_MASK;
+	qApp->x11ProcessEvent (xevent);
+}
+
+void
+IBusClient::flushKeyEvents (IBusInputContext *ctx)
+{
+	KeyEventQueue *queue;
+
+	/* forwarding runs widget code, which may release ctx */
+	while ((queue = key_event_queues.value (ctx)) != NULL &&
+			queue->watcher == NULL &&
+			!queue->events.isEmpty ()) {
+		XEvent xevent = queue->events.dequeue ();
+		forwardKeyEvent (&xevent);
 	}
-	else {
-		return message.arguments ()[0].toBool ();
+}
+
+void
+IBusClient::dropKeyEvents (IBusInputContext *ctx)
+{
+	KeyEventQueue *queue = key_event_queues.take (ctx);
+
+	if (queue == NULL) {
+		return;
 	}
+
+	if (queue->watcher) {
+		delete queue->watcher;
+	}
+	delete queue;
 }
 #endif
 
@@ -393,9 +512,10 @@ IBusClient::setCursorLocation (IBusInputContext *ctx, QRect &rect)
 	message << rect.y ();
 	message << rect.width ();
 	message << rect.height ();
-	message = ibus->call (message);
-	if (message.type() == QDBusMessage::ErrorMessage) {
-		qWarning() << message.errorMessage ();
+
+	/* it is sent on every update, do not wait for the reply */
+	if (!ibus->send (message)) {
+		qWarning () << "Can not send SetCursorLocation";
 	}
 }
 
@@ -587,6 +707,16 @@ void
 IBusClient::disconnectFromBus ()
 {
 	if (ibus) {
+#ifdef Q_WS_X11
+		/* no reply is coming for the outstanding calls */
+		QHash <IBusInputContext *, KeyEventQueue *>::iterator q;
+		for (q = key_event_queues.begin (); q != key_event_queues.end (); ++q) {
+			if ((*q)->watcher) {
+				delete (*q)->watcher;
+				(*q)->watcher = NULL;
+			}
+		}
+#endif
 		delete ibus;
 		ibus = NULL;
 		QDBusConnection::disconnectFromBus ("ibus");
@@ -595,6 +725,13 @@ IBusClient::disconnectFromBus ()
 			(*i)->setIC ("");
 		}
 		context_dict.clear ();
+
+#ifdef Q_WS_X11
+		QList <IBusInputContext *> contexts = key_event_queues.keys ();
+		for (i = contexts.begin (); i != contexts.end (); ++i ) {
+			flushKeyEvents (*i);
+		}
+#endif
 	}
 }
 
@@ -620,6 +757,60 @@ IBusClient::slotIBusDisconnected ()
 }
 
 
+#ifdef Q_WS_X11
+void
+IBusClient::slotProcessKeyEventDone (QDBusPendingCallWatcher *watcher)
+{
+	IBusInputContext *ctx = NULL;
+	KeyEventQueue *queue = NULL;
+
+	watcher->deleteLater ();
+
+	QHash <IBusInputContext *, KeyEventQueue *>::iterator i;
+	for (i = key_event_queues.begin (); i != key_event_queues.end (); ++i) {
+		if ((*i)->watcher == watcher) {
+			ctx = i.key ();
+			queue = *i;
+			break;
+		}
+	}
+
+	if (queue == NULL) {
+		return;
+	}
+
+	queue->watcher = NULL;
+	XEvent xevent = queue->events.dequeue ();
+
+	bool handled = false;
+	bool timed_out = false;
+	QDBusMessage message = watcher->reply ();
+
+	if (message.type() == QDBusMessage::ErrorMessage) {
+		qWarning() << message.errorMessage ();
+		timed_out = (message.errorName () == "org.freedesktop.DBus.Error.NoReply");
+	}
+	else {
+		handled = message.arguments ()[0].toBool ();
+	}
+
+	if (!handled) {
+		forwardKeyEvent (&xevent);
+	}
+
+	/*
+	 * ibus did not answer in time, so the queued keys would each wait as
+	 * long again. Give them to Qt now; later keys go to ibus as usual.
+	 */
+	if (timed_out) {
+		flushKeyEvents (ctx);
+	}
+	else {
+		processNextKeyEvent (ctx);
+	}
+}
+#endif
+
 void
 IBusClient::slotCommitString (QString ic, QString text)
 {
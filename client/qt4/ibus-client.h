@@ -27,6 +27,7 @@
 #include <QInputContext>
 #include <QFileSystemWatcher>
 #include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
 
 enum IBUS_CAP{
 	IBUS_CAP_PREEDIT = 1,
@@ -76,12 +77,23 @@ private slots:
 	void slotUpdatePreedit (QDBusMessage message);
 	void slotShowPreedit (QDBusMessage message);
 	void slotHidePreedit (QDBusMessage message);
+#ifdef Q_WS_X11
+	void slotProcessKeyEventDone (QDBusPendingCallWatcher *watcher);
+#endif
 
 private:
 	bool connectToBus ();
 	void disconnectFromBus ();
 	QString createInputContextRemote ();
 	void findYenBarKeys ();
+#ifdef Q_WS_X11
+	struct KeyEventQueue;
+
+	void processNextKeyEvent (IBusInputContext *ctx);
+	void forwardKeyEvent (XEvent *xevent);
+	void flushKeyEvents (IBusInputContext *ctx);
+	void dropKeyEvents (IBusInputContext *ctx);
+#endif
 
 	QDBusConnection *ibus;
 	QFileSystemWatcher watcher;
@@ -91,6 +103,12 @@ private:
 	QString session;
 	QString ibus_path;
 	QString ibus_addr;
+	int key_event_timeout;
+
+#ifdef Q_WS_X11
+	/* key events waiting for ibus, per input context */
+	QHash <IBusInputContext *, KeyEventQueue *> key_event_queues;
+#endif
 
 	/* hack japan keyboard */
 	unsigned int japan_groups;
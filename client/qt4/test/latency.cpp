@@ -0,0 +1,179 @@
+/* vim:set noet ts=4: */
+/*
+ * ibus - The Input Bus
+ *
+ * Copyright (c) 2007-2008 Huang Peng <shawn.p.huang@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ * Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Types keys into a QLineEdit through the input method and reports how
+ * long each key takes to reach the widget, and the longest time the event
+ * loop went without running. Run it with QT_IM_MODULE=ibus against
+ * slow-ibus.py, see "make test-latency".
+ */
+#include <QApplication>
+#include <QLineEdit>
+#include <QKeyEvent>
+#include <QTimer>
+#include <QTime>
+#include <QX11Info>
+#include <QtDebug>
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <stdio.h>
+#include <string.h>
+
+#define N_KEYS		20
+#define KEY_INTERVAL	20
+#define TICK_INTERVAL	5
+#define WAIT_TIMEOUT	10000
+
+class LatencyEdit : public QLineEdit {
+	Q_OBJECT
+public:
+	LatencyEdit ();
+
+protected:
+	void keyPressEvent (QKeyEvent *event);
+
+private slots:
+	void slotTick ();
+	void slotSendKey ();
+	void slotReport ();
+
+private:
+	void sendXKeyEvent (int type);
+
+	QTime clock;
+	QTimer ticker;
+	int last_tick;
+	int max_stall;
+	int n_sent;
+	int n_received;
+	int sent_at[N_KEYS];
+	int latency[N_KEYS];
+};
+
+LatencyEdit::LatencyEdit ()
+	: last_tick (0), max_stall (0), n_sent (0), n_received (0)
+{
+	clock.start ();
+
+	QObject::connect (&ticker, SIGNAL(timeout ()), this, SLOT(slotTick ()));
+	ticker.start (TICK_INTERVAL);
+
+	/* give the input method time to connect and see the focus */
+	QTimer::singleShot (1000, this, SLOT(slotSendKey ()));
+}
+
+void
+LatencyEdit::keyPressEvent (QKeyEvent *event)
+{
+	if (event->text () == "a" && n_received < n_sent) {
+		latency[n_received] = clock.elapsed () - sent_at[n_received];
+		n_received ++;
+		if (n_received == N_KEYS) {
+			QTimer::singleShot (0, this, SLOT(slotReport ()));
+		}
+	}
+	QLineEdit::keyPressEvent (event);
+}
+
+void
+LatencyEdit::slotTick ()
+{
+	int now = clock.elapsed ();
+
+	if (n_sent > 0 && now - last_tick > max_stall) {
+		max_stall = now - last_tick;
+	}
+	last_tick = now;
+}
+
+void
+LatencyEdit::sendXKeyEvent (int type)
+{
+	XEvent xevent;
+
+	memset (&xevent, 0, sizeof (xevent));
+	xevent.xkey.type = type;
+	xevent.xkey.display = QX11Info::display ();
+	xevent.xkey.window = window ()->winId ();
+	xevent.xkey.root = QX11Info::appRootWindow ();
+	xevent.xkey.time = QX11Info::appTime ();
+	xevent.xkey.same_screen = True;
+	xevent.xkey.keycode = XKeysymToKeycode (QX11Info::display (), XK_a);
+
+	qApp->x11ProcessEvent (&xevent);
+}
+
+void
+LatencyEdit::slotSendKey ()
+{
+	sent_at[n_sent] = clock.elapsed ();
+	n_sent ++;
+
+	sendXKeyEvent (KeyPress);
+	sendXKeyEvent (KeyRelease);
+
+	if (n_sent < N_KEYS) {
+		QTimer::singleShot (KEY_INTERVAL, this, SLOT(slotSendKey ()));
+	}
+	else {
+		QTimer::singleShot (WAIT_TIMEOUT, this, SLOT(slotReport ()));
+	}
+}
+
+void
+LatencyEdit::slotReport ()
+{
+	int i;
+	int min = 0, max = 0, sum = 0;
+
+	for (i = 0; i < n_received; i++) {
+		if (i == 0 || latency[i] < min)
+			min = latency[i];
+		if (latency[i] > max)
+			max = latency[i];
+		sum += latency[i];
+	}
+
+	printf ("keys: %d sent, %d received\n", n_sent, n_received);
+	if (n_received > 0) {
+		printf ("latency: min %d ms, avg %d ms, max %d ms\n",
+				min, sum / n_received, max);
+	}
+	printf ("event loop: longest stall %d ms\n", max_stall);
+
+	qApp->exit (n_received == N_KEYS ? 0 : 1);
+}
+
+int
+main (int argc, char **argv)
+{
+	QApplication app (argc, argv);
+	LatencyEdit edit;
+
+	edit.show ();
+	QApplication::setActiveWindow (&edit);
+	edit.setFocus ();
+
+	return app.exec ();
+}
+
+#include "latency.moc"
@@ -0,0 +1,112 @@
+#! /usr/bin/python
+# vim:set noet ts=4:
+#
+# ibus - The Input Bus
+#
+# Copyright (c) 2007-2008 Huang Peng <shawn.p.huang@gmail.com>
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this program; if not, write to the
+# Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+# Boston, MA  02111-1307  USA
+
+# A stand-in for ibus-daemon at the address the Qt client connects to.
+# Its engine takes DELAY ms to answer each key event and never handles one,
+# so every key comes back to the application.
+
+import os
+import sys
+import getpass
+import glib
+import dbus
+import dbus.server
+import dbus.service
+import dbus.mainloop.glib
+
+IBUS_PATH = "/org/freedesktop/IBus"
+IBUS_IFACE = "org.freedesktop.IBus"
+
+class SlowIBus(dbus.service.Object):
+	def __init__(self, conn, delay):
+		super(SlowIBus, self).__init__(conn, IBUS_PATH)
+		self.__delay = delay
+		self.__id = 0
+
+	@dbus.service.method(IBUS_IFACE, in_signature="s", out_signature="s")
+	def CreateInputContext(self, name):
+		self.__id += 1
+		return "%s-%d" % (name, self.__id)
+
+	@dbus.service.method(IBUS_IFACE, in_signature="s")
+	def ReleaseInputContext(self, ic):
+		pass
+
+	@dbus.service.method(IBUS_IFACE, in_signature="subu", out_signature="b",
+		async_callbacks=("reply_cb", "error_cb"))
+	def ProcessKeyEvent(self, ic, keyval, is_press, state, reply_cb, error_cb):
+		def done():
+			reply_cb(False)
+			return False
+		glib.timeout_add(self.__delay, done)
+
+	@dbus.service.method(IBUS_IFACE, in_signature="siiii")
+	def SetCursorLocation(self, ic, x, y, w, h):
+		pass
+
+	@dbus.service.method(IBUS_IFACE, in_signature="s")
+	def FocusIn(self, ic):
+		pass
+
+	@dbus.service.method(IBUS_IFACE, in_signature="s")
+	def FocusOut(self, ic):
+		pass
+
+	@dbus.service.method(IBUS_IFACE, in_signature="s")
+	def Reset(self, ic):
+		pass
+
+	@dbus.service.method(IBUS_IFACE, in_signature="si")
+	def SetCapabilities(self, ic, caps):
+		pass
+
+def get_address():
+	session = os.environ["DISPLAY"]
+	if session.find(".") == -1:
+		session += ".0"
+	session = session.replace(":", "-")
+	return "/tmp/ibus-%s/ibus-%s" % (getpass.getuser(), session)
+
+def main():
+	delay = 200
+	if len(sys.argv) > 1:
+		delay = int(sys.argv[1])
+
+	path = get_address()
+	if os.path.exists(path):
+		print >> sys.stderr, "%s exists, is ibus-daemon running?" % path
+		sys.exit(1)
+	if not os.path.isdir(os.path.dirname(path)):
+		os.makedirs(os.path.dirname(path))
+
+	dbus.mainloop.glib.DBusGMainLoop(set_as_default=True)
+	server = dbus.server.Server("unix:path=" + path)
+	objects = []
+	server.on_connection_added.append(lambda conn: objects.append(SlowIBus(conn, delay)))
+
+	try:
+		glib.MainLoop().run()
+	finally:
+		os.unlink(path)
+
+if __name__ == "__main__":
+	main()
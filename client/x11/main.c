@@ -35,6 +35,7 @@
 #include <iconv.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <errno.h>
 
 #define _GNU_SOURCES
 #include <getopt.h>
@@ -71,9 +72,28 @@ struct _X11IC {
     gboolean         preedit_visible;
     gboolean         preedit_started;
     gint             onspot_preedit_length;
+
+    /* key events waiting to be sent to ibus */
+    GArray          *keys;
+    guint            keys_idle;
+    gboolean         keys_pending;
 };
 
+typedef struct {
+    XEvent           event;
+    guint32          keyval;
+    guint32          state;
+} X11Key;
+
+typedef struct {
+    gint             icid;
+    GArray          *keys;
+} X11KeyBatch;
+
+#define MAX_KEY_BATCH   (64)
+
 static void     _xim_set_cursor_location    (X11IC              *x11ic);
+static void     _xim_send_keys              (X11IC              *x11ic);
 static void     _context_commit_text_cb     (IBusInputContext   *context,
                                              IBusText           *text,
                                              X11IC              *x11ic);
@@ -116,6 +136,8 @@ static gchar _locale[1024] =
 
 static gboolean _kill_daemon = FALSE;
 static gint     g_debug_level = 0;
+/* -1 means the default dbus timeout and G_MAXINT waits forever */
+static gint     _key_event_timeout = 3000;
 
 static IBusBus *_bus = NULL;
 
@@ -342,6 +364,8 @@ xim_create_ic (XIMS xims, IMChangeICStruct *call_data)
         g_return_val_if_reached (0);
     }
 
+    x11ic->keys = g_array_new (FALSE, FALSE, sizeof (X11Key));
+
     g_signal_connect (x11ic->context, "commit-text",
                         G_CALLBACK (_context_commit_text_cb), x11ic);
     g_signal_connect (x11ic->context, "forward-key-event",
@@ -386,6 +410,16 @@ xim_destroy_ic (XIMS xims, IMChangeICStruct *call_data)
                                           GINT_TO_POINTER ((gint) call_data->icid));
     g_return_val_if_fail (x11ic != NULL, 0);
 
+    if (x11ic->keys_idle) {
+        g_source_remove (x11ic->keys_idle);
+        x11ic->keys_idle = 0;
+    }
+
+    if (x11ic->keys) {
+        g_array_free (x11ic->keys, TRUE);
+        x11ic->keys = NULL;
+    }
+
     if (x11ic->context) {
         ibus_object_destroy ((IBusObject *)x11ic->context);
         g_object_unref (x11ic->context);
@@ -445,10 +479,117 @@ xim_unset_ic_focus (XIMS xims, IMChangeFocusStruct *call_data)
 
 }
 
+static void
+_xim_forward_key (X11IC *x11ic, XEvent *event)
+{
+    IMForwardEventStruct fe;
+    memset (&fe, 0, sizeof (fe));
+
+    fe.major_code = XIM_FORWARD_EVENT;
+    fe.icid = x11ic->icid;
+    fe.connect_id = x11ic->connect_id;
+    fe.sync_bit = 0;
+    fe.serial_number = 0L;
+    fe.event = *event;
+
+    IMForwardEvent (_xims, (XPointer) &fe);
+}
+
+static void
+_process_key_events_done_cb (IBusInputContext *context,
+                             guint             processed,
+                             const guint32    *handled,
+                             X11KeyBatch      *batch)
+{
+    X11IC *x11ic;
+    gboolean update_cursor = FALSE;
+    guint i;
+
+    x11ic = (X11IC *) g_hash_table_lookup (_x11_ic_table,
+                                           GINT_TO_POINTER (batch->icid));
+
+    /* the ic was destroyed while waiting for the engine */
+    if (x11ic == NULL || x11ic->context != context) {
+        g_array_free (batch->keys, TRUE);
+        g_slice_free (X11KeyBatch, batch);
+        return;
+    }
+
+    x11ic->keys_pending = FALSE;
+
+    for (i = 0; i < processed; i++) {
+        if (handled[i / 32] & (1u << (i % 32))) {
+            update_cursor = TRUE;
+        }
+        else {
+            _xim_forward_key (x11ic, &g_array_index (batch->keys, X11Key, i).event);
+        }
+    }
+
+    if (update_cursor && ! x11ic->has_preedit_area) {
+        _xim_set_cursor_location (x11ic);
+    }
+
+    /* keys ibus did not get to are sent again ahead of the newer ones */
+    if (processed < batch->keys->len) {
+        g_array_prepend_vals (x11ic->keys,
+                              &g_array_index (batch->keys, X11Key, processed),
+                              batch->keys->len - processed);
+    }
+
+    g_array_free (batch->keys, TRUE);
+    g_slice_free (X11KeyBatch, batch);
+
+    _xim_send_keys (x11ic);
+}
+
+static void
+_xim_send_keys (X11IC *x11ic)
+{
+    X11KeyBatch *batch;
+    guint32 *keys;
+    guint n_keys, i;
+
+    if (x11ic->keys_pending || x11ic->keys->len == 0)
+        return;
+
+    n_keys = MIN (x11ic->keys->len, MAX_KEY_BATCH);
+
+    batch = g_slice_new (X11KeyBatch);
+    batch->icid = x11ic->icid;
+    batch->keys = g_array_sized_new (FALSE, FALSE, sizeof (X11Key), n_keys);
+    g_array_append_vals (batch->keys, x11ic->keys->data, n_keys);
+    g_array_remove_range (x11ic->keys, 0, n_keys);
+
+    keys = g_new (guint32, n_keys * 2);
+    for (i = 0; i < n_keys; i++) {
+        keys[i * 2] = g_array_index (batch->keys, X11Key, i).keyval;
+        keys[i * 2 + 1] = g_array_index (batch->keys, X11Key, i).state;
+    }
+
+    x11ic->keys_pending = TRUE;
+    ibus_input_context_process_key_events_async (x11ic->context,
+                                                 keys,
+                                                 n_keys,
+                                                 _key_event_timeout,
+                                                 (IBusInputContextKeyEventsFunc) _process_key_events_done_cb,
+                                                 batch);
+    g_free (keys);
+}
+
+static gboolean
+_xim_send_keys_idle_cb (X11IC *x11ic)
+{
+    x11ic->keys_idle = 0;
+    _xim_send_keys (x11ic);
+    return FALSE;
+}
+
 static int
 xim_forward_event (XIMS xims, IMForwardEventStruct *call_data)
 {
     X11IC *x11ic;
+    X11Key key;
     XKeyEvent *xevent;
     GdkEventKey event;
 
@@ -471,30 +612,19 @@ xim_forward_event (XIMS xims, IMForwardEventStruct *call_data)
         event.state |= IBUS_RELEASE_MASK;
     }
 
-    if (ibus_input_context_process_key_event (x11ic->context,
-                event.keyval, event.state)) {
-        if (! x11ic->has_preedit_area) {
-            _xim_set_cursor_location (x11ic);
-        }
-        return 1;
-    }
-
-    IMForwardEventStruct fe;
-    memset (&fe, 0, sizeof (fe));
-
-    fe.major_code = XIM_FORWARD_EVENT;
-    fe.icid = x11ic->icid;
-    fe.connect_id = x11ic->connect_id;
-    fe.sync_bit = 0;
-    fe.serial_number = 0L;
-    fe.event = call_data->event;
-
-    IMForwardEvent (_xims, (XPointer) &fe);
+    key.event = call_data->event;
+    key.keyval = event.keyval;
+    key.state = event.state;
+    g_array_append_val (x11ic->keys, key);
 
+    /* Keys are sent from an idle callback, so all events already read
+     * from the X connection (auto repeat, paste) go in one batch. */
+    if (!x11ic->keys_pending && x11ic->keys_idle == 0) {
+        x11ic->keys_idle = g_idle_add ((GSourceFunc) _xim_send_keys_idle_cb, x11ic);
+    }
     return 1;
 }
 
-
 static int
 xim_open (XIMS xims, IMOpenStruct *call_data)
 {
@@ -530,6 +660,16 @@ _free_ic (gpointer data, gpointer user_data)
         x11ic->preedit_attrs = NULL;
     }
 
+    if (x11ic->keys_idle) {
+        g_source_remove (x11ic->keys_idle);
+        x11ic->keys_idle = 0;
+    }
+
+    if (x11ic->keys) {
+        g_array_free (x11ic->keys, TRUE);
+        x11ic->keys = NULL;
+    }
+
     if (x11ic->context) {
         ibus_object_destroy ((IBusObject *)x11ic->context);
         g_object_unref (x11ic->context);
@@ -839,8 +979,8 @@ _context_update_preedit_text_cb (IBusInputContext *context,
         g_object_unref (x11ic->preedit_attrs);
     }
 
-    g_object_ref(text->attrs);
-    x11ic->preedit_attrs = text->attrs;
+    x11ic->preedit_attrs = ibus_text_get_attributes (text);
+    g_object_ref (x11ic->preedit_attrs);
 
     x11ic->preedit_cursor = cursor_pos;
     x11ic->preedit_visible = visible;
@@ -1001,10 +1141,36 @@ _print_usage (FILE *fp, gchar *name)
         "    --server-name= -n    Setup xim sevrer name\n"
         "    --locale= -l         Setup support locale\n"
         "    --kill-daemon -k     Kill ibus daemon when exit\n"
+        "    --key-event-timeout= Milliseconds to wait for engine before forwarding a key,\n"
+        "                         0 waits forever, a negative value uses the default\n"
         "    --debug= -v          Setup debug level\n",
         name);
 }
 
+/* 0 waits forever like the daemon setting, a negative value takes the
+ * default dbus timeout, garbage is rejected */
+static gboolean
+_parse_key_event_timeout (const gchar *str,
+                          gint        *timeout)
+{
+    gchar *end;
+    glong value;
+
+    errno = 0;
+    value = strtol (str, &end, 10);
+    if (end == str || *end != '\0' || errno != 0 ||
+        value > G_MAXINT || value < G_MININT)
+        return FALSE;
+
+    if (value == 0)
+        *timeout = G_MAXINT;
+    else if (value < 0)
+        *timeout = -1;
+    else
+        *timeout = value;
+    return TRUE;
+}
+
 static int
 _xerror_handler (Display *dpy, XErrorEvent *e)
 {
@@ -1031,6 +1197,7 @@ main (int argc, char **argv)
             {"locale", 1, 0, 0},
             {"help", 0, 0, 0},
             {"kill-daemon", 0, 0, 0},
+            {"key-event-timeout", 1, 0, 0},
             {0, 0, 0, 0},
         };
 
@@ -1057,6 +1224,12 @@ main (int argc, char **argv)
             else if (g_strcmp0 (long_options[option_index].name, "kill-daemon") == 0) {
                 _kill_daemon = TRUE;
             }
+            else if (g_strcmp0 (long_options[option_index].name, "key-event-timeout") == 0) {
+                if (!_parse_key_event_timeout (optarg, &_key_event_timeout)) {
+                    g_printerr ("Invalid --key-event-timeout %s\n", optarg);
+                    exit (EXIT_FAILURE);
+                }
+            }
             break;
         case 'v':
             g_debug_level = atoi (optarg);
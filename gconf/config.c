@@ -20,6 +20,18 @@ static gboolean     ibus_config_gconf_get_value     (IBusConfigService      *con
                                                      const gchar            *name,
                                                      GValue                 *value,
                                                      IBusError             **error);
+static gboolean     ibus_config_gconf_get_values    (IBusConfigService      *config,
+                                                     const gchar            *section,
+                                                     GHashTable             *values,
+                                                     IBusError             **error);
+static gboolean     ibus_config_gconf_get_section   (IBusConfigService      *config,
+                                                     const gchar            *section,
+                                                     GHashTable             *values,
+                                                     IBusError             **error);
+static gboolean     ibus_config_gconf_set_values    (IBusConfigService      *config,
+                                                     const gchar            *section,
+                                                     GHashTable             *values,
+                                                     IBusError             **error);
 
 static GConfValue   *_to_gconf_value                (const GValue           *value);
 static void          _from_gconf_value              (GValue                 *value,
@@ -64,6 +76,9 @@ ibus_config_gconf_class_init (IBusConfigGConfClass *klass)
 	IBUS_OBJECT_CLASS (object_class)->destroy = (IBusObjectDestroyFunc) ibus_config_gconf_destroy;
     IBUS_CONFIG_SERVICE_CLASS (object_class)->set_value = ibus_config_gconf_set_value;
     IBUS_CONFIG_SERVICE_CLASS (object_class)->get_value = ibus_config_gconf_get_value;
+    IBUS_CONFIG_SERVICE_CLASS (object_class)->get_values = ibus_config_gconf_get_values;
+    IBUS_CONFIG_SERVICE_CLASS (object_class)->get_section = ibus_config_gconf_get_section;
+    IBUS_CONFIG_SERVICE_CLASS (object_class)->set_values = ibus_config_gconf_set_values;
 }
 
 static void
@@ -299,6 +314,144 @@ ibus_config_gconf_get_value (IBusConfigService      *config,
     return TRUE;
 }
 
+static gboolean
+_get_entries (GConfClient  *client,
+              const gchar  *dir,
+              gsize         offset,
+              gboolean      recursive,
+              GHashTable   *values,
+              GError      **error)
+{
+    GSList *entries, *dirs, *p;
+    gboolean retval = TRUE;
+
+    entries = gconf_client_all_entries (client, dir, error);
+    if (*error != NULL)
+        return FALSE;
+
+    for (p = entries; p != NULL; p = p->next) {
+        GConfEntry *entry = (GConfEntry *) p->data;
+        GConfValue *gv;
+        GValue *value;
+
+        gv = gconf_entry_get_value (entry);
+        if (gv != NULL) {
+            value = g_slice_new0 (GValue);
+            _from_gconf_value (value, gv);
+            /* name relative to the requested section */
+            g_hash_table_insert (values,
+                                 g_strdup (gconf_entry_get_key (entry) + offset),
+                                 value);
+        }
+        gconf_entry_free (entry);
+    }
+    g_slist_free (entries);
+
+    if (!recursive)
+        return TRUE;
+
+    dirs = gconf_client_all_dirs (client, dir, error);
+    if (*error != NULL)
+        return FALSE;
+
+    for (p = dirs; p != NULL; p = p->next) {
+        if (retval)
+            retval = _get_entries (client, (gchar *) p->data, offset, TRUE, values, error);
+        g_free (p->data);
+    }
+    g_slist_free (dirs);
+
+    return retval;
+}
+
+static gboolean
+ibus_config_gconf_get_values (IBusConfigService      *config,
+                              const gchar            *section,
+                              GHashTable             *values,
+                              IBusError             **error)
+{
+    gchar *dir;
+    GError *gerror = NULL;
+
+    dir = g_strdup_printf (GCONF_PREFIX"/%s", section);
+    _get_entries (((IBusConfigGConf *) config)->client,
+                  dir, strlen (dir) + 1, FALSE, values, &gerror);
+    g_free (dir);
+
+    if (gerror != NULL) {
+        if (error) {
+            *error = ibus_error_new_from_text (DBUS_ERROR_FAILED, gerror->message);
+        }
+        g_error_free (gerror);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+ibus_config_gconf_get_section (IBusConfigService      *config,
+                               const gchar            *section,
+                               GHashTable             *values,
+                               IBusError             **error)
+{
+    gchar *dir;
+    GError *gerror = NULL;
+
+    dir = g_strdup_printf (GCONF_PREFIX"/%s", section);
+    _get_entries (((IBusConfigGConf *) config)->client,
+                  dir, strlen (dir) + 1, TRUE, values, &gerror);
+    g_free (dir);
+
+    if (gerror != NULL) {
+        if (error) {
+            *error = ibus_error_new_from_text (DBUS_ERROR_FAILED, gerror->message);
+        }
+        g_error_free (gerror);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+ibus_config_gconf_set_values (IBusConfigService      *config,
+                              const gchar            *section,
+                              GHashTable             *values,
+                              IBusError             **error)
+{
+    GConfChangeSet *cs;
+    GHashTableIter iter;
+    gpointer name, value;
+    GError *gerror = NULL;
+
+    cs = gconf_change_set_new ();
+
+    g_hash_table_iter_init (&iter, values);
+    while (g_hash_table_iter_next (&iter, &name, &value)) {
+        gchar *key;
+        GConfValue *gv;
+
+        key = g_strdup_printf (GCONF_PREFIX"/%s/%s", section, (gchar *) name);
+        gv = _to_gconf_value ((GValue *) value);
+        gconf_change_set_set_nocopy (cs, key, gv);
+        g_free (key);
+    }
+
+    gconf_client_commit_change_set (((IBusConfigGConf *) config)->client, cs, FALSE, &gerror);
+    gconf_change_set_unref (cs);
+
+    if (gerror != NULL) {
+        if (error) {
+            *error = ibus_error_new_from_text (DBUS_ERROR_FAILED, gerror->message);
+        }
+        g_error_free (gerror);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 IBusConfigGConf *
 ibus_config_gconf_new (IBusConnection *connection)
 {
@@ -128,6 +128,9 @@ class Bus(object.Object):
     def exit(self, restart):
         return self.__ibus.Exit(restart)
 
+    def get_stats(self):
+        return self.__ibus.GetStats()
+
     def get_config(self):
         try:
             return self.__config
@@ -207,7 +207,9 @@ class InputContext(object.Object):
         return self.__context.IsEnabled()
 
     def set_capabilities(self, caps):
-        caps = dbus.UInt32(caps)
+        # Text reads texts without attributes in the compact encoding,
+        # IBUS_CAP_COMPACT_TEXT
+        caps = dbus.UInt32(caps | (1 << 5))
         return self.__context.SetCapabilities(caps)
 
     def destroy(self):
@@ -69,3 +69,6 @@ class IIBus(dbus.service.Object):
     @method(in_signature="b")
     def Exit(self, restart, dbusconn): pass
 
+    @method(out_signature="s")
+    def GetStats(self, dbusconn): pass
+
@@ -41,6 +41,9 @@ class IPanel(dbus.service.Object):
         dbus.service.method(dbus_interface=IBUS_IFACE_PANEL, \
                             async_callbacks=("reply_cb", "error_cb"), \
                             **args)
+    @method(out_signature="u")
+    def GetCapabilities(self): pass
+
     @method(in_signature="iiii")
     def SetCursorLocation(self, x, y, w, h): pass
 
@@ -65,6 +68,10 @@ class IPanel(dbus.service.Object):
     @method(in_signature="vb")
     def UpdateLookupTable(self, lookup_table, visible): pass
 
+    @method(in_signature="uuubbuuavb")
+    def UpdateLookupTableDelta(self, generation, page_size, cursor_pos, cursor_visible, round,
+                               begin, n_removed, candidates, visible): pass
+
     @method()
     def ShowLookupTable(self): pass
 
@@ -101,6 +108,9 @@ class IPanel(dbus.service.Object):
     @method(in_signature="o")
     def FocusOut(self, ic): pass
 
+    @method(in_signature="o")
+    def RestoreState(self, ic): pass
+
     @method()
     def StateChanged(self): pass
 
@@ -135,3 +145,6 @@ class IPanel(dbus.service.Object):
     @signal(signature="s")
     def PropertyHide(self, prop_name): pass
 
+    @signal()
+    def RequestLookupTable(self): pass
+
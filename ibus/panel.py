@@ -34,9 +34,39 @@ IBUS_PATH_PANEL = "/org/freedesktop/IBus/Panel"
 
 from serializable import *
 from object import Object
+from lookuptable import LookupTable
 import interface
 import dbus
 
+# contexts to keep a snapshot of, not less than the daemon expects
+SNAPSHOT_SIZE = 16
+
+# reported to the daemon from GetCapabilities
+CAP_LOOKUP_TABLE_DELTA = 1 << 0
+CAP_RESTORE_STATE = 1 << 1
+CAP_COMPACT_TEXT = 1 << 2
+
+class PanelState:
+    # what the panel shows for an input context
+    def __init__(self):
+        self.props = None
+        self.prop_updates = {}
+        self.preedit = None
+        self.auxiliary = None
+        self.lookup_table = None
+
+    def restore(self, panel):
+        if self.props != None:
+            panel.register_properties(self.props)
+            for prop in self.prop_updates.values():
+                panel.update_property(prop)
+        if self.preedit != None:
+            panel.update_preedit_text(*self.preedit)
+        if self.auxiliary != None:
+            panel.update_auxiliary_text(*self.auxiliary)
+        if self.lookup_table != None:
+            panel.update_lookup_table(*self.lookup_table)
+
 class PanelItem:
     pass
 
@@ -162,38 +192,88 @@ class PanelProxy(interface.IPanel):
         self.__bus = bus
         self.__panel = panel
         self.__focus_ic = None
+        self.__lookup_table = None
+        self.__lookup_table_generation = 0
+        self.__lookup_table_requested = False
+        self.__state = PanelState()
+        # (ic, state) of recently focused contexts, the most recent first
+        self.__snapshots = []
+
+    def __set_visible(self, item, visible):
+        value = getattr(self.__state, item)
+        if value != None:
+            setattr(self.__state, item, value[:-1] + (visible,))
+
+    def GetCapabilities(self):
+        return dbus.UInt32(CAP_LOOKUP_TABLE_DELTA | CAP_RESTORE_STATE | CAP_COMPACT_TEXT)
 
     def SetCursorLocation(self, x, y, w, h):
         self.__panel.set_cursor_location(x, y, w, h)
 
     def UpdatePreeditText(self, text, cursor_pos, visible):
         text = deserialize_object(text)
+        self.__state.preedit = (text, cursor_pos, visible)
         self.__panel.update_preedit_text(text, cursor_pos, visible)
 
     def ShowPreeditText(self):
+        self.__set_visible("preedit", True)
         self.__panel.show_preedit_text()
 
     def HidePreeditText(self):
+        self.__set_visible("preedit", False)
         self.__panel.hide_preedit_text()
 
     def UpdateAuxiliaryText(self, text, visible):
         text = deserialize_object(text)
+        self.__state.auxiliary = (text, visible)
         self.__panel.update_auxiliary_text(text, visible)
 
     def ShowAuxiliaryText(self):
+        self.__set_visible("auxiliary", True)
         self.__panel.show_auxiliary_text()
 
     def HideAuxiliaryText(self):
+        self.__set_visible("auxiliary", False)
         self.__panel.hide_auxiliary_text()
 
     def UpdateLookupTable(self, lookup_table, visible):
         lookup_table = deserialize_object(lookup_table)
+        self.__lookup_table = lookup_table
+        self.__lookup_table_generation += 1
+        self.__lookup_table_requested = False
+        self.__state.lookup_table = (lookup_table, visible)
         self.__panel.update_lookup_table(lookup_table, visible)
 
+    def UpdateLookupTableDelta(self, generation, page_size, cursor_pos, cursor_visible, round,
+                               begin, n_removed, candidates, visible):
+        # generation counts the full tables, the daemon does the same
+        if self.__lookup_table == None or generation != self.__lookup_table_generation:
+            self.__request_lookup_table()
+            return
+        old_table = self.__lookup_table
+        texts = map(old_table.get_candidate, xrange(len(old_table)))
+        if begin + n_removed > len(texts):
+            self.__request_lookup_table()
+            return
+        texts[begin:begin + n_removed] = map(deserialize_object, candidates)
+        lookup_table = LookupTable(page_size, cursor_pos, cursor_visible, round, texts)
+        lookup_table.show_cursor(cursor_visible)
+        self.__lookup_table = lookup_table
+        self.__state.lookup_table = (lookup_table, visible)
+        self.__panel.update_lookup_table(lookup_table, visible)
+
+    def __request_lookup_table(self):
+        # once until the full table arrives, later deltas miss it as well
+        if not self.__lookup_table_requested:
+            self.__lookup_table_requested = True
+            self.RequestLookupTable()
+
     def ShowLookupTable(self):
+        self.__set_visible("lookup_table", True)
         self.__panel.show_lookup_table()
 
     def HideLookupTable(self):
+        self.__set_visible("lookup_table", False)
         self.__panel.hide_lookup_table()
 
     def PageUpLookupTable(self):
@@ -222,18 +302,39 @@ class PanelProxy(interface.IPanel):
 
     def RegisterProperties(self, props):
         props = deserialize_object(props)
+        self.__state.props = props
+        self.__state.prop_updates = {}
         self.__panel.register_properties(props)
 
     def UpdateProperty(self, prop):
         prop = deserialize_object(prop)
+        self.__state.prop_updates[prop.get_key()] = prop
         self.__panel.update_property(prop)
 
     def FocusIn(self, ic):
+        self.__state = PanelState()
+        self.__lookup_table = None
         self.__panel.focus_in(ic)
 
     def FocusOut(self, ic):
+        self.__snapshots = [s for s in self.__snapshots if s[0] != ic]
+        self.__snapshots.insert(0, (ic, self.__state))
+        del self.__snapshots[SNAPSHOT_SIZE:]
+        self.__state = PanelState()
         self.__panel.focus_out(ic)
 
+    def RestoreState(self, ic):
+        # the daemon sends only what changed after this snapshot
+        for snapshot_ic, state in self.__snapshots:
+            if snapshot_ic == ic:
+                self.__state = state
+                break
+        else:
+            return
+        if state.lookup_table != None:
+            self.__lookup_table = state.lookup_table[0]
+        state.restore(self.__panel)
+
     def StateChanged(self):
         self.__panel.state_changed()
 
@@ -47,6 +47,8 @@ class Text(Serializable):
     def serialize(self, struct):
         super(Text, self).serialize(struct)
         struct.append (dbus.String(self.__text))
+        # the daemon may be older than the compact encoding of texts
+        # without attributes, so the full one is sent
         if self.__attrs == None:
             self.__attrs = AttrList()
         struct.append (serialize_object(self.__attrs))
@@ -55,7 +57,11 @@ class Text(Serializable):
         super(Text, self).deserialize(struct)
 
         self.__text = struct.pop(0)
-        self.__attrs = deserialize_object(struct.pop(0))
+        attrs = struct.pop(0)
+        if isinstance(attrs, tuple):
+            self.__attrs = deserialize_object(attrs)
+        else:
+            self.__attrs = None
 
 serializable_register(Text)
 
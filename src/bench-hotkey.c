@@ -0,0 +1,84 @@
+/* vim:set et sts=4: */
+#include "ibus.h"
+
+#define N_ROUNDS        1000000
+#define N_HOTKEYS       128
+
+/* a key stream as the daemon sees it while the user types: presses and
+ * releases of letters which are not bound, with a hotkey now and then */
+static void
+bench (IBusHotkeyProfile *profile,
+       const gchar       *name)
+{
+    GTimer *timer;
+    guint prev_keyval = IBUS_VoidSymbol;
+    guint prev_modifiers = 0;
+    guint n_events = 0;
+    gdouble elapsed;
+    gint i;
+
+    timer = g_timer_new ();
+    for (i = 0; i < N_ROUNDS; i++) {
+        guint keyval = IBUS_a + i % 26;
+        guint modifiers = (i % 64 == 0) ? IBUS_CONTROL_MASK : 0;
+
+        if (i % 2)
+            modifiers |= IBUS_RELEASE_MASK;
+
+        if (ibus_hotkey_profile_filter_key_event (profile,
+                                                  keyval,
+                                                  modifiers,
+                                                  prev_keyval,
+                                                  prev_modifiers,
+                                                  NULL) != 0)
+            n_events ++;
+        prev_keyval = keyval;
+        prev_modifiers = modifiers;
+    }
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    g_print ("%14s %18.1f %10u\n",
+             name,
+             elapsed * 1000000000 / N_ROUNDS,
+             n_events);
+}
+
+int
+main (gint argc, gchar **argv)
+{
+    static const guint modifiers[] = {
+        IBUS_CONTROL_MASK,
+        IBUS_MOD1_MASK,
+        IBUS_CONTROL_MASK | IBUS_SHIFT_MASK,
+        IBUS_MOD1_MASK | IBUS_SHIFT_MASK,
+        IBUS_CONTROL_MASK | IBUS_MOD1_MASK,
+    };
+    IBusHotkeyProfile *profile;
+    GQuark event;
+    gint i;
+
+    g_type_init ();
+
+    event = g_quark_from_static_string ("bench");
+
+    g_print ("%14s %18s %10s\n", "hotkeys", "filter (ns/key)", "events");
+
+    profile = ibus_hotkey_profile_new ();
+    bench (profile, "none");
+
+    ibus_hotkey_profile_add_hotkey_from_string (profile, "Control+space", event);
+    bench (profile, "1");
+
+    for (i = 1; i < N_HOTKEYS; i++) {
+        ibus_hotkey_profile_add_hotkey (profile,
+                                        IBUS_a + i % 26,
+                                        modifiers[i / 26],
+                                        event);
+    }
+    bench (profile, G_STRINGIFY (N_HOTKEYS));
+
+    g_object_unref (profile);
+
+    return 0;
+}
@@ -0,0 +1,247 @@
+/* vim:set et sts=4: */
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "ibus.h"
+#include "ibuskeyring.h"
+
+#define N_WARMUP        1000
+#define N_ROUNDS        20000
+#define BENCH_PATH      "/org/freedesktop/IBus/Bench"
+
+/* key round trips between this process and a forked peer standing in for
+ * the daemon, once over a private D-Bus connection and once over a key
+ * ring; the peer answers at once, so only the transport is measured */
+
+static gboolean
+_process_key_event_cb (IBusConnection *connection,
+                       IBusMessage    *message,
+                       gpointer        user_data)
+{
+    IBusMessage *reply;
+    guint keyval, state;
+    gboolean handled;
+
+    if (!ibus_message_is_method_call (message,
+                                      IBUS_INTERFACE_INPUT_CONTEXT,
+                                      "ProcessKeyEvent"))
+        return FALSE;
+
+    ibus_message_get_args (message,
+                           NULL,
+                           G_TYPE_UINT, &keyval,
+                           G_TYPE_UINT, &state,
+                           G_TYPE_INVALID);
+
+    handled = keyval & 1;
+    reply = ibus_message_new_method_return (message);
+    ibus_message_append_args (reply,
+                              G_TYPE_BOOLEAN, &handled,
+                              G_TYPE_INVALID);
+    ibus_connection_send (connection, reply);
+    ibus_message_unref (reply);
+
+    return TRUE;
+}
+
+static void
+_new_connection_cb (IBusServer     *server,
+                    IBusConnection *connection,
+                    gpointer        user_data)
+{
+    g_object_ref (connection);
+    ibus_connection_register_object_path (connection,
+                                          BENCH_PATH,
+                                          _process_key_event_cb,
+                                          NULL);
+}
+
+static void
+_key_ring_cb (IBusKeyRing            *ring,
+              const IBusKeyRingEvent *event,
+              gpointer                user_data)
+{
+    IBusKeyRingEvent reply = { 0 };
+
+    reply.serial = event->serial;
+    reply.handled = event->keyval & 1;
+    ibus_key_ring_push (ring, &reply);
+}
+
+static void
+run_peer (const gchar *address,
+          IBusKeyRing *ring)
+{
+    IBusServer *server;
+
+    server = ibus_server_new ();
+    if (!ibus_server_listen (server, address))
+        _exit (1);
+    g_signal_connect (server, "new-connection", (GCallback) _new_connection_cb, NULL);
+
+    ibus_key_ring_set_watch (ring, _key_ring_cb, NULL);
+
+    g_main_loop_run (g_main_loop_new (NULL, FALSE));
+    _exit (0);
+}
+
+static gint
+_compare_double (gconstpointer a,
+                 gconstpointer b)
+{
+    gdouble x = *(const gdouble *) a;
+    gdouble y = *(const gdouble *) b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void
+report (const gchar *name,
+        gdouble     *samples)
+{
+    qsort (samples, N_ROUNDS, sizeof (gdouble), _compare_double);
+    g_print ("%10s %12.1f %12.1f %12.1f\n",
+             name,
+             samples[N_ROUNDS / 2],
+             samples[N_ROUNDS * 99 / 100],
+             samples[N_ROUNDS - 1]);
+}
+
+static gboolean
+dbus_round_trip (IBusConnection *connection,
+                 guint           keyval)
+{
+    IBusMessage *message;
+    IBusMessage *reply;
+    IBusError *error = NULL;
+    guint state = 0;
+    gboolean handled = FALSE;
+
+    message = ibus_message_new_method_call (NULL,
+                                            BENCH_PATH,
+                                            IBUS_INTERFACE_INPUT_CONTEXT,
+                                            "ProcessKeyEvent");
+    ibus_message_append_args (message,
+                              G_TYPE_UINT, &keyval,
+                              G_TYPE_UINT, &state,
+                              G_TYPE_INVALID);
+    reply = ibus_connection_send_with_reply_and_block (connection, message, -1, &error);
+    ibus_message_unref (message);
+
+    if (reply == NULL) {
+        g_warning ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
+        return FALSE;
+    }
+
+    ibus_message_get_args (reply, NULL, G_TYPE_BOOLEAN, &handled, G_TYPE_INVALID);
+    ibus_message_unref (reply);
+
+    return handled == (keyval & 1);
+}
+
+static gboolean
+ring_round_trip (IBusKeyRing *ring,
+                 guint        keyval,
+                 guint32      serial)
+{
+    IBusKeyRingEvent event = { 0 };
+
+    event.serial = serial;
+    event.keyval = keyval;
+    if (!ibus_key_ring_push (ring, &event))
+        return FALSE;
+
+    while (!ibus_key_ring_pop (ring, &event)) {
+        if (!ibus_key_ring_wait (ring, 5000))
+            return FALSE;
+    }
+
+    return event.serial == serial && event.handled == (keyval & 1);
+}
+
+int
+main (gint argc, gchar **argv)
+{
+    gchar dir[] = "/tmp/ibus-bench-XXXXXX";
+    gchar *address;
+    IBusKeyRing *peer_ring;
+    IBusKeyRing *ring;
+    IBusConnection *connection;
+    gdouble *samples;
+    GTimer *timer;
+    pid_t pid;
+    gint i;
+
+    g_type_init ();
+
+    if (mkdtemp (dir) == NULL) {
+        g_warning ("Can not create %s", dir);
+        return 1;
+    }
+    address = g_strdup_printf ("unix:abstract=%s", dir);
+
+    /* the peer takes the daemon side of the ring */
+    peer_ring = ibus_key_ring_new (dir);
+    g_assert (peer_ring != NULL);
+
+    pid = fork ();
+    if (pid == 0) {
+        run_peer (address, peer_ring);
+    }
+
+    ring = ibus_key_ring_open (ibus_key_ring_get_path (peer_ring));
+    g_assert (ring != NULL);
+    ibus_key_ring_unlink (ring);
+    ibus_key_ring_free (peer_ring);
+
+    /* wait for the peer to listen */
+    connection = NULL;
+    for (i = 0; i < 100 && connection == NULL; i++) {
+        g_usleep (10000);
+        connection = ibus_connection_open_private (address);
+    }
+    g_assert (connection != NULL);
+
+    samples = g_new (gdouble, N_ROUNDS);
+    timer = g_timer_new ();
+
+    g_print ("%10s %12s %12s %12s\n", "transport", "p50 (us)", "p99 (us)", "max (us)");
+
+    for (i = 0; i < N_WARMUP; i++) {
+        if (!dbus_round_trip (connection, i))
+            g_error ("D-Bus round trip %d failed", i);
+    }
+    for (i = 0; i < N_ROUNDS; i++) {
+        g_timer_start (timer);
+        if (!dbus_round_trip (connection, i))
+            g_error ("D-Bus round trip %d failed", i);
+        samples[i] = g_timer_elapsed (timer, NULL) * 1000000;
+    }
+    report ("D-Bus", samples);
+
+    for (i = 0; i < N_WARMUP; i++) {
+        if (!ring_round_trip (ring, i, i + 1))
+            g_error ("key ring round trip %d failed", i);
+    }
+    for (i = 0; i < N_ROUNDS; i++) {
+        g_timer_start (timer);
+        if (!ring_round_trip (ring, i, N_WARMUP + i + 1))
+            g_error ("key ring round trip %d failed", i);
+        samples[i] = g_timer_elapsed (timer, NULL) * 1000000;
+    }
+    report ("key ring", samples);
+
+    g_timer_destroy (timer);
+    g_free (samples);
+    ibus_key_ring_free (ring);
+
+    kill (pid, SIGTERM);
+    waitpid (pid, NULL, 0);
+    g_free (address);
+    rmdir (dir);
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+/* vim:set et sts=4: */
+#include <stdlib.h>
+#include "ibus.h"
+
+#define N_WARMUP        1000
+#define N_ROUNDS        20000
+#define BENCH_PATH      "/org/freedesktop/IBus/InputContext_1"
+
+/* the messages the daemon builds for one keystroke: CommitText,
+ * UpdatePreeditText, ForwardKeyEvent and the ProcessKeyEvent reply,
+ * once with append_args and once with the typed appends */
+
+/* count the mallocs of glib and libdbus alike; this relies on glibc
+ * exporting __libc_malloc and friends */
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static guint n_allocations = 0;
+
+void *
+malloc (size_t size)
+{
+    n_allocations ++;
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+    n_allocations ++;
+    return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+    n_allocations ++;
+    return __libc_realloc (ptr, size);
+}
+
+static IBusMessage *call;
+static IBusText *text;
+
+static IBusMessage *
+new_signal (const gchar *name)
+{
+    IBusMessage *message;
+
+    message = ibus_message_new_signal (BENCH_PATH,
+                                       IBUS_INTERFACE_INPUT_CONTEXT,
+                                       name);
+    ibus_message_set_sender (message, IBUS_SERVICE_IBUS);
+    return message;
+}
+
+static void
+keystroke_args (void)
+{
+    IBusMessage *message;
+    guint keyval = 0x61;
+    guint state = 0;
+    guint cursor_pos = 5;
+    gboolean visible = TRUE;
+    gboolean handled = TRUE;
+
+    message = new_signal ("CommitText");
+    ibus_message_set_destination (message, ":1.1");
+    ibus_message_append_args (message,
+                              IBUS_TYPE_TEXT, &text,
+                              G_TYPE_INVALID);
+    ibus_message_unref (message);
+
+    message = new_signal ("UpdatePreeditText");
+    ibus_message_set_destination (message, ":1.1");
+    ibus_message_append_args (message,
+                              IBUS_TYPE_TEXT, &text,
+                              G_TYPE_UINT, &cursor_pos,
+                              G_TYPE_BOOLEAN, &visible,
+                              G_TYPE_INVALID);
+    ibus_message_unref (message);
+
+    message = new_signal ("ForwardKeyEvent");
+    ibus_message_set_destination (message, ":1.1");
+    ibus_message_append_args (message,
+                              G_TYPE_UINT, &keyval,
+                              G_TYPE_UINT, &state,
+                              G_TYPE_INVALID);
+    ibus_message_unref (message);
+
+    message = ibus_message_new_method_return (call);
+    ibus_message_append_args (message,
+                              G_TYPE_BOOLEAN, &handled,
+                              G_TYPE_INVALID);
+    ibus_message_unref (message);
+}
+
+static void
+keystroke_typed (void)
+{
+    IBusMessage *message;
+    IBusMessageIter iter;
+
+    message = new_signal ("CommitText");
+    ibus_message_set_destination (message, ":1.1");
+    ibus_message_iter_init_append (message, &iter);
+    ibus_serializable_serialize ((IBusSerializable *) text, &iter);
+    ibus_message_unref (message);
+
+    message = new_signal ("UpdatePreeditText");
+    ibus_message_set_destination (message, ":1.1");
+    ibus_message_iter_init_append (message, &iter);
+    ibus_serializable_serialize ((IBusSerializable *) text, &iter);
+    ibus_message_iter_append_uint (&iter, 5);
+    ibus_message_iter_append_boolean (&iter, TRUE);
+    ibus_message_unref (message);
+
+    message = new_signal ("ForwardKeyEvent");
+    ibus_message_set_destination (message, ":1.1");
+    ibus_message_iter_init_append (message, &iter);
+    ibus_message_iter_append_uint (&iter, 0x61);
+    ibus_message_iter_append_uint (&iter, 0);
+    ibus_message_unref (message);
+
+    message = ibus_message_new_method_return (call);
+    ibus_message_iter_init_append (message, &iter);
+    ibus_message_iter_append_boolean (&iter, TRUE);
+    ibus_message_unref (message);
+}
+
+static void
+bench (const gchar *name,
+       void       (*keystroke) (void))
+{
+    GTimer *timer;
+    guint allocations;
+    gdouble elapsed;
+    gint i;
+
+    for (i = 0; i < N_WARMUP; i++) {
+        keystroke ();
+    }
+
+    allocations = n_allocations;
+    timer = g_timer_new ();
+    for (i = 0; i < N_ROUNDS; i++) {
+        keystroke ();
+    }
+    elapsed = g_timer_elapsed (timer, NULL);
+    allocations = n_allocations - allocations;
+    g_timer_destroy (timer);
+
+    g_print ("%14s %18.2f %18.3f\n",
+             name,
+             (gdouble) allocations / N_ROUNDS,
+             elapsed * 1000000 / N_ROUNDS);
+}
+
+int
+main (gint argc, gchar **argv)
+{
+    g_type_init ();
+
+    text = ibus_text_new_from_string ("nihao");
+    ibus_text_append_attribute (text, IBUS_ATTR_TYPE_UNDERLINE,
+                                IBUS_ATTR_UNDERLINE_SINGLE, 0, -1);
+
+    call = ibus_message_new_method_call (":1.1",
+                                         BENCH_PATH,
+                                         IBUS_INTERFACE_INPUT_CONTEXT,
+                                         "ProcessKeyEvent");
+    /* a reply needs a serial to refer to */
+    dbus_message_set_serial (call, 1);
+
+    g_print ("%14s %18s %18s\n", "messages", "mallocs / key", "time / key (us)");
+    bench ("append args", keystroke_args);
+    bench ("typed appends", keystroke_typed);
+
+    ibus_message_unref (call);
+    g_object_unref (text);
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+/* vim:set et sts=4: */
+#include "ibus.h"
+
+#define N_ROUNDS        10000
+#define N_CANDIDATES    10
+
+/* what an engine sends for UpdatePreeditText */
+static IBusText *
+create_preedit (void)
+{
+    IBusText *text;
+
+    text = ibus_text_new_from_string ("nihao");
+    ibus_text_append_attribute (text, IBUS_ATTR_TYPE_UNDERLINE,
+                                IBUS_ATTR_UNDERLINE_SINGLE, 0, -1);
+    ibus_text_append_attribute (text, IBUS_ATTR_TYPE_BACKGROUND,
+                                0x00c8c8f0, 0, 2);
+    return text;
+}
+
+/* what an engine sends for UpdateLookupTable */
+static IBusLookupTable *
+create_lookup_table (gint n_candidates)
+{
+    static const gchar *candidates[N_CANDIDATES] = {
+        "你好", "拟好", "你号", "妮好", "泥号",
+        "你", "尼", "泥", "腻", "逆",
+    };
+    IBusLookupTable *table;
+    gint i;
+
+    table = ibus_lookup_table_new (5, 0, TRUE, FALSE);
+    for (i = 0; i < n_candidates; i++) {
+        ibus_lookup_table_append_candidate (table,
+                ibus_text_new_from_static_string (candidates[i % N_CANDIDATES]));
+    }
+    return table;
+}
+
+static void
+bench (const gchar        *name,
+       IBusSerializable   *object,
+       IBusSerializeFlags  flags)
+{
+    GTimer *timer;
+    IBusMessage *message;
+    IBusMessageIter iter;
+    IBusMessage *messages[N_ROUNDS];
+    gdouble serialize_time;
+    gdouble deserialize_time;
+    gint i;
+
+    timer = g_timer_new ();
+    for (i = 0; i < N_ROUNDS; i++) {
+        message = ibus_message_new_signal ("/org/freedesktop/IBus",
+                                           "org.freedesktop.IBus",
+                                           "Bench");
+        ibus_message_iter_init_append (message, &iter);
+        ibus_serializable_serialize_with_flags (object, &iter, flags);
+        messages[i] = message;
+    }
+    serialize_time = g_timer_elapsed (timer, NULL);
+
+    g_timer_start (timer);
+    for (i = 0; i < N_ROUNDS; i++) {
+        IBusSerializable *copy;
+        IBusError *error;
+        gboolean retval;
+
+        retval = ibus_message_get_args (messages[i],
+                                        &error,
+                                        IBUS_TYPE_SERIALIZABLE, &copy,
+                                        G_TYPE_INVALID);
+        g_assert (retval);
+        g_object_unref (copy);
+    }
+    deserialize_time = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    for (i = 0; i < N_ROUNDS; i++) {
+        ibus_message_unref (messages[i]);
+    }
+
+    g_print ("%14s %18.3f %18.3f\n",
+             name,
+             serialize_time * 1000000 / N_ROUNDS,
+             deserialize_time * 1000000 / N_ROUNDS);
+}
+
+int
+main (gint argc, gchar **argv)
+{
+    IBusSerializable *object;
+
+    g_type_init ();
+
+    g_print ("%14s %18s %18s\n", "payload", "serialize (us)", "deserialize (us)");
+
+    object = (IBusSerializable *) create_preedit ();
+    bench ("preedit", object, 0);
+    g_object_unref (object);
+
+    object = (IBusSerializable *) create_lookup_table (N_CANDIDATES);
+    bench ("lookup table", object, 0);
+    g_object_unref (object);
+
+    object = (IBusSerializable *) create_lookup_table (100);
+    bench ("100 candidates", object, 0);
+    g_object_unref (object);
+
+    /* as the daemon sends them to peers which read compact texts */
+    object = (IBusSerializable *) create_lookup_table (100);
+    bench ("100, compact", object, IBUS_SERIALIZE_COMPACT_TEXT);
+    g_object_unref (object);
+
+    return 0;
+}
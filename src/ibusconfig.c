@@ -34,7 +34,12 @@ enum {
 
 /* IBusConfigPriv */
 struct _IBusConfigPrivate {
-    gpointer pad;
+    /* section -> value table, NULL if the cache is disabled */
+    GHashTable *cache;
+    /* sections loaded completely by GetValues */
+    GHashTable *complete_sections;
+    guint cache_hits;
+    guint cache_misses;
 };
 typedef struct _IBusConfigPrivate IBusConfigPrivate;
 
@@ -63,6 +68,10 @@ static void      ibus_config_real_destroy  (IBusConfig         *config);
 
 static gboolean ibus_config_ibus_signal    (IBusProxy           *proxy,
                                             IBusMessage         *message);
+static void     ibus_config_cache_store    (IBusConfig          *config,
+                                            const gchar         *section,
+                                            const gchar         *name,
+                                            const GValue        *value);
 
 static IBusProxyClass  *parent_class = NULL;
 
@@ -142,11 +151,18 @@ ibus_config_init (IBusConfig *config)
 {
     IBusConfigPrivate *priv;
     priv = IBUS_CONFIG_GET_PRIVATE (config);
+
+    priv->cache = NULL;
+    priv->complete_sections = NULL;
+    priv->cache_hits = 0;
+    priv->cache_misses = 0;
 }
 
 static void
 ibus_config_real_destroy (IBusConfig *config)
 {
+    ibus_config_set_cache_enabled (config, FALSE);
+
     if (ibus_proxy_get_connection ((IBusProxy *) config) != NULL) {
         ibus_proxy_call ((IBusProxy *) config,
                          "Destroy",
@@ -185,6 +201,8 @@ ibus_config_ibus_signal (IBusProxy     *proxy,
             return FALSE;
         }
 
+        ibus_config_cache_store (config, section, name, &value);
+
         g_signal_emit (config,
                        config_signals[VALUE_CHANGED],
                        0,
@@ -212,10 +230,37 @@ ibus_config_get_value (IBusConfig  *config,
     g_assert (name != NULL);
     g_assert (value != NULL);
 
+    IBusConfigPrivate *priv;
     IBusMessage *reply;
     IBusError *error;
     gboolean retval;
 
+    priv = IBUS_CONFIG_GET_PRIVATE (config);
+
+    if (priv->cache != NULL) {
+        GHashTable *values;
+        GValue *cached = NULL;
+
+        values = (GHashTable *) g_hash_table_lookup (priv->cache, section);
+        if (values != NULL)
+            cached = (GValue *) g_hash_table_lookup (values, name);
+
+        if (cached != NULL) {
+            priv->cache_hits ++;
+            g_value_init (value, G_VALUE_TYPE (cached));
+            g_value_copy (cached, value);
+            return TRUE;
+        }
+
+        /* the whole section is known, so the value does not exist */
+        if (g_hash_table_lookup (priv->complete_sections, section) != NULL) {
+            priv->cache_hits ++;
+            return FALSE;
+        }
+
+        priv->cache_misses ++;
+    }
+
     reply = ibus_proxy_call_with_reply_and_block ((IBusProxy *) config,
                                                   "GetValue",
                                                   -1,
@@ -246,9 +291,124 @@ ibus_config_get_value (IBusConfig  *config,
         return FALSE;
     }
 
+    ibus_config_cache_store (config, section, name, value);
+
     return TRUE;
 }
 
+static GHashTable *
+ibus_config_call_get_values (IBusConfig  *config,
+                             const gchar *method,
+                             const gchar *section)
+{
+    IBusMessage *reply;
+    IBusMessageIter iter;
+    IBusError *error;
+    GHashTable *values = NULL;
+
+    reply = ibus_proxy_call_with_reply_and_block ((IBusProxy *) config,
+                                                  method,
+                                                  -1,
+                                                  &error,
+                                                  G_TYPE_STRING, &section,
+                                                  G_TYPE_INVALID);
+    if (reply == NULL) {
+        g_warning ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
+        return NULL;
+    }
+
+    if ((error = ibus_error_new_from_message (reply)) != NULL) {
+        g_warning ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
+        ibus_message_unref (reply);
+        return NULL;
+    }
+
+    if (ibus_message_iter_init (reply, &iter))
+        values = ibus_message_iter_get_value_table (&iter);
+    ibus_message_unref (reply);
+
+    if (values == NULL) {
+        g_warning ("%s: Can not parse reply of %s.", DBUS_ERROR_INVALID_ARGS, method);
+        return NULL;
+    }
+
+    return values;
+}
+
+GHashTable *
+ibus_config_get_values (IBusConfig  *config,
+                        const gchar *section)
+{
+    g_assert (IBUS_IS_CONFIG (config));
+    g_assert (section != NULL);
+
+    IBusConfigPrivate *priv;
+    GHashTable *values;
+
+    priv = IBUS_CONFIG_GET_PRIVATE (config);
+
+    values = ibus_config_call_get_values (config, "GetValues", section);
+
+    if (values != NULL && priv->cache != NULL) {
+        GHashTableIter iter;
+        gpointer name, value;
+
+        g_hash_table_iter_init (&iter, values);
+        while (g_hash_table_iter_next (&iter, &name, &value)) {
+            ibus_config_cache_store (config, section, name, value);
+        }
+        g_hash_table_replace (priv->complete_sections, g_strdup (section), GINT_TO_POINTER (1));
+    }
+
+    return values;
+}
+
+GHashTable *
+ibus_config_get_section (IBusConfig  *config,
+                         const gchar *section)
+{
+    g_assert (IBUS_IS_CONFIG (config));
+    g_assert (section != NULL);
+
+    IBusConfigPrivate *priv;
+    GHashTable *values;
+
+    priv = IBUS_CONFIG_GET_PRIVATE (config);
+
+    values = ibus_config_call_get_values (config, "GetSection", section);
+
+    if (values != NULL && priv->cache != NULL) {
+        GHashTableIter iter;
+        gpointer key, value;
+
+        g_hash_table_replace (priv->complete_sections, g_strdup (section), GINT_TO_POINTER (1));
+
+        g_hash_table_iter_init (&iter, values);
+        while (g_hash_table_iter_next (&iter, &key, &value)) {
+            gchar *name;
+
+            /* "sub/name" belongs to the section "section/sub" */
+            name = g_strrstr ((gchar *) key, "/");
+            if (name == NULL) {
+                ibus_config_cache_store (config, section, key, value);
+            }
+            else {
+                gchar *subsection;
+                subsection = g_strdup_printf ("%s/%.*s",
+                                              section,
+                                              (gint) (name - (gchar *) key),
+                                              (gchar *) key);
+                ibus_config_cache_store (config, subsection, name + 1, value);
+                g_hash_table_replace (priv->complete_sections, subsection, GINT_TO_POINTER (1));
+            }
+        }
+    }
+
+    return values;
+}
+
 gboolean
 ibus_config_set_value (IBusConfig   *config,
                        const gchar  *section,
@@ -269,5 +429,116 @@ ibus_config_set_value (IBusConfig   *config,
                               G_TYPE_VALUE, value,
                               G_TYPE_INVALID);
     g_assert (retval);
+
+    /* ValueChanged comes later, do not return the old value until then */
+    ibus_config_cache_store (config, section, name, value);
+
+    return TRUE;
+}
+
+gboolean
+ibus_config_set_values (IBusConfig  *config,
+                        const gchar *section,
+                        GHashTable  *values)
+{
+    g_assert (IBUS_IS_CONFIG (config));
+    g_assert (section != NULL);
+    g_assert (values != NULL);
+
+    IBusMessage *message;
+    IBusMessageIter iter;
+    GHashTableIter table_iter;
+    gpointer name, value;
+    gboolean retval;
+
+    message = ibus_message_new_method_call (ibus_proxy_get_name ((IBusProxy *) config),
+                                            ibus_proxy_get_path ((IBusProxy *) config),
+                                            ibus_proxy_get_interface ((IBusProxy *) config),
+                                            "SetValues");
+    ibus_message_iter_init_append (message, &iter);
+    ibus_message_iter_append (&iter, G_TYPE_STRING, &section);
+    ibus_message_iter_append_value_table (&iter, values);
+
+    retval = ibus_proxy_send ((IBusProxy *) config, message);
+    ibus_message_unref (message);
+
+    if (!retval)
+        return FALSE;
+
+    g_hash_table_iter_init (&table_iter, values);
+    while (g_hash_table_iter_next (&table_iter, &name, &value)) {
+        ibus_config_cache_store (config, section, name, value);
+    }
+
     return TRUE;
 }
+
+static void
+ibus_config_cache_store (IBusConfig   *config,
+                         const gchar  *section,
+                         const gchar  *name,
+                         const GValue *value)
+{
+    IBusConfigPrivate *priv;
+    GHashTable *values;
+    GValue *cached;
+
+    priv = IBUS_CONFIG_GET_PRIVATE (config);
+
+    if (priv->cache == NULL)
+        return;
+
+    values = (GHashTable *) g_hash_table_lookup (priv->cache, section);
+    if (values == NULL) {
+        values = ibus_value_table_new ();
+        g_hash_table_insert (priv->cache, g_strdup (section), values);
+    }
+
+    cached = g_slice_new0 (GValue);
+    g_value_init (cached, G_VALUE_TYPE (value));
+    g_value_copy (value, cached);
+    g_hash_table_replace (values, g_strdup (name), cached);
+}
+
+void
+ibus_config_set_cache_enabled (IBusConfig *config,
+                               gboolean    enabled)
+{
+    g_assert (IBUS_IS_CONFIG (config));
+
+    IBusConfigPrivate *priv;
+    priv = IBUS_CONFIG_GET_PRIVATE (config);
+
+    if (enabled && priv->cache == NULL) {
+        priv->cache = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             (GDestroyNotify) g_free,
+                                             (GDestroyNotify) g_hash_table_destroy);
+        priv->complete_sections = g_hash_table_new_full (g_str_hash,
+                                                         g_str_equal,
+                                                         (GDestroyNotify) g_free,
+                                                         NULL);
+    }
+    else if (!enabled && priv->cache != NULL) {
+        g_hash_table_destroy (priv->cache);
+        priv->cache = NULL;
+        g_hash_table_destroy (priv->complete_sections);
+        priv->complete_sections = NULL;
+    }
+}
+
+void
+ibus_config_get_cache_stats (IBusConfig *config,
+                             guint      *hits,
+                             guint      *misses)
+{
+    g_assert (IBUS_IS_CONFIG (config));
+
+    IBusConfigPrivate *priv;
+    priv = IBUS_CONFIG_GET_PRIVATE (config);
+
+    if (hits)
+        *hits = priv->cache_hits;
+    if (misses)
+        *misses = priv->cache_misses;
+}
@@ -65,6 +65,19 @@ gboolean         ibus_config_set_value      (IBusConfig         *config,
                                              const gchar        *section,
                                              const gchar        *name,
                                              const GValue       *value);
+GHashTable      *ibus_config_get_values     (IBusConfig         *config,
+                                             const gchar        *section);
+GHashTable      *ibus_config_get_section    (IBusConfig         *config,
+                                             const gchar        *section);
+gboolean         ibus_config_set_values     (IBusConfig         *config,
+                                             const gchar        *section,
+                                             GHashTable         *values);
+void             ibus_config_set_cache_enabled
+                                            (IBusConfig         *config,
+                                             gboolean            enabled);
+void             ibus_config_get_cache_stats(IBusConfig         *config,
+                                             guint              *hits,
+                                             guint              *misses);
 G_END_DECLS
 #endif
 
@@ -57,6 +57,18 @@ static gboolean ibus_config_service_get_value       (IBusConfigService      *con
                                                      const gchar            *name,
                                                      GValue                 *value,
                                                      IBusError             **error);
+static gboolean ibus_config_service_get_values      (IBusConfigService      *config,
+                                                     const gchar            *section,
+                                                     GHashTable             *values,
+                                                     IBusError             **error);
+static gboolean ibus_config_service_get_section     (IBusConfigService      *config,
+                                                     const gchar            *section,
+                                                     GHashTable             *values,
+                                                     IBusError             **error);
+static gboolean ibus_config_service_set_values      (IBusConfigService      *config,
+                                                     const gchar            *section,
+                                                     GHashTable             *values,
+                                                     IBusError             **error);
 
 static IBusServiceClass  *parent_class = NULL;
 
@@ -117,6 +129,9 @@ ibus_config_service_class_init (IBusConfigServiceClass *klass)
 
     klass->set_value = ibus_config_service_set_value;
     klass->get_value = ibus_config_service_get_value;
+    klass->get_values = ibus_config_service_get_values;
+    klass->get_section = ibus_config_service_get_section;
+    klass->set_values = ibus_config_service_set_values;
 
     g_object_class_install_property (gobject_class,
                     PROP_CONNECTION,
@@ -253,6 +268,77 @@ ibus_config_service_ibus_message (IBusConfigService     *config,
             g_value_unset (&value);
         }
     }
+    else if (ibus_message_is_method_call (message, IBUS_INTERFACE_CONFIG, "GetValues") ||
+             ibus_message_is_method_call (message, IBUS_INTERFACE_CONFIG, "GetSection")) {
+        gchar *section;
+        GHashTable *values;
+        IBusMessageIter iter;
+        IBusError *error = NULL;
+        gboolean retval;
+
+        retval = ibus_message_get_args (message,
+                                        &error,
+                                        G_TYPE_STRING, &section,
+                                        G_TYPE_INVALID);
+
+        if (!retval) {
+            reply = ibus_message_new_error (message,
+                                            error->name,
+                                            error->message);
+            ibus_error_free (error);
+        }
+        else {
+            values = ibus_value_table_new ();
+            if (ibus_message_is_method_call (message, IBUS_INTERFACE_CONFIG, "GetValues")) {
+                retval = IBUS_CONFIG_SERVICE_GET_CLASS (config)->get_values (config, section, values, &error);
+            }
+            else {
+                retval = IBUS_CONFIG_SERVICE_GET_CLASS (config)->get_section (config, section, values, &error);
+            }
+
+            if (!retval) {
+                reply = ibus_message_new_error (message,
+                                                error->name,
+                                                error->message);
+                ibus_error_free (error);
+            }
+            else {
+                reply = ibus_message_new_method_return (message);
+                ibus_message_iter_init_append (reply, &iter);
+                ibus_message_iter_append_value_table (&iter, values);
+            }
+            g_hash_table_destroy (values);
+        }
+    }
+    else if (ibus_message_is_method_call (message, IBUS_INTERFACE_CONFIG, "SetValues")) {
+        gchar *section;
+        GHashTable *values = NULL;
+        IBusMessageIter iter;
+        IBusError *error = NULL;
+
+        if (ibus_message_iter_init (message, &iter) &&
+            ibus_message_iter_get (&iter, G_TYPE_STRING, &section)) {
+            values = ibus_message_iter_get_value_table (&iter);
+        }
+
+        if (values == NULL) {
+            reply = ibus_message_new_error_printf (message,
+                                                   DBUS_ERROR_INVALID_ARGS,
+                                                   "Can not parse arguments of SetValues");
+        }
+        else if (!IBUS_CONFIG_SERVICE_GET_CLASS (config)->set_values (config, section, values, &error)) {
+            reply = ibus_message_new_error (message,
+                                            error->name,
+                                            error->message);
+            ibus_error_free (error);
+        }
+        else {
+            reply = ibus_message_new_method_return (message);
+        }
+
+        if (values != NULL)
+            g_hash_table_destroy (values);
+    }
 
     if (reply) {
         ibus_connection_send (connection, reply);
@@ -293,6 +379,52 @@ ibus_config_service_get_value (IBusConfigService *config,
     return FALSE;
 }
 
+static gboolean
+ibus_config_service_get_values (IBusConfigService *config,
+                                const gchar       *section,
+                                GHashTable        *values,
+                                IBusError        **error)
+{
+    if (error) {
+        *error = ibus_error_new_from_printf (DBUS_ERROR_FAILED,
+                                             "Can not get values [%s]",
+                                             section);
+    }
+    return FALSE;
+}
+
+static gboolean
+ibus_config_service_get_section (IBusConfigService *config,
+                                 const gchar       *section,
+                                 GHashTable        *values,
+                                 IBusError        **error)
+{
+    /* without a backend which knows the subsections, at least return
+     * the values of the section itself */
+    return IBUS_CONFIG_SERVICE_GET_CLASS (config)->get_values (config, section, values, error);
+}
+
+static gboolean
+ibus_config_service_set_values (IBusConfigService *config,
+                                const gchar       *section,
+                                GHashTable        *values,
+                                IBusError        **error)
+{
+    GHashTableIter iter;
+    gpointer name, value;
+
+    g_hash_table_iter_init (&iter, values);
+    while (g_hash_table_iter_next (&iter, &name, &value)) {
+        if (!IBUS_CONFIG_SERVICE_GET_CLASS (config)->set_value (config,
+                                                                section,
+                                                                (const gchar *) name,
+                                                                (const GValue *) value,
+                                                                error))
+            return FALSE;
+    }
+    return TRUE;
+}
+
 void
 ibus_config_service_value_changed (IBusConfigService  *config,
                                    const gchar        *section,
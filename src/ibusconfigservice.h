@@ -66,10 +66,25 @@ struct _IBusConfigServiceClass {
                                const gchar          *name,
                                GValue               *value,
                                IBusError           **error);
+    /* fill values (see ibus_value_table_new) with all values of section */
+    gboolean    (* get_values)(IBusConfigService    *config,
+                               const gchar          *section,
+                               GHashTable           *values,
+                               IBusError           **error);
+    /* like get_values, values of subsections are named "subsection/name" */
+    gboolean    (* get_section)
+                              (IBusConfigService    *config,
+                               const gchar          *section,
+                               GHashTable           *values,
+                               IBusError           **error);
+    gboolean    (* set_values)(IBusConfigService    *config,
+                               const gchar          *section,
+                               GHashTable           *values,
+                               IBusError           **error);
 
     /*< private >*/
     /* padding */
-    gpointer pdummy[14];
+    gpointer pdummy[11];
 };
 
 GType                ibus_config_service_get_type   (void);
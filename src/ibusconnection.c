@@ -172,6 +172,8 @@ ibus_connection_destroy (IBusConnection *connection)
         dbus_connection_remove_filter (priv->connection,
                     (DBusHandleMessageFunction) _connection_handle_message_cb,
                     connection);
+        /* take the connection back from an I/O thread before closing it */
+        dbus_connection_setup (priv->connection, NULL);
     }
 
     if (!priv->shared && priv->connection) {
@@ -346,6 +348,8 @@ void ibus_connection_close (IBusConnection     *connection)
     IBusConnectionPrivate *priv;
     priv = IBUS_CONNECTION_GET_PRIVATE (connection);
 
+    /* take the connection back from an I/O thread before closing it */
+    dbus_connection_setup (priv->connection, NULL);
     dbus_connection_close (priv->connection);
 }
 
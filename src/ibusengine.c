@@ -56,6 +56,14 @@ enum {
 struct _IBusEnginePrivate {
     gchar *name;
     IBusConnection *connection;
+
+    /* the lookup table as last sent, and the number of full updates */
+    IBusLookupTable *lookup_table;
+    gboolean lookup_table_visible;
+    guint lookup_table_generation;
+
+    /* the daemon asked for deltas with EnableLookupTableDelta */
+    gboolean lookup_table_delta;
 };
 typedef struct _IBusEnginePrivate IBusEnginePrivate;
 
@@ -495,6 +503,10 @@ ibus_engine_init (IBusEngine *engine)
 
     priv->name = NULL;
     priv->connection = NULL;
+    priv->lookup_table = NULL;
+    priv->lookup_table_visible = FALSE;
+    priv->lookup_table_generation = 0;
+    priv->lookup_table_delta = FALSE;
 }
 
 static void
@@ -505,6 +517,11 @@ ibus_engine_destroy (IBusEngine *engine)
 
     g_free (priv->name);
 
+    if (priv->lookup_table) {
+        g_object_unref (priv->lookup_table);
+        priv->lookup_table = NULL;
+    }
+
     if (priv->connection) {
         g_object_unref (priv->connection);
         priv->connection = NULL;
@@ -657,6 +674,61 @@ ibus_engine_ibus_message (IBusEngine     *engine,
         ibus_message_unref (error_message);
         return TRUE;
     }
+    else if (ibus_message_is_method_call (message, IBUS_INTERFACE_ENGINE, "ProcessKeyEvents")) {
+        IBusMessageIter iter;
+        GArray *keys = NULL;
+        guint32 *handled;
+        guint n_keys, processed;
+
+        /* keys is a list of (keyval, state) pairs. They are processed in
+         * order and processing stops at the first key the engine does not
+         * handle, so the client can deal with that key before any output
+         * of the following ones. */
+        if (ibus_message_iter_init (message, &iter))
+            keys = ibus_message_iter_get_uint_array (&iter);
+
+        if (keys == NULL || keys->len % 2 != 0) {
+            if (keys)
+                g_array_free (keys, TRUE);
+            error_message = ibus_message_new_error_printf (message,
+                            DBUS_ERROR_INVALID_ARGS,
+                            "%s.%s: Can not match signature (au) of method",
+                            IBUS_INTERFACE_ENGINE, "ProcessKeyEvents");
+            ibus_connection_send (connection, error_message);
+            ibus_message_unref (error_message);
+            return TRUE;
+        }
+
+        n_keys = keys->len / 2;
+        handled = g_new0 (guint32, (n_keys + 31) / 32);
+
+        processed = 0;
+        while (processed < n_keys) {
+            gboolean retval = FALSE;
+            guint k = processed++;
+
+            g_signal_emit (engine,
+                           engine_signals[PROCESS_KEY_EVENT],
+                           0,
+                           g_array_index (keys, guint32, k * 2),
+                           g_array_index (keys, guint32, k * 2 + 1),
+                           &retval);
+            if (!retval)
+                break;
+            handled[k / 32] |= 1u << (k % 32);
+        }
+
+        return_message = ibus_message_new_method_return (message);
+        ibus_message_iter_init_append (return_message, &iter);
+        ibus_message_iter_append (&iter, G_TYPE_UINT, &processed);
+        ibus_message_iter_append_uint_array (&iter, handled, (n_keys + 31) / 32);
+        ibus_connection_send (connection, return_message);
+        ibus_message_unref (return_message);
+
+        g_free (handled);
+        g_array_free (keys, TRUE);
+        return TRUE;
+    }
     else if (ibus_message_is_method_call (message, IBUS_INTERFACE_ENGINE, "PropertyActivate")) {
         gchar *name;
         guint state;
@@ -826,6 +898,29 @@ ibus_engine_ibus_message (IBusEngine     *engine,
         ibus_message_unref (error_message);
         return TRUE;
     }
+    else if (ibus_message_is_method_call (message, IBUS_INTERFACE_ENGINE, "EnableLookupTableDelta")) {
+        priv->lookup_table_delta = TRUE;
+
+        return_message = ibus_message_new_method_return (message);
+        ibus_connection_send (connection, return_message);
+        ibus_message_unref (return_message);
+        return TRUE;
+    }
+    else if (ibus_message_is_method_call (message, IBUS_INTERFACE_ENGINE, "RequestLookupTable")) {
+        /* the daemon lost track of the table, send it in full */
+        if (priv->lookup_table != NULL) {
+            IBusLookupTable *table = priv->lookup_table;
+
+            priv->lookup_table = NULL;
+            ibus_engine_update_lookup_table (engine, table, priv->lookup_table_visible);
+            g_object_unref (table);
+        }
+
+        return_message = ibus_message_new_method_return (message);
+        ibus_connection_send (connection, return_message);
+        ibus_message_unref (return_message);
+        return TRUE;
+    }
     else if (ibus_message_is_method_call (message, IBUS_INTERFACE_ENGINE, "Destroy")) {
         return_message = ibus_message_new_method_return (message);
 
@@ -1036,11 +1131,55 @@ ibus_engine_update_lookup_table (IBusEngine        *engine,
                                  IBusLookupTable   *table,
                                  gboolean           visible)
 {
-    _send_signal (engine,
-                  "UpdateLookupTable",
-                  IBUS_TYPE_LOOKUP_TABLE, &table,
-                  G_TYPE_BOOLEAN, &visible,
-                  G_TYPE_INVALID);
+    g_assert (IBUS_IS_ENGINE (engine));
+    g_assert (IBUS_IS_LOOKUP_TABLE (table));
+
+    IBusEnginePrivate *priv;
+    IBusLookupTableDelta *delta = NULL;
+
+    priv = IBUS_ENGINE_GET_PRIVATE (engine);
+
+    if (priv->lookup_table_delta && priv->lookup_table != NULL) {
+        delta = ibus_lookup_table_diff (priv->lookup_table, table);
+        /* a delta replacing every candidate is not smaller than the table */
+        if (delta->candidates->len > 0 &&
+            delta->candidates->len == table->candidates->len) {
+            ibus_lookup_table_delta_free (delta);
+            delta = NULL;
+        }
+    }
+
+    if (delta != NULL) {
+        IBusMessage *message;
+        IBusMessageIter iter;
+
+        delta->generation = priv->lookup_table_generation;
+
+        message = ibus_message_new_signal (ibus_service_get_path ((IBusService *) engine),
+                                           IBUS_INTERFACE_ENGINE,
+                                           "UpdateLookupTableDelta");
+        ibus_message_iter_init_append (message, &iter);
+        ibus_lookup_table_delta_serialize (delta, &iter, 0);
+        ibus_message_iter_append (&iter, G_TYPE_BOOLEAN, &visible);
+        ibus_connection_send (priv->connection, message);
+        ibus_message_unref (message);
+
+        ibus_lookup_table_delta_free (delta);
+    }
+    else {
+        _send_signal (engine,
+                      "UpdateLookupTable",
+                      IBUS_TYPE_LOOKUP_TABLE, &table,
+                      G_TYPE_BOOLEAN, &visible,
+                      G_TYPE_INVALID);
+        priv->lookup_table_generation ++;
+    }
+
+    /* engines modify their table in place, keep the sent state */
+    if (priv->lookup_table != NULL)
+        g_object_unref (priv->lookup_table);
+    priv->lookup_table = ibus_lookup_table_dup (table);
+    priv->lookup_table_visible = visible;
 }
 
 void
@@ -1074,6 +1213,10 @@ ibus_engine_update_lookup_table_fast (IBusEngine        *engine,
 
 void ibus_engine_show_lookup_table (IBusEngine *engine)
 {
+    IBusEnginePrivate *priv;
+    priv = IBUS_ENGINE_GET_PRIVATE (engine);
+
+    priv->lookup_table_visible = TRUE;
     _send_signal (engine,
                   "ShowLookupTable",
                   G_TYPE_INVALID);
@@ -1081,6 +1224,10 @@ void ibus_engine_show_lookup_table (IBusEngine *engine)
 
 void ibus_engine_hide_lookup_table (IBusEngine *engine)
 {
+    IBusEnginePrivate *priv;
+    priv = IBUS_ENGINE_GET_PRIVATE (engine);
+
+    priv->lookup_table_visible = FALSE;
     _send_signal (engine,
                   "HideLookupTable",
                   G_TYPE_INVALID);
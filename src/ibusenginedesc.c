@@ -110,6 +110,7 @@ ibus_engine_desc_init (IBusEngineDesc *desc)
     desc->icon = NULL;
     desc->layout = NULL;
     desc->rank = 0;
+    desc->shared = FALSE;
 }
 
 static void
@@ -227,6 +228,7 @@ ibus_engine_desc_copy (IBusEngineDesc       *dest,
     dest->author        = g_strdup (src->author);
     dest->icon          = g_strdup (src->icon);
     dest->layout        = g_strdup (src->layout);
+    dest->shared        = src->shared;
 
     return TRUE;
 }
@@ -265,6 +267,10 @@ ibus_engine_desc_output (IBusEngineDesc *desc,
     OUTPUT_ENTRY_1(layout);
     g_string_append_indent (output, indent + 1);
     g_string_append_printf (output, "<rank>%u</rank>\n", desc->rank);
+    if (desc->shared) {
+        g_string_append_indent (output, indent + 1);
+        g_string_append (output, "<shared>true</shared>\n");
+    }
 #undef OUTPUT_ENTRY
 #undef OUTPUT_ENTRY_1
     g_string_append_indent (output, indent);
@@ -302,6 +308,10 @@ ibus_engine_desc_parse_xml_node (IBusEngineDesc *desc,
             desc->rank = atoi (sub_node->text);
             continue;
         }
+        if (g_strcmp0 (sub_node->name , "shared") == 0) {
+            desc->shared = g_strcmp0 (sub_node->text, "true") == 0;
+            continue;
+        }
         g_warning ("<engines> element contains invalidate element <%s>", sub_node->name);
     }
     return TRUE;
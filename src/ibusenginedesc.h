@@ -75,6 +75,8 @@ typedef struct _BusComponent BusComponent;
  * @layout: Keyboard layout
  * @rank: Preference rank among engines, the highest ranked IME will put in
  * the front.
+ * @shared: TRUE if one instance of the engine may serve several input
+ * contexts, one at a time.
  *
  * Input method engine description data.
  */
@@ -92,6 +94,7 @@ struct _IBusEngineDesc {
     gchar *icon;
     gchar *layout;
     guint  rank;
+    gboolean shared;
 };
 
 struct _IBusEngineDescClass {
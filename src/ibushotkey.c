@@ -30,7 +30,11 @@ enum {
     LAST_SIGNAL,
 };
 
+/* initial number of slots in the hotkey table, always a power of 2 */
+#define IBUS_HOTKEY_TABLE_MIN_SIZE  (16)
+
 typedef struct _IBusHotkey IBusHotkey;
+typedef struct _IBusHotkeySlot IBusHotkeySlot;
 typedef struct _IBusHotkeyEvent IBusHotkeyEvent;
 typedef struct _IBusHotkeyProfilePrivate IBusHotkeyProfilePrivate;
 
@@ -39,13 +43,24 @@ struct _IBusHotkey {
     guint   modifiers;
 };
 
+/* a slot of the open addressed hotkey table, event is 0 if it is free */
+struct _IBusHotkeySlot {
+    guint   keyval;
+    guint   modifiers;
+    GQuark  event;
+};
+
 struct _IBusHotkeyEvent {
     GQuark event;
     GList *hotkeys;
 };
 
 struct _IBusHotkeyProfilePrivate {
-    GTree *hotkeys;
+    /* the filter runs for every key the user types, so the hotkeys are
+     * kept in a linear probing table indexed by keyval and modifiers */
+    IBusHotkeySlot *table;
+    guint   table_size;
+    guint   n_hotkeys;
     GArray *events;
     guint   mask;
 };
@@ -148,24 +163,124 @@ ibus_hotkey_copy (const IBusHotkey *src)
     return ibus_hotkey_new (src->keyval, src->modifiers);
 }
 
-static gint
-ibus_hotkey_cmp_with_data (IBusHotkey *hotkey1,
-                           IBusHotkey *hotkey2,
-                           gpointer    user_data)
+static inline guint
+ibus_hotkey_hash (guint keyval,
+                  guint modifiers)
 {
-    gint retval;
+    guint h;
 
-    if (hotkey1 == hotkey2)
-        return 0;
+    /* keyvals are mostly small and dense, mix them before masking */
+    h = keyval * 2654435761U;
+    h ^= (modifiers * 40503U) + (h >> 16);
+    return h;
+}
+
+/* returns the slot holding keyval and modifiers, or the free slot ending
+ * the probe sequence */
+static IBusHotkeySlot *
+ibus_hotkey_profile_find_slot (IBusHotkeyProfilePrivate *priv,
+                               guint                     keyval,
+                               guint                     modifiers)
+{
+    guint mask = priv->table_size - 1;
+    guint i;
+
+    i = ibus_hotkey_hash (keyval, modifiers) & mask;
+    while (priv->table[i].event != 0) {
+        if (priv->table[i].keyval == keyval &&
+            priv->table[i].modifiers == modifiers)
+            break;
+        i = (i + 1) & mask;
+    }
+    return &priv->table[i];
+}
+
+static void
+ibus_hotkey_profile_resize_table (IBusHotkeyProfilePrivate *priv,
+                                  guint                     size)
+{
+    IBusHotkeySlot *old_table = priv->table;
+    guint old_size = priv->table_size;
+    guint i;
+
+    priv->table = g_new0 (IBusHotkeySlot, size);
+    priv->table_size = size;
+
+    for (i = 0; i < old_size; i++) {
+        if (old_table[i].event != 0) {
+            *ibus_hotkey_profile_find_slot (priv,
+                                            old_table[i].keyval,
+                                            old_table[i].modifiers) = old_table[i];
+        }
+    }
+    g_free (old_table);
+}
+
+static void
+ibus_hotkey_profile_insert_slot (IBusHotkeyProfilePrivate *priv,
+                                 guint                     keyval,
+                                 guint                     modifiers,
+                                 GQuark                    event)
+{
+    IBusHotkeySlot *slot;
 
-    retval = hotkey1->keyval - hotkey2->keyval;
-    if (retval == 0)
-        retval = hotkey1->modifiers - hotkey2->modifiers;
+    /* keep the table at most half full, probe sequences stay short */
+    if ((priv->n_hotkeys + 1) * 2 > priv->table_size)
+        ibus_hotkey_profile_resize_table (priv, priv->table_size * 2);
 
-    return retval;
+    slot = ibus_hotkey_profile_find_slot (priv, keyval, modifiers);
+    g_assert (slot->event == 0);
+
+    slot->keyval = keyval;
+    slot->modifiers = modifiers;
+    slot->event = event;
+    priv->n_hotkeys ++;
 }
 
+static void
+ibus_hotkey_profile_remove_slot (IBusHotkeyProfilePrivate *priv,
+                                 IBusHotkeySlot           *slot)
+{
+    guint mask = priv->table_size - 1;
+    guint i, j, k;
+
+    /* shift the following entries of the probe sequence back instead of
+     * leaving tombstones, so a lookup still stops at the first free slot */
+    i = slot - priv->table;
+    j = i;
+    while (TRUE) {
+        j = (j + 1) & mask;
+        if (priv->table[j].event == 0)
+            break;
+        k = ibus_hotkey_hash (priv->table[j].keyval,
+                              priv->table[j].modifiers) & mask;
+        /* move j to i unless its home k lies cyclically in (i, j] */
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        priv->table[i] = priv->table[j];
+        i = j;
+    }
+    priv->table[i].event = 0;
+    priv->n_hotkeys --;
+}
+
+static IBusHotkeyEvent *
+ibus_hotkey_profile_find_event (IBusHotkeyProfilePrivate *priv,
+                                GQuark                    event,
+                                gint                     *index)
+{
+    gint i;
 
+    for (i = 0; i < priv->events->len; i++) {
+        IBusHotkeyEvent *p = &g_array_index (priv->events, IBusHotkeyEvent, i);
+        if (p->event == event) {
+            if (index)
+                *index = i;
+            return p;
+        }
+    }
+    return NULL;
+}
 
 GType
 ibus_hotkey_profile_get_type (void)
@@ -234,10 +349,9 @@ ibus_hotkey_profile_init (IBusHotkeyProfile *profile)
     IBusHotkeyProfilePrivate *priv;
     priv = IBUS_HOTKEY_PROFILE_GET_PRIVATE (profile);
 
-    priv->hotkeys = g_tree_new_full ((GCompareDataFunc) ibus_hotkey_cmp_with_data,
-                                     NULL,
-                                     (GDestroyNotify) ibus_hotkey_free,
-                                     NULL);
+    priv->table = g_new0 (IBusHotkeySlot, IBUS_HOTKEY_TABLE_MIN_SIZE);
+    priv->table_size = IBUS_HOTKEY_TABLE_MIN_SIZE;
+    priv->n_hotkeys = 0;
     priv->events = g_array_new (TRUE, TRUE, sizeof (IBusHotkeyEvent));
 
     priv->mask = IBUS_SHIFT_MASK |
@@ -252,9 +366,11 @@ ibus_hotkey_profile_destroy (IBusHotkeyProfile *profile)
     IBusHotkeyProfilePrivate *priv;
     priv = IBUS_HOTKEY_PROFILE_GET_PRIVATE (profile);
 
-    if (priv->hotkeys) {
-        g_tree_destroy (priv->hotkeys);
-        priv->hotkeys = NULL;
+    if (priv->table) {
+        g_free (priv->table);
+        priv->table = NULL;
+        priv->table_size = 0;
+        priv->n_hotkeys = 0;
     }
 
     if (priv->events) {
@@ -263,8 +379,8 @@ ibus_hotkey_profile_destroy (IBusHotkeyProfile *profile)
         priv->events = NULL;
 
         while (p->event != 0) {
-            if (p->hotkeys)
-                g_list_free (p->hotkeys);
+            g_list_foreach (p->hotkeys, (GFunc) ibus_hotkey_free, NULL);
+            g_list_free (p->hotkeys);
             p ++;
         }
         g_free (events);
@@ -336,31 +452,26 @@ ibus_hotkey_profile_add_hotkey (IBusHotkeyProfile *profile,
     IBusHotkeyProfilePrivate *priv;
     priv = IBUS_HOTKEY_PROFILE_GET_PRIVATE (profile);
 
-    IBusHotkey *hotkey = ibus_hotkey_new (keyval, modifiers);
+    g_return_val_if_fail (event != 0, FALSE);
 
     /* has the same hotkey in profile */
-    if (g_tree_lookup (priv->hotkeys, hotkey) != NULL) {
-        ibus_hotkey_free (hotkey);
+    if (ibus_hotkey_profile_find_slot (priv, keyval, modifiers)->event != 0) {
         g_return_val_if_reached (FALSE);
     }
 
-    g_tree_insert (priv->hotkeys, (gpointer) hotkey, GUINT_TO_POINTER (event));
+    ibus_hotkey_profile_insert_slot (priv, keyval, modifiers, event);
 
-    gint i;
-    IBusHotkeyEvent *p = NULL;
-    for ( i = 0; i < priv->events->len; i++) {
-        p = &g_array_index (priv->events, IBusHotkeyEvent, i);
-        if (p->event == event)
-            break;
-    }
+    IBusHotkeyEvent *p;
+    p = ibus_hotkey_profile_find_event (priv, event, NULL);
 
-    if (i >= priv->events->len) {
+    if (p == NULL) {
+        gint i = priv->events->len;
         g_array_set_size (priv->events, i + 1);
         p = &g_array_index (priv->events, IBusHotkeyEvent, i);
         p->event = event;
     }
 
-    p->hotkeys = g_list_append (p->hotkeys, hotkey);
+    p->hotkeys = g_list_append (p->hotkeys, ibus_hotkey_new (keyval, modifiers));
 
     return TRUE;
 }
@@ -389,39 +500,33 @@ ibus_hotkey_profile_remove_hotkey (IBusHotkeyProfile *profile,
     IBusHotkeyProfilePrivate *priv;
     priv = IBUS_HOTKEY_PROFILE_GET_PRIVATE (profile);
 
-    IBusHotkey hotkey = {
-        .keyval = keyval,
-        .modifiers = modifiers
-    };
-
-    IBusHotkey *p1;
-    GQuark event;
-    gboolean retval;
+    IBusHotkeySlot *slot;
+    IBusHotkeyEvent *p;
+    GList *list;
+    gint i;
 
-    retval = g_tree_lookup_extended (priv->hotkeys,
-                                     &hotkey,
-                                     (gpointer)&p1,
-                                     (gpointer)&event);
+    slot = ibus_hotkey_profile_find_slot (priv, keyval, modifiers);
 
-    if (!retval)
+    if (slot->event == 0)
         return FALSE;
 
-    gint i;
-    IBusHotkeyEvent *p2 = NULL;
-    for ( i = 0; i < priv->events->len; i++) {
-        p2 = &g_array_index (priv->events, IBusHotkeyEvent, i);
-        if (p2->event == event)
+    p = ibus_hotkey_profile_find_event (priv, slot->event, &i);
+    g_assert (p != NULL);
+
+    for (list = p->hotkeys; list != NULL; list = list->next) {
+        IBusHotkey *hotkey = (IBusHotkey *) list->data;
+        if (hotkey->keyval == keyval && hotkey->modifiers == modifiers)
             break;
     }
+    g_assert (list != NULL);
 
-    g_assert (p2->event == event);
-
-    p2->hotkeys = g_list_remove (p2->hotkeys, p1);
-    if (p2->hotkeys == NULL) {
+    ibus_hotkey_free ((IBusHotkey *) list->data);
+    p->hotkeys = g_list_delete_link (p->hotkeys, list);
+    if (p->hotkeys == NULL) {
         g_array_remove_index_fast (priv->events, i);
     }
 
-    g_tree_remove (priv->hotkeys, p1);
+    ibus_hotkey_profile_remove_slot (priv, slot);
 
     return TRUE;
 }
@@ -433,20 +538,21 @@ ibus_hotkey_profile_remove_hotkey_by_event (IBusHotkeyProfile *profile,
     IBusHotkeyProfilePrivate *priv;
     priv = IBUS_HOTKEY_PROFILE_GET_PRIVATE (profile);
 
+    IBusHotkeyEvent *p;
+    GList *list;
     gint i;
-    IBusHotkeyEvent *p = NULL;
-    for ( i = 0; i < priv->events->len; i++) {
-        p = &g_array_index (priv->events, IBusHotkeyEvent, i);
-        if (p->event == event)
-            break;
-    }
 
-    if (p == NULL || p->event != event)
+    p = ibus_hotkey_profile_find_event (priv, event, &i);
+
+    if (p == NULL)
         return FALSE;
 
-    GList *list;
     for (list = p->hotkeys; list != NULL; list = list->next) {
-        g_tree_remove (priv->hotkeys, (IBusHotkey *)list->data);
+        IBusHotkey *hotkey = (IBusHotkey *) list->data;
+
+        ibus_hotkey_profile_remove_slot (priv,
+            ibus_hotkey_profile_find_slot (priv, hotkey->keyval, hotkey->modifiers));
+        ibus_hotkey_free (hotkey);
     }
 
     g_list_free (p->hotkeys);
@@ -466,16 +572,19 @@ ibus_hotkey_profile_filter_key_event (IBusHotkeyProfile *profile,
     IBusHotkeyProfilePrivate *priv;
     priv = IBUS_HOTKEY_PROFILE_GET_PRIVATE (profile);
 
-    IBusHotkey hotkey = {
-        .keyval = keyval,
-        .modifiers = modifiers & priv->mask,
-    };
+    if (priv->n_hotkeys == 0)
+        return 0;
 
-    if ((modifiers & IBUS_RELEASE_MASK) && keyval != prev_keyval) {
+    /* a release triggers a hotkey only right after the press of the same
+     * key, so releasing Shift after Shift+a does not toggle anything */
+    if ((modifiers & IBUS_RELEASE_MASK) &&
+        (keyval != prev_keyval || (prev_modifiers & IBUS_RELEASE_MASK))) {
         return 0;
     }
 
-    GQuark event = (GQuark) GPOINTER_TO_UINT (g_tree_lookup (priv->hotkeys, &hotkey));
+    GQuark event = ibus_hotkey_profile_find_slot (priv,
+                                                  keyval,
+                                                  modifiers & priv->mask)->event;
 
     if (event != 0) {
         g_signal_emit (profile, profile_signals[TRIGGER], event, event, user_data);
@@ -483,3 +592,14 @@ ibus_hotkey_profile_filter_key_event (IBusHotkeyProfile *profile,
 
     return event;
 }
+
+GQuark
+ibus_hotkey_profile_lookup_hotkey (IBusHotkeyProfile *profile,
+                                   guint              keyval,
+                                   guint              modifiers)
+{
+    IBusHotkeyProfilePrivate *priv;
+    priv = IBUS_HOTKEY_PROFILE_GET_PRIVATE (profile);
+
+    return ibus_hotkey_profile_find_slot (priv, keyval, modifiers & priv->mask)->event;
+}
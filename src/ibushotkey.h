@@ -83,6 +83,10 @@ GQuark           ibus_hotkey_profile_filter_key_event
                                                  guint               prev_keyval,
                                                  guint               prev_modifiers,
                                                  gpointer            user_data);
+GQuark           ibus_hotkey_profile_lookup_hotkey
+                                                (IBusHotkeyProfile  *profile,
+                                                 guint               keyval,
+                                                 guint               modifiers);
 
 G_END_DECLS
 #endif
@@ -20,6 +20,7 @@
 #include "ibusshare.h"
 #include "ibusinternal.h"
 #include "ibusinputcontext.h"
+#include "ibuskeyring.h"
 #include "ibusattribute.h"
 #include "ibuslookuptable.h"
 #include "ibusproperty.h"
@@ -27,6 +28,9 @@
 #define IBUS_INPUT_CONTEXT_GET_PRIVATE(o)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((o), IBUS_TYPE_INPUT_CONTEXT, IBusInputContextPrivate))
 
+/* used when no timeout is given, as libdbus does */
+#define IBUS_KEY_RING_TIMEOUT   (25000)
+
 enum {
     ENABLED,
     DISABLED,
@@ -53,7 +57,14 @@ enum {
 
 /* BusInputContextPriv */
 struct _IBusInputContextPrivate {
-    void *pad;
+    /* key events through shared memory, see ibus_input_context_open_key_ring */
+    IBusKeyRing *key_ring;
+    GHashTable *key_ring_calls;
+    guint32 key_ring_serial;
+    /* replies waiting for the signals the daemon sent ahead of them */
+    GQueue *key_ring_replies;
+    /* serial of the last signal of the daemon dispatched */
+    guint32 message_serial;
 };
 typedef struct _IBusInputContextPrivate IBusInputContextPrivate;
 
@@ -66,6 +77,18 @@ static void     ibus_input_context_init         (IBusInputContext       *context
 static void     ibus_input_context_real_destroy (IBusInputContext       *context);
 static gboolean ibus_input_context_ibus_signal  (IBusProxy              *proxy,
                                                  DBusMessage            *message);
+static gboolean ibus_input_context_emit_signal  (IBusInputContext       *context,
+                                                 DBusMessage            *message);
+static void     ibus_input_context_dispatch_key_ring_replies
+                                                (IBusInputContext       *context);
+static gboolean ibus_input_context_push_key_ring
+                                                (IBusInputContext       *context,
+                                                 guint32                 keyval,
+                                                 guint32                 state,
+                                                 gint                    timeout,
+                                                 IBusInputContextKeyEventFunc
+                                                                         callback,
+                                                 gpointer                user_data);
 
 static IBusProxyClass  *parent_class = NULL;
 
@@ -323,11 +346,19 @@ ibus_input_context_init (IBusInputContext *context)
 {
     IBusInputContextPrivate *priv;
     priv = IBUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    priv->key_ring = NULL;
+    priv->key_ring_calls = NULL;
+    priv->key_ring_serial = 0;
+    priv->key_ring_replies = NULL;
+    priv->message_serial = 0;
 }
 
 static void
 ibus_input_context_real_destroy (IBusInputContext *context)
 {
+    ibus_input_context_close_key_ring (context);
+
     if (ibus_proxy_get_connection ((IBusProxy *) context) != NULL) {
         ibus_proxy_call (IBUS_PROXY (context),
                          "Destroy",
@@ -345,11 +376,29 @@ ibus_input_context_ibus_signal (IBusProxy           *proxy,
     g_assert (message != NULL);
 
     IBusInputContext *context;
-    IBusError *error = NULL;
-    gint i;
+    gboolean retval;
+
+    IBusInputContextPrivate *priv;
+    priv = IBUS_INPUT_CONTEXT_GET_PRIVATE (proxy);
 
     context = IBUS_INPUT_CONTEXT (proxy);
 
+    retval = ibus_input_context_emit_signal (context, message);
+
+    /* key ring replies held back for this signal follow it */
+    priv->message_serial = dbus_message_get_serial (message);
+    ibus_input_context_dispatch_key_ring_replies (context);
+
+    return retval;
+}
+
+static gboolean
+ibus_input_context_emit_signal (IBusInputContext    *context,
+                                IBusMessage         *message)
+{
+    IBusError *error = NULL;
+    gint i;
+
     static const struct {
         const gchar *member;
         guint signal_id;
@@ -541,6 +590,32 @@ failed:
     return FALSE;
 }
 
+static gboolean
+ibus_input_context_key_event_reply (IBusMessage *reply_message)
+{
+    IBusError *error = NULL;
+    gboolean retval;
+
+    if (reply_message == NULL) {
+        g_debug ("%s: Do not recevie reply of ProcessKeyEvent", DBUS_ERROR_NO_REPLY);
+        retval = FALSE;
+    }
+    else if ((error = ibus_error_new_from_message (reply_message)) != NULL) {
+        g_debug ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
+        retval = FALSE;
+    }
+    else if (!ibus_message_get_args (reply_message,
+                                     &error,
+                                     G_TYPE_BOOLEAN, &retval,
+                                     G_TYPE_INVALID)) {
+        g_debug ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
+        retval = FALSE;
+    }
+    return retval;
+}
+
 gboolean
 ibus_input_context_process_key_event (IBusInputContext *context,
                                       guint32           keyval,
@@ -579,29 +654,468 @@ ibus_input_context_process_key_event (IBusInputContext *context,
     reply_message = ibus_pending_call_steal_reply (pending);
     ibus_pending_call_unref (pending);
 
+    retval = ibus_input_context_key_event_reply (reply_message);
+
+    if (reply_message)
+        ibus_message_unref (reply_message);
+
+    return retval;
+}
+
+typedef struct {
+    IBusInputContext *context;
+    IBusInputContextKeyEventFunc callback;
+    gpointer user_data;
+} KeyEventCallData;
+
+static void
+_key_event_call_data_free (KeyEventCallData *call_data)
+{
+    g_object_unref (call_data->context);
+    g_slice_free (KeyEventCallData, call_data);
+}
+
+static void
+_process_key_event_reply_cb (IBusPendingCall  *pending,
+                             KeyEventCallData *call_data)
+{
+    IBusMessage *reply_message;
+    gboolean retval;
+
+    reply_message = ibus_pending_call_steal_reply (pending);
+
+    retval = ibus_input_context_key_event_reply (reply_message);
+
+    if (reply_message)
+        ibus_message_unref (reply_message);
+
+    call_data->callback (call_data->context, retval, call_data->user_data);
+}
+
+void
+ibus_input_context_process_key_event_async (IBusInputContext            *context,
+                                            guint32                      keyval,
+                                            guint32                      state,
+                                            gint                         timeout,
+                                            IBusInputContextKeyEventFunc callback,
+                                            gpointer                     user_data)
+{
+    g_assert (IBUS_IS_INPUT_CONTEXT (context));
+    g_assert (callback != NULL);
+
+    IBusPendingCall *pending = NULL;
+    IBusError *error = NULL;
+    KeyEventCallData *call_data;
+    gboolean retval;
+
+    IBusInputContextPrivate *priv;
+    priv = IBUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    /* forwarded keys are never sent back to the engine */
+    if (state & IBUS_FORWARD_MASK) {
+        callback (context, FALSE, user_data);
+        return;
+    }
+
+    if (priv->key_ring != NULL &&
+        ibus_input_context_push_key_ring (context,
+                                          keyval,
+                                          state,
+                                          timeout,
+                                          callback,
+                                          user_data)) {
+        return;
+    }
+
+    retval = ibus_proxy_call_with_reply ((IBusProxy *) context,
+                                         "ProcessKeyEvent",
+                                         &pending,
+                                         timeout,
+                                         &error,
+                                         G_TYPE_UINT, &keyval,
+                                         G_TYPE_UINT, &state,
+                                         G_TYPE_INVALID);
+    if (!retval || pending == NULL) {
+        if (error) {
+            g_debug ("%s: %s", error->name, error->message);
+            ibus_error_free (error);
+        }
+        callback (context, FALSE, user_data);
+        return;
+    }
+
+    call_data = g_slice_new (KeyEventCallData);
+    call_data->context = g_object_ref (context);
+    call_data->callback = callback;
+    call_data->user_data = user_data;
+
+    /* libdbus completes the call with a NoReply error after timeout,
+     * so callback is always invoked exactly once */
+    ibus_pending_call_set_notify (pending,
+                                  (IBusPendingCallNotifyFunction) _process_key_event_reply_cb,
+                                  call_data,
+                                  (GDestroyNotify) _key_event_call_data_free);
+    ibus_pending_call_unref (pending);
+}
+
+typedef struct {
+    IBusInputContext *context;
+    IBusInputContextKeyEventsFunc callback;
+    gpointer user_data;
+    guint n_keys;
+} KeyEventsCallData;
+
+static void
+_process_key_events_reply_cb (IBusPendingCall   *pending,
+                              KeyEventsCallData *call_data)
+{
+    IBusMessage *reply_message;
+    IBusMessageIter iter;
+    IBusError *error;
+    GArray *handled = NULL;
+    guint processed = 0;
+
+    reply_message = pending ? ibus_pending_call_steal_reply (pending) : NULL;
+
     if (reply_message == NULL) {
-        g_debug ("%s: Do not recevie reply of ProcessKeyEvent", DBUS_ERROR_NO_REPLY);
-        retval = FALSE;
+        g_debug ("%s: Do not recevie reply of ProcessKeyEvents", DBUS_ERROR_NO_REPLY);
     }
     else if ((error = ibus_error_new_from_message (reply_message)) != NULL) {
         g_debug ("%s: %s", error->name, error->message);
-        ibus_message_unref (reply_message);
         ibus_error_free (error);
-        retval = FALSE;
+    }
+    else if (!ibus_message_iter_init (reply_message, &iter) ||
+             !ibus_message_iter_get (&iter, G_TYPE_UINT, &processed) ||
+             (handled = ibus_message_iter_get_uint_array (&iter)) == NULL ||
+             processed > call_data->n_keys ||
+             handled->len < (processed + 31) / 32) {
+        g_debug ("%s: Can not match signature (uau) of ProcessKeyEvents reply",
+                 DBUS_ERROR_INVALID_ARGS);
+        if (handled) {
+            g_array_free (handled, TRUE);
+            handled = NULL;
+        }
+    }
+
+    if (reply_message)
+        ibus_message_unref (reply_message);
+
+    if (handled != NULL) {
+        call_data->callback (call_data->context,
+                             processed,
+                             (guint32 *) handled->data,
+                             call_data->user_data);
+        g_array_free (handled, TRUE);
     }
     else {
+        /* on failure every key is reported as not handled */
+        guint32 *none = g_new0 (guint32, (call_data->n_keys + 31) / 32);
+        call_data->callback (call_data->context,
+                             call_data->n_keys,
+                             none,
+                             call_data->user_data);
+        g_free (none);
+    }
+}
 
-        if (!ibus_message_get_args (reply_message,
-                                    &error,
-                                    G_TYPE_BOOLEAN, &retval,
-                                    G_TYPE_INVALID)) {
-            g_debug ("%s: %s", error->name, error->message);
-            ibus_error_free (error);
-            retval = FALSE;
-        }
+static void
+_key_events_call_data_free (KeyEventsCallData *call_data)
+{
+    g_object_unref (call_data->context);
+    g_slice_free (KeyEventsCallData, call_data);
+}
+
+void
+ibus_input_context_process_key_events_async (IBusInputContext             *context,
+                                             const guint32                *keys,
+                                             guint                         n_keys,
+                                             gint                          timeout,
+                                             IBusInputContextKeyEventsFunc callback,
+                                             gpointer                      user_data)
+{
+    g_assert (IBUS_IS_INPUT_CONTEXT (context));
+    g_assert (keys != NULL);
+    g_assert (n_keys > 0);
+    g_assert (callback != NULL);
+
+    IBusMessage *message;
+    IBusMessageIter iter;
+    IBusPendingCall *pending = NULL;
+    KeyEventsCallData *call_data;
+    gboolean retval;
+
+    message = ibus_message_new_method_call (ibus_proxy_get_name ((IBusProxy *) context),
+                                            ibus_proxy_get_path ((IBusProxy *) context),
+                                            ibus_proxy_get_interface ((IBusProxy *) context),
+                                            "ProcessKeyEvents");
+    ibus_message_iter_init_append (message, &iter);
+    ibus_message_iter_append_uint_array (&iter, keys, n_keys * 2);
+
+    retval = ibus_proxy_send_with_reply ((IBusProxy *) context,
+                                         message,
+                                         &pending,
+                                         timeout);
+    ibus_message_unref (message);
+
+    call_data = g_slice_new (KeyEventsCallData);
+    call_data->context = g_object_ref (context);
+    call_data->callback = callback;
+    call_data->user_data = user_data;
+    call_data->n_keys = n_keys;
+
+    if (!retval || pending == NULL) {
+        _process_key_events_reply_cb (NULL, call_data);
+        _key_events_call_data_free (call_data);
+        return;
+    }
+
+    ibus_pending_call_set_notify (pending,
+                                  (IBusPendingCallNotifyFunction) _process_key_events_reply_cb,
+                                  call_data,
+                                  (GDestroyNotify) _key_events_call_data_free);
+    ibus_pending_call_unref (pending);
+}
+
+typedef struct {
+    IBusInputContext *context;
+    IBusInputContextKeyEventFunc callback;
+    gpointer user_data;
+    guint32 serial;
+    guint timeout_id;
+} KeyRingCallData;
+
+static void
+_key_ring_call_done (KeyRingCallData *call_data,
+                     gboolean         handled)
+{
+    IBusInputContextPrivate *priv;
+    priv = IBUS_INPUT_CONTEXT_GET_PRIVATE (call_data->context);
+
+    if (priv->key_ring_calls) {
+        g_hash_table_remove (priv->key_ring_calls,
+                             GUINT_TO_POINTER (call_data->serial));
+    }
+
+    if (call_data->timeout_id != 0) {
+        g_source_remove (call_data->timeout_id);
+        call_data->timeout_id = 0;
+    }
+
+    call_data->callback (call_data->context, handled, call_data->user_data);
+
+    g_object_unref (call_data->context);
+    g_slice_free (KeyRingCallData, call_data);
+}
+
+static gboolean
+_key_ring_timeout_cb (KeyRingCallData *call_data)
+{
+    g_debug ("%s: Do not recevie reply of ProcessKeyEvent", DBUS_ERROR_NO_REPLY);
+
+    /* a late reply finds no call and is dropped */
+    call_data->timeout_id = 0;
+    _key_ring_call_done (call_data, FALSE);
+
+    return FALSE;
+}
+
+/* passes on the replies whose signals were dispatched, in order */
+static void
+ibus_input_context_dispatch_key_ring_replies (IBusInputContext *context)
+{
+    IBusKeyRingEvent *event;
+    KeyRingCallData *call_data;
+
+    IBusInputContextPrivate *priv;
+    priv = IBUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (priv->key_ring_replies == NULL)
+        return;
+
+    /* a callback may drop the last reference */
+    g_object_ref (context);
+
+    while (priv->key_ring_replies != NULL &&
+           (event = (IBusKeyRingEvent *) g_queue_peek_head (priv->key_ring_replies)) != NULL) {
+        /* serials wrap around */
+        if ((gint32) (priv->message_serial - event->message_serial) < 0)
+            break;
+
+        g_queue_pop_head (priv->key_ring_replies);
+
+        /* a call which timed out meanwhile is gone */
+        call_data = (KeyRingCallData *) g_hash_table_lookup (priv->key_ring_calls,
+                                                             GUINT_TO_POINTER (event->serial));
+        if (call_data != NULL)
+            _key_ring_call_done (call_data, event->handled != 0);
+
+        g_slice_free (IBusKeyRingEvent, event);
+    }
+
+    g_object_unref (context);
+}
+
+static void
+_key_ring_reply_cb (IBusKeyRing            *ring,
+                    const IBusKeyRingEvent *event,
+                    IBusInputContext       *context)
+{
+    IBusInputContextPrivate *priv;
+    priv = IBUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (g_hash_table_lookup (priv->key_ring_calls,
+                             GUINT_TO_POINTER (event->serial)) == NULL)
+        return;
+
+    /* the daemon sends the signals caused by a key before it replies, the
+     * reply waits until they were dispatched as on the D-Bus path */
+    g_queue_push_tail (priv->key_ring_replies,
+                       g_slice_dup (IBusKeyRingEvent, event));
+    ibus_input_context_dispatch_key_ring_replies (context);
+}
+
+static gboolean
+ibus_input_context_push_key_ring (IBusInputContext            *context,
+                                  guint32                      keyval,
+                                  guint32                      state,
+                                  gint                         timeout,
+                                  IBusInputContextKeyEventFunc callback,
+                                  gpointer                     user_data)
+{
+    IBusKeyRingEvent event;
+    KeyRingCallData *call_data;
+
+    IBusInputContextPrivate *priv;
+    priv = IBUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    /* 0 is never used, so a zeroed slot matches no call */
+    if (++priv->key_ring_serial == 0)
+        priv->key_ring_serial = 1;
+
+    event.serial = priv->key_ring_serial;
+    event.keyval = keyval;
+    event.state = state;
+    event.handled = 0;
+
+    if (!ibus_key_ring_push (priv->key_ring, &event))
+        return FALSE;
+
+    call_data = g_slice_new (KeyRingCallData);
+    call_data->context = g_object_ref (context);
+    call_data->callback = callback;
+    call_data->user_data = user_data;
+    call_data->serial = event.serial;
+    call_data->timeout_id = g_timeout_add (timeout > 0 ? timeout : IBUS_KEY_RING_TIMEOUT,
+                                           (GSourceFunc) _key_ring_timeout_cb,
+                                           call_data);
+
+    g_hash_table_insert (priv->key_ring_calls,
+                         GUINT_TO_POINTER (call_data->serial),
+                         call_data);
+    return TRUE;
+}
+
+gboolean
+ibus_input_context_open_key_ring (IBusInputContext *context)
+{
+    g_assert (IBUS_IS_INPUT_CONTEXT (context));
+
+    IBusMessage *reply_message;
+    IBusError *error = NULL;
+    gchar *path;
+    IBusKeyRing *ring;
+
+    IBusInputContextPrivate *priv;
+    priv = IBUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (priv->key_ring != NULL)
+        return TRUE;
+
+    reply_message = ibus_proxy_call_with_reply_and_block ((IBusProxy *) context,
+                                                          "OpenKeyRing",
+                                                          -1,
+                                                          &error,
+                                                          G_TYPE_INVALID);
+    if (reply_message == NULL) {
+        g_debug ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
+        return FALSE;
+    }
+
+    if ((error = ibus_error_new_from_message (reply_message)) != NULL ||
+        !ibus_message_get_args (reply_message,
+                                &error,
+                                G_TYPE_STRING, &path,
+                                G_TYPE_INVALID)) {
+        g_debug ("%s: %s", error->name, error->message);
+        ibus_error_free (error);
         ibus_message_unref (reply_message);
+        return FALSE;
     }
-    return retval;
+
+    ring = ibus_key_ring_open (path);
+    ibus_message_unref (reply_message);
+
+    if (ring == NULL) {
+        ibus_proxy_call ((IBusProxy *) context,
+                         "CloseKeyRing",
+                         G_TYPE_INVALID);
+        return FALSE;
+    }
+
+    ibus_key_ring_unlink (ring);
+    ibus_key_ring_set_watch (ring,
+                             (IBusKeyRingFunc) _key_ring_reply_cb,
+                             context);
+
+    priv->key_ring = ring;
+    priv->key_ring_calls = g_hash_table_new (g_direct_hash, g_direct_equal);
+    priv->key_ring_replies = g_queue_new ();
+
+    return TRUE;
+}
+
+void
+ibus_input_context_close_key_ring (IBusInputContext *context)
+{
+    g_assert (IBUS_IS_INPUT_CONTEXT (context));
+
+    GHashTable *calls;
+    GList *list, *p;
+
+    IBusInputContextPrivate *priv;
+    priv = IBUS_INPUT_CONTEXT_GET_PRIVATE (context);
+
+    if (priv->key_ring == NULL)
+        return;
+
+    ibus_key_ring_free (priv->key_ring);
+    priv->key_ring = NULL;
+
+    while (!g_queue_is_empty (priv->key_ring_replies)) {
+        g_slice_free (IBusKeyRingEvent,
+                      (IBusKeyRingEvent *) g_queue_pop_head (priv->key_ring_replies));
+    }
+    g_queue_free (priv->key_ring_replies);
+    priv->key_ring_replies = NULL;
+
+    if (ibus_proxy_get_connection ((IBusProxy *) context) != NULL) {
+        ibus_proxy_call ((IBusProxy *) context,
+                         "CloseKeyRing",
+                         G_TYPE_INVALID);
+    }
+
+    /* every callback is still invoked exactly once */
+    calls = priv->key_ring_calls;
+    priv->key_ring_calls = NULL;
+
+    list = g_hash_table_get_values (calls);
+    g_hash_table_destroy (calls);
+
+    for (p = list; p != NULL; p = p->next) {
+        _key_ring_call_done ((KeyRingCallData *) p->data, FALSE);
+    }
+    g_list_free (list);
 }
 
 void
@@ -628,6 +1142,9 @@ ibus_input_context_set_capabilities (IBusInputContext   *context,
 {
     g_assert (IBUS_IS_INPUT_CONTEXT (context));
 
+    /* texts are deserialized here, which reads both encodings */
+    capabilites |= IBUS_CAP_COMPACT_TEXT;
+
     ibus_proxy_call ((IBusProxy *) context,
                      "SetCapabilities",
                      G_TYPE_UINT, &capabilites,
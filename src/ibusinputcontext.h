@@ -45,6 +45,14 @@ G_BEGIN_DECLS
 typedef struct _IBusInputContext IBusInputContext;
 typedef struct _IBusInputContextClass IBusInputContextClass;
 
+typedef void (* IBusInputContextKeyEventFunc)   (IBusInputContext   *context,
+                                                 gboolean            handled,
+                                                 gpointer            user_data);
+typedef void (* IBusInputContextKeyEventsFunc)  (IBusInputContext   *context,
+                                                 guint               processed,
+                                                 const guint32      *handled,
+                                                 gpointer            user_data);
+
 struct _IBusInputContext {
   IBusProxy parent;
   /* instance members */
@@ -67,6 +75,26 @@ gboolean     ibus_input_context_process_key_event
                                             (IBusInputContext   *context,
                                              guint32             keyval,
                                              guint32             state);
+void         ibus_input_context_process_key_event_async
+                                            (IBusInputContext   *context,
+                                             guint32             keyval,
+                                             guint32             state,
+                                             gint                timeout,
+                                             IBusInputContextKeyEventFunc
+                                                                 callback,
+                                             gpointer            user_data);
+void         ibus_input_context_process_key_events_async
+                                            (IBusInputContext   *context,
+                                             const guint32      *keys,
+                                             guint               n_keys,
+                                             gint                timeout,
+                                             IBusInputContextKeyEventsFunc
+                                                                 callback,
+                                             gpointer            user_data);
+gboolean     ibus_input_context_open_key_ring
+                                            (IBusInputContext   *context);
+void         ibus_input_context_close_key_ring
+                                            (IBusInputContext   *context);
 void         ibus_input_context_set_cursor_location
                                             (IBusInputContext   *context,
                                              gint32              x,
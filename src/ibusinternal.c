@@ -87,6 +87,8 @@ message_queue_dispatch (GSource     *source,
 typedef struct
 {
     GMainContext *context;      /**< the main context */
+    GMainContext *io_context;   /**< the context of the watches, may run in another thread */
+    GStaticRecMutex *io_lock;   /**< guards the handlers, NULL if io_context is context */
     GSList *ios;                /**< all IOHandler */
     GSList *timeouts;           /**< all TimeoutHandler */
     DBusConnection *connection; /**< NULL if this is really for a server not a connection */
@@ -99,6 +101,7 @@ typedef struct
     ConnectionSetup *cs;
     GSource *source;
     DBusWatch *watch;
+    GStaticRecMutex *io_lock;
 } IOHandler;
 
 typedef struct
@@ -106,23 +109,48 @@ typedef struct
     ConnectionSetup *cs;
     GSource *source;
     DBusTimeout *timeout;
+    GStaticRecMutex *io_lock;
 } TimeoutHandler;
 
+/* With an I/O thread, libdbus calls the watch and timeout functions from
+ * both threads, and from inside dbus_watch_handle() in the I/O thread.
+ * io_lock is recursive and is held while a watch or timeout is handled
+ * and while a handler or the lists of a setup change, so a handler is
+ * never used after the other thread detached it. The lock belongs to the
+ * I/O thread and outlives every setup.
+ */
+#define IO_LOCK(lock)                           \
+    G_STMT_START {                              \
+      if (lock)                                 \
+        g_static_rec_mutex_lock (lock);         \
+    } G_STMT_END
+#define IO_UNLOCK(lock)                         \
+    G_STMT_START {                              \
+      if (lock)                                 \
+        g_static_rec_mutex_unlock (lock);       \
+    } G_STMT_END
+
 dbus_int32_t _dbus_gmain_connection_slot = -1;
 static dbus_int32_t server_slot = -1;
 
 static ConnectionSetup*
-connection_setup_new (GMainContext   *context,
-                      DBusConnection *connection)
+connection_setup_new (GMainContext    *context,
+                      GMainContext    *io_context,
+                      GStaticRecMutex *io_lock,
+                      DBusConnection  *connection)
 {
     ConnectionSetup *cs;
 
     cs = g_new0 (ConnectionSetup, 1);
 
     g_assert (context != NULL);
+    g_assert (io_context != NULL);
 
     cs->context = context;
     g_main_context_ref (cs->context);
+    cs->io_context = io_context;
+    g_main_context_ref (cs->io_context);
+    cs->io_lock = io_lock;
 
     if (connection)
       {
@@ -144,24 +172,58 @@ io_handler_source_finalized (gpointer data)
 
     handler = data;
 
+    /* io_handler_destroy_source detached it already, unless the source
+     * went away with its context */
+    IO_LOCK (handler->io_lock);
     if (handler->watch)
-      dbus_watch_set_data (handler->watch, NULL, NULL);
+      {
+        DBusWatch *watch = handler->watch;
+        handler->watch = NULL;
+        dbus_watch_set_data (watch, NULL, NULL);
+      }
+    IO_UNLOCK (handler->io_lock);
 
     g_free (handler);
 }
 
+/* Detaches the handler from its watch and setup, then drops the source.
+ * The handler may be freed by the last unref, so it is not touched after.
+ */
 static void
 io_handler_destroy_source (void *data)
 {
     IOHandler *handler;
+    GStaticRecMutex *io_lock;
+    GSource *source;
 
     handler = data;
+    io_lock = handler->io_lock;
+
+    IO_LOCK (io_lock);
 
-    if (handler->source)
+    source = handler->source;
+    if (source)
       {
-        GSource *source = handler->source;
         handler->source = NULL;
         handler->cs->ios = g_slist_remove (handler->cs->ios, handler);
+      }
+
+    /* Detach from the watch now rather than when the source is
+     * finalized, which may happen later in the I/O thread while the
+     * watch already has a new handler. This calls io_handler_watch_freed,
+     * which finds nothing left to do.
+     */
+    if (handler->watch)
+      {
+        DBusWatch *watch = handler->watch;
+        handler->watch = NULL;
+        dbus_watch_set_data (watch, NULL, NULL);
+      }
+
+    IO_UNLOCK (io_lock);
+
+    if (source)
+      {
         g_source_destroy (source);
         g_source_unref (source);
       }
@@ -174,9 +236,10 @@ io_handler_watch_freed (void *data)
 
     handler = data;
 
+    IO_LOCK (handler->io_lock);
     handler->watch = NULL;
-
     io_handler_destroy_source (handler);
+    IO_UNLOCK (handler->io_lock);
 }
 
 static gboolean
@@ -187,8 +250,21 @@ io_handler_dispatch (GIOChannel   *source,
     IOHandler *handler;
     guint dbus_condition = 0;
     DBusConnection *connection;
+    DBusWatch *watch;
+    GStaticRecMutex *io_lock;
 
     handler = data;
+    io_lock = handler->io_lock;
+
+    IO_LOCK (io_lock);
+
+    /* removed by another thread while this dispatch was pending */
+    watch = handler->watch;
+    if (watch == NULL)
+      {
+        IO_UNLOCK (io_lock);
+        return TRUE;
+      }
 
     connection = handler->cs->connection;
 
@@ -206,11 +282,14 @@ io_handler_dispatch (GIOChannel   *source,
 
     /* Note that we don't touch the handler after this, because
      * dbus may have disabled the watch and thus killed the
-     * handler.
+     * handler. The other thread can not free the watch meanwhile,
+     * as detaching it takes io_lock.
      */
-    dbus_watch_handle (handler->watch, dbus_condition);
+    dbus_watch_handle (watch, dbus_condition);
     handler = NULL;
 
+    IO_UNLOCK (io_lock);
+
     if (connection)
       dbus_connection_unref (connection);
 
@@ -229,6 +308,8 @@ connection_setup_add_watch (ConnectionSetup *cs,
     if (!dbus_watch_get_enabled (watch))
       return;
 
+    IO_LOCK (cs->io_lock);
+
     g_assert (dbus_watch_get_data (watch) == NULL);
 
     flags = dbus_watch_get_flags (watch);
@@ -242,17 +323,22 @@ connection_setup_add_watch (ConnectionSetup *cs,
     handler = g_new0 (IOHandler, 1);
     handler->cs = cs;
     handler->watch = watch;
+    handler->io_lock = cs->io_lock;
 
     channel = g_io_channel_unix_new (dbus_watch_get_unix_fd (watch));
 
     handler->source = g_io_create_watch (channel, condition);
     g_source_set_callback (handler->source, (GSourceFunc) io_handler_dispatch, handler,
                            io_handler_source_finalized);
-    g_source_attach (handler->source, cs->context);
 
     cs->ios = g_slist_prepend (cs->ios, handler);
-
     dbus_watch_set_data (watch, handler, io_handler_watch_freed);
+
+    /* the I/O thread may dispatch it from here on */
+    g_source_attach (handler->source, cs->io_context);
+
+    IO_UNLOCK (cs->io_lock);
+
     g_io_channel_unref (channel);
 }
 
@@ -262,12 +348,15 @@ connection_setup_remove_watch (ConnectionSetup *cs,
 {
     IOHandler *handler;
 
+    IO_LOCK (cs->io_lock);
+
     handler = dbus_watch_get_data (watch);
 
-    if (handler == NULL)
-      return;
+    /* the watch may already belong to a new setup */
+    if (handler != NULL && handler->cs == cs)
+      io_handler_destroy_source (handler);
 
-    io_handler_destroy_source (handler);
+    IO_UNLOCK (cs->io_lock);
 }
 
 static void
@@ -277,8 +366,14 @@ timeout_handler_source_finalized (gpointer data)
 
     handler = data;
 
+    IO_LOCK (handler->io_lock);
     if (handler->timeout)
-      dbus_timeout_set_data (handler->timeout, NULL, NULL);
+      {
+        DBusTimeout *timeout = handler->timeout;
+        handler->timeout = NULL;
+        dbus_timeout_set_data (timeout, NULL, NULL);
+      }
+    IO_UNLOCK (handler->io_lock);
 
     g_free (handler);
 }
@@ -287,14 +382,32 @@ static void
 timeout_handler_destroy_source (void *data)
 {
     TimeoutHandler *handler;
+    GStaticRecMutex *io_lock;
+    GSource *source;
 
     handler = data;
+    io_lock = handler->io_lock;
+
+    IO_LOCK (io_lock);
 
-    if (handler->source)
+    source = handler->source;
+    if (source)
       {
-        GSource *source = handler->source;
         handler->source = NULL;
         handler->cs->timeouts = g_slist_remove (handler->cs->timeouts, handler);
+      }
+
+    if (handler->timeout)
+      {
+        DBusTimeout *timeout = handler->timeout;
+        handler->timeout = NULL;
+        dbus_timeout_set_data (timeout, NULL, NULL);
+      }
+
+    IO_UNLOCK (io_lock);
+
+    if (source)
+      {
         g_source_destroy (source);
         g_source_unref (source);
       }
@@ -307,19 +420,26 @@ timeout_handler_timeout_freed (void *data)
 
     handler = data;
 
+    IO_LOCK (handler->io_lock);
     handler->timeout = NULL;
-
     timeout_handler_destroy_source (handler);
+    IO_UNLOCK (handler->io_lock);
 }
 
 static gboolean
 timeout_handler_dispatch (gpointer      data)
 {
     TimeoutHandler *handler;
+    GStaticRecMutex *io_lock;
 
     handler = data;
+    io_lock = handler->io_lock;
 
-    dbus_timeout_handle (handler->timeout);
+    /* the I/O thread may remove the timeout meanwhile */
+    IO_LOCK (io_lock);
+    if (handler->timeout)
+      dbus_timeout_handle (handler->timeout);
+    IO_UNLOCK (io_lock);
 
     return TRUE;
 }
@@ -333,20 +453,25 @@ connection_setup_add_timeout (ConnectionSetup *cs,
     if (!dbus_timeout_get_enabled (timeout))
       return;
 
+    IO_LOCK (cs->io_lock);
+
     g_assert (dbus_timeout_get_data (timeout) == NULL);
 
     handler = g_new0 (TimeoutHandler, 1);
     handler->cs = cs;
     handler->timeout = timeout;
+    handler->io_lock = cs->io_lock;
 
     handler->source = g_timeout_source_new (dbus_timeout_get_interval (timeout));
     g_source_set_callback (handler->source, timeout_handler_dispatch, handler,
                            timeout_handler_source_finalized);
-    g_source_attach (handler->source, handler->cs->context);
 
     cs->timeouts = g_slist_prepend (cs->timeouts, handler);
-
     dbus_timeout_set_data (timeout, handler, timeout_handler_timeout_freed);
+
+    g_source_attach (handler->source, handler->cs->context);
+
+    IO_UNLOCK (cs->io_lock);
 }
 
 static void
@@ -355,23 +480,37 @@ connection_setup_remove_timeout (ConnectionSetup *cs,
 {
     TimeoutHandler *handler;
 
+    IO_LOCK (cs->io_lock);
+
     handler = dbus_timeout_get_data (timeout);
 
-    if (handler == NULL)
-      return;
+    if (handler != NULL && handler->cs == cs)
+      timeout_handler_destroy_source (handler);
 
-    timeout_handler_destroy_source (handler);
+    IO_UNLOCK (cs->io_lock);
 }
 
+/* Holding io_lock also waits until the I/O thread is done with a watch
+ * it was handling. */
 static void
-connection_setup_free (ConnectionSetup *cs)
+connection_setup_detach (ConnectionSetup *cs)
 {
+    IO_LOCK (cs->io_lock);
+
     while (cs->ios)
       io_handler_destroy_source (cs->ios->data);
 
     while (cs->timeouts)
       timeout_handler_destroy_source (cs->timeouts->data);
 
+    IO_UNLOCK (cs->io_lock);
+}
+
+static void
+connection_setup_free (ConnectionSetup *cs)
+{
+    connection_setup_detach (cs);
+
     if (cs->message_queue_source)
       {
         GSource *source;
@@ -384,6 +523,7 @@ connection_setup_free (ConnectionSetup *cs)
       }
 
     g_main_context_unref (cs->context);
+    g_main_context_unref (cs->io_context);
     g_free (cs);
 }
 
@@ -470,42 +610,35 @@ wakeup_main (void *data)
     ConnectionSetup *cs = data;
 
     g_main_context_wakeup (cs->context);
+    if (cs->io_context != cs->context)
+      g_main_context_wakeup (cs->io_context);
 }
 
+/* Messages read in the I/O thread are dispatched in the main context */
+static void
+dispatch_status_changed (DBusConnection     *connection,
+                         DBusDispatchStatus  new_status,
+                         void               *data)
+{
+    if (new_status == DBUS_DISPATCH_DATA_REMAINS)
+      g_main_context_wakeup ((GMainContext *) data);
+}
 
-/* Move to a new context */
+/* Move to a new context. The watches and timeouts are detached from the
+ * old setup here; setting the new watch and timeout functions adds them
+ * to the new one.
+ */
 static ConnectionSetup*
 connection_setup_new_from_old (GMainContext    *context,
-                                 ConnectionSetup *old)
+                               GMainContext    *io_context,
+                               GStaticRecMutex *io_lock,
+                               ConnectionSetup *old)
 {
-    GSList *tmp;
-    ConnectionSetup *cs;
-
-    g_assert (old->context != context);
-
-    cs = connection_setup_new (context, old->connection);
-
-    tmp = old->ios;
-    while (tmp != NULL)
-      {
-        IOHandler *handler = tmp->data;
-
-        connection_setup_add_watch (cs, handler->watch);
-
-        tmp = tmp->next;
-      }
-
-    tmp = old->timeouts;
-    while (tmp != NULL)
-      {
-        TimeoutHandler *handler = tmp->data;
-
-        connection_setup_add_timeout (cs, handler->timeout);
+    g_assert (old->context != context || old->io_context != io_context);
 
-        tmp = tmp->next;
-      }
+    connection_setup_detach (old);
 
-    return cs;
+    return connection_setup_new (context, io_context, io_lock, old->connection);
 }
 
 /** @} */ /* End of GLib bindings internals */
@@ -532,6 +665,28 @@ connection_setup_new_from_old (GMainContext    *context,
 void
 dbus_connection_setup (DBusConnection *connection,
                    GMainContext   *context)
+{
+    dbus_connection_setup_with_io (connection, context, NULL, NULL);
+}
+
+/**
+ * dbus_connection_setup_with_io:
+ * @connection: the connection
+ * @context: the #GMainContext or #NULL for default context
+ * @io_context: the #GMainContext for reading and writing, or #NULL for @context
+ * @io_lock: a recursive lock owned by the thread of @io_context, or #NULL
+ *
+ * Like dbus_connection_setup(), but the socket is read and written by
+ * @io_context, which may run in another thread. Messages are still
+ * dispatched and pending calls timed out in @context. libdbus must be
+ * initialized for threads before. Before the last reference is dropped
+ * from @context, set the connection up without @io_context again.
+ */
+void
+dbus_connection_setup_with_io (DBusConnection  *connection,
+                               GMainContext    *context,
+                               GMainContext    *io_context,
+                               GStaticRecMutex *io_lock)
 {
     ConnectionSetup *old_setup;
     ConnectionSetup *cs;
@@ -546,27 +701,25 @@ dbus_connection_setup (DBusConnection *connection,
     if (context == NULL)
       context = g_main_context_default ();
 
+    if (io_context == NULL || io_context == context)
+      {
+        io_context = context;
+        io_lock = NULL;
+      }
+
     cs = NULL;
 
     old_setup = dbus_connection_get_data (connection, _dbus_gmain_connection_slot);
     if (old_setup != NULL)
       {
-        if (old_setup->context == context)
+        if (old_setup->context == context && old_setup->io_context == io_context)
           return; /* nothing to do */
 
-        cs = connection_setup_new_from_old (context, old_setup);
-
-        /* Nuke the old setup */
-        dbus_connection_set_data (connection, _dbus_gmain_connection_slot, NULL, NULL);
-        old_setup = NULL;
+        cs = connection_setup_new_from_old (context, io_context, io_lock, old_setup);
       }
 
     if (cs == NULL)
-      cs = connection_setup_new (context, connection);
-
-    if (!dbus_connection_set_data (connection, _dbus_gmain_connection_slot, cs,
-                                   (DBusFreeFunction)connection_setup_free))
-      goto nomem;
+      cs = connection_setup_new (context, io_context, io_lock, connection);
 
     if (!dbus_connection_set_watch_functions (connection,
                                               add_watch,
@@ -586,6 +739,18 @@ dbus_connection_setup (DBusConnection *connection,
                         wakeup_main,
                         cs, NULL);
 
+    if (io_context != context)
+      dbus_connection_set_dispatch_status_function (connection,
+                                                    dispatch_status_changed,
+                                                    context, NULL);
+    else
+      dbus_connection_set_dispatch_status_function (connection, NULL, NULL, NULL);
+
+    /* frees the old setup, after the functions stopped using it */
+    if (!dbus_connection_set_data (connection, _dbus_gmain_connection_slot, cs,
+                                   (DBusFreeFunction)connection_setup_free))
+      goto nomem;
+
     return;
 
  nomem:
@@ -631,19 +796,11 @@ dbus_server_setup (DBusServer   *server,
         if (old_setup->context == context)
           return; /* nothing to do */
 
-        cs = connection_setup_new_from_old (context, old_setup);
-
-        /* Nuke the old setup */
-        dbus_server_set_data (server, server_slot, NULL, NULL);
-        old_setup = NULL;
+        cs = connection_setup_new_from_old (context, context, NULL, old_setup);
       }
 
     if (cs == NULL)
-      cs = connection_setup_new (context, NULL);
-
-    if (!dbus_server_set_data (server, server_slot, cs,
-                               (DBusFreeFunction)connection_setup_free))
-      goto nomem;
+      cs = connection_setup_new (context, context, NULL, NULL);
 
     if (!dbus_server_set_watch_functions (server,
                                           add_watch,
@@ -659,6 +816,10 @@ dbus_server_setup (DBusServer   *server,
                                             cs, NULL))
       goto nomem;
 
+    if (!dbus_server_set_data (server, server_slot, cs,
+                               (DBusFreeFunction)connection_setup_free))
+      goto nomem;
+
     return;
 
  nomem:
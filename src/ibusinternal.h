@@ -29,6 +29,12 @@ void    dbus_server_setup       (DBusServer     *server,
                                  GMainContext   *context);
 void    dbus_connection_setup   (DBusConnection *connection,
                                  GMainContext   *context);
+void    dbus_connection_setup_with_io
+                                (DBusConnection *connection,
+                                 GMainContext   *context,
+                                 GMainContext   *io_context,
+                                 GStaticRecMutex
+                                                *io_lock);
 
 
 
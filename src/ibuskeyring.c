@@ -0,0 +1,441 @@
+/* vim:set et sts=4: */
+/* ibus - The Input Bus
+ * Copyright (C) 2008-2009 Huang Peng <shawn.p.huang@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "ibuskeyring.h"
+
+#define IBUS_KEY_RING_MAGIC     (0x4b455952)
+#define IBUS_KEY_RING_VERSION   (2)
+#define IBUS_KEY_RING_MASK      (IBUS_KEY_RING_SIZE - 1)
+
+/* head and tail are written by different processes, keep them apart */
+typedef struct {
+    volatile gint head;
+    gchar pad0[64 - sizeof (gint)];
+    volatile gint tail;
+    gchar pad1[64 - sizeof (gint)];
+    IBusKeyRingEvent events[IBUS_KEY_RING_SIZE];
+} IBusKeyRingBuffer;
+
+typedef struct {
+    guint32 magic;
+    guint32 version;
+    /* 0 carries events to the daemon, 1 to the client */
+    IBusKeyRingBuffer buffers[2];
+} IBusKeyRingShared;
+
+struct _IBusKeyRing {
+    gchar *path;
+    IBusKeyRingShared *shared;
+    IBusKeyRingBuffer *in;
+    IBusKeyRingBuffer *out;
+    gint in_fd;
+    gint out_fd;
+
+    guint watch_id;
+    IBusKeyRingFunc func;
+    gpointer user_data;
+
+    /* ibus_key_ring_free called from a dispatched func */
+    gboolean dispatching;
+    gboolean freed;
+};
+
+static gchar *
+_fifo_path (const gchar *path,
+            gint         direction)
+{
+    return g_strdup_printf ("%s.%d", path, direction);
+}
+
+static gint
+_open_fifo (const gchar *path,
+            gint         direction)
+{
+    gchar *fifo;
+    gint fd;
+
+    /* O_RDWR never blocks on a fifo and never sees EOF */
+    fifo = _fifo_path (path, direction);
+    fd = open (fifo, O_RDWR | O_NONBLOCK);
+    g_free (fifo);
+
+    if (fd >= 0) {
+        fcntl (fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+}
+
+static gboolean
+_ibus_key_ring_map (IBusKeyRing *ring,
+                    gint         fd)
+{
+    gpointer p;
+
+    p = mmap (NULL, sizeof (IBusKeyRingShared),
+              PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        g_warning ("Can not map %s: %s", ring->path, g_strerror (errno));
+        return FALSE;
+    }
+
+    ring->shared = (IBusKeyRingShared *) p;
+    return TRUE;
+}
+
+static IBusKeyRing *
+_ibus_key_ring_alloc (const gchar *path)
+{
+    IBusKeyRing *ring;
+
+    ring = g_slice_new0 (IBusKeyRing);
+    ring->path = g_strdup (path);
+    ring->in_fd = -1;
+    ring->out_fd = -1;
+
+    return ring;
+}
+
+IBusKeyRing *
+ibus_key_ring_new (const gchar *dir)
+{
+    g_assert (dir != NULL);
+
+    IBusKeyRing *ring;
+    gchar *path;
+    gchar *fifo;
+    gint fd;
+    gint i;
+
+    path = g_build_filename (dir, "keyring-XXXXXX", NULL);
+    fd = g_mkstemp (path);
+    if (fd < 0) {
+        g_warning ("Can not create %s: %s", path, g_strerror (errno));
+        g_free (path);
+        return NULL;
+    }
+
+    ring = _ibus_key_ring_alloc (path);
+    g_free (path);
+
+    if (ftruncate (fd, sizeof (IBusKeyRingShared)) < 0) {
+        g_warning ("Can not resize %s: %s", ring->path, g_strerror (errno));
+        close (fd);
+        goto failed;
+    }
+
+    if (!_ibus_key_ring_map (ring, fd)) {
+        close (fd);
+        goto failed;
+    }
+    close (fd);
+
+    for (i = 0; i < 2; i++) {
+        fifo = _fifo_path (ring->path, i);
+        if (mkfifo (fifo, 0600) < 0) {
+            g_warning ("Can not create %s: %s", fifo, g_strerror (errno));
+            g_free (fifo);
+            goto failed;
+        }
+        g_free (fifo);
+    }
+
+    ring->in_fd = _open_fifo (ring->path, 0);
+    ring->out_fd = _open_fifo (ring->path, 1);
+    if (ring->in_fd < 0 || ring->out_fd < 0) {
+        g_warning ("Can not open fifos of %s: %s", ring->path, g_strerror (errno));
+        goto failed;
+    }
+
+    ring->in = &ring->shared->buffers[0];
+    ring->out = &ring->shared->buffers[1];
+
+    /* ftruncate zeroed the buffers */
+    ring->shared->version = IBUS_KEY_RING_VERSION;
+    g_atomic_int_set ((gint *) &ring->shared->magic, IBUS_KEY_RING_MAGIC);
+
+    return ring;
+
+failed:
+    ibus_key_ring_unlink (ring);
+    ibus_key_ring_free (ring);
+    return NULL;
+}
+
+IBusKeyRing *
+ibus_key_ring_open (const gchar *path)
+{
+    g_assert (path != NULL);
+
+    IBusKeyRing *ring;
+    struct stat st;
+    gint fd;
+
+    fd = open (path, O_RDWR);
+    if (fd < 0) {
+        g_warning ("Can not open %s: %s", path, g_strerror (errno));
+        return NULL;
+    }
+
+    ring = _ibus_key_ring_alloc (path);
+
+    if (fstat (fd, &st) < 0 || st.st_size != sizeof (IBusKeyRingShared)) {
+        g_warning ("%s is not a key ring", path);
+        close (fd);
+        goto failed;
+    }
+
+    if (!_ibus_key_ring_map (ring, fd)) {
+        close (fd);
+        goto failed;
+    }
+    close (fd);
+
+    if (g_atomic_int_get ((gint *) &ring->shared->magic) != IBUS_KEY_RING_MAGIC ||
+        ring->shared->version != IBUS_KEY_RING_VERSION) {
+        g_warning ("%s is not a key ring of version %d", path, IBUS_KEY_RING_VERSION);
+        goto failed;
+    }
+
+    ring->in_fd = _open_fifo (ring->path, 1);
+    ring->out_fd = _open_fifo (ring->path, 0);
+    if (ring->in_fd < 0 || ring->out_fd < 0) {
+        g_warning ("Can not open fifos of %s: %s", ring->path, g_strerror (errno));
+        goto failed;
+    }
+
+    ring->in = &ring->shared->buffers[1];
+    ring->out = &ring->shared->buffers[0];
+
+    return ring;
+
+failed:
+    ibus_key_ring_free (ring);
+    return NULL;
+}
+
+void
+ibus_key_ring_free (IBusKeyRing *ring)
+{
+    g_assert (ring != NULL);
+
+    if (ring->watch_id != 0) {
+        g_source_remove (ring->watch_id);
+        ring->watch_id = 0;
+    }
+
+    if (ring->dispatching) {
+        ring->freed = TRUE;
+        return;
+    }
+
+    if (ring->in_fd >= 0)
+        close (ring->in_fd);
+    if (ring->out_fd >= 0)
+        close (ring->out_fd);
+    if (ring->shared)
+        munmap (ring->shared, sizeof (IBusKeyRingShared));
+
+    g_free (ring->path);
+    g_slice_free (IBusKeyRing, ring);
+}
+
+const gchar *
+ibus_key_ring_get_path (IBusKeyRing *ring)
+{
+    g_assert (ring != NULL);
+
+    return ring->path;
+}
+
+void
+ibus_key_ring_unlink (IBusKeyRing *ring)
+{
+    g_assert (ring != NULL);
+
+    gchar *fifo;
+    gint i;
+
+    /* both sides have them open by now, the names are not needed */
+    unlink (ring->path);
+    for (i = 0; i < 2; i++) {
+        fifo = _fifo_path (ring->path, i);
+        unlink (fifo);
+        g_free (fifo);
+    }
+}
+
+gboolean
+ibus_key_ring_push (IBusKeyRing            *ring,
+                    const IBusKeyRingEvent *event)
+{
+    g_assert (ring != NULL);
+    g_assert (event != NULL);
+
+    IBusKeyRingBuffer *buffer = ring->out;
+    guint head, tail;
+    gssize n;
+
+    head = (guint) g_atomic_int_get (&buffer->head);
+    tail = (guint) g_atomic_int_get (&buffer->tail);
+
+    /* full, the caller falls back to D-Bus */
+    if (head - tail >= IBUS_KEY_RING_SIZE)
+        return FALSE;
+
+    buffer->events[head & IBUS_KEY_RING_MASK] = *event;
+    g_atomic_int_set (&buffer->head, (gint) (head + 1));
+
+    /* a byte per event, so no wakeup is lost; a full fifo means the
+     * consumer has wakeups pending anyway */
+    do {
+        n = write (ring->out_fd, "", 1);
+    } while (n < 0 && errno == EINTR);
+
+    return TRUE;
+}
+
+gboolean
+ibus_key_ring_pop (IBusKeyRing      *ring,
+                   IBusKeyRingEvent *event)
+{
+    g_assert (ring != NULL);
+    g_assert (event != NULL);
+
+    IBusKeyRingBuffer *buffer = ring->in;
+    guint head, tail;
+
+    tail = (guint) g_atomic_int_get (&buffer->tail);
+    head = (guint) g_atomic_int_get (&buffer->head);
+
+    if (head == tail)
+        return FALSE;
+
+    /* the other side owns head, do not trust it */
+    if (head - tail > IBUS_KEY_RING_SIZE) {
+        g_warning ("Key ring %s is corrupted", ring->path);
+        g_atomic_int_set (&buffer->tail, (gint) head);
+        return FALSE;
+    }
+
+    *event = buffer->events[tail & IBUS_KEY_RING_MASK];
+    g_atomic_int_set (&buffer->tail, (gint) (tail + 1));
+
+    return TRUE;
+}
+
+guint
+ibus_key_ring_dispatch (IBusKeyRing     *ring,
+                        IBusKeyRingFunc  func,
+                        gpointer         user_data)
+{
+    g_assert (ring != NULL);
+    g_assert (func != NULL);
+
+    IBusKeyRingEvent event;
+    gchar buf[64];
+    guint n = 0;
+
+    /* drain the wakeups first, events pushed after this signal again */
+    while (read (ring->in_fd, buf, sizeof (buf)) > 0);
+
+    ring->dispatching = TRUE;
+    while (!ring->freed && ibus_key_ring_pop (ring, &event)) {
+        func (ring, &event, user_data);
+        n ++;
+    }
+    ring->dispatching = FALSE;
+
+    if (ring->freed) {
+        ibus_key_ring_free (ring);
+    }
+
+    return n;
+}
+
+gboolean
+ibus_key_ring_wait (IBusKeyRing *ring,
+                    gint         timeout)
+{
+    g_assert (ring != NULL);
+
+    struct pollfd pfd;
+    gchar buf[64];
+    gint retval;
+
+    pfd.fd = ring->in_fd;
+    pfd.events = POLLIN;
+
+    do {
+        retval = poll (&pfd, 1, timeout);
+    } while (retval < 0 && errno == EINTR);
+
+    if (retval <= 0)
+        return FALSE;
+
+    /* the caller pops until the ring is empty, the wakeups are used up */
+    while (read (ring->in_fd, buf, sizeof (buf)) > 0);
+
+    return TRUE;
+}
+
+static gboolean
+_ibus_key_ring_watch_cb (GIOChannel   *channel,
+                         GIOCondition  condition,
+                         IBusKeyRing  *ring)
+{
+    if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+        g_warning ("Key ring %s is broken", ring->path);
+        ring->watch_id = 0;
+        return FALSE;
+    }
+
+    ibus_key_ring_dispatch (ring, ring->func, ring->user_data);
+
+    return TRUE;
+}
+
+void
+ibus_key_ring_set_watch (IBusKeyRing     *ring,
+                         IBusKeyRingFunc  func,
+                         gpointer         user_data)
+{
+    g_assert (ring != NULL);
+    g_assert (func != NULL);
+    g_assert (ring->watch_id == 0);
+
+    GIOChannel *channel;
+
+    ring->func = func;
+    ring->user_data = user_data;
+
+    channel = g_io_channel_unix_new (ring->in_fd);
+    ring->watch_id = g_io_add_watch (channel,
+                                     G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                     (GIOFunc) _ibus_key_ring_watch_cb,
+                                     ring);
+    g_io_channel_unref (channel);
+}
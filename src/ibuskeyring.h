@@ -0,0 +1,74 @@
+/* vim:set et sts=4: */
+/* ibus - The Input Bus
+ * Copyright (C) 2008-2009 Huang Peng <shawn.p.huang@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __IBUS_KEY_RING_H_
+#define __IBUS_KEY_RING_H_
+
+/*
+ * A shared memory path for ProcessKeyEvent and its reply between an input
+ * context and the daemon. The daemon creates a ring for the context and
+ * passes its path over D-Bus, which stays the control channel. The ring
+ * holds one single producer/single consumer queue in each direction; the
+ * consumer is woken up through a fifo next to the shared file.
+ */
+
+#include <glib.h>
+
+#define IBUS_KEY_RING_SIZE  (64)
+
+G_BEGIN_DECLS
+
+typedef struct _IBusKeyRing IBusKeyRing;
+typedef struct _IBusKeyRingEvent IBusKeyRingEvent;
+
+typedef void (* IBusKeyRingFunc)    (IBusKeyRing            *ring,
+                                     const IBusKeyRingEvent *event,
+                                     gpointer                user_data);
+
+struct _IBusKeyRingEvent {
+    guint32 serial;
+    guint32 keyval;
+    guint32 state;
+    guint32 handled;
+    /* replies only: the D-Bus serial of the last signal the daemon sent to
+     * the input context before the reply, 0 for none */
+    guint32 message_serial;
+};
+
+IBusKeyRing     *ibus_key_ring_new      (const gchar        *dir);
+IBusKeyRing     *ibus_key_ring_open     (const gchar        *path);
+void             ibus_key_ring_free     (IBusKeyRing        *ring);
+const gchar     *ibus_key_ring_get_path (IBusKeyRing        *ring);
+void             ibus_key_ring_unlink   (IBusKeyRing        *ring);
+gboolean         ibus_key_ring_push     (IBusKeyRing        *ring,
+                                         const IBusKeyRingEvent
+                                                            *event);
+gboolean         ibus_key_ring_pop      (IBusKeyRing        *ring,
+                                         IBusKeyRingEvent   *event);
+guint            ibus_key_ring_dispatch (IBusKeyRing        *ring,
+                                         IBusKeyRingFunc     func,
+                                         gpointer            user_data);
+gboolean         ibus_key_ring_wait     (IBusKeyRing        *ring,
+                                         gint                timeout);
+void             ibus_key_ring_set_watch(IBusKeyRing        *ring,
+                                         IBusKeyRingFunc     func,
+                                         gpointer            user_data);
+
+G_END_DECLS
+#endif
@@ -138,7 +138,9 @@ ibus_lookup_table_serialize (IBusLookupTable *table,
         if (text == NULL)
             break;
 
-        retval = ibus_message_iter_append (&array_iter, IBUS_TYPE_TEXT, &text);
+        retval = ibus_serializable_serialize_with_flags ((IBusSerializable *) text,
+                                                         &array_iter,
+                                                         flags);
         g_return_val_if_fail (retval, FALSE);
     }
 
@@ -429,3 +431,240 @@ ibus_lookup_table_cursor_down (IBusLookupTable *table)
     table->cursor_pos ++;
     return TRUE;
 }
+
+IBusLookupTable *
+ibus_lookup_table_dup (IBusLookupTable *table)
+{
+    g_assert (IBUS_IS_LOOKUP_TABLE (table));
+
+    IBusLookupTable *new_table;
+    guint i;
+
+    new_table = ibus_lookup_table_new (table->page_size,
+                                       table->cursor_pos,
+                                       table->cursor_visible,
+                                       table->round);
+
+    for (i = 0; i < table->candidates->len; i++) {
+        ibus_lookup_table_append_candidate (new_table,
+                                            g_array_index (table->candidates, IBusText *, i));
+    }
+
+    return new_table;
+}
+
+static gboolean
+_attr_list_equal (IBusAttrList *attrs1,
+                  IBusAttrList *attrs2)
+{
+    guint len1, len2, i;
+
+    len1 = attrs1 ? attrs1->attributes->len : 0;
+    len2 = attrs2 ? attrs2->attributes->len : 0;
+
+    if (len1 != len2)
+        return FALSE;
+
+    for (i = 0; i < len1; i++) {
+        IBusAttribute *attr1 = ibus_attr_list_get (attrs1, i);
+        IBusAttribute *attr2 = ibus_attr_list_get (attrs2, i);
+
+        if (attr1->type != attr2->type ||
+            attr1->value != attr2->value ||
+            attr1->start_index != attr2->start_index ||
+            attr1->end_index != attr2->end_index)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+_text_equal (IBusText *text1,
+             IBusText *text2)
+{
+    if (text1 == text2)
+        return TRUE;
+
+    return g_strcmp0 (text1->text, text2->text) == 0 &&
+           _attr_list_equal (text1->attrs, text2->attrs);
+}
+
+IBusLookupTableDelta *
+ibus_lookup_table_diff (IBusLookupTable *old_table,
+                        IBusLookupTable *new_table)
+{
+    g_assert (IBUS_IS_LOOKUP_TABLE (old_table));
+    g_assert (IBUS_IS_LOOKUP_TABLE (new_table));
+
+    IBusLookupTableDelta *delta;
+    guint old_len, new_len;
+    guint prefix, suffix;
+    guint i;
+
+    old_len = old_table->candidates->len;
+    new_len = new_table->candidates->len;
+
+    for (prefix = 0; prefix < old_len && prefix < new_len; prefix++) {
+        if (!_text_equal (g_array_index (old_table->candidates, IBusText *, prefix),
+                          g_array_index (new_table->candidates, IBusText *, prefix)))
+            break;
+    }
+
+    for (suffix = 0; prefix + suffix < old_len && prefix + suffix < new_len; suffix++) {
+        if (!_text_equal (g_array_index (old_table->candidates, IBusText *, old_len - suffix - 1),
+                          g_array_index (new_table->candidates, IBusText *, new_len - suffix - 1)))
+            break;
+    }
+
+    delta = g_slice_new0 (IBusLookupTableDelta);
+    delta->page_size = new_table->page_size;
+    delta->cursor_pos = new_table->cursor_pos;
+    delta->cursor_visible = new_table->cursor_visible;
+    delta->round = new_table->round;
+    delta->begin = prefix;
+    delta->n_removed = old_len - prefix - suffix;
+    delta->candidates = g_ptr_array_sized_new (new_len - prefix - suffix);
+
+    for (i = prefix; i < new_len - suffix; i++) {
+        IBusText *text = g_array_index (new_table->candidates, IBusText *, i);
+        g_ptr_array_add (delta->candidates, g_object_ref (text));
+    }
+
+    return delta;
+}
+
+IBusLookupTable *
+ibus_lookup_table_apply_delta (IBusLookupTable            *table,
+                               const IBusLookupTableDelta *delta)
+{
+    g_assert (IBUS_IS_LOOKUP_TABLE (table));
+    g_assert (delta != NULL);
+
+    IBusLookupTable *new_table;
+    guint i;
+
+    if (delta->page_size == 0 ||
+        delta->begin + delta->n_removed > table->candidates->len)
+        return NULL;
+
+    new_table = ibus_lookup_table_new (delta->page_size,
+                                       delta->cursor_pos,
+                                       delta->cursor_visible,
+                                       delta->round);
+
+    for (i = 0; i < delta->begin; i++) {
+        ibus_lookup_table_append_candidate (new_table,
+                                            g_array_index (table->candidates, IBusText *, i));
+    }
+    for (i = 0; i < delta->candidates->len; i++) {
+        ibus_lookup_table_append_candidate (new_table,
+                                            (IBusText *) g_ptr_array_index (delta->candidates, i));
+    }
+    for (i = delta->begin + delta->n_removed; i < table->candidates->len; i++) {
+        ibus_lookup_table_append_candidate (new_table,
+                                            g_array_index (table->candidates, IBusText *, i));
+    }
+
+    return new_table;
+}
+
+gboolean
+ibus_lookup_table_delta_serialize (const IBusLookupTableDelta *delta,
+                                   IBusMessageIter            *iter,
+                                   IBusSerializeFlags          flags)
+{
+    g_assert (delta != NULL);
+    g_assert (iter != NULL);
+
+    IBusMessageIter array_iter;
+    gboolean retval;
+    guint i;
+
+    retval = ibus_message_iter_append (iter, G_TYPE_UINT, &delta->generation);
+    g_return_val_if_fail (retval, FALSE);
+
+    retval = ibus_message_iter_append (iter, G_TYPE_UINT, &delta->page_size);
+    g_return_val_if_fail (retval, FALSE);
+
+    retval = ibus_message_iter_append (iter, G_TYPE_UINT, &delta->cursor_pos);
+    g_return_val_if_fail (retval, FALSE);
+
+    retval = ibus_message_iter_append (iter, G_TYPE_BOOLEAN, &delta->cursor_visible);
+    g_return_val_if_fail (retval, FALSE);
+
+    retval = ibus_message_iter_append (iter, G_TYPE_BOOLEAN, &delta->round);
+    g_return_val_if_fail (retval, FALSE);
+
+    retval = ibus_message_iter_append (iter, G_TYPE_UINT, &delta->begin);
+    g_return_val_if_fail (retval, FALSE);
+
+    retval = ibus_message_iter_append (iter, G_TYPE_UINT, &delta->n_removed);
+    g_return_val_if_fail (retval, FALSE);
+
+    retval = ibus_message_iter_open_container (iter,
+                                               IBUS_TYPE_ARRAY,
+                                               "v",
+                                               &array_iter);
+    g_return_val_if_fail (retval, FALSE);
+
+    for (i = 0; i < delta->candidates->len; i++) {
+        IBusText *text = (IBusText *) g_ptr_array_index (delta->candidates, i);
+
+        retval = ibus_message_iter_append (&array_iter, IBUS_TYPE_TEXT, &text);
+        g_return_val_if_fail (retval, FALSE);
+    }
+
+    retval = ibus_message_iter_close_container (iter, &array_iter);
+    g_return_val_if_fail (retval, FALSE);
+
+    return TRUE;
+}
+
+IBusLookupTableDelta *
+ibus_lookup_table_delta_deserialize (IBusMessageIter *iter)
+{
+    g_assert (iter != NULL);
+
+    IBusLookupTableDelta *delta;
+    IBusMessageIter array_iter;
+
+    delta = g_slice_new0 (IBusLookupTableDelta);
+    delta->candidates = g_ptr_array_new ();
+
+    if (!ibus_message_iter_get (iter, G_TYPE_UINT, &delta->generation) ||
+        !ibus_message_iter_get (iter, G_TYPE_UINT, &delta->page_size) ||
+        !ibus_message_iter_get (iter, G_TYPE_UINT, &delta->cursor_pos) ||
+        !ibus_message_iter_get (iter, G_TYPE_BOOLEAN, &delta->cursor_visible) ||
+        !ibus_message_iter_get (iter, G_TYPE_BOOLEAN, &delta->round) ||
+        !ibus_message_iter_get (iter, G_TYPE_UINT, &delta->begin) ||
+        !ibus_message_iter_get (iter, G_TYPE_UINT, &delta->n_removed) ||
+        !ibus_message_iter_recurse (iter, IBUS_TYPE_ARRAY, &array_iter)) {
+        ibus_lookup_table_delta_free (delta);
+        return NULL;
+    }
+
+    while (ibus_message_iter_get_arg_type (&array_iter) != G_TYPE_INVALID) {
+        IBusText *text;
+
+        if (!ibus_message_iter_get (&array_iter, IBUS_TYPE_TEXT, &text)) {
+            ibus_lookup_table_delta_free (delta);
+            return NULL;
+        }
+        g_ptr_array_add (delta->candidates, text);
+    }
+
+    ibus_message_iter_next (iter);
+
+    return delta;
+}
+
+void
+ibus_lookup_table_delta_free (IBusLookupTableDelta *delta)
+{
+    g_assert (delta != NULL);
+
+    g_ptr_array_foreach (delta->candidates, (GFunc) g_object_unref, NULL);
+    g_ptr_array_free (delta->candidates, TRUE);
+    g_slice_free (IBusLookupTableDelta, delta);
+}
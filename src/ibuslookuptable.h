@@ -61,6 +61,24 @@ struct _IBusLookupTableClass {
     IBusSerializableClass parent;
 };
 
+typedef struct _IBusLookupTableDelta IBusLookupTableDelta;
+
+/* The change from one lookup table to the next one: the new page size,
+ * cursor and flags, and the candidates [begin, begin + n_removed) of the
+ * old table replaced by @candidates. generation is the number of full
+ * tables sent before on the same link, a delta for another generation
+ * must be dropped. */
+struct _IBusLookupTableDelta {
+    guint generation;
+    guint page_size;
+    guint cursor_pos;
+    gboolean cursor_visible;
+    gboolean round;
+    guint begin;
+    guint n_removed;
+    GPtrArray *candidates;
+};
+
 
 GType                ibus_lookup_table_get_type (void);
 IBusLookupTable     *ibus_lookup_table_new      (guint               page_size,
@@ -96,6 +114,23 @@ gboolean             ibus_lookup_table_page_down(IBusLookupTable    *table);
 gboolean             ibus_lookup_table_cursor_up(IBusLookupTable    *table);
 gboolean             ibus_lookup_table_cursor_down
                                                 (IBusLookupTable    *table);
+IBusLookupTable     *ibus_lookup_table_dup      (IBusLookupTable    *table);
+IBusLookupTableDelta*ibus_lookup_table_diff     (IBusLookupTable    *old_table,
+                                                 IBusLookupTable    *new_table);
+IBusLookupTable     *ibus_lookup_table_apply_delta
+                                                (IBusLookupTable    *table,
+                                                 const IBusLookupTableDelta
+                                                                    *delta);
+gboolean             ibus_lookup_table_delta_serialize
+                                                (const IBusLookupTableDelta
+                                                                    *delta,
+                                                 IBusMessageIter    *iter,
+                                                 IBusSerializeFlags  flags);
+IBusLookupTableDelta*ibus_lookup_table_delta_deserialize
+                                                (IBusMessageIter    *iter);
+void                 ibus_lookup_table_delta_free
+                                                (IBusLookupTableDelta
+                                                                    *delta);
 G_END_DECLS
 #endif
 
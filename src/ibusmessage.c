@@ -838,6 +838,173 @@ ibus_message_iter_get_element_type (IBusMessageIter *iter)
     return dbus_type_to_gtype (type);
 }
 
+/* typed appends for fixed signatures, without the GType dispatch of
+ * ibus_message_iter_append */
+gboolean
+ibus_message_iter_append_boolean (IBusMessageIter *iter,
+                                  gboolean         value)
+{
+    dbus_bool_t v = value ? TRUE : FALSE;
+
+    return dbus_message_iter_append_basic (iter, DBUS_TYPE_BOOLEAN, &v);
+}
+
+gboolean
+ibus_message_iter_append_uint (IBusMessageIter *iter,
+                               guint            value)
+{
+    dbus_uint32_t v = value;
+
+    return dbus_message_iter_append_basic (iter, DBUS_TYPE_UINT32, &v);
+}
+
+gboolean
+ibus_message_iter_append_string (IBusMessageIter *iter,
+                                 const gchar     *value)
+{
+    g_assert (value != NULL);
+
+    return dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &value);
+}
+
+gboolean
+ibus_message_iter_append_uint_array (IBusMessageIter *iter,
+                                     const guint32   *values,
+                                     guint            n_values)
+{
+    g_assert (iter != NULL);
+    g_assert (values != NULL || n_values == 0);
+
+    IBusMessageIter sub_iter;
+    gboolean retval;
+
+    retval = dbus_message_iter_open_container (iter,
+                                               DBUS_TYPE_ARRAY,
+                                               DBUS_TYPE_UINT32_AS_STRING,
+                                               &sub_iter);
+    if (!retval)
+        return FALSE;
+
+    retval = dbus_message_iter_append_fixed_array (&sub_iter,
+                                                   DBUS_TYPE_UINT32,
+                                                   &values,
+                                                   n_values);
+    if (!retval) {
+        dbus_message_iter_close_container (iter, &sub_iter);
+        return FALSE;
+    }
+
+    return dbus_message_iter_close_container (iter, &sub_iter);
+}
+
+GArray *
+ibus_message_iter_get_uint_array (IBusMessageIter *iter)
+{
+    g_assert (iter != NULL);
+
+    IBusMessageIter sub_iter;
+    const guint32 *values;
+    gint n_values;
+    GArray *array;
+
+    if (dbus_message_iter_get_arg_type (iter) != DBUS_TYPE_ARRAY ||
+        dbus_message_iter_get_element_type (iter) != DBUS_TYPE_UINT32)
+        return NULL;
+
+    dbus_message_iter_recurse (iter, &sub_iter);
+    dbus_message_iter_get_fixed_array (&sub_iter, &values, &n_values);
+
+    array = g_array_sized_new (FALSE, FALSE, sizeof (guint32), n_values);
+    g_array_append_vals (array, values, n_values);
+
+    dbus_message_iter_next (iter);
+
+    return array;
+}
+
+static void
+_value_free (GValue *value)
+{
+    g_value_unset (value);
+    g_slice_free (GValue, value);
+}
+
+GHashTable *
+ibus_value_table_new (void)
+{
+    return g_hash_table_new_full (g_str_hash,
+                                  g_str_equal,
+                                  (GDestroyNotify) g_free,
+                                  (GDestroyNotify) _value_free);
+}
+
+static void
+_append_value_entry (const gchar     *name,
+                     const GValue    *value,
+                     IBusMessageIter *iter)
+{
+    IBusMessageIter entry_iter;
+
+    ibus_message_iter_open_container (iter, IBUS_TYPE_DICT_ENTRY, NULL, &entry_iter);
+    ibus_message_iter_append (&entry_iter, G_TYPE_STRING, &name);
+    ibus_message_iter_append (&entry_iter, G_TYPE_VALUE, value);
+    ibus_message_iter_close_container (iter, &entry_iter);
+}
+
+gboolean
+ibus_message_iter_append_value_table (IBusMessageIter *iter,
+                                      GHashTable      *values)
+{
+    g_assert (iter != NULL);
+    g_assert (values != NULL);
+
+    IBusMessageIter sub_iter;
+
+    if (!ibus_message_iter_open_container (iter, IBUS_TYPE_ARRAY, "{sv}", &sub_iter))
+        return FALSE;
+
+    g_hash_table_foreach (values, (GHFunc) _append_value_entry, &sub_iter);
+
+    return ibus_message_iter_close_container (iter, &sub_iter);
+}
+
+GHashTable *
+ibus_message_iter_get_value_table (IBusMessageIter *iter)
+{
+    g_assert (iter != NULL);
+
+    IBusMessageIter sub_iter;
+    GHashTable *values;
+
+    if (dbus_message_iter_get_arg_type (iter) != DBUS_TYPE_ARRAY ||
+        dbus_message_iter_get_element_type (iter) != DBUS_TYPE_DICT_ENTRY)
+        return NULL;
+
+    values = ibus_value_table_new ();
+
+    dbus_message_iter_recurse (iter, &sub_iter);
+    while (dbus_message_iter_get_arg_type (&sub_iter) == DBUS_TYPE_DICT_ENTRY) {
+        IBusMessageIter entry_iter;
+        gchar *name;
+        GValue *value;
+
+        dbus_message_iter_recurse (&sub_iter, &entry_iter);
+        dbus_message_iter_next (&sub_iter);
+
+        if (!ibus_message_iter_get (&entry_iter, G_TYPE_STRING, &name) ||
+            dbus_message_iter_get_arg_type (&entry_iter) != DBUS_TYPE_VARIANT)
+            continue;
+
+        value = g_slice_new0 (GValue);
+        _from_dbus_value (&entry_iter, value);
+        g_hash_table_insert (values, g_strdup (name), value);
+    }
+
+    dbus_message_iter_next (iter);
+
+    return values;
+}
+
 gchar *
 ibus_message_to_string (IBusMessage *message)
 {
@@ -140,6 +140,27 @@ gboolean         ibus_message_iter_recurse      (IBusMessageIter    *iter,
 GType            ibus_message_iter_get_arg_type (IBusMessageIter    *iter);
 GType            ibus_message_iter_get_element_type
                                                 (IBusMessageIter    *iter);
+gboolean         ibus_message_iter_append_boolean
+                                                (IBusMessageIter    *iter,
+                                                 gboolean            value);
+gboolean         ibus_message_iter_append_uint  (IBusMessageIter    *iter,
+                                                 guint               value);
+gboolean         ibus_message_iter_append_string
+                                                (IBusMessageIter    *iter,
+                                                 const gchar        *value);
+gboolean         ibus_message_iter_append_uint_array
+                                                (IBusMessageIter    *iter,
+                                                 const guint32      *values,
+                                                 guint               n_values);
+GArray          *ibus_message_iter_get_uint_array
+                                                (IBusMessageIter    *iter);
+/* value tables map names to GValues, both owned by the table */
+GHashTable      *ibus_value_table_new           (void);
+gboolean         ibus_message_iter_append_value_table
+                                                (IBusMessageIter    *iter,
+                                                 GHashTable         *values);
+GHashTable      *ibus_message_iter_get_value_table
+                                                (IBusMessageIter    *iter);
 gchar           *ibus_message_to_string         (IBusMessage *message);
 
 G_END_DECLS
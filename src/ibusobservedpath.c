@@ -18,25 +18,29 @@
  * Boston, MA 02111-1307, USA.
  */
 #include <glib/gstdio.h>
+#include <gio/gio.h>
 #include <stdlib.h>
+#include "ibusmarshalers.h"
 #include "ibusobservedpath.h"
+#include "ibusinternal.h"
 
 
 enum {
+    CHANGED,
     LAST_SIGNAL,
 };
 
 
 /* IBusObservedPathPriv */
 struct _IBusObservedPathPrivate {
-    gpointer pad;
+    GFileMonitor *monitor;
 };
 typedef struct _IBusObservedPathPrivate IBusObservedPathPrivate;
 
 #define IBUS_OBSERVED_PATH_GET_PRIVATE(o)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((o), IBUS_TYPE_OBSERVED_PATH, IBusObservedPathPrivate))
 
-// static guint            _signals[LAST_SIGNAL] = { 0 };
+static guint            _signals[LAST_SIGNAL] = { 0 };
 
 /* functions prototype */
 static void      ibus_observed_path_class_init      (IBusObservedPathClass  *klass);
@@ -50,6 +54,7 @@ static gboolean  ibus_observed_path_copy            (IBusObservedPath       *des
                                                      const IBusObservedPath *src);
 static gboolean  ibus_observed_path_parse_xml_node  (IBusObservedPath       *path,
                                                      XMLNode                *node);
+static void      ibus_observed_path_fill_stat       (IBusObservedPath       *path);
 
 static IBusSerializableClass  *parent_class = NULL;
 
@@ -89,7 +94,7 @@ ibus_observed_path_class_init (IBusObservedPathClass *klass)
 
     parent_class = (IBusSerializableClass *) g_type_class_peek_parent (klass);
 
-    // g_type_class_add_private (klass, sizeof (IBusObservedPathPrivate));
+    g_type_class_add_private (klass, sizeof (IBusObservedPathPrivate));
 
     object_class->destroy = (IBusObjectDestroyFunc) ibus_observed_path_destroy;
 
@@ -98,19 +103,39 @@ ibus_observed_path_class_init (IBusObservedPathClass *klass)
     serializable_class->copy        = (IBusSerializableCopyFunc) ibus_observed_path_copy;
 
     g_string_append (serializable_class->signature, "sx");
+
+    /* install signals */
+    _signals[CHANGED] =
+        g_signal_new (I_("changed"),
+            G_TYPE_FROM_CLASS (klass),
+            G_SIGNAL_RUN_LAST,
+            0,
+            NULL, NULL,
+            ibus_marshal_VOID__STRING_UINT,
+            G_TYPE_NONE,
+            2,
+            G_TYPE_STRING,
+            G_TYPE_UINT);
 }
 
 
 static void
 ibus_observed_path_init (IBusObservedPath *path)
 {
+    IBusObservedPathPrivate *priv;
+    priv = IBUS_OBSERVED_PATH_GET_PRIVATE (path);
+
     path->path = NULL;
+    priv->monitor = NULL;
 }
 
 static void
 ibus_observed_path_destroy (IBusObservedPath *path)
 {
+    ibus_observed_path_stop_monitor (path);
+
     g_free (path->path);
+    path->path = NULL;
     IBUS_OBJECT_CLASS (parent_class)->destroy (IBUS_OBJECT (path));
 }
 
@@ -333,3 +358,91 @@ ibus_observed_path_new (const gchar *path,
     return op;
 }
 
+static void
+_monitor_changed_cb (GFileMonitor      *monitor,
+                     GFile             *file,
+                     GFile             *other_file,
+                     GFileMonitorEvent  event,
+                     IBusObservedPath  *path)
+{
+    g_assert (IBUS_IS_OBSERVED_PATH (path));
+
+    gchar *filename;
+
+    switch (event) {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_CREATED:
+        break;
+    default:
+        /* CHANGED is followed by CHANGES_DONE_HINT, attribute changes do
+         * not touch the content */
+        return;
+    }
+
+    /* keep mtime in sync, so the stat check at next startup does not
+     * see a change which was already handled */
+    ibus_observed_path_fill_stat (path);
+
+    filename = g_file_get_path (file);
+    g_signal_emit (path, _signals[CHANGED], 0, filename, (guint) event);
+    g_free (filename);
+}
+
+gboolean
+ibus_observed_path_start_monitor (IBusObservedPath *path)
+{
+    g_assert (IBUS_IS_OBSERVED_PATH (path));
+
+    IBusObservedPathPrivate *priv;
+    GFile *file;
+    GError *error = NULL;
+
+    priv = IBUS_OBSERVED_PATH_GET_PRIVATE (path);
+
+    if (priv->monitor != NULL)
+        return TRUE;
+
+    file = g_file_new_for_path (path->path);
+    /* a missing path is watched as a directory, so the files created in
+     * it later are reported too */
+    if (path->is_dir || !path->is_exist) {
+        priv->monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, &error);
+    }
+    else {
+        priv->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, &error);
+    }
+    g_object_unref (file);
+
+    if (priv->monitor == NULL) {
+        g_warning ("Can not monitor %s: %s", path->path, error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    g_signal_connect (priv->monitor,
+                      "changed",
+                      G_CALLBACK (_monitor_changed_cb),
+                      path);
+
+    return TRUE;
+}
+
+void
+ibus_observed_path_stop_monitor (IBusObservedPath *path)
+{
+    g_assert (IBUS_IS_OBSERVED_PATH (path));
+
+    IBusObservedPathPrivate *priv;
+    priv = IBUS_OBSERVED_PATH_GET_PRIVATE (path);
+
+    if (priv->monitor == NULL)
+        return;
+
+    g_signal_handlers_disconnect_by_func (priv->monitor,
+                                          G_CALLBACK (_monitor_changed_cb),
+                                          path);
+    g_file_monitor_cancel (priv->monitor);
+    g_object_unref (priv->monitor);
+    priv->monitor = NULL;
+}
@@ -73,6 +73,8 @@ gboolean             ibus_observed_path_check_modification  (IBusObservedPath
 void                 ibus_observed_path_output              (IBusObservedPath   *path,
                                                              GString            *output,
                                                              gint                indent);
+gboolean             ibus_observed_path_start_monitor       (IBusObservedPath   *path);
+void                 ibus_observed_path_stop_monitor        (IBusObservedPath   *path);
 
 G_END_DECLS
 #endif
@@ -580,6 +580,30 @@ ibus_proxy_send (IBusProxy      *proxy,
     return ibus_connection_send (priv->connection, message);
 }
 
+gboolean
+ibus_proxy_send_with_reply (IBusProxy        *proxy,
+                            IBusMessage      *message,
+                            IBusPendingCall **pending,
+                            gint              timeout_milliseconds)
+{
+    g_assert (IBUS_IS_PROXY (proxy));
+    g_assert (message != NULL);
+    g_assert (pending != NULL);
+
+    IBusProxyPrivate *priv;
+    priv = IBUS_PROXY_GET_PRIVATE (proxy);
+
+    *pending = NULL;
+
+    if (priv->connection == NULL || !ibus_connection_is_connected (priv->connection))
+        return FALSE;
+
+    return ibus_connection_send_with_reply (priv->connection,
+                                            message,
+                                            pending,
+                                            timeout_milliseconds);
+}
+
 gboolean
 ibus_proxy_call (IBusProxy      *proxy,
                  const gchar    *method,
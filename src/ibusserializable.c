@@ -50,6 +50,10 @@ static gboolean  ibus_serializable_real_copy        (IBusSerializable       *des
 
 static IBusObjectClass *parent_class = NULL;
 
+/* flags of the ibus_serializable_serialize_with_flags in progress, the
+ * objects nested in it are serialized the same way */
+static IBusSerializeFlags serialize_flags = 0;
+
 
 GType
 ibus_serializable_get_type (void)
@@ -96,6 +100,8 @@ ibus_serializable_base_init     (IBusSerializableClass *klass)
 {
     /* init signature */
     klass->signature = g_string_new ("a{sv}");
+    /* the parent class's cached signature was copied with the class struct */
+    klass->variant_signature = NULL;
 }
 
 static void
@@ -104,6 +110,8 @@ ibus_serializable_base_fini     (IBusSerializableClass *klass)
     /* init signature */
     g_string_free (klass->signature, TRUE);
     klass->signature = NULL;
+    g_free (klass->variant_signature);
+    klass->variant_signature = NULL;
 }
 
 static void
@@ -316,9 +324,12 @@ ibus_serializable_real_serialize (IBusSerializable *object,
                                                &array_iter);
     g_return_val_if_fail (retval, FALSE);
 
-    g_datalist_foreach (&priv->attachments,
-                        (GDataForeachFunc) _serialize_cb,
-                        &array_iter);
+    /* most objects never get an attachment */
+    if (priv->attachments != NULL) {
+        g_datalist_foreach (&priv->attachments,
+                            (GDataForeachFunc) _serialize_cb,
+                            &array_iter);
+    }
 
     retval = ibus_message_iter_close_container (iter, &array_iter);
     g_return_val_if_fail (retval, FALSE);
@@ -386,6 +397,9 @@ ibus_serializable_real_copy (IBusSerializable *dest,
     src_priv = IBUS_SERIALIZABLE_GET_PRIVATE (src);
     dest_priv = IBUS_SERIALIZABLE_GET_PRIVATE (dest);
 
+    if (src_priv->attachments == NULL)
+        return TRUE;
+
     g_datalist_foreach (&src_priv->attachments,
                         (GDataForeachFunc) _copy_cb,
                         &dest_priv->attachments);
@@ -491,18 +505,23 @@ ibus_serializable_serialize (IBusSerializable *object,
     g_return_val_if_fail (IBUS_IS_SERIALIZABLE (object), FALSE);
     g_return_val_if_fail (iter != NULL, FALSE);
 
+    IBusSerializableClass *klass;
     IBusMessageIter variant_iter;
     IBusMessageIter sub_iter;
     gboolean retval;
 
-    gchar *signature;
+    klass = IBUS_SERIALIZABLE_GET_CLASS (object);
+
+    /* subclasses only extend signature in class_init, so it is final
+     * once an instance exists */
+    if (G_UNLIKELY (klass->variant_signature == NULL)) {
+        klass->variant_signature = g_strdup_printf ("(s%s)", klass->signature->str);
+    }
 
-    signature = g_strdup_printf ("(s%s)", IBUS_SERIALIZABLE_GET_CLASS (object)->signature->str);
     retval = ibus_message_iter_open_container (iter,
                                                IBUS_TYPE_VARIANT,
-                                               signature,
+                                               klass->variant_signature,
                                                &variant_iter);
-    g_free (signature);
     g_return_val_if_fail (retval, FALSE);
 
     retval = ibus_message_iter_open_container (&variant_iter,
@@ -519,7 +538,7 @@ ibus_serializable_serialize (IBusSerializable *object,
                                        &type_name);
     g_return_val_if_fail (retval, FALSE);
 
-    retval = IBUS_SERIALIZABLE_GET_CLASS (object)->serialize (object, &sub_iter);
+    retval = klass->serialize (object, &sub_iter);
     g_return_val_if_fail (retval, FALSE);
 
     retval = ibus_message_iter_close_container (&variant_iter, &sub_iter);
@@ -531,6 +550,28 @@ ibus_serializable_serialize (IBusSerializable *object,
     return TRUE;
 }
 
+gboolean
+ibus_serializable_serialize_with_flags (IBusSerializable   *object,
+                                        IBusMessageIter    *iter,
+                                        IBusSerializeFlags  flags)
+{
+    IBusSerializeFlags saved_flags;
+    gboolean retval;
+
+    saved_flags = serialize_flags;
+    serialize_flags = flags;
+    retval = ibus_serializable_serialize (object, iter);
+    serialize_flags = saved_flags;
+
+    return retval;
+}
+
+IBusSerializeFlags
+ibus_serializable_get_serialize_flags (void)
+{
+    return serialize_flags;
+}
+
 IBusSerializable *
 ibus_serializable_deserialize (IBusMessageIter *iter)
 {
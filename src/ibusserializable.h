@@ -52,6 +52,19 @@ G_BEGIN_DECLS
 
 typedef struct _IBusSerializable IBusSerializable;
 typedef struct _IBusSerializableClass IBusSerializableClass;
+
+/**
+ * IBusSerializeFlags:
+ * @IBUS_SERIALIZE_COMPACT_TEXT: IBusTexts without attributes carry a
+ * variant holding the uint32 0 instead of an empty IBusAttrList. Both
+ * forms are deserialized, but peers built before the compact encoding only
+ * read the full one.
+ *
+ * Flags of ibus_serializable_serialize_with_flags().
+ */
+typedef enum {
+    IBUS_SERIALIZE_COMPACT_TEXT = 1 << 0,
+} IBusSerializeFlags;
 /**
  * IBusSerializable:
  *
@@ -84,8 +97,11 @@ struct _IBusSerializableClass {
     gboolean    (* copy)        (IBusSerializable       *dest,
                                  const IBusSerializable *src);
     /*< private >*/
+    /* "(s" + signature + ")", built on first serialize */
+    gchar *variant_signature;
+
     /* padding */
-    gpointer pdummy[5];
+    gpointer pdummy[4];
 };
 
 GType                ibus_serializable_get_type         (void);
@@ -101,6 +117,12 @@ void                 ibus_serializable_remove_qattachment
 IBusSerializable    *ibus_serializable_copy             (IBusSerializable   *object);
 gboolean             ibus_serializable_serialize        (IBusSerializable   *object,
                                                          IBusMessageIter    *iter);
+gboolean             ibus_serializable_serialize_with_flags
+                                                        (IBusSerializable   *object,
+                                                         IBusMessageIter    *iter,
+                                                         IBusSerializeFlags  flags);
+IBusSerializeFlags   ibus_serializable_get_serialize_flags
+                                                        (void);
 IBusSerializable    *ibus_serializable_deserialize      (IBusMessageIter    *iter);
 
 G_END_DECLS
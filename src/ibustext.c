@@ -32,6 +32,9 @@ static gboolean     ibus_text_copy         (IBusText            *dest,
 
 static IBusSerializableClass *parent_class = NULL;
 
+/* sent for texts without attributes in the full encoding */
+static IBusAttrList *_empty_attrs = NULL;
+
 GType
 ibus_text_get_type (void)
 {
@@ -109,18 +112,58 @@ ibus_text_serialize (IBusText        *text,
     retval = parent_class->serialize ((IBusSerializable *)text, iter);
     g_return_val_if_fail (retval, FALSE);
 
-    retval = ibus_message_iter_append (iter, G_TYPE_STRING, &text->text);
+    retval = ibus_message_iter_append_string (iter, text->text);
     g_return_val_if_fail (retval, FALSE);
 
-    if (text->attrs == NULL)
-        text->attrs = ibus_attr_list_new ();
+    /* most texts have no attributes; instead of a whole IBusAttrList
+     * they carry a variant holding the uint32 0 if the peer reads it */
+    if ((text->attrs == NULL || text->attrs->attributes->len == 0) &&
+        (ibus_serializable_get_serialize_flags () & IBUS_SERIALIZE_COMPACT_TEXT)) {
+        IBusMessageIter variant_iter;
+
+        retval = ibus_message_iter_open_container (iter,
+                                                   IBUS_TYPE_VARIANT,
+                                                   "u",
+                                                   &variant_iter);
+        g_return_val_if_fail (retval, FALSE);
+        retval = ibus_message_iter_append_uint (&variant_iter, 0);
+        g_return_val_if_fail (retval, FALSE);
+        retval = ibus_message_iter_close_container (iter, &variant_iter);
+        g_return_val_if_fail (retval, FALSE);
+
+        return TRUE;
+    }
 
-    retval = ibus_message_iter_append (iter, IBUS_TYPE_ATTR_LIST, &text->attrs);
+    if (text->attrs == NULL) {
+        if (_empty_attrs == NULL)
+            _empty_attrs = ibus_attr_list_new ();
+        retval = ibus_message_iter_append (iter, IBUS_TYPE_ATTR_LIST, &_empty_attrs);
+    }
+    else {
+        retval = ibus_message_iter_append (iter, IBUS_TYPE_ATTR_LIST, &text->attrs);
+    }
     g_return_val_if_fail (retval, FALSE);
 
     return TRUE;
 }
 
+/* whether the attrs field holds an IBusAttrList or the compact encoding
+ * of an empty one */
+static gboolean
+_has_attr_list (IBusMessageIter *iter)
+{
+    IBusMessageIter variant_iter;
+    gboolean retval;
+
+    if (ibus_message_iter_get_arg_type (iter) != IBUS_TYPE_VARIANT)
+        return TRUE;
+
+    retval = ibus_message_iter_recurse (iter, IBUS_TYPE_VARIANT, &variant_iter);
+    g_return_val_if_fail (retval, FALSE);
+
+    return ibus_message_iter_get_arg_type (&variant_iter) == IBUS_TYPE_STRUCT;
+}
+
 static gboolean
 ibus_text_deserialize (IBusText        *text,
                        IBusMessageIter *iter)
@@ -134,14 +177,32 @@ ibus_text_deserialize (IBusText        *text,
     retval = ibus_message_iter_get (iter, G_TYPE_STRING, &str);
     g_return_val_if_fail (retval, FALSE);
 
-    text->is_static = FALSE;
-    text->text = g_strdup (str);
+    if (text->is_static == FALSE)
+        g_free (text->text);
+
+    /* many candidates are a single character; those and the empty string
+     * are interned instead of copied into every text */
+    if (str[0] == '\0' || *g_utf8_next_char (str) == '\0') {
+        text->is_static = TRUE;
+        text->text = (gchar *) g_intern_string (str);
+    }
+    else {
+        text->is_static = FALSE;
+        text->text = g_strdup (str);
+    }
 
     if (text->attrs) {
         g_object_unref (text->attrs);
         text->attrs = NULL;
     }
 
+    /* the attribute list is only created when asked for, see
+     * ibus_text_get_attributes */
+    if (!_has_attr_list (iter)) {
+        ibus_message_iter_next (iter);
+        return TRUE;
+    }
+
     retval = ibus_message_iter_get (iter, IBUS_TYPE_ATTR_LIST, &text->attrs);
     g_return_val_if_fail (retval, FALSE);
 
@@ -161,8 +222,15 @@ ibus_text_copy (IBusText       *dest,
     g_return_val_if_fail (IBUS_IS_TEXT (dest), FALSE);
     g_return_val_if_fail (IBUS_IS_TEXT (src), FALSE);
 
-    dest->text = g_strdup (src->text);
-    dest->is_static = FALSE;
+    /* static strings outlive both texts */
+    if (src->is_static) {
+        dest->text = src->text;
+        dest->is_static = TRUE;
+    }
+    else {
+        dest->text = g_strdup (src->text);
+        dest->is_static = FALSE;
+    }
     if (src->attrs)
         dest->attrs = (IBusAttrList *)ibus_serializable_copy ((IBusSerializable *)src->attrs);
 
@@ -286,6 +354,17 @@ ibus_text_append_attribute (IBusText *text,
     ibus_attr_list_append (text->attrs, ibus_attribute_new (type, value, start_index, end_index));
 }
 
+IBusAttrList *
+ibus_text_get_attributes (IBusText *text)
+{
+    g_assert (IBUS_IS_TEXT (text));
+
+    if (text->attrs == NULL)
+        text->attrs = ibus_attr_list_new ();
+
+    return text->attrs;
+}
+
 guint
 ibus_text_get_length (IBusText *text)
 {
@@ -58,9 +58,9 @@ typedef struct _IBusTextClass IBusTextClass;
 
 /**
  * IBusText:
- * @is_static: Whether @text is static, i.e., no need and will not be freed. Only TRUE if IBusText is newed from ibus_text_new_from_static_string().
+ * @is_static: Whether @text is static, i.e., no need and will not be freed. TRUE if IBusText is newed from ibus_text_new_from_static_string(), or deserialized with an empty or single character string, which is interned.
  * @text: The string content of IBusText in UTF-8.
- * @attrs: Associated IBusAttributes.
+ * @attrs: Associated IBusAttributes, or %NULL if there are none. See ibus_text_get_attributes().
  *
  * A text object in IBus.
  */
@@ -143,6 +143,16 @@ void             ibus_text_append_attribute         (IBusText       *text,
                                                      guint           value,
                                                      guint           start_index,
                                                      gint            end_index);
+/**
+ * ibus_text_get_attributes:
+ * @text: An IBusText.
+ * @returns: The IBusAttrList of @text, owned by @text.
+ *
+ * Return the attribute list of an IBusText, creating an empty one if
+ * @text has no attributes yet.
+ */
+IBusAttrList    *ibus_text_get_attributes           (IBusText       *text);
+
 /**
  * ibus_text_get_length:
  * @text: An IBusText.
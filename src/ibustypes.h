@@ -91,6 +91,8 @@ typedef enum
  * @IBUS_CAP_LOOKUP_TABLE: UI is capable to show the lookup table.
  * @IBUS_CAP_FOCUS: UI is capable to get focus.
  * @IBUS_CAP_PROPERTY: UI is capable to have property.
+ * @IBUS_CAP_COMPACT_TEXT: Client reads IBusTexts without attributes in the
+ * compact encoding, see #IBUS_SERIALIZE_COMPACT_TEXT.
  *
  * Capability flags of UI.
  */
@@ -100,6 +102,7 @@ typedef enum {
     IBUS_CAP_LOOKUP_TABLE       = 1 << 2,
     IBUS_CAP_FOCUS              = 1 << 3,
     IBUS_CAP_PROPERTY           = 1 << 4,
+    IBUS_CAP_COMPACT_TEXT       = 1 << 5,
 } IBusCapabilite;
 
 /**
@@ -0,0 +1,57 @@
+/* vim:set et sts=4: */
+#include "ibus.h"
+
+#define N_HOTKEYS 200
+
+int main()
+{
+    IBusHotkeyProfile *profile;
+    GQuark trigger, other;
+    gint i;
+
+    g_type_init ();
+
+    trigger = g_quark_from_static_string ("trigger");
+    other = g_quark_from_static_string ("other");
+
+    profile = ibus_hotkey_profile_new ();
+
+    g_assert (ibus_hotkey_profile_add_hotkey_from_string (profile, "Control+space", trigger));
+    g_assert (ibus_hotkey_profile_add_hotkey_from_string (profile, "Shift+Release+Shift_L", trigger));
+    for (i = 0; i < N_HOTKEYS; i++) {
+        g_assert (ibus_hotkey_profile_add_hotkey (profile, IBUS_a + i, IBUS_MOD1_MASK, other));
+    }
+
+    g_assert (ibus_hotkey_profile_lookup_hotkey (profile, IBUS_space, IBUS_CONTROL_MASK) == trigger);
+    g_assert (ibus_hotkey_profile_lookup_hotkey (profile, IBUS_space, 0) == 0);
+    for (i = 0; i < N_HOTKEYS; i++) {
+        g_assert (ibus_hotkey_profile_lookup_hotkey (profile, IBUS_a + i, IBUS_MOD1_MASK) == other);
+    }
+
+    /* release hotkeys need the press of the same key right before */
+    g_assert (ibus_hotkey_profile_filter_key_event (profile,
+                IBUS_Shift_L, IBUS_SHIFT_MASK | IBUS_RELEASE_MASK,
+                IBUS_Shift_L, 0, NULL) == trigger);
+    g_assert (ibus_hotkey_profile_filter_key_event (profile,
+                IBUS_Shift_L, IBUS_SHIFT_MASK | IBUS_RELEASE_MASK,
+                IBUS_A, IBUS_SHIFT_MASK, NULL) == 0);
+    g_assert (ibus_hotkey_profile_filter_key_event (profile,
+                IBUS_Shift_L, IBUS_SHIFT_MASK | IBUS_RELEASE_MASK,
+                IBUS_Shift_L, IBUS_SHIFT_MASK | IBUS_RELEASE_MASK, NULL) == 0);
+
+    /* removing entries keeps the others reachable */
+    for (i = 0; i < N_HOTKEYS; i += 2) {
+        g_assert (ibus_hotkey_profile_remove_hotkey (profile, IBUS_a + i, IBUS_MOD1_MASK));
+    }
+    for (i = 0; i < N_HOTKEYS; i++) {
+        g_assert (ibus_hotkey_profile_lookup_hotkey (profile, IBUS_a + i, IBUS_MOD1_MASK) ==
+                  (i % 2 ? other : 0));
+    }
+
+    g_assert (ibus_hotkey_profile_remove_hotkey_by_event (profile, other));
+    g_assert (ibus_hotkey_profile_lookup_hotkey (profile, IBUS_b, IBUS_MOD1_MASK) == 0);
+    g_assert (ibus_hotkey_profile_lookup_hotkey (profile, IBUS_space, IBUS_CONTROL_MASK) == trigger);
+
+    g_object_unref (profile);
+    return 0;
+}
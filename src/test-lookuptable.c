@@ -4,7 +4,9 @@ int main()
 {
 	g_type_init ();
 	IBusLookupTable *table, *table1;
+	IBusLookupTableDelta *delta;
 	IBusMessage *message;
+	IBusMessageIter iter;
 	IBusError *error;
 	gboolean retval;
 
@@ -35,5 +37,60 @@ int main()
 	g_object_unref (table);
 	g_object_unref (table1);
 
+	/* cursor only delta */
+	table = ibus_lookup_table_new (9, 0, TRUE, FALSE);
+	ibus_lookup_table_append_candidate (table, ibus_text_new_from_static_string ("a"));
+	ibus_lookup_table_append_candidate (table, ibus_text_new_from_static_string ("b"));
+	ibus_lookup_table_append_candidate (table, ibus_text_new_from_static_string ("c"));
+	table1 = ibus_lookup_table_dup (table);
+	ibus_lookup_table_cursor_down (table1);
+
+	delta = ibus_lookup_table_diff (table, table1);
+	g_assert (delta->cursor_pos == 1);
+	g_assert (delta->n_removed == 0);
+	g_assert (delta->candidates->len == 0);
+	ibus_lookup_table_delta_free (delta);
+	g_object_unref (table1);
+
+	/* candidate range delta, sent through a message */
+	table1 = ibus_lookup_table_new (9, 2, TRUE, FALSE);
+	ibus_lookup_table_append_candidate (table1, ibus_text_new_from_static_string ("a"));
+	ibus_lookup_table_append_candidate (table1, ibus_text_new_from_static_string ("x"));
+	ibus_lookup_table_append_candidate (table1, ibus_text_new_from_static_string ("y"));
+	ibus_lookup_table_append_candidate (table1, ibus_text_new_from_static_string ("c"));
+
+	delta = ibus_lookup_table_diff (table, table1);
+	g_assert (delta->begin == 1);
+	g_assert (delta->n_removed == 1);
+	g_assert (delta->candidates->len == 2);
+	delta->generation = 7;
+
+	message = ibus_message_new (DBUS_MESSAGE_TYPE_METHOD_CALL);
+	ibus_message_iter_init_append (message, &iter);
+	retval = ibus_lookup_table_delta_serialize (delta, &iter, IBUS_SERIALIZE_COMPACT_TEXT);
+	g_assert (retval);
+	ibus_lookup_table_delta_free (delta);
+
+	retval = ibus_message_iter_init (message, &iter);
+	g_assert (retval);
+	delta = ibus_lookup_table_delta_deserialize (&iter);
+	g_assert (delta);
+	g_assert (delta->generation == 7);
+	ibus_message_unref (message);
+
+	g_object_unref (table1);
+	table1 = ibus_lookup_table_apply_delta (table, delta);
+	g_assert (table1);
+	g_assert (table1->candidates->len == 4);
+	g_assert (ibus_lookup_table_get_cursor_pos (table1) == 2);
+	g_assert (g_strcmp0 (ibus_lookup_table_get_candidate (table1, 0)->text, "a") == 0);
+	g_assert (g_strcmp0 (ibus_lookup_table_get_candidate (table1, 1)->text, "x") == 0);
+	g_assert (g_strcmp0 (ibus_lookup_table_get_candidate (table1, 2)->text, "y") == 0);
+	g_assert (g_strcmp0 (ibus_lookup_table_get_candidate (table1, 3)->text, "c") == 0);
+	ibus_lookup_table_delta_free (delta);
+
+	g_object_unref (table);
+	g_object_unref (table1);
+
 	return 0;
 }
@@ -0,0 +1,104 @@
+#include "ibus.h"
+
+int main()
+{
+	g_type_init ();
+	IBusMessage *message;
+	IBusMessageIter iter;
+	GArray *array;
+	guint32 values[] = { 0x61, 0, 0x62, IBUS_RELEASE_MASK, 0xff0d, IBUS_CONTROL_MASK };
+	guint32 n;
+	gboolean retval;
+	gint i;
+	GHashTable *table;
+	GValue *value;
+	gchar *string;
+	gboolean b;
+
+	message = ibus_message_new (DBUS_MESSAGE_TYPE_METHOD_CALL);
+
+	ibus_message_iter_init_append (message, &iter);
+	n = G_N_ELEMENTS (values);
+	retval = ibus_message_iter_append (&iter, G_TYPE_UINT, &n);
+	g_assert (retval);
+	retval = ibus_message_iter_append_uint_array (&iter, values, G_N_ELEMENTS (values));
+	g_assert (retval);
+	retval = ibus_message_iter_append_uint_array (&iter, NULL, 0);
+	g_assert (retval);
+
+	retval = ibus_message_iter_init (message, &iter);
+	g_assert (retval);
+
+	/* not an array */
+	g_assert (ibus_message_iter_get_uint_array (&iter) == NULL);
+
+	retval = ibus_message_iter_get (&iter, G_TYPE_UINT, &n);
+	g_assert (retval);
+	g_assert (n == G_N_ELEMENTS (values));
+
+	array = ibus_message_iter_get_uint_array (&iter);
+	g_assert (array);
+	g_assert (array->len == G_N_ELEMENTS (values));
+	for (i = 0; i < G_N_ELEMENTS (values); i++) {
+		g_assert (g_array_index (array, guint32, i) == values[i]);
+	}
+	g_array_free (array, TRUE);
+
+	array = ibus_message_iter_get_uint_array (&iter);
+	g_assert (array);
+	g_assert (array->len == 0);
+	g_array_free (array, TRUE);
+
+	ibus_message_unref (message);
+
+	/* name -> value tables */
+	table = ibus_value_table_new ();
+	value = g_slice_new0 (GValue);
+	g_value_init (value, G_TYPE_STRING);
+	g_value_set_string (value, "pinyin");
+	g_hash_table_insert (table, g_strdup ("engine"), value);
+	value = g_slice_new0 (GValue);
+	g_value_init (value, G_TYPE_INT);
+	g_value_set_int (value, 42);
+	g_hash_table_insert (table, g_strdup ("size"), value);
+
+	message = ibus_message_new (DBUS_MESSAGE_TYPE_METHOD_CALL);
+	ibus_message_iter_init_append (message, &iter);
+	retval = ibus_message_iter_append_value_table (&iter, table);
+	g_assert (retval);
+	g_hash_table_destroy (table);
+
+	retval = ibus_message_iter_init (message, &iter);
+	g_assert (retval);
+	table = ibus_message_iter_get_value_table (&iter);
+	g_assert (table);
+	g_assert (g_hash_table_size (table) == 2);
+	value = (GValue *) g_hash_table_lookup (table, "engine");
+	g_assert (value && G_VALUE_HOLDS_STRING (value));
+	g_assert (g_strcmp0 (g_value_get_string (value), "pinyin") == 0);
+	value = (GValue *) g_hash_table_lookup (table, "size");
+	g_assert (value && G_VALUE_HOLDS_INT (value));
+	g_assert (g_value_get_int (value) == 42);
+	g_hash_table_destroy (table);
+
+	ibus_message_unref (message);
+
+	/* the typed appends read back as ibus_message_append_args wrote them */
+	message = ibus_message_new_signal ("/org/freedesktop/IBus", "org.freedesktop.IBus", "Test");
+	ibus_message_iter_init_append (message, &iter);
+	g_assert (ibus_message_iter_append_uint (&iter, 42));
+	g_assert (ibus_message_iter_append_boolean (&iter, TRUE));
+	g_assert (ibus_message_iter_append_string (&iter, "pinyin"));
+
+	retval = ibus_message_get_args (message, NULL,
+	                                G_TYPE_UINT, &n,
+	                                G_TYPE_BOOLEAN, &b,
+	                                G_TYPE_STRING, &string,
+	                                G_TYPE_INVALID);
+	g_assert (retval);
+	g_assert (n == 42 && b == TRUE);
+	g_assert (g_strcmp0 (string, "pinyin") == 0);
+	ibus_message_unref (message);
+
+	return 0;
+}
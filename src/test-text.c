@@ -9,9 +9,10 @@ int main()
 	IBusMessage *message;
 	IBusError *error;
 	gboolean retval;
+	IBusMessageIter iter;
 
+	/* old peers read the full encoding only, it is the default */
 	text1 = ibus_text_new_from_string ("Hello");
-	text2 = ibus_text_new_from_static_string ("Hello");
 
 	message = ibus_message_new_signal ("/org/freedesktop/IBus",
 									   "org.freedesktop.IBus",
@@ -19,9 +20,40 @@ int main()
 
 	retval = ibus_message_append_args (message,
 									   IBUS_TYPE_SERIALIZABLE, &text1,
-									   IBUS_TYPE_SERIALIZABLE, &text2,
 									   G_TYPE_INVALID);
 	g_assert (retval);
+	g_assert (text1->attrs == NULL);
+	g_object_unref (text1);
+
+	retval = ibus_message_get_args (message,
+									&error,
+									IBUS_TYPE_SERIALIZABLE, &text1,
+									G_TYPE_INVALID);
+	g_assert (retval);
+	g_assert (text1->attrs != NULL);
+	g_assert (text1->attrs->attributes->len == 0);
+
+	g_object_unref (text1);
+	ibus_message_unref (message);
+
+	text1 = ibus_text_new_from_string ("Hello");
+	text2 = ibus_text_new_from_static_string ("Hello");
+
+	message = ibus_message_new_signal ("/org/freedesktop/IBus",
+									   "org.freedesktop.IBus",
+									   "Test");
+
+	ibus_message_iter_init_append (message, &iter);
+	retval = ibus_serializable_serialize_with_flags ((IBusSerializable *) text1,
+													 &iter,
+													 IBUS_SERIALIZE_COMPACT_TEXT);
+	g_assert (retval);
+	retval = ibus_serializable_serialize_with_flags ((IBusSerializable *) text2,
+													 &iter,
+													 IBUS_SERIALIZE_COMPACT_TEXT);
+	g_assert (retval);
+	/* the flags do not outlive the call */
+	g_assert (ibus_serializable_get_serialize_flags () == 0);
 	g_object_unref (text1);
 	g_object_unref (text2);
 
@@ -34,8 +66,47 @@ int main()
 	g_assert_cmpstr (text1->text, ==, "Hello");
 	g_assert_cmpstr (text2->text, ==, "Hello");
 
+	/* texts without attributes do not carry an attribute list */
+	g_assert (text1->attrs == NULL);
+	g_assert (text2->attrs == NULL);
+	g_assert (ibus_text_get_attributes (text1)->attributes->len == 0);
+
+	g_object_unref (text1);
+	g_object_unref (text2);
+	ibus_message_unref (message);
+
+	/* attributes survive, single characters are interned */
+	text1 = ibus_text_new_from_string ("Hello");
+	ibus_text_append_attribute (text1, IBUS_ATTR_TYPE_UNDERLINE,
+								IBUS_ATTR_UNDERLINE_SINGLE, 0, -1);
+	text2 = ibus_text_new_from_string ("\xe4\xbd\xa0");
+
+	message = ibus_message_new_signal ("/org/freedesktop/IBus",
+									   "org.freedesktop.IBus",
+									   "Test");
+	retval = ibus_message_append_args (message,
+									   IBUS_TYPE_SERIALIZABLE, &text1,
+									   IBUS_TYPE_SERIALIZABLE, &text2,
+									   G_TYPE_INVALID);
+	g_assert (retval);
+	g_object_unref (text1);
+	g_object_unref (text2);
+
+	retval = ibus_message_get_args (message,
+									&error,
+									IBUS_TYPE_SERIALIZABLE, &text1,
+									IBUS_TYPE_SERIALIZABLE, &text2,
+									G_TYPE_INVALID);
+	g_assert (retval);
+	g_assert (text1->attrs != NULL);
+	g_assert (text1->attrs->attributes->len == 1);
+	g_assert (ibus_attr_list_get (text1->attrs, 0)->end_index == 5);
+	g_assert (text2->is_static);
+	g_assert (text2->text == g_intern_string ("\xe4\xbd\xa0"));
+
 	g_object_unref (text1);
 	g_object_unref (text2);
+	ibus_message_unref (message);
 
 	return 0;
 